@@ -0,0 +1,412 @@
+/*
+ * Bench.cxx
+ * Benchmark harness rendering scripted, deterministic scenes and reporting their costs as JSON.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../include/Vulkray/ShowBase.h"
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BENCH_WARMUP_FRAMES 60 // not measured (pipeline compiles, first uploads, arena growth)
+#define BENCH_MEASURED_FRAMES PROFILER_HISTORY_FRAMES // exactly the profiler's rolling window
+#define BENCH_DEFAULT_THRESHOLD 10.0 // percent a metric may grow by before it counts as a regression
+
+/* Every heap allocation of the process, the engine's included (the executable's operator new takes over
+ * the shared library's calls too). The allocations per frame are counted over the measured frames only.
+ */
+static std::atomic<uint64_t> allocationCount = 0;
+
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+
+// xorshift32, every scene is seeded the same way so consecutive runs (and commits) do the exact same work
+struct BenchRandom {
+    uint32_t state = 0x2545F491;
+    uint32_t next() {
+        this->state ^= this->state << 13;
+        this->state ^= this->state >> 17;
+        this->state ^= this->state << 5;
+        return this->state;
+    }
+    float unit() { return (float) (this->next() & 0xFFFFFF) / (float) 0xFFFFFF; } // 0 - 1
+};
+
+struct BenchScene;
+struct BenchContext {
+    BenchScene *scene;
+    BenchRandom random;
+    uint32_t frame = 0;
+    uint64_t warmupAllocations = 0;
+    uint64_t finalAllocations = 0;
+    std::atomic<uint64_t> keyEvents = 0;
+    std::vector<MeshHandle> meshes;
+};
+
+struct BenchScene {
+    const char *name;
+    const char *description;
+    void (*setup)(BenchContext *context, ShowBase *base); // before launch()
+    void (*frame)(BenchContext *context, ShowBase *base); // serial job, runs first in every frame
+};
+
+struct BenchResult {
+    std::string scene;
+    double frameTimes[4]; // p50, p90, p99, max (ms)
+    double gpuFrameTimes[4];
+    std::vector<std::pair<std::string, std::pair<double, double>>> stages; // name, (p50, p99)
+    double allocationsPerFrame;
+    uint64_t keyEvents;
+    unsigned int workers;
+};
+
+static const double reportedPercentiles[4] = {50, 90, 99, 100};
+
+// ---------- Scene helpers ---------- //
+
+static void addCubeMesh(BenchContext *context, ShowBase *base) {
+    glm::vec3 color = {context->random.unit(), context->random.unit(), context->random.unit()};
+    std::vector<Vertex> vertices;
+    for (uint32_t i = 0; i < 8; i++) {
+        glm::vec3 corner = {i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f};
+        vertices.push_back({corner, color});
+    }
+    std::vector<uint32_t> indices = {
+            0, 2, 3, 3, 1, 0, 4, 5, 7, 7, 6, 4, 0, 1, 5, 5, 4, 0,
+            2, 6, 7, 7, 3, 2, 0, 4, 6, 6, 2, 0, 1, 3, 7, 7, 5, 1
+    };
+    context->meshes.push_back(base->meshes->add_mesh(vertices, indices));
+}
+
+static std::vector<InstanceData> gridInstances(BenchContext *context, uint32_t count) {
+    std::vector<InstanceData> instances(count);
+    for (InstanceData &instance : instances) {
+        instance.model = glm::mat4(1.0f);
+        instance.model[3] = glm::vec4(context->random.unit() * 40.0f, context->random.unit() * 40.0f - 20.0f,
+                                      context->random.unit() * 40.0f - 20.0f, 1.0f);
+        instance.materialIndex = 0;
+    }
+    return instances;
+}
+
+static void keepFrame(BenchContext *context, ShowBase *base) {} // scenes that are set up once
+
+// ---------- Scenes ---------- //
+
+// 256 meshes with 16 instances each, nothing changes after the first frame
+static void staticMeshesSetup(BenchContext *context, ShowBase *base) {
+    for (uint32_t i = 0; i < 256; i++) {
+        addCubeMesh(context, base);
+        base->meshes->set_mesh_instances(context->meshes.back(), gridInstances(context, 16));
+    }
+}
+
+// 64 meshes, every frame one is replaced, another one's vertices & instances are updated
+static void meshChurnSetup(BenchContext *context, ShowBase *base) {
+    for (uint32_t i = 0; i < 64; i++) {
+        addCubeMesh(context, base);
+        base->meshes->set_mesh_instances(context->meshes.back(), gridInstances(context, 8));
+    }
+}
+
+static void meshChurnFrame(BenchContext *context, ShowBase *base) {
+    uint32_t replaced = context->random.next() % context->meshes.size();
+    base->meshes->remove_mesh(context->meshes[replaced]);
+    std::swap(context->meshes[replaced], context->meshes.back());
+    context->meshes.pop_back();
+    addCubeMesh(context, base);
+    base->meshes->set_mesh_instances(context->meshes.back(), gridInstances(context, 8));
+
+    MeshHandle updated = context->meshes[context->random.next() % context->meshes.size()];
+    std::vector<Vertex> vertices(8);
+    for (uint32_t i = 0; i < 8; i++) {
+        vertices[i].pos = {i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f};
+        vertices[i].color = {context->random.unit(), context->random.unit(), context->random.unit()};
+    }
+    base->meshes->update_mesh_vertices(updated, 0, vertices);
+    base->meshes->set_mesh_instances(updated, gridInstances(context, 8));
+}
+
+// 512 jobs of fixed busywork over every priority, in dependency chains of up to 4 jobs
+static void busyworkJob(void *caller, ShowBase *base) {
+    volatile uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < 2000; i++) hash = (hash ^ i) * 16777619u;
+}
+
+static void manyJobsSetup(BenchContext *context, ShowBase *base) {
+    addCubeMesh(context, base);
+    base->meshes->set_mesh_instances(context->meshes.back(), gridInstances(context, 1));
+    JobHandle previous;
+    for (uint32_t i = 0; i < 512; i++) {
+        JobOptions options;
+        options.priority = (int) (context->random.next() % JOB_PRIORITY_COUNT);
+        if (i % 4 != 0) {
+            options.dependencies[0] = previous;
+            options.dependencyCount = 1;
+        }
+        options.beforeUniformUpdate = i % 64 == 0;
+        previous = base->jobManager->new_job("bench_busywork", context, busyworkJob, options);
+    }
+}
+
+// 1024 key callbacks spread over 16 keys, fed 64 key events every frame (the builtin camera keys are avoided)
+static const char *benchKeys[16] = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "f", "g", "h", "i", "j", "k"};
+static const int benchGlfwKeys[16] = {GLFW_KEY_0, GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4, GLFW_KEY_5,
+                                      GLFW_KEY_6, GLFW_KEY_7, GLFW_KEY_8, GLFW_KEY_9, GLFW_KEY_F, GLFW_KEY_G,
+                                      GLFW_KEY_H, GLFW_KEY_I, GLFW_KEY_J, GLFW_KEY_K};
+
+static void benchKeyCallback(void *caller, ShowBase *base, int action) {
+    ((BenchContext*) caller)->keyEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void inputCallbacksSetup(BenchContext *context, ShowBase *base) {
+    addCubeMesh(context, base);
+    base->meshes->set_mesh_instances(context->meshes.back(), gridInstances(context, 1));
+    for (uint32_t i = 0; i < 1024; i++) base->input->new_accept_key(benchKeys[i % 16], context, benchKeyCallback);
+}
+
+static void inputCallbacksFrame(BenchContext *context, ShowBase *base) {
+    for (uint32_t i = 0; i < 64; i++) {
+        int key = benchGlfwKeys[context->random.next() % 16];
+        int action = (int) (context->random.next() % 3); // released, pressed or held
+        base->input->_non_static_key_callback(key, 0, action, 0);
+    }
+}
+
+// a resolution change every 4th frame, between 640x360 and 1920x1080
+static void resizeStormSetup(BenchContext *context, ShowBase *base) {
+    staticMeshesSetup(context, base);
+}
+
+static void resizeStormFrame(BenchContext *context, ShowBase *base) {
+    if (context->frame % 4 != 0) return;
+    unsigned int width = 640 + context->random.next() % 1281;
+    unsigned int height = 360 + context->random.next() % 721;
+    base->set_window_size(width, height);
+}
+
+static BenchScene benchScenes[] = {
+        {"static_meshes", "256 meshes, 4096 instances", staticMeshesSetup, keepFrame},
+        {"mesh_churn", "a mesh replaced & another updated every frame", meshChurnSetup, meshChurnFrame},
+        {"many_jobs", "512 jobs in dependency chains", manyJobsSetup, keepFrame},
+        {"input_callbacks", "1024 key callbacks, 64 key events a frame", inputCallbacksSetup, inputCallbacksFrame},
+        {"resize_storm", "static_meshes resized every 4th frame", resizeStormSetup, resizeStormFrame},
+};
+
+// ---------- Running & reporting ---------- //
+
+static void benchFrameJob(void *caller, ShowBase *base) {
+    BenchContext *context = (BenchContext*) caller;
+    if (context->frame == BENCH_WARMUP_FRAMES) context->warmupAllocations = allocationCount.load();
+    context->scene->frame(context, base);
+    context->frame++;
+    if (context->frame == BENCH_WARMUP_FRAMES + BENCH_MEASURED_FRAMES) {
+        context->finalAllocations = allocationCount.load();
+    }
+}
+
+static void benchStopJob(void *caller, ShowBase *base) {
+    if (((BenchContext*) caller)->frame >= BENCH_WARMUP_FRAMES + BENCH_MEASURED_FRAMES) base->stop();
+}
+
+static BenchResult runScene(BenchScene *scene, bool windowed) {
+    EngineConfig config;
+    config.windowTitle = "Vulkray Benchmark";
+    config.pipelineCachePath = nullptr; // every run compiles the same pipelines
+    config.headless = !windowed;
+    config.headlessWidth = 1280;
+    config.headlessHeight = 720;
+    config.headlessFrameCount = BENCH_WARMUP_FRAMES + BENCH_MEASURED_FRAMES;
+    config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; // windowed runs shouldn't be capped by the display
+    config.profiling = true;
+
+    BenchContext context;
+    context.scene = scene;
+    BenchResult result;
+    {
+        ShowBase base(config);
+        base.camera->set_xyz(-10, 0, 0);
+        base.camera->set_fov(70);
+        scene->setup(&context, &base);
+        base.jobManager->new_job("bench_frame", &context, benchFrameJob); // serial, runs before the scene's jobs
+        if (windowed) {
+            base.jobManager->new_job("bench_stop", &context, benchStopJob); // no frame count outside headless
+        }
+        base.launch();
+
+        result.scene = scene->name;
+        for (int i = 0; i < 4; i++) {
+            result.frameTimes[i] = base.profiler->get_frame_time(reportedPercentiles[i]);
+            result.gpuFrameTimes[i] = base.profiler->get_gpu_frame_time(reportedPercentiles[i]);
+        }
+        for (const char *stage : base.profiler->get_stage_names()) {
+            result.stages.push_back({stage, {base.profiler->get_stage_time(stage, 50),
+                                             base.profiler->get_stage_time(stage, 99)}});
+        }
+        result.workers = base.jobManager->get_worker_count();
+    }
+    // the measured frames are the allocation counter's last snapshots (the profiler's window covers the same)
+    result.allocationsPerFrame = (double) (context.finalAllocations - context.warmupAllocations) /
+                                 (double) (BENCH_MEASURED_FRAMES - 1);
+    result.keyEvents = context.keyEvents;
+    spdlog::info("[bench] {0}: frame p50 {1:.3f} ms, p99 {2:.3f} ms, {3:.1f} allocations a frame", result.scene,
+                 result.frameTimes[0], result.frameTimes[2], result.allocationsPerFrame);
+    return result;
+}
+
+// Flat keys per scene (the stages last), so the baseline comparison can read the report back without a parser
+static std::string writeReport(const std::vector<BenchResult> &results, bool windowed) {
+    std::stringstream json;
+    json << std::fixed << std::setprecision(4);
+    json << "{\n  \"warmup_frames\": " << BENCH_WARMUP_FRAMES << ",\n  \"measured_frames\": "
+         << BENCH_MEASURED_FRAMES << ",\n  \"headless\": " << (windowed ? "false" : "true") << ",\n  \"scenes\": {";
+    const char *percentileNames[4] = {"p50", "p90", "p99", "max"};
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        json << (i == 0 ? "\n" : ",\n") << "    \"" << result.scene << "\": {\n";
+        for (int p = 0; p < 4; p++) json << "      \"frame_" << percentileNames[p] << "_ms\": "
+                                          << result.frameTimes[p] << ",\n";
+        for (int p = 0; p < 4; p++) json << "      \"gpu_" << percentileNames[p] << "_ms\": "
+                                          << result.gpuFrameTimes[p] << ",\n";
+        json << "      \"allocations_per_frame\": " << result.allocationsPerFrame << ",\n";
+        json << "      \"key_events\": " << result.keyEvents << ",\n";
+        json << "      \"job_workers\": " << result.workers << ",\n";
+        json << "      \"stages\": {";
+        for (size_t s = 0; s < result.stages.size(); s++) {
+            json << (s == 0 ? "\n" : ",\n") << "        \"" << result.stages[s].first << "\": {\"p50_ms\": "
+                 << result.stages[s].second.first << ", \"p99_ms\": " << result.stages[s].second.second << "}";
+        }
+        json << "\n      }\n    }";
+    }
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+// Reads a scene's metric back from a report written by writeReport() (false = the baseline doesn't have it)
+static bool readBaselineMetric(const std::string &baseline, const std::string &scene, const char *key,
+                               double *value) {
+    size_t sceneStart = baseline.find("\"" + scene + "\": {");
+    if (sceneStart == std::string::npos) return false;
+    size_t sceneEnd = baseline.find("\"stages\"", sceneStart);
+    size_t keyStart = baseline.find("\"" + std::string(key) + "\":", sceneStart);
+    if (keyStart == std::string::npos || keyStart > sceneEnd) return false;
+    *value = std::strtod(baseline.c_str() + baseline.find(':', keyStart) + 1, nullptr);
+    return true;
+}
+
+// Flags the metrics that grew by more than the threshold since the baseline report
+static bool compareWithBaseline(const std::vector<BenchResult> &results, const std::string &baseline,
+                                double threshold) {
+    bool regressed = false;
+    for (const BenchResult &result : results) {
+        struct { const char *key; double current; double slack; } metrics[] = {
+                {"frame_p50_ms", result.frameTimes[0], 0.0},
+                {"frame_p99_ms", result.frameTimes[2], 0.0},
+                {"allocations_per_frame", result.allocationsPerFrame, 0.5}, // a stray allocation isn't a trend
+        };
+        for (auto &metric : metrics) {
+            double previous;
+            if (!readBaselineMetric(baseline, result.scene, metric.key, &previous)) {
+                spdlog::warn("[bench] The baseline has no {0} for {1}, skipped.", metric.key, result.scene);
+                continue;
+            }
+            double limit = previous * (1.0 + threshold / 100.0) + metric.slack;
+            if (metric.current <= limit) continue;
+            spdlog::error("[bench] {0} regressed on {1}: {2:.4f} (baseline {3:.4f}, limit {4:.4f})",
+                          metric.key, result.scene, metric.current, previous, limit);
+            regressed = true;
+        }
+    }
+    return regressed;
+}
+
+static void printUsage() {
+    std::cout << "Usage: vulkray-bench [--scene NAME] [--output FILE] [--baseline FILE] [--threshold PERCENT]"
+                 " [--windowed]\n\nScenes:\n";
+    for (BenchScene &scene : benchScenes) std::cout << "  " << scene.name << " - " << scene.description << "\n";
+}
+
+int main(int argc, char **argv) {
+    const char *sceneName = nullptr;
+    const char *outputPath = nullptr;
+    const char *baselinePath = nullptr;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    bool windowed = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--scene") == 0 && hasValue) sceneName = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && hasValue) outputPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue) baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue) threshold = std::strtod(argv[++i], nullptr);
+        else if (strcmp(argv[i], "--windowed") == 0) windowed = true;
+        else {
+            printUsage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    try {
+        for (BenchScene &scene : benchScenes) {
+            if (sceneName != nullptr && strcmp(scene.name, sceneName) != 0) continue;
+            results.push_back(runScene(&scene, windowed));
+        }
+    } catch (const std::exception &exception) {
+        std::cerr << "An exception was thrown by the engine:\n" << exception.what() << "\n";
+        return 1;
+    }
+    if (results.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    std::string report = writeReport(results, windowed);
+    if (outputPath != nullptr) {
+        std::ofstream file(outputPath, std::ios::trunc);
+        file << report;
+        if (!file) {
+            spdlog::error("[bench] Could not write the report to '{0}'.", outputPath);
+            return 1;
+        }
+    } else {
+        std::cout << report;
+    }
+
+    if (baselinePath != nullptr) {
+        std::ifstream file(baselinePath);
+        if (!file) {
+            spdlog::error("[bench] Could not read the baseline report '{0}'.", baselinePath);
+            return 1;
+        }
+        std::stringstream baseline;
+        baseline << file.rdbuf();
+        if (compareWithBaseline(results, baseline.str(), threshold)) return 3;
+        spdlog::info("[bench] No regressions over {0}% against '{1}'.", threshold, baselinePath);
+    }
+    return 0;
+}
@@ -72,13 +72,14 @@ Application::Application() {
 
 void Application::cameraSpinJob(void *caller, ShowBase *base) {
     Application *self = (Application*)caller; // cast void pointer to defined class
-    //base->camera->set_h(base->camera->h + 1);
-    spdlog::info("Cam XYZ: {}, {}, {}", base->camera->x, base->camera->y, base->camera->z);
-    spdlog::info("Cam Look At: {}, {}, {}",
-                 base->camera->get_look_at_vector().x,
-                 base->camera->get_look_at_vector().y,
-                 base->camera->get_look_at_vector().z);
-    spdlog::info("Cam HPR : {}, {}, {}", base->camera->h, base->camera->p, base->camera->r);
+    //base->camera->set_h(base->camera->get_hpr().x + 1);
+    Vector3 camPos = base->camera->get_xyz();
+    Vector3 camHpr = base->camera->get_hpr();
+    glm::vec3 camLookAt = base->camera->get_look_at_vector(); // cached until the camera turns
+    // runs every frame, so the camera is only printed once a second
+    VULKRAY_LOG_EVERY_MS(spdlog::level::info, 1000, "Cam XYZ: {}, {}, {} | Look At: {}, {}, {} | HPR: {}, {}, {}",
+                         camPos.x, camPos.y, camPos.z, camLookAt.x, camLookAt.y, camLookAt.z,
+                         camHpr.x, camHpr.y, camHpr.z);
 }
 
 void Application::toggleBuiltinCameraControl(void *caller, ShowBase *base, int action) {
@@ -32,11 +32,15 @@ public:
     void set_fov(float fov);
     float get_fov_radians();
     glm::mat4x4 get_view_matrix();
+    CameraState get_state(); // as of the last update()
+    static glm::mat4x4 compose_view_matrix(glm::vec3 eye, glm::vec3 lookAt);
     void create_view_matrix();
     void calculate_look_vector();
     glm::vec3 get_look_at_vector();
 private:
     glm::mat4x4 view_matrix;
+    uint32_t viewVersion = UINT32_MAX; // transform version the view matrix was built from
+    uint32_t lookVersion = UINT32_MAX; // transform version the look at vector was calculated from
     glm::vec3 look_at_vector = {1.0f, 0.0f, 0.0f}; // looking at +X by default
     float fov_radians;
     /*
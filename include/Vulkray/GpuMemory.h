@@ -0,0 +1,83 @@
+/*
+ * GpuMemory.h
+ * API Header - Defines the GpuMemory class reporting the GPU memory heaps' usage, budgets & allocations.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_GPUMEMORY_H
+#define VULKRAY_API_GPUMEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define MEMORY_CATEGORY_VERTEX 0
+#define MEMORY_CATEGORY_INDEX 1
+#define MEMORY_CATEGORY_UNIFORM 2
+#define MEMORY_CATEGORY_IMAGE 3 // render targets
+#define MEMORY_CATEGORY_STAGING 4 // host visible transfer buffers (uploads & headless readback)
+#define MEMORY_CATEGORY_OTHER 5 // storage & indirect buffers (culling, draw lists)
+#define MEMORY_CATEGORY_TEXTURE 6 // streamed textures (ShowBase::textures)
+#define MEMORY_CATEGORY_COUNT 7
+#define MEMORY_PRESSURE_REPEAT_FRAMES 60 // the pressure callback repeats this often while a heap stays over
+
+class ShowBase; // prototype ShowBase class
+
+struct GpuHeapBudget {
+    uint32_t heapIndex;
+    bool deviceLocal;
+    uint64_t heapSize;
+    uint64_t usage; // bytes used by the whole process (other Vulkan devices & APIs included with the extension)
+    uint64_t budget; // bytes the process can use before the driver starts paging (or failing allocations)
+    uint64_t blockBytes; // bytes the engine itself allocated from the heap
+};
+
+struct GpuMemoryCategory {
+    uint64_t allocationCount;
+    uint64_t bytes;
+};
+
+/* The renderer's GPU memory, refreshed once per frame. With VK_EXT_memory_budget the usage & budgets come from
+ * the driver, otherwise VMA estimates them (its own allocations against 80% of every heap).
+ * Every getter can be called from any thread (e.g. a job), they return nothing while the renderer isn't running.
+ */
+class GpuMemory {
+private:
+    std::mutex mutex;
+    VmaAllocator allocator = VK_NULL_HANDLE; // only set while the renderer runs
+    std::vector<GpuHeapBudget> heaps;
+    std::vector<uint32_t> pressureFrames; // per heap, frames since the callback last fired for it (0 = not over)
+    std::atomic<uint64_t> categoryCounts[MEMORY_CATEGORY_COUNT]{};
+    std::atomic<uint64_t> categoryBytes[MEMORY_CATEGORY_COUNT]{};
+    float pressureThreshold;
+    void *pressureCaller = nullptr;
+    void (*pressureCallback)(void *caller, ShowBase *base, const GpuHeapBudget &heap) = nullptr;
+public:
+    GpuMemory(float pressureThreshold);
+    std::vector<GpuHeapBudget> get_heap_budgets();
+    GpuMemoryCategory get_category(int category); // MEMORY_CATEGORY_*
+    static const char *get_category_name(int category);
+    std::string get_stats_string(bool detailed = false); // VMA's JSON dump (detailed = every single allocation)
+    /* Called on the render thread once a heap's usage goes over pressureThreshold of its budget (and again every
+     * MEMORY_PRESSURE_REPEAT_FRAMES frames while it stays over), so streamed assets can be evicted in time.
+     */
+    void set_pressure_callback(void *caller, void (*pFunction)(void *caller, ShowBase *base,
+                                                               const GpuHeapBudget &heap));
+    // used by the vulkan renderer module
+    void _set_allocator(VmaAllocator allocator); // VK_NULL_HANDLE once it's destroyed
+    void _track_allocation(int category, uint64_t size);
+    void _untrack_allocation(int category, uint64_t size);
+    void _update_budgets(ShowBase *base);
+};
+
+#endif //VULKRAY_API_GPUMEMORY_H
@@ -14,21 +14,30 @@
 #define VULKRAY_API_INPUTMANAGER_H
 
 #include "Vulkan.h"
+#include "Logging.h"
 #include <GLFW/glfw3.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #define KEY_RELEASED 0
 #define KEY_PRESSED 1
 #define KEY_HELD 2
 #define KEY_EITHER 3
 #define KEY_ANY 4
+#define INPUT_EVENT_KEY 0
+#define INPUT_EVENT_CURSOR 1
+#define INPUT_QUEUE_CAPACITY 1024 // power of two, events past it are dropped until the next frame drains the queue
 
 struct GLFWKeyAlias {
     int glfwKeyID;
     std::string keyAlias;
 };
 struct KeyCallback {
-    std::string key;
+    int glfwKeyID; // resolved from the key alias when the callback is registered
     int action; // integer in 0-4 range
     void *caller; // pointer to class that created callback
     void(*pFunction)(void *caller, ShowBase *base, int action); // all callbacks must return void
@@ -39,11 +48,49 @@ struct CursorCallback {
     void(*pFunction)(void *caller, ShowBase *base, double x, double y); // all callbacks must return void
 };
 
+struct InputEvent {
+    int type; // INPUT_EVENT_*
+    int key; // GLFW key code & action of key events
+    int action;
+    double x, y; // cursor position of cursor events
+    uint64_t timestamp; // steady clock nanoseconds when GLFW handed the event over
+};
+
+/* Lock-free single producer / single consumer ring of input events. The producer is GLFW's event callbacks,
+ * the consumer the render thread draining the queue once per frame.
+ */
+class InputEventQueue {
+private:
+    std::array<InputEvent, INPUT_QUEUE_CAPACITY> events;
+    // on their own cache lines, so the producer & consumer don't invalidate each other's
+    alignas(64) std::atomic<uint64_t> head{0}; // next event to pop, only written by the consumer
+    alignas(64) std::atomic<uint64_t> tail{0}; // next slot to push into, only written by the producer
+public:
+    bool push(const InputEvent &event); // false once full
+    bool pop(InputEvent *event); // false once empty
+};
+
 class InputManager {
 private:
+    ShowBase *base; // handed to the callbacks (there's no window in headless mode)
     Window *m_window;
-    std::vector<KeyCallback> keyCallbacks;
+    // callbacks indexed by GLFW key code, so a key event only looks at the callbacks of that key
+    std::array<std::vector<KeyCallback>, GLFW_KEY_LAST + 1> keyCallbacks;
+    std::unordered_map<std::string, int> aliasKeyIDs; // key alias -> GLFW key code (built from keyAliases)
     std::vector<CursorCallback> cursorCallbacks;
+    bool queued; // events go through the queue & are dispatched once per frame instead of while GLFW polls
+    InputEventQueue eventQueue;
+    std::atomic<uint64_t> droppedEvents{0};
+    uint64_t reportedDrops = 0;
+    std::atomic<int64_t> dropsLogged{VULKRAY_LOG_SITE_NEVER_LOGGED}; // drops are reported once per log interval at most
+    bool cursorKnown = false; // the first cursor position only sets where the deltas start from
+    double cursorX = 0, cursorY = 0;
+    double cursorDeltaX = 0, cursorDeltaY = 0; // accumulated since the last dispatch
+    double frameDeltaX = 0, frameDeltaY = 0; // the last dispatched frame's
+    int findKeyID(const char *key, const char *caller);
+    void dispatchKey(int key, int action);
+    void dispatchCursor(double x_pos, double y_pos);
+    void moveCursor(double x_pos, double y_pos);
     static void static_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
     static void static_cursor_callback(GLFWwindow* window, double x_pos, double y_pos);
 
@@ -92,7 +139,9 @@ private:
             {GLFW_KEY_KP_7, "np_7"}, {GLFW_KEY_KP_8, "np_8"}, {GLFW_KEY_KP_9, "np_9"}
     };
 public:
-    InputManager();
+    /* queued: GLFW's callbacks only push timestamped events into a lock-free queue, drained by the render thread
+     * at the start of every frame. Cursor motion is coalesced, the cursor callbacks get one position per frame. */
+    InputManager(ShowBase *base, bool queued = false);
     ~InputManager();
     void new_accept_key(const char *key, int action, void *caller,
                     void (*pFunction)(void *caller, ShowBase *base, int action));
@@ -103,10 +152,13 @@ public:
     void remove_accept_key(const char *key, int action);
     void remove_accept_key(const char *key);
     void remove_accept_cursor(const char* id);
+    void get_cursor_delta(double *x, double *y); // the cursor's motion over the last frame (callbacks & jobs)
+    uint64_t get_dropped_events(); // queued events lost to a full queue
     static void _static_init_glfw_input(Vulkan *m_vulkan);
     void _non_static_init_glfw_input(Window *m_window);
     void _non_static_key_callback(int key, int scancode, int action, int mods);
     void _non_static_cursor_callback(double x_pos, double y_pos);
+    uint64_t _dispatch_events(); // once per frame, returns the oldest dispatched event's age in ns (0 = none)
 };
 
 #endif //VULKRAY_API_INPUTMANAGER_H
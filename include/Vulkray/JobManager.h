@@ -13,26 +13,169 @@
 #ifndef VULKRAY_API_JOBMANAGER_H
 #define VULKRAY_API_JOBMANAGER_H
 
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#define JOB_PRIORITY_LOW 0
+#define JOB_PRIORITY_NORMAL 1
+#define JOB_PRIORITY_HIGH 2
+#define JOB_PRIORITY_COUNT 3
+#define JOB_MAX_DEPENDENCIES 4
+#define JOB_SLOT_NONE UINT32_MAX
+
 class ShowBase; // prototype ShowBase class
 
+// Stable reference to a registered job. Goes stale (instead of pointing at another job) once the job is removed.
+struct JobHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 = null handle, slot generations start at 1
+    bool operator==(const JobHandle &other) const = default;
+};
+
+struct JobOptions {
+    int priority = JOB_PRIORITY_NORMAL; // higher priority jobs are picked up first by the workers
+    bool beforeUniformUpdate = false; // renderer waits for this job before updating the frame's UBO
+    // runs on the thread dispatching the frame's jobs instead of a worker (jobs using GLFW or unsynchronized state)
+    bool mainThread = false;
+    JobHandle dependencies[JOB_MAX_DEPENDENCIES]{}; // registered jobs that have to finish first (same frame)
+    uint32_t dependencyCount = 0;
+};
+
 struct JobCallback {
+    /* only kept for the name based remove_job() (the hash is compared first, the name settles collisions).
+     * Names longer than the string's small buffer still allocate once per new_job(), callbacks are moved after. */
+    uint64_t nameHash;
     std::string name;
     void *caller; // pointer to class that created job callback
     void(*pFunction)(void *caller, ShowBase *base); // all jobs must return void
+    JobOptions options;
+    /* Jobs registered without options keep the original semantics: they run one after another
+     * in registration order on the thread dispatching the frame's jobs, and always finish before the UBO update.
+     */
+    bool serial = false;
+    uint32_t slot; // slot map entry pointing at this callback
 };
 
 class JobManager {
 private:
+    struct Task {
+        void(*pFunction)(JobManager *self, void *context, uint32_t index);
+        void *context;
+        uint32_t index;
+    };
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks[JOB_PRIORITY_COUNT];
+    };
+    struct JobSlot {
+        uint32_t generation = 1;
+        uint32_t denseIndex = 0; // index into jobCallbacks (or the next free slot while unused)
+        uint32_t previousSerial = JOB_SLOT_NONE; // registration order of the serial jobs
+        uint32_t nextSerial = JOB_SLOT_NONE;
+        bool alive = false;
+    };
+    struct FrameJob {
+        void *caller;
+        void(*pFunction)(void *caller, ShowBase *base);
+        int priority;
+        bool beforeUniformUpdate;
+        bool mainThread;
+        uint32_t dependencyCount;
+        uint32_t firstDependent; // range in frameDependents of the jobs waiting on this one
+        uint32_t dependentCount;
+    };
+    struct ParallelBatch {
+        void *caller;
+        void(*pFunction)(void *caller, uint32_t index);
+        std::atomic<uint32_t> remaining;
+        std::mutex errorMutex;
+        std::exception_ptr error = nullptr; // first failed task, rethrown by _run_parallel() only
+    };
+    struct BackgroundTask {
+        void *caller;
+        void(*pFunction)(void *caller, uint32_t index);
+        uint32_t index;
+    };
+    // registered jobs, a slot map over a dense array (modified by the user API, compiled into the frame graph)
+    std::mutex registryMutex;
+    std::vector<JobSlot> jobSlots;
     std::vector<JobCallback> jobCallbacks;
+    uint32_t freeSlot = JOB_SLOT_NONE;
+    uint32_t firstSerialSlot = JOB_SLOT_NONE;
+    uint32_t lastSerialSlot = JOB_SLOT_NONE;
+    bool graphDirty = true;
+    // compiled frame job graph (only touched between frames, buffers are reused to avoid reallocating)
+    std::vector<FrameJob> frameJobs;
+    std::vector<uint32_t> frameDependents;
+    std::vector<std::pair<uint32_t, uint32_t>> graphEdges; // (dependency, dependent) scratch buffer
+    std::vector<uint32_t> sortCounts; // cycle check scratch buffers
+    std::vector<uint32_t> sortStack;
+    std::unique_ptr<std::atomic<uint32_t>[]> pendingDependencies;
+    size_t pendingCapacity = 0;
+    std::atomic<uint32_t> remainingJobs = 0;
+    std::atomic<uint32_t> remainingUniformJobs = 0;
+    ShowBase *frameBase = nullptr;
+    // worker threads & work-stealing queues (last queue belongs to non-worker threads, e.g. the render thread)
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<TaskQueue>> taskQueues;
+    std::mutex sleepMutex;
+    std::condition_variable wakeSignal;
+    std::atomic<uint32_t> queuedTasks = 0;
+    bool stopping = false;
+    // frame jobs only the dispatching thread runs (while it waits on the frame's jobs)
+    TaskQueue mainThreadQueue;
+    std::atomic<uint32_t> queuedMainThreadTasks = 0;
+    std::atomic<std::thread::id> dispatchThread;
+    // tasks not tied to any frame, only picked up by idle workers (guarded by the sleep mutex)
+    std::deque<BackgroundTask> backgroundTasks;
+    uint32_t runningBackgroundTasks = 0;
+    std::mutex errorMutex;
+    std::exception_ptr jobError = nullptr;
+
+    JobHandle addJob(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base),
+                     const JobOptions &options, bool serial);
+    void removeSlot(uint32_t slot);
+    bool isAlive(JobHandle handle);
+    void compileFrameGraph();
+    void pushTask(Task task, int priority, size_t queueIndex);
+    void queueFrameJob(uint32_t index, size_t queueIndex);
+    bool tryRunTask(int minPriority);
+    bool tryRunMainThreadTask();
+    bool tryRunBackgroundTask();
+    bool tryRunBatchTask(ParallelBatch &batch);
+    void helpUntilZero(std::atomic<uint32_t> &counter, int minPriority);
+    void notifyWaiters();
+    void rethrowJobError();
+    void workerLoop(size_t workerIndex);
+    size_t localQueueIndex();
+    static void runFrameJob(JobManager *self, void *context, uint32_t index);
+    static void runParallelTask(JobManager *self, void *context, uint32_t index);
 public:
-    JobManager();
+    JobManager(unsigned int workerCount); // 0 = one worker per hardware thread (minus the render thread)
     ~JobManager();
-    std::vector<JobCallback> _get_job_callbacks_vector();
-    void new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base));
-    void remove_job(const char *jobName);
+    JobHandle new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base));
+    JobHandle new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base),
+                      const JobOptions &options);
+    void remove_job(JobHandle handle); // O(1)
+    void remove_job(const char *jobName); // scans the registered jobs, prefer removing by handle
+    bool is_job_valid(JobHandle handle);
+    unsigned int get_worker_count();
+    // used by the vulkan renderer module
+    void _dispatch_frame_jobs(ShowBase *base);
+    void _wait_for_uniform_jobs();
+    void _wait_for_frame_jobs();
+    void _run_parallel(uint32_t count, void *caller, void (*pFunction)(void *caller, uint32_t index));
+    void _run_background(void *caller, void (*pFunction)(void *caller, uint32_t index), uint32_t index);
+    void _wait_for_background_tasks();
 };
 
 #endif //VULKRAY_API_JOBMANAGER_H
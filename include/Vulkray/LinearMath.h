@@ -0,0 +1,239 @@
+/*
+ * LinearMath.h
+ * API Header - Defines the SIMD backed Vector4, Quaternion & Matrix4 types, and the batch math kernels.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_LINEARMATH_H
+#define VULKRAY_API_LINEARMATH_H
+
+#include "Vector3.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// SSE2 is part of x86-64 & NEON of AArch64, so neither needs extra compiler flags (anything else is scalar)
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LINMATH_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LINMATH_NEON
+#endif
+
+#define LINMATH_KERNEL_BATCH 64 // elements the batch kernels process per chunk (their scratch is on the stack)
+
+/* 4 lane float operations the types below are built on. Constant evaluated code never gets here, every
+ * operation has a scalar path for it.
+ */
+namespace linmath {
+#if defined(LINMATH_SSE2)
+    typedef __m128 float4;
+    inline float4 load4(const float *values) { return _mm_load_ps(values); }
+    inline void store4(float *values, float4 vector) { _mm_store_ps(values, vector); }
+    inline float4 splat4(float value) { return _mm_set1_ps(value); }
+    inline float4 add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+    inline float4 sub4(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+    inline float4 mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+#elif defined(LINMATH_NEON)
+    typedef float32x4_t float4;
+    inline float4 load4(const float *values) { return vld1q_f32(values); }
+    inline void store4(float *values, float4 vector) { vst1q_f32(values, vector); }
+    inline float4 splat4(float value) { return vdupq_n_f32(value); }
+    inline float4 add4(float4 a, float4 b) { return vaddq_f32(a, b); }
+    inline float4 sub4(float4 a, float4 b) { return vsubq_f32(a, b); }
+    inline float4 mul4(float4 a, float4 b) { return vmulq_f32(a, b); }
+#else
+    struct float4 {
+        float lanes[4];
+    };
+    inline float4 load4(const float *values) { return {{values[0], values[1], values[2], values[3]}}; }
+    inline void store4(float *values, float4 vector) { std::memcpy(values, vector.lanes, sizeof(vector.lanes)); }
+    inline float4 splat4(float value) { return {{value, value, value, value}}; }
+    inline float4 add4(float4 a, float4 b) {
+        return {{a.lanes[0] + b.lanes[0], a.lanes[1] + b.lanes[1], a.lanes[2] + b.lanes[2], a.lanes[3] + b.lanes[3]}};
+    }
+    inline float4 sub4(float4 a, float4 b) {
+        return {{a.lanes[0] - b.lanes[0], a.lanes[1] - b.lanes[1], a.lanes[2] - b.lanes[2], a.lanes[3] - b.lanes[3]}};
+    }
+    inline float4 mul4(float4 a, float4 b) {
+        return {{a.lanes[0] * b.lanes[0], a.lanes[1] * b.lanes[1], a.lanes[2] * b.lanes[2], a.lanes[3] * b.lanes[3]}};
+    }
+#endif
+}
+
+// 16 byte aligned 4 component vector (matrix columns, homogeneous coordinates). Same layout as glm::vec4.
+struct alignas(16) Vector4 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 0.0f;
+    constexpr Vector4() = default;
+    constexpr Vector4(float x, float y, float z, float w): x(x), y(y), z(z), w(w) {}
+    constexpr Vector4(const Vector3 &xyz, float w): x(xyz.x), y(xyz.y), z(xyz.z), w(w) {}
+    Vector4(const glm::vec4 &vector): x(vector[0]), y(vector[1]), z(vector[2]), w(vector[3]) {}
+    operator glm::vec4() const {
+        glm::vec4 vector;
+        std::memcpy(static_cast<void*>(&vector), &this->x, sizeof(vector)); // both trivially copyable
+        return vector;
+    }
+    linmath::float4 load() const {
+        return linmath::load4(&this->x);
+    }
+    static Vector4 store(linmath::float4 vector) {
+        Vector4 result;
+        linmath::store4(&result.x, vector);
+        return result;
+    }
+    constexpr Vector3 xyz() const {
+        return {this->x, this->y, this->z};
+    }
+    constexpr float &operator[](int index) {
+        return index == 0 ? this->x : index == 1 ? this->y : index == 2 ? this->z : this->w;
+    }
+    constexpr const float &operator[](int index) const {
+        return index == 0 ? this->x : index == 1 ? this->y : index == 2 ? this->z : this->w;
+    }
+    constexpr Vector4 operator+(const Vector4 &other) const {
+        if (!std::is_constant_evaluated()) return Vector4::store(linmath::add4(this->load(), other.load()));
+        return {this->x + other.x, this->y + other.y, this->z + other.z, this->w + other.w};
+    }
+    constexpr Vector4 operator-(const Vector4 &other) const {
+        if (!std::is_constant_evaluated()) return Vector4::store(linmath::sub4(this->load(), other.load()));
+        return {this->x - other.x, this->y - other.y, this->z - other.z, this->w - other.w};
+    }
+    constexpr Vector4 operator*(const Vector4 &other) const { // component-wise
+        if (!std::is_constant_evaluated()) return Vector4::store(linmath::mul4(this->load(), other.load()));
+        return {this->x * other.x, this->y * other.y, this->z * other.z, this->w * other.w};
+    }
+    constexpr Vector4 operator*(float scalar) const {
+        return *this * Vector4(scalar, scalar, scalar, scalar);
+    }
+    constexpr bool operator==(const Vector4 &other) const = default;
+    constexpr float dot(const Vector4 &other) const {
+        Vector4 product = *this * other;
+        return (product.x + product.y) + (product.z + product.w);
+    }
+};
+
+/* Column major 4x4 matrix (matrix[column][row]), the same layout as glm::mat4, so converting between them is
+ * a plain copy. Products are computed as sums of scaled columns, 4 lanes at a time.
+ */
+struct alignas(16) Matrix4 {
+    Vector4 columns[4];
+    constexpr Matrix4() = default; // zero matrix
+    constexpr Matrix4(const Vector4 &c0, const Vector4 &c1, const Vector4 &c2, const Vector4 &c3):
+            columns{c0, c1, c2, c3} {}
+    Matrix4(const glm::mat4 &matrix) {
+        std::memcpy(static_cast<void*>(this->columns), &matrix, sizeof(this->columns));
+    }
+    operator glm::mat4() const {
+        glm::mat4 matrix;
+        std::memcpy(static_cast<void*>(&matrix), this->columns, sizeof(this->columns));
+        return matrix;
+    }
+    static constexpr Matrix4 identity() {
+        return {{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}};
+    }
+    static constexpr Matrix4 translation(const Vector3 &offset) {
+        Matrix4 matrix = Matrix4::identity();
+        matrix.columns[3] = Vector4(offset, 1.0f);
+        return matrix;
+    }
+    constexpr Vector4 &operator[](int column) {
+        return this->columns[column];
+    }
+    constexpr const Vector4 &operator[](int column) const {
+        return this->columns[column];
+    }
+    constexpr Vector4 operator*(const Vector4 &vector) const {
+        if (!std::is_constant_evaluated()) {
+            linmath::float4 result = linmath::mul4(this->columns[0].load(), linmath::splat4(vector.x));
+            result = linmath::add4(result, linmath::mul4(this->columns[1].load(), linmath::splat4(vector.y)));
+            result = linmath::add4(result, linmath::mul4(this->columns[2].load(), linmath::splat4(vector.z)));
+            result = linmath::add4(result, linmath::mul4(this->columns[3].load(), linmath::splat4(vector.w)));
+            return Vector4::store(result);
+        }
+        Vector4 result;
+        for (int row = 0; row < 4; row++) {
+            result[row] = this->columns[0][row] * vector.x + this->columns[1][row] * vector.y +
+                          this->columns[2][row] * vector.z + this->columns[3][row] * vector.w;
+        }
+        return result;
+    }
+    constexpr Matrix4 operator*(const Matrix4 &other) const {
+        return {*this * other.columns[0], *this * other.columns[1], *this * other.columns[2], *this * other.columns[3]};
+    }
+    constexpr bool operator==(const Matrix4 &other) const = default;
+    constexpr Vector3 transform_point(const Vector3 &point) const {
+        return (*this * Vector4(point, 1.0f)).xyz();
+    }
+};
+
+// Unit quaternion rotation (x, y, z = imaginary part, w = real part)
+struct alignas(16) Quaternion {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f; // identity rotation by default
+    constexpr Quaternion() = default;
+    constexpr Quaternion(float x, float y, float z, float w): x(x), y(y), z(z), w(w) {}
+    static Quaternion from_hpr(const Vector3 &hpr); // degrees, the same convention as the node transforms
+    constexpr Quaternion operator*(const Quaternion &other) const { // this rotation applied after the other one
+        return {this->w * other.x + this->x * other.w + this->y * other.z - this->z * other.y,
+                this->w * other.y - this->x * other.z + this->y * other.w + this->z * other.x,
+                this->w * other.z + this->x * other.y - this->y * other.x + this->z * other.w,
+                this->w * other.w - this->x * other.x - this->y * other.y - this->z * other.z};
+    }
+    constexpr Quaternion conjugate() const { // the inverse rotation (of a unit quaternion)
+        return {-this->x, -this->y, -this->z, this->w};
+    }
+    constexpr bool operator==(const Quaternion &other) const = default;
+    constexpr Vector3 rotate(const Vector3 &vector) const {
+        Vector3 axis(this->x, this->y, this->z);
+        Vector3 t = axis.cross(vector) * 2.0f;
+        return vector + t * this->w + axis.cross(t);
+    }
+    constexpr Matrix4 to_matrix() const {
+        float xx = this->x * this->x, yy = this->y * this->y, zz = this->z * this->z;
+        float xy = this->x * this->y, xz = this->x * this->z, yz = this->y * this->z;
+        float wx = this->w * this->x, wy = this->w * this->y, wz = this->w * this->z;
+        return {{1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f},
+                {2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f},
+                {2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f},
+                {0.0f, 0.0f, 0.0f, 1.0f}};
+    }
+    Quaternion normalized() const;
+    static Quaternion nlerp(const Quaternion &from, const Quaternion &to, float alpha); // shortest path
+};
+
+static_assert(sizeof(Vector4) == sizeof(glm::vec4), "Vector4 has to match glm::vec4's layout");
+static_assert(sizeof(Matrix4) == sizeof(glm::mat4), "Matrix4 has to match glm::mat4's layout");
+
+/* Kernels over arrays, e.g. the transform system's structure-of-arrays node data. They run in chunks of
+ * LINMATH_KERNEL_BATCH elements with every lane going through the same SIMD code (tails are padded), so an
+ * element's result doesn't depend on where in the array it is.
+ */
+namespace linmath {
+    // sine & cosine of every angle (radians), a polynomial approximation accurate to a few float ULPs
+    void sin_cos(const float *radians, float *sines, float *cosines, size_t count);
+    /* Local node matrices from their positions, HPR rotations (degrees, heading & pitch clockwise) & scales.
+     * Same as Quaternion::from_hpr(hpr).to_matrix() scaled & translated, without going through quaternions.
+     */
+    void compose_transforms(size_t count, const float *positionX, const float *positionY, const float *positionZ,
+                            const float *heading, const float *pitch, const float *roll,
+                            const float *scaleX, const float *scaleY, const float *scaleZ, Matrix4 *matrices);
+    void multiply_matrices(size_t count, const Matrix4 *left, const Matrix4 *right, Matrix4 *results);
+    void transform_points(const Matrix4 &matrix, size_t count, const Vector3 *points, Vector3 *results);
+}
+
+#endif //VULKRAY_API_LINEARMATH_H
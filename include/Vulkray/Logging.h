@@ -0,0 +1,54 @@
+/*
+ * Logging.h
+ * API Header - Log macros for per-frame code paths (rate limited, sampled & debug-only output).
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_LOGGING_H
+#define VULKRAY_API_LOGGING_H
+
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#define VULKRAY_LOG_SITE_NEVER_LOGGED INT64_MIN
+#define VULKRAY_LOG_REPEAT_INTERVAL_MS 1000 // warnings that can repeat every frame are logged once a second at most
+
+/* Debug output is compiled out of release builds (NDEBUG, the builds only printing info output anyway).
+ * The arguments are still type checked there, but never evaluated.
+ */
+#ifndef NDEBUG
+#define VULKRAY_LOG_DEBUG(...) spdlog::debug(__VA_ARGS__)
+#else
+#define VULKRAY_LOG_DEBUG(...) do { if (false) spdlog::debug(__VA_ARGS__); } while (false)
+#endif
+
+// Logs the first of every n calls of the log site (e.g. a per-frame value, sampled once every 60 frames)
+#define VULKRAY_LOG_EVERY_N(level, n, ...) do { \
+        static std::atomic<uint64_t> _logSiteCalls{0}; \
+        if (_logSiteCalls.fetch_add(1, std::memory_order_relaxed) % (n) == 0) spdlog::log(level, __VA_ARGS__); \
+    } while (false)
+
+// Logs a call of the log site only when it last logged at least ms milliseconds ago (the first call logs)
+#define VULKRAY_LOG_EVERY_MS(level, ms, ...) do { \
+        static std::atomic<int64_t> _logSiteLastLogged{VULKRAY_LOG_SITE_NEVER_LOGGED}; \
+        if (vulkray_log_interval_passed(_logSiteLastLogged, ms)) spdlog::log(level, __VA_ARGS__); \
+    } while (false)
+
+// Claims the log site's next message (thread safe, a single caller logs when several race for it)
+inline bool vulkray_log_interval_passed(std::atomic<int64_t> &lastLogged, int64_t intervalMs) {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = lastLogged.load(std::memory_order_relaxed);
+    if (last != VULKRAY_LOG_SITE_NEVER_LOGGED && now - last < intervalMs) return false;
+    return lastLogged.compare_exchange_strong(last, now, std::memory_order_relaxed);
+}
+
+#endif //VULKRAY_API_LOGGING_H
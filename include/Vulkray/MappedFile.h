@@ -0,0 +1,42 @@
+/*
+ * MappedFile.h
+ * API Header - Defines the MappedFile class, a read only memory mapping of a whole file (asset loading).
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_MAPPEDFILE_H
+#define VULKRAY_API_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Maps the file with mmap (file mappings on Windows), hinting the kernel to read it ahead sequentially.
+ * Asset formats (MeshAsset, TextureAsset) point straight into the mapping, nothing is read up front.
+ */
+class MappedFile {
+private:
+    std::string path;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+public:
+    explicit MappedFile(const std::string &path); // throws if the file can't be opened, is empty or isn't mappable
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    const std::string &get_path() const;
+    const uint8_t *get_data() const;
+    size_t get_size() const;
+};
+
+#endif //VULKRAY_API_MAPPEDFILE_H
@@ -0,0 +1,100 @@
+/*
+ * MeshAsset.h
+ * API Header - Defines the engine's binary mesh asset format (.vkrmesh), read straight from memory mapped files.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_MESHASSET_H
+#define VULKRAY_API_MESHASSET_H
+
+#include "VertexFormat.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define MESH_ASSET_VERSION 1
+#define MESH_ASSET_ALIGNMENT 16 // every data block starts on a multiple of it (from the start of the file)
+
+/* File layout (little endian): the header, one entry per mesh, then the data blocks the entries point to.
+ * Vertices are stored packed in their mesh's vertex format & indices in the index type the geometry arena
+ * uses for them, so both are uploaded to the GPU as they are.
+ */
+struct MeshAssetHeader {
+    char magic[4]; // "VKRM"
+    uint32_t version; // MESH_ASSET_VERSION
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshAssetEntry {
+    VertexFormat vertexFormat;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize; // 2 (meshes of at most VERTEX_MAX_NARROW_INDEX_VERTICES vertices) or 4 bytes
+    uint32_t instanceCount; // 0 = drawn once with an identity transform
+    uint32_t reserved;
+    float quantization[4]; // offset (xyz) & scale (w), only used by quantized formats
+    float boundingSphere[4]; // model space center (xyz) & radius (w)
+    uint64_t vertexDataOffset;
+    uint64_t indexDataOffset;
+    uint64_t instanceDataOffset;
+};
+
+struct MeshAssetInstance {
+    float model[16]; // column major model matrix
+    uint32_t materialIndex;
+    uint32_t reserved[3];
+};
+
+// A mesh of a loaded asset, its data points into the mapped file
+struct MeshAssetView {
+    VertexFormat vertexFormat;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    VertexQuantization quantization;
+    glm::vec4 boundingSphere;
+    const uint8_t *vertexData; // vertexCount packed vertices
+    const uint8_t *indexData; // indexCount indices of indexSize bytes
+    uint32_t instanceCount;
+    const MeshAssetInstance *instances;
+};
+
+// A mesh to write out (converter tools), packed in the given format by MeshAsset::write()
+struct MeshAssetSource {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    VertexFormat vertexFormat = VERTEX_FORMAT_DEFAULT;
+    std::vector<MeshAssetInstance> instances;
+};
+
+/* A .vkrmesh file mapped into memory (read only). Loading only checks the header & the bounds of every block,
+ * nothing is parsed or copied: the mesh registry hands the file's blocks to the geometry arena, which copies
+ * them straight into the upload staging ring. Keep it in a shared pointer, the registry holds on to it until
+ * the meshes were uploaded.
+ * Note: Indices aren't checked against the vertex counts, only load assets from trusted sources.
+ */
+class MeshAsset {
+private:
+    MappedFile file;
+    const uint8_t *data;
+    size_t size;
+    std::vector<MeshAssetView> meshes;
+    void readEntries();
+public:
+    explicit MeshAsset(const std::string &path);
+    const std::string &get_path() const;
+    size_t get_file_size() const;
+    uint32_t get_mesh_count() const;
+    const MeshAssetView &get_mesh(uint32_t index) const;
+    static void write(const std::string &path, const std::vector<MeshAssetSource> &meshes);
+};
+
+#endif //VULKRAY_API_MESHASSET_H
@@ -0,0 +1,120 @@
+/*
+ * MeshRegistry.h
+ * API Header - Defines the MeshRegistry class to add, update and remove geometry at runtime.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_MESHREGISTRY_H
+#define VULKRAY_API_MESHREGISTRY_H
+
+#include "Vulkan.h"
+#include "MeshAsset.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define MESH_OPERATION_ADD 0
+#define MESH_OPERATION_UPDATE 1
+#define MESH_OPERATION_REMOVE 2
+#define MESH_OPERATION_SET_INSTANCES 3
+#define MESH_OPERATION_SET_LODS 4
+#define MESH_OPERATION_SET_PIPELINE 5
+#define MAX_MESH_LODS 4 // including the mesh's own indices (LOD 0)
+
+class ObjectNode; // prototype ObjectNode class
+
+// Stable reference to a registered mesh. Goes stale once the mesh is removed.
+struct MeshHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 = null handle, slot generations start at 1
+    bool operator==(const MeshHandle &other) const = default;
+};
+
+// Lower detail index list over the mesh's vertices, drawn from the given camera distance on
+struct MeshLod {
+    std::vector<uint32_t> indices;
+    float distance;
+};
+
+struct MeshOperation {
+    int type;
+    MeshHandle mesh;
+    uint32_t firstVertex = 0; // only used by updates
+    std::vector<uint8_t> vertexData; // adds & updates, packed in the mesh's vertex format
+    glm::vec4 boundingSphere{}; // adds & updates (model space, the registry grows it to fit updated vertices)
+    std::vector<uint32_t> indices; // only used by adds
+    VertexFormat vertexFormat = VERTEX_FORMAT_DEFAULT; // only used by adds
+    VertexQuantization quantization; // only used by adds
+    std::shared_ptr<const MeshAsset> asset; // adds from a mesh asset (uploaded from the mapped file instead)
+    uint32_t assetMesh = 0;
+    std::vector<InstanceData> instances; // only used by instance updates
+    std::vector<MeshLod> lods; // only used by LOD updates
+    std::optional<PipelineState> pipeline; // only used by pipeline changes
+    uint64_t tick = 0; // simulation tick that published it (with a simulation thread)
+};
+
+/* The registry only keeps track of the meshes & queues up their changes, it never touches the GPU.
+ * The renderer's geometry arena applies the queued operations at the start of the next frame,
+ * so meshes can be added, updated and removed from any thread (e.g. from jobs). With a simulation thread,
+ * the operations are handed over per tick, a frame only applies those of the ticks it renders.
+ */
+class MeshRegistry {
+private:
+    struct MeshSlot {
+        uint32_t generation = 1;
+        uint32_t vertexCount = 0;
+        VertexFormat vertexFormat = VERTEX_FORMAT_DEFAULT;
+        VertexQuantization quantization;
+        glm::vec4 boundingSphere{};
+        uint32_t nextFree = UINT32_MAX;
+        bool alive = false;
+    };
+    std::mutex registryMutex;
+    std::vector<MeshSlot> meshSlots;
+    uint32_t freeSlot = UINT32_MAX;
+    std::vector<MeshOperation> pendingOperations;
+    std::vector<MeshOperation> publishedOperations; // of finished ticks, oldest first
+    bool publishedPerTick = false;
+    bool isAlive(MeshHandle mesh);
+    MeshHandle queueAdd(MeshOperation operation, uint32_t vertexCount);
+public:
+    MeshRegistry();
+    ~MeshRegistry();
+    /* Vertices are packed into the format on the calling thread. Quantized meshes are scaled to the bounds of
+     * the vertices they're added with, their updates have to stay within those bounds.
+     */
+    MeshHandle add_mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices,
+                        VertexFormat format = VERTEX_FORMAT_DEFAULT);
+    // adds one of a loaded .vkrmesh asset's meshes (see MeshAsset.h), or all of them
+    MeshHandle add_mesh(std::shared_ptr<const MeshAsset> asset, uint32_t assetMesh);
+    std::vector<MeshHandle> add_meshes(const std::shared_ptr<const MeshAsset> &asset);
+    void update_mesh_vertices(MeshHandle mesh, uint32_t firstVertex, const std::vector<Vertex> &vertices);
+    void remove_mesh(MeshHandle mesh);
+    // All instances of a mesh are drawn with a single indirect draw call (an empty list hides the mesh)
+    void set_mesh_instances(MeshHandle mesh, std::vector<InstanceData> instances);
+    void set_mesh_instances(MeshHandle mesh, const std::vector<ObjectNode*> &nodes, uint32_t materialIndex = 0);
+    /* Replaces the mesh's lower detail levels (sorted by distance, at most MAX_MESH_LODS - 1 of them).
+     * Instances pick their LOD by camera distance in the GPU culling pass, an empty list removes them.
+     */
+    void set_mesh_lods(MeshHandle mesh, std::vector<MeshLod> lods);
+    /* Draws the mesh with a pipeline variant (shaders, culling, topology & blending). New variants compile in
+     * the background, the mesh keeps drawing with the default pipeline of its vertex format until its variant
+     * is ready. The state's vertex format is replaced by the mesh's, its shaders have to take that format's
+     * attributes (see VertexFormat.h).
+     */
+    void set_mesh_pipeline(MeshHandle mesh, PipelineState pipeline);
+    bool is_mesh_valid(MeshHandle mesh);
+    uint32_t get_mesh_slot_count();
+    // used by the vulkan renderer module
+    void _publish_pending_operations(uint64_t tick); // simulation thread, at the end of each tick
+    // the operations queued so far, or with a simulation thread only those published up to the given tick
+    void _take_pending_operations(std::vector<MeshOperation> &operations, uint64_t lastTick);
+};
+
+#endif //VULKRAY_API_MESHREGISTRY_H
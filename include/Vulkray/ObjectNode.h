@@ -13,23 +13,19 @@
 #ifndef VULKRAY_OBJECTNODE_H
 #define VULKRAY_OBJECTNODE_H
 
-struct Vector3 {
-    float x = 0.0f;
-    float y = 0.0f;
-    float z = 0.0f;
-};
+#include "TransformSystem.h"
+#include "Vector3.h"
+#include <glm/mat4x4.hpp>
 
+// Lightweight handle to a node in the transform system (the transform data itself is stored there)
 class ObjectNode {
 public:
-    ObjectNode();
-    ~ObjectNode();
-    float x = 0.0f;
-    float y = 0.0f;
-    float z = 0.0f;
-    float h = 0.0f; // heading (degrees)
-    float p = 0.0f; // pitch (degrees)
-    float r = 0.0f; // roll (degrees)
-    // setters
+    TransformHandle node;
+    ObjectNode(TransformSystem *transforms, ObjectNode *parent = nullptr);
+    ~ObjectNode(); // destroys the node, its children become root nodes
+    ObjectNode(const ObjectNode&) = delete; // every ObjectNode owns its node
+    ObjectNode &operator=(const ObjectNode&) = delete;
+    // setters (relative to the parent node)
     void set_x(float x);
     void set_y(float y);
     void set_z(float z);
@@ -40,9 +36,16 @@ public:
     void set_r(float r);
     void set_hpr(float h, float p, float r);
     void set_hpr(Vector3 hpr);
+    void set_scale(float x, float y, float z);
+    void set_parent(ObjectNode *parent); // nullptr = root node
     // getters
     Vector3 get_xyz();
     Vector3 get_hpr();
+    Vector3 get_scale();
+    glm::mat4 get_model_matrix(); // world matrix as of the last update (computed once per frame)
+    glm::mat4 compute_model_matrix(); // world matrix as the node is right now (includes moves since the update)
+protected:
+    TransformSystem *transforms;
 };
 
 #endif //VULKRAY_OBJECTNODE_H
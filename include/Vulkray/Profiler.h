@@ -0,0 +1,117 @@
+/*
+ * Profiler.h
+ * API Header - Defines the Profiler class timing the renderer's frame stages on the CPU & GPU.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_PROFILER_H
+#define VULKRAY_API_PROFILER_H
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#define PROFILER_HISTORY_FRAMES 240 // frames the rolling percentiles are taken over
+#define PROFILER_MAX_CAPTURE_EVENTS (1 << 20) // events a capture keeps at most (the rest are dropped)
+#define PROFILER_TRACK_CPU 1 // render thread
+#define PROFILER_TRACK_GPU 2 // graphics queue
+#define PROFILER_TRACK_STARTUP 3 // the renderer's startup phases (any thread)
+
+struct ProfileEvent {
+    const char *name; // string literal, only the pointer is kept
+    uint64_t start; // nanoseconds since the profiler was created
+    uint64_t duration;
+    uint32_t track; // PROFILER_TRACK_*
+};
+
+/* Rolling per-stage & per-frame timings, plus an optional capture of every timed event.
+ * Stages are recorded by the render thread, the getters can be called from any thread (e.g. a job).
+ * The renderer's startup phases are kept as they were timed (they only happen once), captures include them.
+ */
+class Profiler {
+private:
+    struct RollingHistory {
+        std::vector<double> samples; // ring buffer (milliseconds)
+        size_t next = 0;
+        void push(double sample);
+    };
+    struct StageTimings {
+        const char *name;
+        uint32_t track;
+        uint64_t frameTotal = 0; // nanoseconds accumulated in the current frame
+        RollingHistory history;
+    };
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point epoch;
+    bool enabled;
+    uint64_t frameStart = 0;
+    bool frameStarted = false;
+    RollingHistory frameTimes;
+    RollingHistory gpuFrameTimes;
+    std::vector<StageTimings> stages;
+    std::vector<double> sortScratch;
+    bool capturing = false;
+    bool captureTruncated = false;
+    std::vector<ProfileEvent> captureEvents;
+    std::vector<ProfileEvent> startupPhases; // in the order they finished
+    uint64_t startupTime = 0; // renderer start to the first submitted frame
+
+    StageTimings &findStage(const char *name, uint32_t track);
+    void captureEvent(const char *name, uint64_t start, uint64_t duration, uint32_t track);
+    double percentileOf(const RollingHistory &history, double percentile);
+public:
+    Profiler(bool enabled);
+    bool is_enabled();
+    // rolling percentiles (0 - 100) in milliseconds over the last PROFILER_HISTORY_FRAMES frames (0 = no data yet)
+    double get_frame_time(double percentile); // CPU frame to frame time, includes waiting on the GPU & present
+    double get_gpu_frame_time(double percentile); // first to last timestamp of the frame's command buffer
+    double get_stage_time(const char *stage, double percentile); // e.g. "frame wait" or "GPU render pass"
+    std::vector<const char*> get_stage_names(); // every stage & GPU region timed so far, in first timed order
+    // a phase's duration in milliseconds (0 = not timed), phases running on workers overlap the render thread's
+    double get_startup_phase_time(const char *phase);
+    std::vector<ProfileEvent> get_startup_phases();
+    double get_startup_time(); // milliseconds until the first frame was submitted (0 = not there yet)
+    // records every stage & GPU region until stop_capture(), which saves them as a Chrome trace (JSON)
+    void start_capture();
+    bool stop_capture(const char *path); // chrome://tracing, Perfetto & Tracy's import-chrome can open it
+    bool is_capturing();
+    // used by the vulkan renderer module
+    uint64_t _now();
+    void _begin_frame(); // closes the previous frame's timings
+    void _record_stage(const char *name, uint64_t start, uint64_t end);
+    void _record_gpu_region(const char *name, uint64_t start, uint64_t end);
+    void _record_gpu_frame(uint64_t duration);
+    void _record_startup_phase(const char *name, uint64_t start, uint64_t end); // thread safe
+    void _startup_finished(uint64_t start); // logs a summary of the startup phases
+};
+
+// Times the enclosing scope as a CPU stage of the current frame
+class ProfileScope {
+public:
+    ProfileScope(Profiler *profiler, const char *name);
+    ~ProfileScope();
+private:
+    Profiler *profiler;
+    const char *name;
+    uint64_t start;
+};
+
+// Times the enclosing scope as a startup phase (from any thread)
+class ProfilePhase {
+public:
+    ProfilePhase(Profiler *profiler, const char *name);
+    ~ProfilePhase();
+private:
+    Profiler *profiler;
+    const char *name;
+    uint64_t start;
+};
+
+#endif //VULKRAY_API_PROFILER_H
@@ -0,0 +1,157 @@
+/*
+ * RenderGraph.h
+ * API Header - Defines the RenderGraph class, the frame's passes & the images they read and write.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_RENDERGRAPH_H
+#define VULKRAY_API_RENDERGRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define RENDER_GRAPH_NONE UINT32_MAX
+#define RENDER_GRAPH_EXTERNAL UINT32_MAX // subpass index of dependencies with what's outside the render pass
+
+// How a pass uses an image, the renderer maps every usage to an image layout, pipeline stages & accesses
+#define RENDER_USAGE_UNDEFINED 0u // before the image's first use in the frame (its contents are discarded)
+#define RENDER_USAGE_COLOR_ATTACHMENT 1u
+#define RENDER_USAGE_DEPTH_ATTACHMENT 2u
+#define RENDER_USAGE_RESOLVE_ATTACHMENT 3u // written by the multisample resolve at the end of the pass
+#define RENDER_USAGE_INPUT_ATTACHMENT 4u // the same pixel read by a later pass (the passes can merge)
+#define RENDER_USAGE_SAMPLED 5u // read by fragment shaders
+#define RENDER_USAGE_STORAGE 6u // read & written by compute shaders
+#define RENDER_USAGE_TRANSFER_SRC 7u
+#define RENDER_USAGE_TRANSFER_DST 8u
+#define RENDER_USAGE_PRESENT 9u
+#define RENDER_USAGE_COUNT 10u
+
+#define RENDER_PASS_RASTER 0u // draws into attachments, consecutive raster passes may merge into subpasses
+#define RENDER_PASS_COMPUTE 1u
+#define RENDER_PASS_TRANSFER 2u
+
+#define RENDER_LOAD_DONT_CARE 0u
+#define RENDER_LOAD_CLEAR 1u
+#define RENDER_LOAD_LOAD 2u
+
+typedef uint32_t RenderImage; // index of an image in its graph
+
+struct RenderGraphImage { // an image as declared, plus what the compiled plan found out about it
+    std::string name;
+    uint32_t format; // VkFormat
+    uint32_t samples;
+    bool imported; // owned outside the graph (e.g. the swap images), the graph's outputs
+    uint32_t finalUsage; // imported images only, the usage the frame leaves them in
+    bool depth = false; // used as a depth attachment
+    uint32_t usages = 0; // bit mask of (1 << RENDER_USAGE_*) of every use
+    // graph owned images only used as attachments of one render pass & never stored live in tile memory, the
+    // renderer backs them with lazily allocated memory (transient attachments)
+    bool lazy = false;
+    uint32_t slot = RENDER_GRAPH_NONE; // physical image of graph owned images (shared by disjoint lifetimes)
+};
+
+struct RenderGraphUse {
+    RenderImage image;
+    uint32_t usage;
+    bool write;
+    bool clear = false; // color & depth attachments only
+};
+
+struct RenderGraphPass {
+    std::string name;
+    uint32_t type;
+    bool sideEffects; // writes outside the graph (e.g. a readback buffer), never culled
+    std::vector<RenderGraphUse> uses;
+};
+
+struct RenderAttachmentPlan {
+    RenderImage image;
+    uint32_t loadOp; // RENDER_LOAD_*
+    bool store; // contents are used after the render pass (tile memory only otherwise)
+    uint32_t initialUsage;
+    uint32_t finalUsage; // the usage of the image's next use, so the render pass does the layout change
+};
+
+struct RenderSubpassPlan {
+    uint32_t pass;
+    std::vector<uint32_t> colorAttachments; // indices in the group's attachments
+    std::vector<uint32_t> resolveAttachments; // empty, or one per color attachment (RENDER_GRAPH_NONE = none)
+    std::vector<uint32_t> inputAttachments;
+    uint32_t depthAttachment = RENDER_GRAPH_NONE;
+};
+
+struct RenderDependencyPlan {
+    uint32_t srcSubpass; // RENDER_GRAPH_EXTERNAL for what came before the render pass
+    uint32_t dstSubpass; // RENDER_GRAPH_EXTERNAL for what comes after it
+    uint32_t srcUsages; // bit masks of (1 << RENDER_USAGE_*)
+    uint32_t dstUsages;
+    bool byRegion; // only the same pixels depend on each other (between subpasses)
+};
+
+struct RenderBarrierPlan { // recorded before a compute or transfer group
+    RenderImage image;
+    uint32_t oldUsage;
+    uint32_t newUsage;
+};
+
+struct RenderGroupPlan { // one render pass (raster passes merged into its subpasses), or one compute/transfer pass
+    uint32_t type;
+    // in execution order, a subpass each for render passes (none for the group moving imported images into their
+    // final usage at the end of the frame, it only holds barriers)
+    std::vector<uint32_t> passes;
+    std::vector<RenderAttachmentPlan> attachments;
+    std::vector<RenderSubpassPlan> subpasses;
+    std::vector<RenderDependencyPlan> dependencies;
+    std::vector<RenderBarrierPlan> barriers;
+};
+
+struct RenderSlotPlan { // physical image backing graph owned images
+    uint32_t format;
+    uint32_t samples;
+    bool depth;
+    uint32_t usages; // of every image aliased to it
+    bool lazy; // every image aliased to it is lazy
+};
+
+struct RenderGraphPlan {
+    std::vector<RenderGraphImage> images;
+    std::vector<RenderGroupPlan> groups;
+    std::vector<RenderSlotPlan> slots;
+    std::vector<uint32_t> passGroups; // group of every declared pass (RENDER_GRAPH_NONE = culled)
+    std::vector<uint32_t> passSubpasses; // subpass of every raster pass in its group
+};
+
+/* Passes are declared in execution order with the images they read & write. The graph never touches the GPU,
+ * compile() plans the frame the renderer builds its render passes & barriers from:
+ * - passes contributing to neither an imported image nor a side effect are culled
+ * - consecutive raster passes merge into the subpasses of one render pass, as long as they only read each
+ *   other's results as input attachments (on tiled GPUs, the intermediate images never leave the tile)
+ * - every image's layout changes become attachment load/store ops & layouts, subpass dependencies, or barriers
+ * - graph owned images whose lifetimes don't overlap share a physical image (slot) when they're compatible
+ */
+class RenderGraph {
+private:
+    std::vector<RenderGraphImage> images;
+    std::vector<RenderGraphPass> passes;
+    void addUse(uint32_t pass, RenderImage image, uint32_t usage, bool write, bool clear);
+    std::vector<bool> findLivePasses() const;
+public:
+    RenderImage add_image(const std::string &name, uint32_t format, uint32_t samples = 1);
+    RenderImage import_image(const std::string &name, uint32_t format, uint32_t finalUsage, uint32_t samples = 1);
+    uint32_t add_pass(const std::string &name, uint32_t type, bool sideEffects = false);
+    void write_color(uint32_t pass, RenderImage image, bool clear);
+    void write_depth(uint32_t pass, RenderImage image, bool clear);
+    void write_resolve(uint32_t pass, RenderImage image); // of the pass' last color attachment
+    void read(uint32_t pass, RenderImage image, uint32_t usage); // input attachment, sampled, storage, transfer
+    void write(uint32_t pass, RenderImage image, uint32_t usage); // storage or transfer
+    RenderGraphPlan compile() const; // throws if an image is read before anything wrote it
+};
+
+#endif //VULKRAY_API_RENDERGRAPH_H
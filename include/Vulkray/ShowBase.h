@@ -17,33 +17,118 @@
 #include "JobManager.h"
 #include "Camera.h"
 #include "Vulkan.h"
+#include "MeshRegistry.h"
+#include "TextureRegistry.h"
+#include "TransformSystem.h"
+#include "Profiler.h"
+#include "GpuMemory.h"
+#include "Simulation.h"
+#include "Logging.h"
 #include <memory>
+#include <atomic>
+
+// builtin camera controls, per second of simulated time (the 0.06 & 0.1 per frame they were at 60 FPS)
+#define CAM_MOVE_SPEED 3.6f
+#define CAM_FOV_SPEED 6.0f
 
 // class prototypes
 class InputManager;
 class Camera;
+class MeshRegistry;
+class TextureRegistry;
 
 struct EngineConfig {
     const char* windowTitle = nullptr; // default set at vulkan/Window.cxx module
     GraphicsInput graphicsInput; // temporary
+    // Pre-record one command buffer per (frame in flight, swap image) and only re-record it when marked dirty
+    bool cacheCommandBuffers = false;
+    // Slots recording draws into secondary command buffers (1 = inline on the render thread, 0 = one per job worker)
+    unsigned int recordingThreads = 1;
+    // Worker threads running the per-frame jobs (0 = one per hardware thread, minus the render thread)
+    unsigned int jobWorkerThreads = 0;
+    // Bytes of uniform data every frame in flight can suballocate from the uniform ring buffer
+    unsigned int uniformRingFrameSize = 256 * 1024;
+    // Bytes of the staging ring buffer uploads stream through (bigger uploads are split into chunks)
+    unsigned int uploadStagingSize = 32 * 1024 * 1024;
+    /* Vertices & indices the shared geometry arenas can hold (every registered mesh is suballocated from them),
+     * counted in default format vertices & 32 bit indices. Compact meshes & 16 bit indices take less space.
+     */
+    unsigned int vertexArenaCapacity = 1024 * 1024;
+    unsigned int indexArenaCapacity = 3 * 1024 * 1024;
+    /* Bytes of GPU memory the streamed textures can take (less when the device local heaps run low). Textures
+     * keep their mip tails resident even over it, the rest goes to the textures that need their detail most. */
+    uint64_t textureMemoryBudget = 256 * 1024 * 1024;
+    /* Bytes of texture levels uploaded per frame at most (and half the staging ring at most). Textures over it
+     * get sharper a level per frame, only a single level bigger than it still goes through in one frame. */
+    uint64_t textureUploadBytesPerFrame = 8 * 1024 * 1024;
+    // Cull instances against the camera frustum & pick their LOD in a compute pass (only LOD 0 is drawn otherwise)
+    bool gpuCulling = true;
+    // File the pipeline cache is loaded from & saved to between runs (nullptr = don't keep it between runs)
+    const char* pipelineCachePath = "vulkray_pipeline_cache.bin";
+    // Swap chain present mode (FIFO, mailbox, immediate or FIFO relaxed), falls back to FIFO when unsupported
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // Frames the CPU may record ahead of the GPU (1 to 3, fewer = less latency, more = better throughput)
+    unsigned int framesInFlight = 2;
+    /* Waits for the last frames to reach the display before input is polled (VK_KHR_present_wait, when the GPU
+     * supports it), so every frame is rendered from the freshest input. Lowers motion-to-photon latency. */
+    bool lowLatency = false;
+    /* Queues key & cursor events with timestamps and dispatches them once per frame, at the start of the frame
+     * (cursor motion coalesced into one callback). Input latency is profiled as the "input latency" stage. */
+    bool queuedInput = false;
+    /* Ticks per second the jobs, input callbacks & camera are simulated at, on their own thread (0 = stepped
+     * once per rendered frame instead). Frames render the latest tick's camera & mesh changes. */
+    double simulationRate = 0;
+    /* Renders into offscreen images without creating a window or surface (GPUs without a display, CI).
+     * Runs for headlessFrameCount frames (0 = until ShowBase::stop() is called), there's no input. */
+    bool headless = false;
+    unsigned int headlessWidth = 1920;
+    unsigned int headlessHeight = 1080;
+    uint64_t headlessFrameCount = 0;
+    // Receives every headless frame's pixels, read back asynchronously (MAX_FRAMES_IN_FLIGHT frames late)
+    void (*headlessFrameCallback)(void *caller, ShowBase *base, const HeadlessFrame &frame) = nullptr;
+    void *headlessFrameCaller = nullptr;
+    // Times the renderer's frame stages on the CPU & GPU (rolling percentiles & captures via ShowBase::profiler)
+    bool profiling = true;
+    // Fraction of a GPU heap's budget its usage can reach before the memory pressure callback is called
+    float memoryPressureThreshold = 0.9f;
+    /* Formats & writes the log output on a background thread, so logging threads never block on stdout. Up to
+     * logQueueSize messages wait for it, the oldest ones are dropped when it falls behind (false = log in place).
+     * Errors are still written right away by the thread logging them, they're never dropped. It's the process'
+     * default logger, set up by the first ShowBase asking for it. */
+    bool asyncLogging = true;
+    unsigned int logQueueSize = 8192;
 };
 
 class ShowBase {
 public:
     EngineConfig config;
     bool defaultCamEnabled = false;
+    std::unique_ptr<Profiler> profiler;
+    std::unique_ptr<GpuMemory> memory; // GPU heap budgets & allocations (refreshed every frame by the renderer)
     std::unique_ptr<InputManager> input;
     std::unique_ptr<JobManager> jobManager;
+    std::unique_ptr<TransformSystem> transforms; // every ObjectNode's transform (world matrices updated per frame)
+    std::unique_ptr<Simulation> simulation; // steps the jobs & camera (per frame or at a fixed rate)
     std::unique_ptr<Camera> camera;
+    std::unique_ptr<MeshRegistry> meshes;
+    std::unique_ptr<TextureRegistry> textures; // KTX2 textures streamed by the renderer
     ShowBase(EngineConfig config);
     ~ShowBase();
     void launch();
+    void stop(); // ends the render loop after the current frame (thread safe)
+    bool _is_stopping();
+    // resizes the window (the offscreen images in headless mode) before the next frame, thread safe
+    void set_window_size(unsigned int width, unsigned int height);
+    bool _take_window_size(unsigned int *width, unsigned int *height);
     void enable_cam_controls();
     void disable_cam_controls();
     // below has to be public, used by the builtin camera (accessed via key callback static method)
     int _cam_controls_key_map[6] = {0, 0, 0, 0, 0, 0};
 private:
     std::unique_ptr<Vulkan> vulkanRenderer;
+    std::atomic<bool> stopRequested = false;
+    std::atomic<uint64_t> pendingWindowSize = 0; // width << 32 | height (0 = unchanged)
+    JobHandle cameraJob;
     // default cam control callbacks
     static void camera_task(void *caller, ShowBase *base);
     static void cam_control_forward(void *caller, ShowBase *base, int action);
@@ -0,0 +1,111 @@
+/*
+ * Simulation.h
+ * API Header - Defines the Simulation class stepping the user's jobs & camera, on its own thread if configured.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_SIMULATION_H
+#define VULKRAY_API_SIMULATION_H
+
+#include <glm/vec3.hpp>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+
+#define SIMULATION_MAX_CATCHUP_TICKS 5 // ticks the simulation thread runs back to back before it skips ahead
+#define SIMULATION_MAX_DELTA_TIME 0.25f // seconds a single frame step can simulate (e.g. after a long stall)
+
+class ShowBase; // prototype ShowBase class
+
+// Everything the renderer reads from the camera, copied out so it can be rendered while the camera moves on
+struct CameraState {
+    glm::vec3 position;
+    glm::vec3 lookAt; // look at vector (relative to the position)
+    float fovRadians;
+    float near;
+    float far;
+};
+
+struct SimulationSnapshot {
+    CameraState camera;
+    uint64_t tick; // the mesh registry's operations up to this tick go with it
+};
+
+/* Hands the latest value from one producer thread to one consumer thread without either of them waiting:
+ * the producer writes into its own buffer and swaps it with the shared one, the consumer swaps the shared
+ * buffer with its own once a newer one got published. Values the consumer didn't get to are overwritten.
+ */
+template<typename T>
+class TripleBuffer {
+private:
+    static constexpr uint32_t FRESH_BIT = 4; // the shared buffer was published after the consumer's last swap
+    T buffers[3]{};
+    std::atomic<uint32_t> shared{2}; // index of the shared buffer | FRESH_BIT
+    uint32_t writeIndex = 0; // only used by the producer
+    uint32_t readIndex = 1; // only used by the consumer
+public:
+    T &get_write_buffer() {
+        return this->buffers[this->writeIndex];
+    }
+    void publish() {
+        this->writeIndex = this->shared.exchange(this->writeIndex | FRESH_BIT, std::memory_order_acq_rel) & 3;
+    }
+    // true if a newer value was published since the last call (get_read_buffer() returns it then)
+    bool update() {
+        if ((this->shared.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+        this->readIndex = this->shared.exchange(this->readIndex, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+    const T &get_read_buffer() {
+        return this->buffers[this->readIndex];
+    }
+};
+
+/* Without a simulation rate, the jobs & camera are stepped once per rendered frame (by the renderer's frame).
+ * With one, they run on the simulation thread at that fixed rate instead: every tick drains the queued input,
+ * runs the frame jobs, updates the world matrices & publishes a snapshot of the camera, along with the mesh
+ * changes made during the tick. Every frame draws the latest whole tick, so a slow frame doesn't slow down the
+ * simulation (and a slow tick doesn't hold up the frames). The camera isn't interpolated between ticks, the
+ * instances it looks at jump from tick to tick too (it would drift against them).
+ * Note: While the simulation has its own thread, the jobs & input callbacks are the only safe place to move
+ *       nodes around and change the camera from.
+ */
+class Simulation {
+private:
+    ShowBase *base;
+    double rate; // ticks per second (0 = stepped by the renderer's frames)
+    uint64_t tickDuration = 0; // nanoseconds
+    float deltaTime;
+    uint64_t lastStepTime = 0;
+    std::atomic<uint64_t> tick{0};
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::exception_ptr threadError = nullptr;
+    TripleBuffer<SimulationSnapshot> snapshots;
+
+    void threadLoop();
+    void runTick();
+    void publishSnapshot();
+public:
+    Simulation(ShowBase *base, double rate);
+    ~Simulation();
+    bool is_threaded();
+    float get_delta_time(); // seconds the current step simulates (1 / rate on the simulation thread)
+    uint64_t get_tick(); // steps simulated so far
+    static uint64_t now(); // steady clock nanoseconds
+    // used by the vulkan renderer module
+    void _start(); // launches the simulation thread (threaded mode)
+    void _stop(); // joins it, rethrows what the thread failed with
+    void _begin_frame_step(); // frame stepped mode, at the start of the frame
+    uint64_t _begin_render_frame(); // picks the tick the frame draws (threaded mode, the latest published one)
+    CameraState _get_render_camera(); // threaded mode: the frame's snapshot, else the camera as it is
+};
+
+#endif //VULKRAY_API_SIMULATION_H
@@ -0,0 +1,79 @@
+/*
+ * TextureAsset.h
+ * API Header - Defines the TextureAsset class reading KTX2 textures straight from memory mapped files.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_TEXTUREASSET_H
+#define VULKRAY_API_TEXTUREASSET_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TEXTURE_MAX_LEVELS 16 // mip levels of a 32768 texel wide texture
+
+/* Layout of a texture format's texel blocks (1x1 for uncompressed formats). Formats are VkFormat values,
+ * which is also how KTX2 files store them.
+ */
+struct TextureFormatInfo {
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    uint32_t blockSize; // bytes
+    bool compressed; // BC & ASTC (the GPU can't generate their mips)
+};
+
+struct TextureLevel { // a mip level of a loaded texture, its data points into the mapped file
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *data;
+    uint64_t size;
+    uint64_t rowPitch; // bytes per row of texel blocks
+};
+
+namespace textureformat {
+    // false for formats the engine doesn't load (supported: 8 bit UNORM/SRGB, RGBA16F, BC1-7 & ASTC)
+    bool get_format_info(uint32_t format, TextureFormatInfo *info);
+    uint32_t get_mip_count(uint32_t width, uint32_t height); // full chain down to 1x1
+    uint32_t get_level_extent(uint32_t extent, uint32_t level);
+    uint64_t get_level_size(const TextureFormatInfo &info, uint32_t width, uint32_t height);
+}
+
+/* A 2D KTX2 texture mapped into memory (read only). Loading only checks the header & that every mip level is
+ * within the file, the texture streamer copies the levels it needs straight into the upload staging ring.
+ * Files without mip levels (KTX2's level count of 0) get their mips generated on the GPU, which only works
+ * for uncompressed formats. Supercompressed (Basis Universal, Zstandard), cube map & array textures aren't
+ * supported.
+ */
+class TextureAsset {
+private:
+    MappedFile file;
+    uint32_t format;
+    TextureFormatInfo formatInfo;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount; // levels of the texture on the GPU (the full chain when they're generated)
+    bool generateMips;
+    std::vector<TextureLevel> levels; // stored in the file, level 0 is the largest
+    void readHeader();
+public:
+    explicit TextureAsset(const std::string &path);
+    const std::string &get_path() const;
+    uint32_t get_format() const; // VkFormat
+    const TextureFormatInfo &get_format_info() const;
+    uint32_t get_width() const;
+    uint32_t get_height() const;
+    uint32_t get_mip_count() const;
+    bool needs_mip_generation() const; // only level 0 is stored, the rest are generated with blits
+    uint32_t get_stored_level_count() const;
+    const TextureLevel &get_level(uint32_t level) const; // throws for levels that aren't stored
+};
+
+#endif //VULKRAY_API_TEXTUREASSET_H
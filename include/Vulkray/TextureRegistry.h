@@ -0,0 +1,100 @@
+/*
+ * TextureRegistry.h
+ * API Header - Defines the TextureRegistry class to add & remove streamed textures at runtime.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_TEXTUREREGISTRY_H
+#define VULKRAY_API_TEXTUREREGISTRY_H
+
+#include "TextureAsset.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define TEXTURE_OPERATION_ADD 0
+#define TEXTURE_OPERATION_REMOVE 1
+#define TEXTURE_OPERATION_SET_PRIORITY 2
+#define TEXTURE_OPERATION_SET_MATERIAL 3
+#define TEXTURE_STREAMING_TAIL_SIZE 64 // mip levels at most this many texels wide are always resident
+#define TEXTURE_STREAMING_INTERVAL 8 // frames between the streamer's residency updates
+
+// Stable reference to a registered texture. Goes stale once the texture is removed.
+struct TextureHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 = null handle, slot generations start at 1
+    bool operator==(const TextureHandle &other) const = default;
+};
+
+struct TextureOperation {
+    int type;
+    TextureHandle texture; // null for material changes that unset the material's texture
+    std::shared_ptr<const TextureAsset> asset; // only used by adds
+    float priority = 1.0f; // adds & priority changes
+    uint32_t materialIndex = 0; // only used by material changes
+};
+
+// One streamed texture's state for texturestreaming::plan_residency(), levels count from the largest (0)
+struct TextureResidencyRequest {
+    uint32_t mipCount;
+    uint64_t levelSizes[TEXTURE_MAX_LEVELS]; // bytes of every mip level on the GPU
+    uint32_t tailLevel; // largest level of the always resident mip tail
+    uint32_t wantedLevel; // largest level the texture's screen-space size needs
+    uint32_t residentLevel; // largest level resident right now (mipCount = nothing yet)
+    float priority;
+    uint32_t plannedLevel = 0; // result: largest level that should be resident
+};
+
+namespace texturestreaming {
+    uint32_t get_tail_level(uint32_t width, uint32_t height, uint32_t mipCount);
+    // mip level whose texels are about as big as the screen pixels of an object covering the given pixels
+    uint32_t get_wanted_level(uint32_t width, uint32_t height, uint32_t mipCount, float coveragePixels);
+    uint64_t get_resident_size(const TextureResidencyRequest &request, uint32_t level);
+    /* Plans every texture's resident mip levels within the budget. The mip tails are always resident (even over
+     * budget), the remaining budget refines the textures missing the most levels first (weighted by their
+     * priority), one level at a time. Textures at most one level sharper than they need keep their levels while
+     * the budget allows it, so small camera movements don't reload them.
+     */
+    void plan_residency(std::vector<TextureResidencyRequest> &requests, uint64_t budget);
+}
+
+/* The registry only keeps track of the textures & queues up their changes, it never touches the GPU.
+ * The renderer's texture streamer applies the queued operations at the start of the next frame, then streams
+ * the textures' mip levels in (and out) by screen-space need, so textures can be added from any thread.
+ * Screen-space need comes from the meshes drawing with a texture: instances whose material index maps to it
+ * (set_material_texture()). Textures no material maps to are streamed in fully (as the budget allows).
+ */
+class TextureRegistry {
+private:
+    struct TextureSlot {
+        uint32_t generation = 1;
+        uint32_t nextFree = UINT32_MAX;
+        bool alive = false;
+    };
+    std::mutex registryMutex;
+    std::vector<TextureSlot> textureSlots;
+    uint32_t freeSlot = UINT32_MAX;
+    std::vector<TextureOperation> pendingOperations;
+    bool isAlive(TextureHandle texture);
+public:
+    TextureRegistry();
+    ~TextureRegistry();
+    // higher priorities get their levels streamed in first & evicted last (1 = default)
+    TextureHandle add_texture(std::shared_ptr<const TextureAsset> asset, float priority = 1.0f);
+    TextureHandle add_texture(const std::string &path, float priority = 1.0f); // maps the KTX2 file right away
+    void remove_texture(TextureHandle texture);
+    void set_texture_priority(TextureHandle texture, float priority);
+    void set_material_texture(uint32_t materialIndex, TextureHandle texture); // a null handle unsets it
+    bool is_texture_valid(TextureHandle texture);
+    // used by the vulkan renderer module
+    void _take_pending_operations(std::vector<TextureOperation> &operations);
+};
+
+#endif //VULKRAY_API_TEXTUREREGISTRY_H
@@ -0,0 +1,105 @@
+/*
+ * TransformSystem.h
+ * API Header - Defines the TransformSystem class storing every node's transform as structure-of-arrays.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_TRANSFORMSYSTEM_H
+#define VULKRAY_API_TRANSFORMSYSTEM_H
+
+#include "LinearMath.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+#define TRANSFORM_NONE UINT32_MAX
+#define TRANSFORM_BATCH_SIZE 2048 // nodes per job when world matrices are computed in parallel
+
+class JobManager; // prototype JobManager class
+
+// Stable reference to a transform node. Goes stale once the node is destroyed.
+struct TransformHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 = null handle (no parent), slot generations start at 1
+    bool operator==(const TransformHandle &other) const = default;
+};
+
+/* Every node's local transform is kept in densely packed arrays, sorted so parents always come before their
+ * children (grouped by hierarchy depth). World matrices are then computed in one linear pass, depth level by
+ * depth level, only for nodes whose local transform or parent changed. Each level is split across the job
+ * manager's workers.
+ * Note: Nodes can be moved from parallel jobs as long as every job only touches its own nodes, and the job
+ *       finishes before the uniform update (the default for jobs registered without options). Creating,
+ *       destroying & re-parenting nodes is only safe while no other thread is using the system.
+ */
+class TransformSystem {
+private:
+    struct TransformSlot {
+        uint32_t generation = 1;
+        uint32_t denseIndex = TRANSFORM_NONE; // position in the dense arrays (or the next free slot while unused)
+        bool alive = false;
+    };
+    // dense node data (structure-of-arrays)
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> heading, pitch, roll; // degrees
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<uint32_t> parents; // dense index of the parent node (TRANSFORM_NONE for root nodes)
+    std::vector<uint32_t> versions; // bumped on every local change, lets consumers skip unchanged nodes
+    std::vector<uint8_t> localDirty;
+    std::vector<uint8_t> worldChanged; // world matrix was recomputed by the last update
+    std::vector<Matrix4> worldMatrices;
+    std::vector<uint32_t> depths; // depth in the hierarchy (0 = root node)
+    std::vector<uint32_t> denseSlots; // dense index -> slot (TRANSFORM_NONE for destroyed nodes)
+    // slot map handing out the handles
+    std::vector<TransformSlot> slots;
+    uint32_t freeSlot = TRANSFORM_NONE;
+    // hierarchy order (rebuilt lazily when nodes are destroyed or re-parented)
+    bool orderDirty = false;
+    std::vector<uint32_t> levelStarts = {0}; // dense range of every depth level (+ the end of the last one)
+    std::vector<uint32_t> remap; // reorder scratch buffers
+    std::vector<uint32_t> depthStack;
+    // range of the level currently being computed in parallel
+    uint32_t batchStart = 0;
+    uint32_t batchEnd = 0;
+    uint32_t denseIndex(TransformHandle node);
+    bool isAlive(TransformHandle node);
+    void markDirty(uint32_t index);
+    glm::mat4 localMatrix(uint32_t index);
+    void rebuildOrder();
+    template<typename T> void permute(std::vector<T> &values, uint32_t newCount);
+    void computeRange(uint32_t first, uint32_t last);
+    static void computeBatchTask(void *caller, uint32_t index);
+public:
+    TransformSystem();
+    ~TransformSystem();
+    TransformHandle create_node(TransformHandle parent = {});
+    void destroy_node(TransformHandle node); // children become root nodes (keeping their local transform)
+    void set_parent(TransformHandle node, TransformHandle parent); // null handle = root node
+    bool is_node_valid(TransformHandle node);
+    uint32_t get_node_count();
+    // local transform (relative to the parent node)
+    void set_position(TransformHandle node, float x, float y, float z);
+    void set_rotation(TransformHandle node, float h, float p, float r);
+    void set_scale(TransformHandle node, float x, float y, float z);
+    glm::vec3 get_position(TransformHandle node);
+    glm::vec3 get_rotation(TransformHandle node);
+    glm::vec3 get_scale(TransformHandle node);
+    uint32_t get_version(TransformHandle node);
+    // world transform as of the last update (updated once per frame by the renderer)
+    glm::mat4 get_world_matrix(TransformHandle node);
+    // world transform as the node is right now (composed up its parents, includes changes since the last update)
+    glm::mat4 compute_world_matrix(TransformHandle node);
+    bool world_matrix_changed(TransformHandle node);
+    static glm::mat4 compose_matrix(glm::vec3 position, glm::vec3 hpr, glm::vec3 scale);
+    // used by the vulkan renderer module (jobManager can be nullptr to compute on the calling thread)
+    void _update_world_matrices(JobManager *jobManager);
+};
+
+#endif //VULKRAY_API_TRANSFORMSYSTEM_H
@@ -13,12 +13,64 @@
 #ifndef VULKRAY_API_VECTOR3_H
 #define VULKRAY_API_VECTOR3_H
 
-class Vector3 {
-public:
-    Vector3();
-    ~Vector3();
-private:
-    //
+#include <glm/vec3.hpp>
+#include <cmath>
+
+/* Plain 3 component vector (positions, HPR rotations & scales of nodes). It's a tightly packed 12 bytes, the
+ * SIMD types (Vector4, Quaternion & Matrix4) are in LinearMath.h. Converts to & from glm::vec3 implicitly.
+ */
+struct Vector3 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    constexpr Vector3() = default;
+    constexpr Vector3(float x, float y, float z): x(x), y(y), z(z) {}
+    Vector3(const glm::vec3 &vector): x(vector.x), y(vector.y), z(vector.z) {}
+    operator glm::vec3() const {
+        return {this->x, this->y, this->z};
+    }
+    constexpr Vector3 operator+(const Vector3 &other) const {
+        return {this->x + other.x, this->y + other.y, this->z + other.z};
+    }
+    constexpr Vector3 operator-(const Vector3 &other) const {
+        return {this->x - other.x, this->y - other.y, this->z - other.z};
+    }
+    constexpr Vector3 operator-() const {
+        return {-this->x, -this->y, -this->z};
+    }
+    constexpr Vector3 operator*(float scalar) const {
+        return {this->x * scalar, this->y * scalar, this->z * scalar};
+    }
+    constexpr Vector3 operator*(const Vector3 &other) const { // component-wise
+        return {this->x * other.x, this->y * other.y, this->z * other.z};
+    }
+    constexpr Vector3 &operator+=(const Vector3 &other) {
+        *this = *this + other;
+        return *this;
+    }
+    constexpr Vector3 &operator-=(const Vector3 &other) {
+        *this = *this - other;
+        return *this;
+    }
+    constexpr Vector3 &operator*=(float scalar) {
+        *this = *this * scalar;
+        return *this;
+    }
+    constexpr bool operator==(const Vector3 &other) const = default;
+    constexpr float dot(const Vector3 &other) const {
+        return this->x * other.x + this->y * other.y + this->z * other.z;
+    }
+    constexpr Vector3 cross(const Vector3 &other) const {
+        return {this->y * other.z - this->z * other.y, this->z * other.x - this->x * other.z,
+                this->x * other.y - this->y * other.x};
+    }
+    float length() const {
+        return std::sqrt(this->dot(*this));
+    }
+    Vector3 normalized() const { // the zero vector stays zero
+        float length = this->length();
+        return length > 0.0f ? *this * (1.0f / length) : *this;
+    }
 };
 
 #endif //VULKRAY_API_VECTOR3_H
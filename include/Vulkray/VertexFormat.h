@@ -0,0 +1,84 @@
+/*
+ * VertexFormat.h
+ * API Header - Defines the Vertex struct and the vertex formats meshes are packed into on the GPU.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#ifndef VULKRAY_API_VERTEXFORMAT_H
+#define VULKRAY_API_VERTEXFORMAT_H
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstdint>
+#include <vector>
+
+/* A vertex format is a set of the flags below. Positions & colors are always there, normals & texture
+ * coordinates only when their flag is set. Attributes are packed in that order (shader locations 0, 1, 7 & 8,
+ * locations 2-6 are the instance attributes).
+ * Quantized formats store 16 bit normalized positions (scaled & offset to the mesh's bounds), R8G8B8A8_UNORM
+ * colors, octahedral normals in two 16 bit normalized components & half float texture coordinates.
+ */
+typedef uint32_t VertexFormat;
+#define VERTEX_FORMAT_DEFAULT 0 // 32 bit float positions & colors (24 bytes)
+#define VERTEX_FORMAT_NORMALS 1
+#define VERTEX_FORMAT_UVS 2
+#define VERTEX_FORMAT_QUANTIZED 4
+#define VERTEX_FORMAT_COMPACT VERTEX_FORMAT_QUANTIZED // quantized positions & colors (12 bytes)
+#define VERTEX_FORMAT_FLAG_MASK 7
+
+#define VERTEX_MAX_NARROW_INDEX_VERTICES 65536 // meshes of at most this many vertices get 16 bit indices
+
+#define VERTEX_ATTRIBUTE_POSITION 0
+#define VERTEX_ATTRIBUTE_COLOR 1
+#define VERTEX_ATTRIBUTE_NORMAL 2
+#define VERTEX_ATTRIBUTE_UV 3
+#define VERTEX_ATTRIBUTE_COUNT 4
+
+struct Vertex { // what meshes are given to the registry as, packed into the mesh's vertex format from there
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec3 normal{}; // only stored by formats with VERTEX_FORMAT_NORMALS
+    glm::vec2 uv{}; // only stored by formats with VERTEX_FORMAT_UVS
+};
+
+/* Maps a quantized mesh's positions into [-1, 1]. The scale is the same on every axis, so dequantizing doesn't
+ * change the direction of normals & the length of bounding sphere radii only scales along.
+ */
+struct VertexQuantization {
+    glm::vec3 offset{0.0f}; // center of the mesh's bounding box
+    float scale = 1.0f; // half of its longest side
+    static VertexQuantization fit(const std::vector<Vertex> &vertices);
+    bool contains(const glm::vec3 &position) const; // false if the position is clamped when quantized
+    glm::mat4 get_dequantization_matrix() const; // quantized to model space
+};
+
+namespace vertexformat {
+    bool is_valid(VertexFormat format);
+    bool has_attribute(VertexFormat format, int attribute);
+    uint32_t get_stride(VertexFormat format); // bytes per packed vertex (always a multiple of 4)
+    uint32_t get_attribute_offset(VertexFormat format, int attribute);
+    uint32_t get_attribute_size(VertexFormat format, int attribute);
+    // appends the vertices packed in the format (the quantization is only used by quantized formats)
+    void pack_vertices(VertexFormat format, const VertexQuantization &quantization,
+                       const Vertex *vertices, size_t count, std::vector<uint8_t> &packed);
+    Vertex unpack_vertex(VertexFormat format, const VertexQuantization &quantization, const uint8_t *packed);
+    // sphere around the vertices' bounding box (not the tightest fit, but cheap and never misses a vertex)
+    glm::vec4 compute_bounding_sphere(const std::vector<Vertex> &vertices);
+    // component packing (also used by the tests)
+    int16_t pack_snorm16(float value);
+    float unpack_snorm16(int16_t value);
+    uint16_t pack_half(float value); // rounded to the nearest half float
+    float unpack_half(uint16_t value);
+    glm::vec2 encode_octahedral(const glm::vec3 &normal); // unit normal to a point of the [-1, 1] square
+    glm::vec3 decode_octahedral(const glm::vec2 &encoded);
+}
+
+#endif //VULKRAY_API_VERTEXFORMAT_H
@@ -17,6 +17,9 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include "VertexFormat.h"
+#include "TextureRegistry.h"
+#include "RenderGraph.h"
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
@@ -27,55 +30,82 @@
 #include <vector>
 #include <string>
 #include <optional>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
 
 // Class/struct prototypes
 class Vulkan;
 class Window;
 class ShowBase;
+struct MeshOperation;
 class VkModuleBase {
 public:
     Vulkan *m_vulkan; // every module has a pointer to the core Vulkan class instance
     VkModuleBase(Vulkan *m_vulkan);
 };
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
+struct InstanceData { // per-instance vertex attributes, one entry per drawn object
+    glm::mat4 model;
+    uint32_t materialIndex;
+    uint32_t meshIndex = 0; // set by the geometry arena (mesh the GPU culling pass tests the instance against)
+    uint32_t padding[2] = {}; // matches the std430 layout of the culling shader
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
-        // vertex binding data
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        // instance binding data (advances once per instance instead of per vertex)
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
         return bindingDescription;
     }
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-        // vertex position data to shader
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-        // vertex color data to shader
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
+    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+        // model matrix to shader (a mat4 takes up one location per column)
+        for (uint32_t column = 0; column < 4; column++) {
+            attributeDescriptions[column].binding = 1;
+            attributeDescriptions[column].location = 2 + column;
+            attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[column].offset = offsetof(InstanceData, model) + column * sizeof(glm::vec4);
+        }
+        // material index to shader
+        attributeDescriptions[4].binding = 1;
+        attributeDescriptions[4].location = 6;
+        attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+        attributeDescriptions[4].offset = offsetof(InstanceData, materialIndex);
 
         return attributeDescriptions;
     }
 };
 struct GraphicsInput {
-    std::vector<Vertex> vertexData = {
-            {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}}, // invisible placeholder vertex (buffer cannot be empty)
-    };
-    std::vector<uint32_t> indexData = {
-            0, 0, 0 // invisible placeholder indices (buffer cannot be initialized empty)
-    };
+    std::vector<Vertex> vertexData; // optional initial mesh (added to ShowBase::meshes on launch)
+    std::vector<uint32_t> indexData;
+    VertexFormat vertexFormat = VERTEX_FORMAT_DEFAULT;
+    std::string meshAssetPath; // optional .vkrmesh file, all of its meshes are added on launch as well
     VkClearValue bufferClearColor = (VkClearValue){{{0.05f, 0.05f, 0.05f, 1.0f}}}; // default world background color
 };
+typedef uint64_t PipelineKey;
+struct PipelineState { // everything a graphics pipeline variant can differ in (defaults = the default pipeline)
+    std::string vertexShader = "shaders/engine_basic.vert.spv";
+    std::string fragmentShader = "shaders/engine_basic.frag.spv";
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    bool alphaBlending = true;
+    VertexFormat vertexFormat = VERTEX_FORMAT_DEFAULT; // always set to the mesh's format by the geometry arena
+};
+struct HeadlessFrame { // a frame rendered in headless mode, read back from the GPU (EngineConfig::headless)
+    uint64_t frameNumber;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format; // HEADLESS_COLOR_FORMAT, 4 bytes per pixel
+    const uint8_t *pixels; // tightly packed rows, only valid during the frame callback
+};
 
 #include "ShowBase.h"
 
@@ -112,6 +142,8 @@ struct QueueFamilyIndices {
     std::optional<uint32_t> presentFamily;
     std::optional<uint32_t> transferFamily;
     std::optional<bool> dedicatedTransferFamily;
+    std::optional<uint32_t> computeFamily; // the graphics family unless the GPU has an async compute family
+    std::optional<bool> dedicatedComputeFamily;
     /* Note: Queue families with either `VK_QUEUE_GRAPHICS_BIT` or `VK_QUEUE_COMPUTE_BIT` capabilities already
      * implicitly support `VK_QUEUE_TRANSFER_BIT` operations. Just for the challenge, I've added a dedicated
      * `transferFamily` property to the indices in case there is a GPU queue family dedicated to transfer operations.
@@ -120,25 +152,40 @@ struct QueueFamilyIndices {
     bool isComplete() {
         return graphicsFamily.has_value() &&
                 presentFamily.has_value() &&
-                transferFamily.has_value();
+                transferFamily.has_value() &&
+                computeFamily.has_value();
     }
 };
 
 class PhysicalDevice: public VkModuleBase {
 public:
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties; // of the selected GPU
+    uint8_t driverUUID[VK_UUID_SIZE];
     QueueFamilyIndices queueFamilies;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT; // default MSAA
+    bool multiDrawIndirect = false; // several indirect draws per call (one call per draw otherwise)
+    bool drawIndirectCount = false; // draw count read from a GPU buffer (lets the culling pass compact draws)
+    bool samplerAnisotropy = false; // anisotropic texture filtering
+    bool textureCompressionBC = false; // BC1-7 texture formats (desktop GPUs)
+    bool textureCompressionASTC = false; // ASTC LDR texture formats (mobile GPUs)
+    bool descriptorIndexing = false; // update after bind descriptor arrays, non-uniformly indexed (bindless mode)
+    bool presentWait = false; // VK_KHR_present_id & VK_KHR_present_wait (low latency frame pacing)
+    bool memoryBudget = false; // VK_EXT_memory_budget (heap usage & budgets reported by the driver)
+    uint32_t timestampValidBits = 0; // of the graphics queue's timestamps (0 = no timestamp queries)
     PhysicalDevice(Vulkan *m_vulkan);
     VkFormat findDepthFormat();
     bool depthFormatHasStencilComponent(VkFormat format);
-    VkSampleCountFlagBits getMaxUsableSampleCount();
+    VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice device);
 private:
+    std::vector<VkPhysicalDevice> probedDevices; // every GPU & its suitability score (during device selection)
+    std::vector<int> probedScores;
     VkFormat findSupportedDepthFormat(const std::vector<VkFormat>& candidates,
                                       VkImageTiling tiling, VkFormatFeatureFlags features);
-    QueueFamilyIndices findDeviceQueueFamilies();
-    int rateGPUSuitability();
-    bool checkGPUExtensionSupport();
+    QueueFamilyIndices findDeviceQueueFamilies(VkPhysicalDevice device);
+    int rateGPUSuitability(VkPhysicalDevice device);
+    bool checkGPUExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> &extensions);
+    static void rateDeviceTask(void *caller, uint32_t index); // runs on the job manager's workers
 };
 
 // ---------- LogicalDevice.cxx ---------- //
@@ -149,20 +196,63 @@ public:
     VkQueue graphicsQueue;
     VkQueue presentQueue;
     VkQueue transferQueue;
+    VkQueue computeQueue; // the graphics queue without a dedicated compute family
+    PFN_vkWaitForPresentKHR pWaitForPresent = nullptr; // only loaded in low latency mode (EngineConfig::lowLatency)
     LogicalDevice(Vulkan *m_vulkan);
     ~LogicalDevice();
     void waitForDeviceIdle();
 };
 
+// ---------- PipelineCache.cxx ---------- //
+/* Shared by every pipeline the engine builds. Loaded from disk at startup (if it was saved by the same GPU
+ * & driver) and written back at shutdown, so warm starts skip the driver's shader compilation.
+ */
+class PipelineCache: public VkModuleBase {
+public:
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    PipelineCache(Vulkan *m_vulkan, const char* cachePath); // nullptr path = in memory only
+    ~PipelineCache();
+private:
+    std::string cachePath;
+    std::vector<char> readCacheFile();
+    void writeCacheFile();
+};
+
 // ---------- DescriptorPool.cxx ---------- //
+const uint32_t BINDLESS_MAX_TEXTURES = 16384; // sampled image descriptors of the bindless set
+const uint32_t BINDLESS_MAX_STORAGE_BUFFERS = 64; // storage buffer descriptors of the bindless set
+const uint32_t BINDLESS_NO_TEXTURE = UINT32_MAX; // texture index of materials without a resident texture
+
+struct BindlessConstants { // push constants of the graphics pipelines (bindless mode only)
+    uint32_t materialTable; // storage buffer element holding this frame's material table
+};
+
+/* Set 0 holds the camera UBO. With descriptor indexing, set 1 is the bindless set shared by every draw:
+ * binding 0 the texture sampler, binding 1 the sampled images & binding 2 the storage buffers, both large
+ * partially bound arrays updated after bind. Draws only push the index of the frame's material table, which
+ * gives every material the index of its texture, so switching materials doesn't bind anything.
+ */
 class DescriptorPool: public VkModuleBase {
 public:
     VkDescriptorSetLayout descriptorSetLayout;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkDescriptorSet descriptorSet; // single set, the frame's UBO is selected with a dynamic offset
+    bool bindless = false; // PhysicalDevice::descriptorIndexing, the bindless set is only created with it
+    VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet bindlessSet = VK_NULL_HANDLE;
     DescriptorPool(Vulkan *m_vulkan);
     ~DescriptorPool();
+    uint32_t allocateTextureIndex(); // BINDLESS_NO_TEXTURE once the array is full
+    void freeTextureIndex(uint32_t index); // only once no frame in flight samples the texture anymore
+    // descriptor writes are only legal for elements no pending command buffer uses (updated after bind)
+    void writeSampler(VkSampler sampler);
+    void writeTexture(uint32_t index, VkImageView imageView);
+    void writeStorageBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize range);
 private:
     VkDescriptorPool descriptorPool;
+    VkDescriptorPool bindlessPool = VK_NULL_HANDLE; // update after bind sets need a pool of their own
+    std::vector<uint32_t> freeTextureIndices;
+    uint32_t textureIndexCount = 0; // indices handed out so far (not counting the freed ones)
+    void createBindlessSet();
 };
 
 // ---------- Buffers.cxx ---------- //
@@ -170,44 +260,334 @@ struct AllocatedBuffer {
     VkBuffer _bufferInstance;
     VmaAllocation _bufferMemory;
 };
-struct UniformBufferObject {
-    alignas(16) glm::mat4 model;
+struct UniformBufferObject { // per-frame camera data, per-object data goes through InstanceData
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
+    alignas(16) glm::vec4 frustumPlanes[6]; // world space, normals pointing inwards (used by the culling pass)
+    alignas(16) glm::vec4 cameraPosition;
 };
 
+#define MEMORY_POOL_DEFAULT 0 // VMA's general purpose blocks (long lived buffers)
+#define MEMORY_POOL_FRAME 1 // per-frame buffers regrown at runtime (VulkanMemoryAllocator's frame pools)
+const VkDeviceSize FRAME_POOL_BLOCK_SIZE = 16 * 1024 * 1024;
+
 class Buffer: public VkModuleBase {
 public:
     AllocatedBuffer buffer;
-    // When vertex/index buffer init, only one data parameter is used (after BufferUsageFlagBit), never both.
-    Buffer(Vulkan *m_vulkan, VkBufferUsageFlagBits bufferType,
-           const std::vector<Vertex> *vertexData, const std::vector<uint32_t> *indexData);
+    VkDeviceSize size;
+    void *mappedData = nullptr; // only set for buffers allocated with `VMA_ALLOCATION_CREATE_MAPPED_BIT`
+    /* Device local by default, host visible buffers pass the `VMA_ALLOCATION_CREATE_HOST_ACCESS_*` flags.
+     * Buffers are exclusive to the graphics family unless the transfer queue writes them while they're drawn
+     * from (transferShared), exclusive uploads go through an ownership transfer instead (UploadQueue).
+     * Buffers async compute work reads or writes are shared with the compute family (computeShared).
+     */
+    Buffer(Vulkan *m_vulkan, VkBufferUsageFlags usage, VkDeviceSize size, VmaAllocationCreateFlags allocationFlags = 0,
+           int memoryPool = MEMORY_POOL_DEFAULT, bool transferShared = false, bool computeShared = false);
     ~Buffer();
 private:
-    void createVertexBuffer(const std::vector<Vertex> vertices);
-    void createIndexBuffer(const std::vector<uint32_t> indices);
-    void createUniformBuffer();
     void allocateBuffer(AllocatedBuffer *buffer, VkBufferUsageFlags usageTypeBit,
-                        VmaAllocationCreateFlags allocationFlags, VkDeviceSize bufferSize);
-    void copyBuffer(AllocatedBuffer srcBuffer, AllocatedBuffer dstBuffer, VkDeviceSize bufferSize);
+                        VmaAllocationCreateFlags allocationFlags, VkDeviceSize bufferSize,
+                        int memoryPool, bool transferShared, bool computeShared);
+};
+
+// ---------- UniformRing.cxx ---------- //
+struct UniformAllocation {
+    void *data; // persistently mapped, write the uniform data straight into it
+    uint32_t offset; // dynamic offset to bind the descriptor set with
+};
+
+class UniformRing: public VkModuleBase {
+public:
+    AllocatedBuffer buffer;
+    VkDeviceSize frameSize; // aligned size of every frame in flight's region
+    UniformRing(Vulkan *m_vulkan, VkDeviceSize frameSize);
+    ~UniformRing();
+    void beginFrame(uint32_t frameIndex);
+    UniformAllocation allocate(VkDeviceSize size);
+    void flush();
+private:
+    VkDeviceSize alignment = 1;
+    uint8_t *mappedData = nullptr;
+    VkDeviceSize frameOffset = 0;
+    VkDeviceSize head = 0;
+    bool hostCoherent = true;
+    VkDeviceSize alignUp(VkDeviceSize size);
+};
+
+// ---------- UploadQueue.cxx ---------- //
+struct ImageUploadLevel { // a mip level's tightly packed texel blocks, e.g. straight from a mapped texture file
+    const void *data;
+    VkDeviceSize size;
+    VkDeviceSize rowPitch; // bytes per row of texel blocks
+    uint32_t rowHeight; // texels per row of texel blocks (the format's block height)
+};
+
+class UploadQueue: public VkModuleBase {
+public:
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE; // signalled with the value of every completed batch
+    UploadQueue(Vulkan *m_vulkan, VkDeviceSize stagingSize);
+    ~UploadQueue();
+    void enqueueBufferUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size,
+                             bool exclusiveBuffer);
+    void enqueueBufferCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, VkBufferCopy region);
+    void enqueueImageUpload(VkImage image, VkExtent2D extent, uint32_t levelCount,
+                            const std::vector<ImageUploadLevel> &levels);
+    void enqueueDownsampledImageUpload(VkImage image, VkImage sourceImage, VkExtent2D sourceExtent,
+                                       uint32_t skippedLevels, uint32_t levelCount, const ImageUploadLevel &level);
+    VkDeviceSize getStagingSize();
+    uint64_t flush();
+    uint64_t getGraphicsWaitValue();
+    void addGraphicsWait(uint64_t value); // for batches without buffer writes, e.g. a texture frames start sampling
+    bool isComplete(uint64_t value);
+    void waitFor(uint64_t value);
+private:
+    struct PendingCopy {
+        VkBuffer srcBuffer; // staging ring for uploads
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+        bool exclusiveBuffer; // dstBuffer is EXCLUSIVE to the graphics family (needs an ownership transfer)
+    };
+    struct PendingImage {
+        VkImage image;
+        VkExtent2D extent; // of level 0
+        uint32_t levelCount; // of the image, the levels after the uploaded ones are generated with blits
+        uint32_t uploadedLevels;
+        // downsampled uploads: the uploaded level goes to the source image, blitted down skippedLevels levels to
+        // the image's level 0 (the source isn't touched once the batch is done)
+        VkImage sourceImage = VK_NULL_HANDLE;
+        VkExtent2D sourceExtent{};
+        uint32_t skippedLevels = 0;
+        bool started = false; // moved to TRANSFER_DST_OPTIMAL by an earlier batch
+        bool finished = false; // every level is queued, the next batch hands the image over to be sampled
+    };
+    struct PendingImageCopy {
+        VkImage image;
+        VkBufferImageCopy region;
+    };
+    struct UploadBatch {
+        VkCommandBuffer transferCommands;
+        VkCommandBuffer graphicsCommands; // ownership acquire, only with a dedicated transfer family
+        uint64_t value; // timeline value this batch signals once it's fully done
+        uint64_t stagingEnd; // staging ring cursor to reclaim up to when the batch is done
+    };
+    bool ownershipTransfer = false; // transfer family != graphics family
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandPool graphicsPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> freeTransferCommands;
+    std::vector<VkCommandBuffer> freeGraphicsCommands;
+    AllocatedBuffer stagingBuffer;
+    uint8_t *stagingData = nullptr;
+    VkDeviceSize stagingSize;
+    bool stagingCoherent = true;
+    uint64_t writeCursor = 0; // monotonic staging ring cursors (position = cursor % stagingSize)
+    uint64_t reclaimCursor = 0;
+    uint64_t nextValue = 0;
+    uint64_t lastSubmittedValue = 0;
+    uint64_t lastAcquireValue = 0; // the last batch's ownership acquire (0 without one)
+    uint64_t graphicsWaitValue = 0; // last batch writing buffers, frames don't wait on texture only batches
+    std::vector<PendingCopy> pendingCopies; // staging ring -> buffer
+    std::vector<PendingCopy> pendingBufferCopies; // buffer -> buffer, run after the uploads of the same batch
+    void recordCopies(VkCommandBuffer commandBuffer, std::vector<PendingCopy> &copies,
+                      std::vector<VkBufferMemoryBarrier> &releaseBarriers);
+    std::vector<PendingImage> pendingImages; // in enqueue order, the images of a single batch never overlap
+    std::vector<PendingImageCopy> pendingImageCopies; // staging ring -> image
+    void stageImageLevel(VkImage image, uint32_t mipLevel, VkExtent2D extent, const ImageUploadLevel &upload);
+    void recordLevelBlit(VkCommandBuffer commandBuffer, VkImage srcImage, VkExtent2D srcExtent, uint32_t srcLevel,
+                         VkImage dstImage, VkExtent2D dstExtent, uint32_t dstLevel);
+    void recordImageCopies(VkCommandBuffer commandBuffer);
+    void recordImageFinalize(VkCommandBuffer commandBuffer, const PendingImage &pendingImage);
+    bool hasPendingWork();
+    std::deque<UploadBatch> inFlightBatches;
+    VkDeviceSize allocateStaging(VkDeviceSize size);
+    void reclaimBatches();
+    VkCommandBuffer getCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer> &freeCommands);
+    void submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue, VkPipelineStageFlags waitStage,
+                uint64_t signalValue);
+};
+
+// ---------- AsyncCompute.cxx ---------- //
+/* Compute work scheduled for the frame is submitted right before its graphics work, on the compute queue. With
+ * a dedicated compute family it runs alongside the graphics queue still rasterizing the previous frame, otherwise
+ * it's a submit of its own on the graphics queue. The frame's graphics submit waits on the timeline semaphore at
+ * the stages the jobs' results are used at, the jobs wait on the buffer uploads the frame waits on.
+ * Buffers used by both families are created computeShared, images & other exclusive resources have to be
+ * handed over with ownership transfers recorded by the jobs themselves.
+ * Note: Not thread safe, compute work is scheduled & submitted from the render thread.
+ */
+class AsyncCompute: public VkModuleBase {
+public:
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE; // signalled with the value of every frame's compute submit
+    bool dedicatedQueue; // runs on its own queue family (overlapping the graphics queue)
+    AsyncCompute(Vulkan *m_vulkan);
+    ~AsyncCompute();
+    // records into the frame's compute command buffer at the next submit(), in scheduling order
+    void schedule(std::function<void(VkCommandBuffer)> record, VkPipelineStageFlags graphicsWaitStages);
+    void submit(); // the frame's scheduled work (submits nothing without any)
+    uint64_t getGraphicsWaitValue(); // 0 when the frame has no compute work to wait on
+    VkPipelineStageFlags getGraphicsWaitStages();
+    void waitFor(uint64_t value);
+private:
+    struct ComputeJob {
+        std::function<void(VkCommandBuffer)> record;
+        VkPipelineStageFlags graphicsWaitStages; // first graphics stages using the job's results
+    };
+    std::vector<ComputeJob> scheduledJobs;
+    std::vector<uint64_t> frameValues; // value of every frame in flight's last submit (its command buffer's)
+    uint64_t nextValue = 0;
+    uint64_t graphicsWaitValue = 0;
+    VkPipelineStageFlags graphicsWaitStages = 0;
+};
+
+// ---------- GeometryArena.cxx ---------- //
+// First-fit allocator handing out element ranges of a fixed size arena, freed ranges are coalesced
+class RangeAllocator {
+public:
+    uint32_t capacity;
+    RangeAllocator(uint32_t capacity);
+    bool allocate(uint32_t count, uint32_t *offset, uint32_t alignment = 1); // offset is a multiple of alignment
+    void free(uint32_t offset, uint32_t count);
+private:
+    std::map<uint32_t, uint32_t> freeRanges; // offset -> element count
+};
+
+struct MeshCullData { // per drawn mesh, std430 layout of the culling shader
+    glm::vec4 boundingSphere; // model space center (xyz) & radius (w)
+    glm::vec4 lodDistances; // camera distance every LOD starts at (LOD 0 always starts at 0)
+    uint32_t firstDraw; // draw slot of LOD 0, the other LODs follow it
+    uint32_t lodCount;
+    uint32_t drawBatch; // compacted draws are counted per batch
+    uint32_t batchFirstDraw;
+};
+
+struct DrawBatch { // consecutive draws sharing a pipeline variant & index type
+    PipelineKey pipelineKey;
+    VkIndexType indexType;
+    uint32_t firstDraw;
+    uint32_t drawCount;
+    bool operator==(const DrawBatch &other) const = default;
+};
+
+/* Holds every registered mesh in one shared vertex & index buffer, so meshes can be streamed in and out
+ * without a VMA allocation per mesh. Applies the mesh registry's queued operations between frames.
+ * Both buffers are suballocated by the byte (in 4 & 2 byte units), every mesh's vertices start on a multiple
+ * of its vertex format's stride & its indices are 16 bit whenever its vertex count allows it.
+ */
+class GeometryArena: public VkModuleBase {
+public:
+    std::unique_ptr<Buffer> vertexBuffer;
+    std::unique_ptr<Buffer> indexBuffer;
+    struct FrameDrawBuffers { // one set per frame in flight (rewritten while other frames draw)
+        // host visible, written by the arena
+        std::unique_ptr<Buffer> instanceBuffer;
+        std::unique_ptr<Buffer> indirectBuffer; // draw list (one empty draw slot per mesh LOD with GPU culling)
+        std::unique_ptr<Buffer> meshBuffer; // MeshCullData of every drawn mesh (GPU culling only)
+        // device local, written by the culling pass (GPU culling only)
+        std::unique_ptr<Buffer> drawSlotBuffer; // draw slots holding the instance counts that survived culling
+        std::unique_ptr<Buffer> culledInstanceBuffer; // surviving instances, grouped by draw slot
+        std::unique_ptr<Buffer> compactedDrawBuffer; // non-empty draw slots packed to the front
+        std::unique_ptr<Buffer> drawCountBuffer; // number of compacted draws of every draw batch
+        uint32_t instanceCount = 0;
+        uint32_t drawCount = 0;
+        uint32_t meshCount = 0;
+        uint64_t drawVersion = 0; // version of the draw list the buffers hold
+    };
+    std::vector<FrameDrawBuffers> frameDrawBuffers;
+    GeometryArena(Vulkan *m_vulkan, uint32_t vertexCapacity, uint32_t indexCapacity);
+    ~GeometryArena();
+    // returns true when the number of draws or instances (or the draw batches) changed, those are recorded
+    // (frame timeline value, the mesh operations are applied up to the simulation tick the frame draws)
+    bool applyPendingOperations(uint64_t completedValue, uint64_t lastTick);
+    bool writeFrameDraws(uint32_t frameIndex); // returns true when the frame's buffers were reallocated
+    void estimateMaterialCoverage(const glm::vec3 &cameraPosition, float pixelsPerUnit, std::vector<float> &coverage);
+private:
+    struct LodRange {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float distance;
+    };
+    struct MeshAllocation {
+        uint32_t generation = 0; // generation of the registry handle (0 = slot unused)
+        uint32_t vertexOffset; // in vertices of the mesh's format
+        uint32_t vertexCount;
+        uint32_t firstIndex; // in indices of the mesh's index type
+        uint32_t indexCount;
+        VertexFormat vertexFormat;
+        uint32_t vertexStride;
+        VkIndexType indexType;
+        VertexQuantization quantization; // folded into the instance transforms of quantized meshes
+        glm::vec4 boundingSphere; // model space, only ever grows with vertex updates
+        std::vector<LodRange> lods; // lower detail index ranges (LOD 1 onwards)
+        PipelineKey pipelineKey = 0; // set to the library's default key when added
+        uint64_t copyBatch = 0; // upload batch the mesh was last copied in
+        bool customInstances = false; // meshes without instances set are drawn once with an identity transform
+        std::vector<InstanceData> instances;
+    };
+    struct DeferredFree { // ranges in the allocators' units
+        uint64_t timelineValue; // frame timeline value the range is free at (no frame in flight draws from it)
+        uint32_t vertexOffset;
+        uint32_t vertexSize;
+        uint32_t indexOffset; // index range is only freed along with removed meshes (size 0 otherwise)
+        uint32_t indexSize;
+    };
+    RangeAllocator vertexRanges; // 4 byte units
+    RangeAllocator indexRanges; // 2 byte units
+    std::vector<MeshAllocation> meshAllocations; // indexed by the mesh handle's slot index
+    std::deque<DeferredFree> deferredFrees;
+    std::vector<MeshOperation> operations; // reused between frames
+    std::vector<InstanceData> instances; // instances of every draw, packed in draw order
+    std::vector<MeshCullData> cullMeshes; // GPU culling only
+    std::vector<uint32_t> drawOrder; // mesh slots sorted by pipeline & index type (scratch buffer)
+    std::vector<uint16_t> narrowedIndices; // scratch buffer of 16 bit index uploads
+    uint32_t culledInstanceCapacity = 0; // instances the draw slots can hold (every LOD fits all mesh instances)
+    uint64_t drawVersion = 1;
+    uint64_t uploadBatch = 1;
+    void addMesh(MeshOperation &operation);
+    bool allocateIndices(const MeshAllocation &allocation, uint32_t indexCount, uint32_t *firstIndex);
+    void uploadIndices(const MeshAllocation &allocation, uint32_t firstIndex, const std::vector<uint32_t> &indices);
+    void updateMesh(MeshOperation &operation, uint64_t timelineValue);
+    void removeMesh(MeshOperation &operation, uint64_t timelineValue);
+    void setMeshInstances(MeshOperation &operation);
+    void setMeshLods(MeshOperation &operation, uint64_t timelineValue);
+    void setMeshPipeline(MeshOperation &operation);
+    void releaseDeferredFrees(uint64_t completedValue);
+    void flushUploads();
+    bool rebuildDrawCommands();
+    bool reserveBuffer(std::unique_ptr<Buffer> &buffer, VkBufferUsageFlags usage, VkDeviceSize size,
+                       VkDeviceSize minimumSize, VmaAllocationCreateFlags allocationFlags);
 };
 
 // ---------- VulkanMemoryAllocator.cxx ---------- //
 class VulkanMemoryAllocator: public VkModuleBase {
 public:
     VmaAllocator memoryAllocator;
+    /* Per-frame draw & culling buffers are regrown (and the old ones retired) at runtime, so they get blocks of
+     * their own instead of fragmenting the long lived arena buffers' blocks. One pool per memory type used.
+     */
+    VmaPool hostFramePool = VK_NULL_HANDLE; // host visible (sequentially written by the CPU)
+    VmaPool deviceFramePool = VK_NULL_HANDLE; // device local (written by the GPU)
     VulkanMemoryAllocator(Vulkan *m_vulkan);
     ~VulkanMemoryAllocator();
+    VmaPool getPool(int memoryPool, VmaAllocationCreateFlags allocationFlags, VkDeviceSize size);
+    // counts the allocation under its ShowBase::memory category until it's untracked (right before freeing it)
+    void track(VmaAllocation allocation, int category);
+    void untrack(VmaAllocation allocation);
+private:
+    VmaPool createFramePool(VmaAllocationCreateFlags allocationFlags);
 };
 
 // ---------- SwapChain.cxx ---------- //
+struct AllocatedImage { // allocated by ImageViews::allocateVMAImage()
+    VkImage _imageInstance;
+    VmaAllocation _imageMemory;
+};
 
 // Prefer standard 32-bit color formats (SRGB)
 const VkFormat PREFERRED_COLOR_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
 const VkColorSpaceKHR PREFERRED_COLOR_SPACE = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-// Preferred swap chain presentation modes
+// Fallback for unsupported presentation modes (EngineConfig::presentMode)
 const VkPresentModeKHR DEFAULT_PRESENTATION = VK_PRESENT_MODE_FIFO_KHR; // guaranteed & optimal, higher latency
-const VkPresentModeKHR PREFERRED_PRESENTATION = VK_PRESENT_MODE_MAILBOX_KHR; // more expensive, but lowest latency
+// Offscreen image format in headless mode (RGBA byte order, so read back frames can be written out as they are)
+const VkFormat HEADLESS_COLOR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
 
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -215,9 +595,12 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+/* In headless mode there's no surface to present to, the swap chain is made of one offscreen VMA image per frame
+ * in flight instead (swapChain stays VK_NULL_HANDLE, every module using the swap images works as it is).
+ */
 class SwapChain: public VkModuleBase {
 public:
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
@@ -225,19 +608,18 @@ public:
     ~SwapChain();
     static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 private:
+    std::vector<AllocatedImage> offscreenImages; // headless mode only
+    void createOffscreenImages();
     // Surface format (presentation color depth)
     static VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
     // Presentation mode (image buffer swapping methods)
-    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
+    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes,
+                                              VkPresentModeKHR requestedMode);
     // Swap Extent (resolution of swap chain images)
     static VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities, GLFWwindow *window);
 };
 
 // ---------- ImageViews.cxx ---------- //
-struct AllocatedImage {
-    VkImage _imageInstance;
-    VmaAllocation _imageMemory;
-};
 class SwapImageViews: public VkModuleBase {
 public:
     std::vector<VkImageView> swapChainImageViews;
@@ -247,57 +629,168 @@ public:
 // static helper class for creating images using VMA
 class ImageViews {
 public:
+    // render targets are big & recreated with the swap chain, their own memory keeps them from fragmenting
     static void allocateVMAImage(VmaAllocator allocator, AllocatedImage *allocatedImage, uint32_t width,
                                  uint32_t height, VkImageTiling tiling, VkSampleCountFlagBits msaaSamples,
-                                 VkImageUsageFlags usageFlags, VkFormat imageFormat);
-    static VkImageView createImageView(VkDevice logicalDevice, VkImage image,
-                                       VkFormat format, VkImageAspectFlags aspectFlags);
-    static void transitionImageLayout(AllocatedImage allocatedImage, VkFormat format,
-                                      VkImageLayout oldLayout, VkImageLayout newLayout);
-};
-
-// ---------- MultiSampling.cxx ---------- //
-class MultiSampling: public VkModuleBase {
-public:
-    AllocatedImage msaaImage;
-    VkImageView msaaImageView;
-    MultiSampling(Vulkan *m_vulkan);
-    ~MultiSampling();
-};
-
-// ---------- DepthBuffering.cxx ---------- //
-class DepthTesting: public VkModuleBase {
-public:
-    AllocatedImage depthImage;
-    VkImageView depthImageView;
-    DepthTesting(Vulkan *m_vulkan);
-    ~DepthTesting();
+                                 VkImageUsageFlags usageFlags, VkFormat imageFormat, uint32_t mipLevels = 1,
+                                 VmaAllocationCreateFlags allocationFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                                 VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO);
+    static VkImageView createImageView(VkDevice logicalDevice, VkImage image, VkFormat format,
+                                       VkImageAspectFlags aspectFlags, uint32_t levelCount = 1);
+    static void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask,
+                                      VkImageLayout oldLayout, VkImageLayout newLayout,
+                                      uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 };
 
 // ---------- RenderPass.cxx ---------- //
+/* Builds & compiles the frame's render graph: the GPU culling pre-pass, the scene pass drawing the draw list
+ * (multisampled color & depth resolved into the swap image) and in headless mode the readback copy. Every
+ * raster group of the compiled plan becomes a VkRenderPass, post-processing & shadow passes are added to the
+ * graph in buildFrameGraph() instead of changing the render passes by hand.
+ */
 class RenderPass: public VkModuleBase {
 public:
-    VkRenderPass renderPass;
+    VkRenderPass renderPass; // of the scene pass' group, the pipelines & draws are recorded against it
+    uint32_t sceneSubpass = 0; // of the scene pass in that render pass
+    RenderGraphPlan plan;
+    std::vector<VkRenderPass> renderPasses; // per plan group (VK_NULL_HANDLE for compute & transfer groups)
+    uint32_t cullingPass = RENDER_GRAPH_NONE; // graph passes (culling only with GPU culling, readback headless)
+    uint32_t scenePass = RENDER_GRAPH_NONE;
+    uint32_t readbackPass = RENDER_GRAPH_NONE;
+    RenderImage frameImage; // the imported swap image (the offscreen image in headless mode)
     RenderPass(Vulkan *m_vulkan);
     ~RenderPass();
+    VkImage getImage(RenderImage image, uint32_t imageIndex);
+    std::vector<VkClearValue> getClearValues(uint32_t group);
+    void recordBarriers(VkCommandBuffer commandBuffer, uint32_t group, uint32_t imageIndex);
+    static VkImageLayout getUsageLayout(uint32_t usage, bool depth);
+    static VkPipelineStageFlags getUsageStages(uint32_t usages); // of a (1 << RENDER_USAGE_*) mask
+    static VkAccessFlags getUsageAccess(uint32_t usages);
+private:
+    void buildFrameGraph();
+    VkRenderPass createRenderPass(const RenderGroupPlan &group);
+};
+
+// ---------- RenderTargets.cxx ---------- //
+/* The physical images of the render graph's own images, one per slot of the plan (images with disjoint
+ * lifetimes share one). Images that never leave their render pass (the multisampled color & the depth image)
+ * are transient attachments in lazily allocated memory where the GPU has it, tiled GPUs then keep them in tile
+ * memory only. Allocated at the high-water mark of the swap extent, like the swap chain's other dependents.
+ */
+class RenderTargets: public VkModuleBase {
+public:
+    VkExtent2D imageExtent; // can be larger than the swap extent (reused while it fits)
+    RenderTargets(Vulkan *m_vulkan, VkExtent2D minimumExtent = {0, 0});
+    ~RenderTargets();
+    bool covers(VkExtent2D extent);
+    VkImage getImage(RenderImage image); // graph owned images only
+    VkImageView getImageView(RenderImage image);
+private:
+    std::vector<AllocatedImage> images; // per plan slot
+    std::vector<VkImageView> imageViews;
 };
 
 // ---------- GraphicsPipeline.cxx ---------- //
 class GraphicsPipeline: public VkModuleBase {
 public:
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    // default pipeline (PipelineState defaults), draws fall back to it. Compiled in the background at startup,
+    // VK_NULL_HANDLE until then (the first frames only clear)
+    std::atomic<VkPipeline> graphicsPipeline = VK_NULL_HANDLE;
     GraphicsPipeline(Vulkan *m_vulkan);
     ~GraphicsPipeline();
-private:
+    void checkDefaultPipeline(); // rethrows what compiling the default pipeline failed with
+    VkPipeline createPipeline(const PipelineState &state); // thread safe (compiles the library's variants)
     VkShaderModule createShaderModule(const std::vector<char> &shaderBinary);
     static std::vector<char> readSpirVShaderBinary(const std::string &filename);
+    static VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format);
+    static std::vector<VkVertexInputAttributeDescription> getVertexAttributeDescriptions(VertexFormat format);
+private:
+    std::atomic<bool> defaultFailed = false;
+    std::exception_ptr defaultError = nullptr; // set before defaultFailed
+    static void compileDefaultTask(void *caller, uint32_t index); // runs on the job manager's workers
+};
+
+// ---------- PipelineLibrary.cxx ---------- //
+/* Graphics pipeline variants keyed by a hash of their state. Variants are compiled on the job manager's
+ * workers in the background, draws using one fall back to the default pipeline (of the variant's vertex
+ * format) until it's ready.
+ * SPIR-V binaries are read from disk once and shared by every pipeline using them. The ones needed at startup
+ * are preloaded on the workers, a pipeline needing a binary that's still being read waits for that read.
+ */
+class PipelineLibrary: public VkModuleBase {
+public:
+    PipelineKey defaultKey; // key of the default PipelineState (never compiled by the library)
+    PipelineLibrary(Vulkan *m_vulkan);
+    ~PipelineLibrary();
+    PipelineKey hashState(const PipelineState &state);
+    PipelineKey requestPipeline(const PipelineState &state); // render thread, queues the compile of new variants
+    // the compiled variant, or the default pipeline (of its vertex format) until then, VK_NULL_HANDLE if neither is
+    VkPipeline getPipeline(PipelineKey key);
+    bool takeReadyVariants(); // true once after variants finished compiling (their draws need re-recording)
+    std::shared_ptr<const std::vector<char>> getShaderBinary(const std::string &filename); // thread safe
+    void preloadShaders(std::vector<std::string> filenames); // once, at startup (read in the background)
+private:
+    struct ShaderBinary {
+        std::shared_ptr<const std::vector<char>> code;
+        bool loading = true; // being read by another thread
+    };
+    struct PipelineVariant {
+        PipelineLibrary *library;
+        PipelineState state;
+        PipelineKey fallbackKey; // default state of the variant's vertex format (drawn with until it's compiled)
+        std::atomic<VkPipeline> pipeline = VK_NULL_HANDLE; // set by the compiling worker
+    };
+    std::unordered_map<PipelineKey, std::unique_ptr<PipelineVariant>> variants; // render thread only
+    std::mutex shaderMutex;
+    std::condition_variable shaderLoaded;
+    std::unordered_map<std::string, ShaderBinary> shaderBinaries;
+    std::vector<std::string> preloadFilenames;
+    std::atomic<bool> variantsReady = false;
+    std::atomic<bool> shuttingDown = false;
+    bool defaultPipelinePending = true; // frames are recorded without draws until the default pipeline is ready
+    static void compileVariantTask(void *caller, uint32_t index); // runs on the job manager's workers
+    static void preloadShaderTask(void *caller, uint32_t index);
+};
+
+// ---------- CullingPass.cxx ---------- //
+const uint32_t CULLING_WORKGROUP_SIZE = 64; // local_size_x of the culling shaders
+const char *const CULLING_CULL_SHADER = "shaders/engine_cull.comp.spv";
+const char *const CULLING_COMPACT_SHADER = "shaders/engine_compact.comp.spv";
+
+struct CullingConstants {
+    uint32_t instanceCount;
+    uint32_t drawCount;
+    uint32_t meshCount;
+};
+
+/* Compute pre-pass recorded ahead of the render pass. Tests every instance's bounding sphere against the
+ * camera frustum, picks its LOD by distance and appends the survivors to their LOD's draw slot. The non-empty
+ * slots are then compacted into the indirect buffer the render pass draws from.
+ */
+class CullingPass: public VkModuleBase {
+public:
+    bool compactDraws = false; // drawIndirectCount support (otherwise every draw slot is drawn, empty or not)
+    CullingPass(Vulkan *m_vulkan);
+    ~CullingPass();
+    void updateDescriptorSet(uint32_t frameIndex); // after the frame's draw buffers were reallocated
+    void recordCulling(VkCommandBuffer commandBuffer);
+private:
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    std::vector<VkDescriptorSet> descriptorSets; // one per frame in flight
+    VkPipelineLayout pipelineLayout;
+    VkPipeline cullPipeline;
+    VkPipeline compactPipeline;
+    VkPipeline createComputePipeline(const std::string &filename);
+    static void createPipelineTask(void *caller, uint32_t index); // both pipelines compile at once
 };
 
 // ---------- FrameBuffers.cxx ---------- //
 class FrameBuffers: public VkModuleBase {
 public:
-    std::vector<VkFramebuffer> swapChainFrameBuffers;
+    // per render graph group (empty for compute & transfer groups), one per swap image
+    std::vector<std::vector<VkFramebuffer>> groupFrameBuffers;
     FrameBuffers(Vulkan *m_vulkan);
     ~FrameBuffers();
 };
@@ -312,33 +805,267 @@ public:
     void recordGraphicsCommands(uint32_t imageIndex);
     void submitNextCommandBuffer();
     void resetGraphicsCmdBuffer(uint32_t imageIndex);
+    void allocateCachedCommandBuffers(uint32_t swapImageCount);
+    void markCommandBuffersDirty();
+    void recordDrawState(VkCommandBuffer commandBuffer);
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount);
 private:
+    void recordGraphPass(VkCommandBuffer commandBuffer, uint32_t pass, uint32_t imageIndex);
+    VkSubpassContents getSubpassContents(uint32_t pass);
+    bool cachedRecording = false; // re-record buffers only when marked dirty (EngineConfig::cacheCommandBuffers)
+    uint32_t cachedImageCount = 0;
+    uint32_t activeBufferIndex = 0; // command buffer used by the frame currently being rendered
+    std::vector<bool> dirtyCommandBuffers;
     void createCommandPool(VkCommandPoolCreateFlags additionalFlags, uint32_t queueIndex);
     void createCommandBuffer();
 };
 
+// ---------- ParallelRecorder.cxx ---------- //
+const uint32_t MIN_DRAWS_PER_SLOT = 64; // fewer draws than this are recorded on the render thread alone
+
+class ParallelRecorder: public VkModuleBase {
+public:
+    ParallelRecorder(Vulkan *m_vulkan, uint32_t slotCount);
+    ~ParallelRecorder();
+    void allocateSecondaryBuffers(uint32_t primaryBufferCount);
+    void recordDraws(VkCommandBuffer primaryBuffer, uint32_t primaryIndex, uint32_t imageIndex);
+private:
+    struct RecordingSlot {
+        VkCommandPool commandPool = VK_NULL_HANDLE; // one pool per slot (pools are externally synchronized)
+        std::vector<VkCommandBuffer> commandBuffers; // one secondary buffer per primary buffer
+        uint32_t firstDraw = 0;
+        uint32_t drawCount = 0;
+    };
+    std::vector<RecordingSlot> recordingSlots;
+    uint32_t primaryIndex = 0;
+    uint32_t imageIndex = 0;
+    void recordSlot(uint32_t slot);
+    static void recordSlotTask(void *caller, uint32_t slot); // runs on the job manager's workers
+};
+
 // ---------- Synchronization.cxx ---------- //
+/* Every frame's graphics submit signals the frame timeline (a timeline semaphore) with the next value, the CPU
+ * waits on a frame in flight's value (or polls the current one) instead of using per-frame fences. Skipped frames
+ * submit nothing, so their value is handed to the next frame that does.
+ * Submits are queued and go out with flushSubmits(), one vkQueueSubmit per queue in first queued order. Only
+ * timeline semaphores (wait-before-signal is fine for those) may be waited on across queued submits.
+ */
+struct SubmitSemaphore {
+    VkSemaphore semaphore; // VK_NULL_HANDLE entries are left out of the submit
+    uint64_t value; // ignored for binary semaphores
+    VkPipelineStageFlags stages; // waits only
+};
+
 class Synchronization: public VkModuleBase {
 public:
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    VkSemaphore waitSemaphores[1];
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
     VkSemaphore signalSemaphores[1];
     Synchronization(Vulkan *m_vulkan);
     ~Synchronization();
+    uint64_t getPendingValue(); // signalled by the next graphics submit, once the frames submitted so far are done
+    uint64_t getCompletedValue();
+    uint64_t frameSubmitted(uint32_t frameIndex); // returns the frame's value, signalled by its graphics submit
+    void waitForFrame(uint32_t frameIndex); // the last frame submitted with the frame index
+    void waitFor(uint64_t value);
+    void queueSubmit(VkQueue queue, VkCommandBuffer commandBuffer, std::initializer_list<SubmitSemaphore> waits,
+                     std::initializer_list<SubmitSemaphore> signals);
+    void flushSubmits();
+private:
+    struct QueuedSubmit {
+        VkQueue queue; // VK_NULL_HANDLE once it's part of a flushed vkQueueSubmit
+        VkCommandBuffer commandBuffer;
+        uint32_t firstWait; // ranges in the semaphore arrays below, signals follow the waits
+        uint32_t waitCount;
+        uint32_t signalCount;
+    };
+    std::vector<uint64_t> frameValues; // per frame index, the value its last graphics submit signals
+    uint64_t submittedValue = 0;
+    std::vector<QueuedSubmit> queuedSubmits;
+    std::vector<VkSemaphore> queuedSemaphores; // reused every flush, so queueing doesn't allocate
+    std::vector<uint64_t> queuedValues;
+    std::vector<VkPipelineStageFlags> queuedStages;
+    std::vector<VkSubmitInfo> submitInfos;
+    std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos;
+};
+
+// ---------- GpuProfiler.cxx ---------- //
+// Timestamps written by every frame's command buffer, the GPU regions reported to the profiler lie between them
+const uint32_t GPU_TIMESTAMP_FRAME_START = 0;
+const uint32_t GPU_TIMESTAMP_CULLING_END = 1; // render pass start
+const uint32_t GPU_TIMESTAMP_RENDER_PASS_END = 2;
+const uint32_t GPU_TIMESTAMP_FRAME_END = 3; // after the headless readback copy
+const uint32_t GPU_TIMESTAMP_COUNT = 4;
+
+/* Times the frame's command buffer regions with timestamp queries. The queries of a frame in flight are read
+ * once its frame was waited on (MAX_FRAMES_IN_FLIGHT frames later), so reading them never stalls the GPU.
+ * GPU regions are placed on the profiler's clock relative to the frame's submit (the clocks aren't calibrated).
+ */
+class GpuProfiler: public VkModuleBase {
+public:
+    GpuProfiler(Vulkan *m_vulkan);
+    ~GpuProfiler();
+    void recordFrameStart(VkCommandBuffer commandBuffer); // resets the frame's queries, first thing recorded
+    void recordTimestamp(VkCommandBuffer commandBuffer, uint32_t timestamp, VkPipelineStageFlagBits stage);
+    void frameSubmitted(uint32_t frameIndex, uint64_t submitTime);
+    void collectFrame(uint32_t frameIndex); // after the frame was waited on
+private:
+    struct FrameQueries {
+        uint64_t submitTime = 0; // profiler clock
+        bool pending = false;
+    };
+    VkQueryPool queryPool;
+    std::vector<FrameQueries> frameQueries; // one per frame in flight
+    uint64_t timestampMask;
+};
+
+// ---------- FrameReadback.cxx ---------- //
+/* Headless mode's replacement for presenting. Every frame copies its offscreen image into the frame in flight's
+ * host visible readback buffer, the copy is handed to EngineConfig::headlessFrameCallback once that frame
+ * was waited on (MAX_FRAMES_IN_FLIGHT frames later), so reading it back overlaps the frames rendered meanwhile.
+ */
+class FrameReadback: public VkModuleBase {
+public:
+    FrameReadback(Vulkan *m_vulkan);
+    ~FrameReadback();
+    void recordCopy(VkCommandBuffer commandBuffer, uint32_t imageIndex); // after the render pass
+    void frameSubmitted(uint32_t frameIndex, uint64_t frameNumber);
+    void collectFrame(uint32_t frameIndex); // after the frame was waited on
+    void collectAll(); // once the device is idle (end of the render loop)
+private:
+    struct ReadbackSlot {
+        std::unique_ptr<Buffer> buffer; // persistently mapped, grows with the offscreen images
+        uint64_t frameNumber = 0;
+        VkExtent2D extent{}; // of the frame it holds
+        bool pending = false; // holds a frame the callback hasn't been given yet
+    };
+    std::vector<ReadbackSlot> readbackSlots; // one per frame in flight
+    static VkDeviceSize frameSize(VkExtent2D extent);
+};
+
+// ---------- DeletionQueue.cxx ---------- //
+/* Retired resources are destroyed once the frame timeline passed the value of the next graphics submit at the
+ * time they were retired, so no frame in flight can still be using them (instead of waiting for the whole
+ * device to be idle).
+ */
+class DeletionQueue: public VkModuleBase {
+public:
+    DeletionQueue(Vulkan *m_vulkan);
+    ~DeletionQueue();
+    void retire(std::function<void()> destroy);
+    template<typename T> void retire(std::unique_ptr<T> module) { // takes over a whole module
+        T *pModule = module.release();
+        this->retire([pModule] { delete pModule; });
+    }
+    void release(uint64_t completedValue); // frame timeline value
+private:
+    struct RetiredResource {
+        uint64_t timelineValue; // frame timeline value the resource is free at
+        std::function<void()> destroy;
+    };
+    std::deque<RetiredResource> retiredResources;
+};
+
+// ---------- TextureStreamer.cxx ---------- //
+/* Applies the texture registry's queued operations & keeps every texture's mip levels resident by the screen
+ * coverage of the materials drawing with it, within the texture memory budget (EngineConfig). A texture
+ * changing its resident levels gets a new image holding just those levels, uploaded straight from the mapped
+ * file through the upload queue (at most EngineConfig::textureUploadBytesPerFrame per frame, textures over it
+ * get sharper a level per frame), and it's only swapped in once the upload is done. The replaced image is
+ * retired to the deletion queue.
+ * In bindless mode, a swapped in view gets a new descriptor index (the old one may still be sampled by frames
+ * in flight), the material tables pick the new index up with the frame they're next written in.
+ */
+const uint32_t BINDLESS_MAX_MATERIALS = 4096; // material table entries, higher material indices draw untextured
+
+class TextureStreamer: public VkModuleBase {
+public:
+    VkSampler sampler = VK_NULL_HANDLE; // shared by every texture (trilinear, repeating, anisotropic if supported)
+    TextureStreamer(Vulkan *m_vulkan, uint64_t memoryBudget, uint64_t uploadBytesPerFrame);
+    ~TextureStreamer();
+    void update(uint64_t frameNumber);
+    void flushUploads(); // after the frame was submitted
+    VkImageView getTextureView(uint32_t materialIndex); // VK_NULL_HANDLE while nothing of the texture is resident
+    uint64_t getResidentBytes();
+private:
+    struct StreamedTexture {
+        uint32_t generation = 0; // generation of the registry handle (0 = slot unused)
+        std::shared_ptr<const TextureAsset> asset;
+        VkFormat format;
+        uint32_t mipCount; // levels on the GPU (only level 0 when generated mips can't be blitted)
+        uint64_t levelSizes[TEXTURE_MAX_LEVELS];
+        uint32_t tailLevel;
+        float priority;
+        uint32_t wantedLevel;
+        uint32_t plannedLevel; // largest level the last residency plan keeps resident
+        AllocatedImage image{}; // holds the levels from residentLevel on (its level 0 = residentLevel)
+        VkImageView imageView = VK_NULL_HANDLE;
+        uint32_t residentLevel; // mipCount = nothing resident
+        AllocatedImage pendingImage{}; // being uploaded, replaces the image once its upload is done
+        VkImageView pendingImageView = VK_NULL_HANDLE;
+        AllocatedImage pendingSource{}; // generated mips from a smaller level: level 0 to blit them down from
+        uint32_t pendingLevel;
+        uint64_t pendingValue = 0; // upload timeline value (0 = no upload in flight)
+        uint32_t descriptorIndex = BINDLESS_NO_TEXTURE; // of the image view in the bindless set
+    };
+    struct CancelledUpload { // pending image (or source) of a removed texture, destroyed once its upload is done
+        AllocatedImage image;
+        VkImageView imageView;
+        uint64_t value;
+    };
+    uint64_t memoryBudget;
+    uint64_t uploadBytesPerFrame;
+    // bindless mode: every frame in flight's material table (texture index per material index)
+    std::vector<std::unique_ptr<Buffer>> materialTables;
+    std::vector<uint64_t> materialTableVersions; // materialsVersion each frame's table was written at
+    uint64_t materialsVersion = 1; // changes with the material textures & their descriptor indices
+    std::vector<StreamedTexture> textures; // indexed by the texture handle's slot index
+    std::vector<TextureHandle> materials; // texture of every material index (null handle = none)
+    std::vector<CancelledUpload> cancelledUploads;
+    std::vector<uint32_t> uploadSlots; // textures whose uploads were queued since the last flush
+    std::vector<TextureOperation> operations; // reused between frames
+    std::vector<float> coverage; // per material index, in pixels across (scratch buffer)
+    std::vector<TextureResidencyRequest> requests; // scratch buffers of the residency planning
+    std::vector<uint32_t> requestSlots;
+    bool planNeeded = false; // textures were added, removed or re-prioritized since the last residency plan
+    void applyPendingOperations();
+    void addTexture(TextureOperation &operation);
+    void removeTexture(uint32_t slot);
+    bool checkFormatSupport(const TextureAsset &asset, bool *blitMips);
+    void swapFinishedUploads();
+    void planResidency();
+    void startUploads();
+    uint64_t getUploadBytes(const StreamedTexture &texture, uint32_t level);
+    bool startUpload(uint32_t slot, uint32_t level);
+    uint64_t getBudget();
+    void writeMaterialTable(uint32_t frameIndex);
+    void retireImage(AllocatedImage image, VkImageView imageView, uint32_t descriptorIndex);
+    void destroyImage(AllocatedImage image, VkImageView imageView);
 };
 
 // ---------- Vulkan.cxx ---------- //
+const uint64_t PRESENT_WAIT_TIMEOUT = 100000000; // nanoseconds the low latency pacing waits for a present at most
+
 class Vulkan {
 public:
     const char* engineName = "Vulkray";
     GraphicsInput graphicsInput;
     // Render variables
-    const unsigned int MAX_FRAMES_IN_FLIGHT = 2;
+    unsigned int MAX_FRAMES_IN_FLIGHT = 2; // EngineConfig::framesInFlight (fixed once the modules are created)
     uint32_t frameIndex = 0;
-    bool framebufferResized = false;
-    const std::vector<const char*> requiredExtensions = {
+    uint64_t frameNumber = 0; // frames rendered so far (frameIndex wraps around, this doesn't)
+    uint64_t startupStart = 0; // profiler clock, the startup time is reported with the first frame
+    bool framebufferResized = false; // swap chain is recreated at the start of the next frame (at most once)
+    uint64_t presentId = 0; // id of the last present (VK_KHR_present_id, low latency mode only)
+    uint64_t swapChainFirstPresentId = 1; // first present id of the current swap chain
+    // draw list (one indirect draw per mesh, or per mesh LOD with GPU culling) written to the indirect buffers
+    std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+    std::vector<DrawBatch> drawBatches; // draw list ranges sharing a pipeline variant (sorted by pipeline)
+    UniformAllocation cameraUniforms{}; // this frame's UBO in the uniform ring (always its first allocation)
+    glm::vec3 cameraPosition{}; // of the last UBO update, textures are streamed by the last frame's camera
+    float pixelsPerUnit = 0.0f; // screen pixels an object 1 unit wide covers at a distance of 1 (last UBO update)
+    const std::vector<const char*> requiredExtensions = { // window mode only, headless mode needs none
             VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
     const std::vector<const char*> validationLayers = {
@@ -352,36 +1079,46 @@ public:
     #endif
     // Vulkan instance modules (RAII)
     std::unique_ptr<VulkanInstance> m_vulkanInstance;
-    std::unique_ptr<Window> m_window;
+    std::unique_ptr<Window> m_window = nullptr; // there's no window (or surface) in headless mode
     std::unique_ptr<PhysicalDevice> m_physicalDevice;
     std::unique_ptr<LogicalDevice> m_logicalDevice;
     std::unique_ptr<VulkanMemoryAllocator> m_VMA;
+    std::unique_ptr<Synchronization> m_synchronization; // destroyed after the modules submitting work
+    std::unique_ptr<PipelineCache> m_pipelineCache;
     std::unique_ptr<SwapChain> m_swapChain;
     std::unique_ptr<SwapChain> m_oldSwapChain = nullptr; // used for swap recreation
     std::unique_ptr<SwapImageViews> m_imageViews;
-    std::unique_ptr<MultiSampling> m_MSAA;
-    std::unique_ptr<DepthTesting> m_depthTesting;
     std::unique_ptr<RenderPass> m_renderPass;
+    std::unique_ptr<RenderTargets> m_renderTargets;
     std::unique_ptr<DescriptorPool> m_descriptorPool;
     std::unique_ptr<GraphicsPipeline> m_graphicsPipeline;
+    std::unique_ptr<PipelineLibrary> m_pipelineLibrary; // created before the graphics pipeline (shader cache)
+    std::unique_ptr<CullingPass> m_cullingPass = nullptr; // only used with GPU culling (EngineConfig::gpuCulling)
     std::unique_ptr<FrameBuffers> m_frameBuffers;
     std::unique_ptr<CommandPool> m_graphicsCommandPool;
-    std::unique_ptr<CommandPool> m_transferCommandPool;
-    std::unique_ptr<Buffer> m_vertexBuffer;
-    std::unique_ptr<Buffer> m_indexBuffer;
-    std::vector<std::unique_ptr<Buffer>> m_uniformBuffers;
-    std::unique_ptr<Synchronization> m_synchronization;
+    std::unique_ptr<CommandPool> m_computeCommandPool; // on the compute family, one buffer per frame in flight
+    std::unique_ptr<AsyncCompute> m_asyncCompute;
+    std::unique_ptr<UploadQueue> m_uploadQueue;
+    std::unique_ptr<ParallelRecorder> m_parallelRecorder = nullptr; // only used with multiple recording threads
+    std::unique_ptr<GeometryArena> m_geometryArena;
+    std::unique_ptr<TextureStreamer> m_textureStreamer;
+    std::unique_ptr<UniformRing> m_uniformRing;
+    std::unique_ptr<GpuProfiler> m_gpuProfiler = nullptr; // only with EngineConfig::profiling & timestamp support
+    std::unique_ptr<FrameReadback> m_frameReadback = nullptr; // only used in headless mode (EngineConfig::headless)
+    std::unique_ptr<DeletionQueue> m_deletionQueue; // destroyed first (retired resources depend on the rest)
     ShowBase *base;
     Vulkan(ShowBase *base, GraphicsInput graphicsInput, char* winTitle, void (*initGlfwInput)(Vulkan *m_vulkan));
     ~Vulkan();
 private:
     void renderFrame();
-    void waitForPreviousFrame(); // Wrapper for vkWaitForFences()
+    void waitForPreviousFrame(); // Waits on the frame index' frame timeline value
+    void waitForPresentPacing();
     void updateUniformBuffer(uint32_t imageIndex);
-    void getNextSwapChainImage(uint32_t *imageIndex);
+    bool getNextSwapChainImage(uint32_t *imageIndex); // false when the frame has to be skipped
     void resetGraphicsCmdBuffer(uint32_t imageIndex);
     void presentImageBuffer(uint32_t *imageIndex);
     void recreateSwapChain();
+    void applyWindowSize(); // ShowBase::set_window_size()
 };
 
 #endif //VULKRAY_VULKAN_HXX
@@ -1,17 +1,22 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 frustumPlanes[6]; // only used by the culling pass
+    vec4 cameraPosition;
 } ubo;
 
+// quantized vertex formats pass normalized positions, their dequantization is part of the model matrix
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+// per-instance attributes (InstanceData, locations 2-5 hold the model matrix columns)
+layout(location = 2) in mat4 inModel;
+layout(location = 6) in uint inMaterialIndex;
 
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
     fragColor = inColor;
 }
\ No newline at end of file
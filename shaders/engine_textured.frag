@@ -0,0 +1,31 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// the bindless set (DescriptorPool), every resident texture is in it
+layout(set = 1, binding = 0) uniform sampler textureSampler;
+layout(set = 1, binding = 1) uniform texture2D textures[];
+layout(set = 1, binding = 2) readonly buffer MaterialTable {
+    uint textureIndices[]; // per material index, 0xFFFFFFFF = no resident texture
+} materialTables[];
+
+layout(push_constant) uniform BindlessConstants {
+    uint materialTable; // this frame's material table in the storage buffer array
+} constants;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragMaterialIndex;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor, 1.0);
+    uint textureIndex = 0xFFFFFFFFu;
+    if (fragMaterialIndex < materialTables[constants.materialTable].textureIndices.length()) {
+        textureIndex = materialTables[constants.materialTable].textureIndices[fragMaterialIndex];
+    }
+    // the material index differs between the instances of a draw, so the texture index isn't uniform
+    if (textureIndex != 0xFFFFFFFFu) {
+        outColor *= texture(sampler2D(textures[nonuniformEXT(textureIndex)], textureSampler), fragUV);
+    }
+}
\ No newline at end of file
@@ -13,10 +13,11 @@
 #include "../../include/Vulkray/Camera.h"
 #include "../../include/Vulkray/ObjectNode.h"
 #include "../../include/Vulkray/JobManager.h"
+#include "../../include/Vulkray/LinearMath.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
-Camera::Camera(ShowBase *base): ObjectNode() {
+Camera::Camera(ShowBase *base): ObjectNode(base->transforms.get()) {
     this->update(); // initial camera update
     this->base = base;
     base->jobManager->new_job("_global_cam_update", this, &this->_per_frame_update);
@@ -27,9 +28,13 @@ Camera::~Camera() {
 }
 
 void Camera::update() {
-    this->create_view_matrix();
-    this->fov_radians = glm::radians(this->fov);
+    this->fov_radians = glm::radians(this->fov); // `fov` can be changed directly, so this is always refreshed
+    // the view matrix only depends on the camera's transform, skip rebuilding it while the camera isn't moving
+    uint32_t version = this->transforms->get_version(this->node);
+    if (version == this->viewVersion) return;
+    this->viewVersion = version;
     this->calculate_look_vector();
+    this->create_view_matrix();
 }
 
 void Camera::_per_frame_update(void *caller, ShowBase *base) {
@@ -37,23 +42,30 @@ void Camera::_per_frame_update(void *caller, ShowBase *base) {
     self->update(); // update camera
 }
 
-void Camera::create_view_matrix() {
-    glm::vec3 eye = glm::vec3(this->x, this->y, this->z); // 'eye' coordinate (cam pos)
-    glm::vec3 center = glm::vec3(this->x + this->look_at_vector.x,
-                                 this->y + this->look_at_vector.y, // 'center' coordinate (cam look at)
-                                 this->z + this->look_at_vector.z);
+glm::mat4x4 Camera::compose_view_matrix(glm::vec3 eye, glm::vec3 lookAt) {
+    glm::vec3 center = eye + lookAt; // 'center' coordinate (cam look at)
     glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f); // 'up' vector (Z axis is up in this engine)
+    return glm::lookAt(eye, center, up);
+}
 
-    this->view_matrix = glm::lookAt(eye, center, up);
+void Camera::create_view_matrix() {
+    glm::vec3 eye = this->transforms->get_position(this->node); // 'eye' coordinate (cam pos)
+    this->view_matrix = Camera::compose_view_matrix(eye, this->look_at_vector);
 }
 
 glm::mat4x4 Camera::get_view_matrix() {
-    // used by the Vulkan module for the uniform buffer
     return this->view_matrix;
 }
 
+// used by the Vulkan module for the uniform buffer (the simulation thread's snapshots in threaded mode)
+CameraState Camera::get_state() {
+    return {this->transforms->get_position(this->node), this->look_at_vector, this->fov_radians,
+            this->near, this->far};
+}
+
 glm::vec3 Camera::get_look_at_vector() {
-    this->calculate_look_vector(); // make sure look_at vector is updated!
+    // only recalculated when the camera turned since (same as the view matrix)
+    if (this->transforms->get_version(this->node) != this->lookVersion) this->calculate_look_vector();
     return this->look_at_vector;
 }
 
@@ -65,13 +77,18 @@ void Camera::calculate_look_vector() {
      * Note: y value of heading vector is inverted for clockwise degrees. (45 degrees turns 45 degrees right)
      *       Pretty sure (if I'm correct) this is because OpenGL / Vulkan has flipped y coords.
      */
+    this->lookVersion = this->transforms->get_version(this->node);
+    glm::vec3 hpr = this->transforms->get_rotation(this->node);
+    float angles[2] = {glm::radians(hpr.x), glm::radians(hpr.y)};
+    float sines[2], cosines[2];
+    linmath::sin_cos(angles, sines, cosines, 2); // both angles at once
     this->look_at_vector = glm::vec3(0.0f, 0.0f, 0.0f);
     // calculate heading
-    this->look_at_vector.x += glm::cos(glm::radians(this->h)); // x
-    this->look_at_vector.y += glm::sin(glm::radians(this->h)) * -1; // y
+    this->look_at_vector.x += cosines[0]; // x
+    this->look_at_vector.y += sines[0] * -1; // y
     // calculate pitch
-    this->look_at_vector.x += glm::cos(glm::radians(this->p)); // x
-    this->look_at_vector.z += glm::sin(glm::radians(this->p)); // z
+    this->look_at_vector.x += cosines[1]; // x
+    this->look_at_vector.z += sines[1]; // z
 }
 
 void Camera::set_near(float near) {
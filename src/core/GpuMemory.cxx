@@ -0,0 +1,124 @@
+/*
+ * GpuMemory.cxx
+ * Keeps track of the GPU memory heaps' usage & budgets, and the renderer's allocations by category.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/GpuMemory.h"
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+GpuMemory::GpuMemory(float pressureThreshold) {
+    this->pressureThreshold = pressureThreshold;
+}
+
+std::vector<GpuHeapBudget> GpuMemory::get_heap_budgets() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->heaps;
+}
+
+GpuMemoryCategory GpuMemory::get_category(int category) {
+    if (category < 0 || category >= MEMORY_CATEGORY_COUNT) {
+        spdlog::error("get_category(): Received an invalid memory category!");
+        throw std::runtime_error("An invalid memory category was given to the GPU memory module.");
+    }
+    return {this->categoryCounts[category].load(), this->categoryBytes[category].load()};
+}
+
+const char *GpuMemory::get_category_name(int category) {
+    static const char *names[MEMORY_CATEGORY_COUNT] = {"vertex", "index", "uniform", "image", "staging", "other",
+                                                       "texture"};
+    if (category < 0 || category >= MEMORY_CATEGORY_COUNT) return "unknown";
+    return names[category];
+}
+
+std::string GpuMemory::get_stats_string(bool detailed) {
+    std::lock_guard<std::mutex> lock(this->mutex); // keeps the allocator from being destroyed meanwhile
+    if (this->allocator == VK_NULL_HANDLE) return "";
+    char *statsString = nullptr;
+    vmaBuildStatsString(this->allocator, &statsString, detailed ? VK_TRUE : VK_FALSE);
+    std::string stats(statsString);
+    vmaFreeStatsString(this->allocator, statsString);
+    return stats;
+}
+
+void GpuMemory::set_pressure_callback(void *caller, void (*pFunction)(void *caller, ShowBase *base,
+                                                                      const GpuHeapBudget &heap)) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->pressureCaller = caller;
+    this->pressureCallback = pFunction;
+}
+
+void GpuMemory::_set_allocator(VmaAllocator allocator) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->allocator = allocator;
+    if (allocator == VK_NULL_HANDLE) {
+        this->heaps.clear();
+        this->pressureFrames.clear();
+    }
+}
+
+void GpuMemory::_track_allocation(int category, uint64_t size) {
+    this->categoryCounts[category].fetch_add(1, std::memory_order_relaxed);
+    this->categoryBytes[category].fetch_add(size, std::memory_order_relaxed);
+}
+
+void GpuMemory::_untrack_allocation(int category, uint64_t size) {
+    this->categoryCounts[category].fetch_sub(1, std::memory_order_relaxed);
+    this->categoryBytes[category].fetch_sub(size, std::memory_order_relaxed);
+}
+
+// vmaGetHeapBudgets() is cheap enough to be called every frame (the driver is only queried every few allocations)
+void GpuMemory::_update_budgets(ShowBase *base) {
+    std::vector<GpuHeapBudget> pressuredHeaps;
+    void *caller;
+    void (*callback)(void *caller, ShowBase *base, const GpuHeapBudget &heap);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->allocator == VK_NULL_HANDLE) return;
+        const VkPhysicalDeviceMemoryProperties *memoryProperties;
+        vmaGetMemoryProperties(this->allocator, &memoryProperties);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(this->allocator, budgets);
+
+        uint32_t heapCount = memoryProperties->memoryHeapCount;
+        this->heaps.resize(heapCount);
+        this->pressureFrames.resize(heapCount, 0);
+        for (uint32_t i = 0; i < heapCount; i++) {
+            GpuHeapBudget &heap = this->heaps[i];
+            heap.heapIndex = i;
+            heap.deviceLocal = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            heap.heapSize = memoryProperties->memoryHeaps[i].size;
+            heap.usage = budgets[i].usage;
+            heap.budget = budgets[i].budget;
+            heap.blockBytes = budgets[i].statistics.blockBytes;
+
+            if ((double) heap.usage <= (double) heap.budget * this->pressureThreshold) {
+                this->pressureFrames[i] = 0;
+                continue;
+            }
+            // fires right away when the heap goes over, then every MEMORY_PRESSURE_REPEAT_FRAMES frames
+            if (this->pressureFrames[i] == 0 || this->pressureFrames[i] >= MEMORY_PRESSURE_REPEAT_FRAMES) {
+                if (this->pressureFrames[i] == 0) {
+                    spdlog::warn("GPU memory heap {0} is over {1}% of its budget. ({2} of {3} MiB)", i,
+                                 (int) (this->pressureThreshold * 100), heap.usage >> 20, heap.budget >> 20);
+                }
+                pressuredHeaps.push_back(heap);
+                this->pressureFrames[i] = 1;
+            } else {
+                this->pressureFrames[i]++;
+            }
+        }
+        caller = this->pressureCaller;
+        callback = this->pressureCallback;
+    }
+    if (callback == nullptr) return;
+    // outside the lock, evicting assets may well query the budgets again
+    for (const GpuHeapBudget &heap : pressuredHeaps) callback(caller, base, heap);
+}
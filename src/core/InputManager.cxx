@@ -10,51 +10,143 @@
  * with this source code in a file named "COPYING."
  */
 
+#include <chrono>
 #include <string>
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 #include "../../include/Vulkray/InputManager.h"
 
-InputManager::InputManager() {
-    // placeholder
+InputManager::InputManager(ShowBase *base, bool queued) {
+    this->base = base;
+    this->queued = queued;
+    for (const GLFWKeyAlias &alias : this->keyAliases) {
+        if (!alias.keyAlias.empty()) this->aliasKeyIDs[alias.keyAlias] = alias.glfwKeyID; // skip unused entries
+    }
 }
 
 InputManager::~InputManager() {
     // placeholder
 }
 
+// Looks the key alias up once, callbacks are stored & dispatched by key code
+int InputManager::findKeyID(const char *key, const char *caller) {
+    auto alias = this->aliasKeyIDs.find(key);
+    if (alias == this->aliasKeyIDs.end()) {
+        spdlog::error("{0}(): Received an invalid key string! ('{1}')", caller, key);
+        throw std::runtime_error("An invalid key was given to the input module.");
+    }
+    return alias->second;
+}
+
+static uint64_t eventTimestamp() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+bool InputEventQueue::push(const InputEvent &event) {
+    uint64_t tail = this->tail.load(std::memory_order_relaxed);
+    if (tail - this->head.load(std::memory_order_acquire) >= INPUT_QUEUE_CAPACITY) return false;
+    this->events[tail % INPUT_QUEUE_CAPACITY] = event;
+    this->tail.store(tail + 1, std::memory_order_release); // publishes the event to the consumer
+    return true;
+}
+
+bool InputEventQueue::pop(InputEvent *event) {
+    uint64_t head = this->head.load(std::memory_order_relaxed);
+    if (head == this->tail.load(std::memory_order_acquire)) return false;
+    *event = this->events[head % INPUT_QUEUE_CAPACITY];
+    this->head.store(head + 1, std::memory_order_release); // hands the slot back to the producer
+    return true;
+}
+
+void InputManager::dispatchKey(int key, int action) {
+    if (key < 0 || key > GLFW_KEY_LAST) return; // GLFW_KEY_UNKNOWN (e.g. media keys), no callback can accept it
+    std::vector<KeyCallback> &callbacks = this->keyCallbacks[key];
+
+    // by index & copied out, a callback may (un)register key callbacks while they're being called
+    for (size_t i = 0; i < callbacks.size(); i++) {
+        KeyCallback callback = callbacks[i];
+        // KEY_EITHER is our own feature that represents either KEY_PRESSED or KEY_HELD
+        bool accepted = callback.action == KEY_ANY || callback.action == action ||
+                        (callback.action == KEY_EITHER && action != KEY_RELEASED);
+        if (accepted) callback.pFunction(callback.caller, this->base, action);
+    }
+}
+
+void InputManager::dispatchCursor(double x_pos, double y_pos) {
+    // call every cursor callback allocated by the developer
+    for (CursorCallback callback : this->cursorCallbacks) {
+        callback.pFunction(callback.caller, this->base, x_pos, y_pos);
+    }
+}
+
+void InputManager::moveCursor(double x_pos, double y_pos) {
+    if (this->cursorKnown) {
+        this->cursorDeltaX += x_pos - this->cursorX;
+        this->cursorDeltaY += y_pos - this->cursorY;
+    }
+    this->cursorKnown = true;
+    this->cursorX = x_pos;
+    this->cursorY = y_pos;
+}
+
 void InputManager::_non_static_key_callback(int key, int scancode, int action, int mods) {
-    size_t keyMapLength = sizeof(this->keyAliases) / sizeof(GLFWKeyAlias);
-
-    for (size_t i = 0; i < keyMapLength; i++) {
-        GLFWKeyAlias alias = this->keyAliases[i];
-        if (alias.glfwKeyID != key) continue;
-
-        for (KeyCallback callback : this->keyCallbacks) {
-            if (callback.key.compare(alias.keyAlias) != 0) continue; // skip if callback key doesn't match
-
-            if (callback.action != KEY_ANY) {
-                // skip if callback action doesn't match
-                if (callback.action != action) {
-                    // could be that callback.action == 3, which is our own feature that represents either 1 or 2.
-                    if ((callback.action == KEY_EITHER) & (action != KEY_RELEASED)) {
-                        callback.pFunction(callback.caller, this->m_window->m_vulkan->base, action);
-                    } else continue;
-                }
-            }
-            callback.pFunction(callback.caller, this->m_window->m_vulkan->base, action);
-        }
+    if (!this->queued) {
+        this->dispatchKey(key, action);
         return;
     }
-    spdlog::error("The UserInput module key callback received an invalid key!");
-    throw std::runtime_error("An invalid key was received by the input module.");
+    InputEvent event{INPUT_EVENT_KEY, key, action, 0, 0, eventTimestamp()};
+    if (!this->eventQueue.push(event)) this->droppedEvents.fetch_add(1, std::memory_order_relaxed);
 }
 
 void InputManager::_non_static_cursor_callback(double x_pos, double y_pos) {
-    // call every cursor callback allocated by the developer
-    for (CursorCallback callback : this->cursorCallbacks) {
-        callback.pFunction(callback.caller, this->m_window->m_vulkan->base, x_pos, y_pos);
+    if (!this->queued) {
+        this->moveCursor(x_pos, y_pos);
+        this->dispatchCursor(x_pos, y_pos);
+        return;
     }
+    InputEvent event{INPUT_EVENT_CURSOR, 0, 0, x_pos, y_pos, eventTimestamp()};
+    if (!this->eventQueue.push(event)) this->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Key events are dispatched in the order they came in, the frame's cursor motion is coalesced into a single
+ * cursor callback with its last position (dispatched after the keys). Without the queue this only closes the
+ * frame's cursor delta, the callbacks were already called while GLFW polled the events.
+ */
+uint64_t InputManager::_dispatch_events() {
+    uint64_t oldestTimestamp = 0;
+    bool cursorMoved = false;
+    InputEvent event;
+    while (this->eventQueue.pop(&event)) {
+        if (oldestTimestamp == 0) oldestTimestamp = event.timestamp;
+        if (event.type == INPUT_EVENT_KEY) {
+            this->dispatchKey(event.key, event.action);
+        } else {
+            this->moveCursor(event.x, event.y);
+            cursorMoved = true;
+        }
+    }
+    this->frameDeltaX = this->cursorDeltaX;
+    this->frameDeltaY = this->cursorDeltaY;
+    this->cursorDeltaX = 0;
+    this->cursorDeltaY = 0;
+    if (cursorMoved) this->dispatchCursor(this->cursorX, this->cursorY);
+    uint64_t dropped = this->droppedEvents.load(std::memory_order_relaxed);
+    if (dropped != this->reportedDrops &&
+        vulkray_log_interval_passed(this->dropsLogged, VULKRAY_LOG_REPEAT_INTERVAL_MS)) {
+        spdlog::warn("{0} input events were dropped, the input queue was full.", dropped - this->reportedDrops);
+        this->reportedDrops = dropped;
+    }
+    return oldestTimestamp == 0 ? 0 : eventTimestamp() - oldestTimestamp;
+}
+
+void InputManager::get_cursor_delta(double *x, double *y) {
+    *x = this->frameDeltaX;
+    *y = this->frameDeltaY;
+}
+
+uint64_t InputManager::get_dropped_events() {
+    return this->droppedEvents.load(std::memory_order_relaxed);
 }
 
 void InputManager::static_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -83,100 +175,39 @@ void InputManager::_static_init_glfw_input(Vulkan *m_vulkan) {
 
 void InputManager::new_accept_key(const char *key, int action, void *caller,
                               void (*pFunction)(void *caller, ShowBase *, int action)) {
-
-    size_t keyMapLength = sizeof(this->keyAliases) / sizeof(GLFWKeyAlias);
-
-    for (size_t i = 0; i < keyMapLength; i++) {
-        if (this->keyAliases[i].keyAlias.compare(key) == 0) continue;
-        if (action > 4 || action < 0) {
-            spdlog::error("new_accept(): Key callbacks can only accept from an action between 0-4!");
-            throw std::runtime_error("An invalid action was given to the input module to accept.");
-        }
-        // once params are validated, append new callback struct to vector
-        KeyCallback newCallback;
-        newCallback.key.assign(key);
-        newCallback.action = action;
-        newCallback.caller = caller;
-        newCallback.pFunction = pFunction;
-        this->keyCallbacks.push_back(newCallback);
-        return;
+    if (action > 4 || action < 0) {
+        spdlog::error("new_accept(): Key callbacks can only accept from an action between 0-4!");
+        throw std::runtime_error("An invalid action was given to the input module to accept.");
     }
-    spdlog::error("new_accept(): Received an invalid key string!");
-    throw std::runtime_error("An invalid key was given to the input module to accept.");
+    int keyID = this->findKeyID(key, "new_accept");
+    KeyCallback newCallback;
+    newCallback.glfwKeyID = keyID;
+    newCallback.action = action;
+    newCallback.caller = caller;
+    newCallback.pFunction = pFunction;
+    this->keyCallbacks[keyID].push_back(newCallback);
 }
 
 void InputManager::new_accept_key(const char *key, void *caller,
                               void (*pFunction)(void *caller, ShowBase *, int action)) {
-
-    size_t keyMapLength = sizeof(this->keyAliases) / sizeof(GLFWKeyAlias);
-
-    for (size_t i = 0; i < keyMapLength; i++) {
-        if (this->keyAliases[i].keyAlias.compare(key) == 0) continue;
-
-        // once params are validated, append new callback struct to vector
-        KeyCallback newCallback;
-        newCallback.key.assign(key);
-        newCallback.action = KEY_ANY; // this method overload takes no action param, listen to all actions.
-        newCallback.caller = caller;
-        newCallback.pFunction = pFunction;
-        this->keyCallbacks.push_back(newCallback);
-        return;
-    }
-    spdlog::error("new_accept(): Received an invalid key string!");
-    throw std::runtime_error("An invalid key was given to the input module to accept.");
+    // this method overload takes no action param, listen to all actions.
+    this->new_accept_key(key, KEY_ANY, caller, pFunction);
 }
 
+// Removes the key's first callback registered with that action
 void InputManager::remove_accept_key(const char *key, int action) {
-    size_t keyMapLength = sizeof(this->keyAliases) / sizeof(GLFWKeyAlias);
-
-    for (size_t i = 0; i < keyMapLength; i++) {
-        GLFWKeyAlias alias = this->keyAliases[i];
-        if (alias.keyAlias != key) continue;
-
-        int j = 0; // search through callbacks vector and find index of matching callback to delete
-        for (KeyCallback callback : this->keyCallbacks) {
-            if (callback.key.compare(alias.keyAlias) != 0) {
-                j++; continue;
-            }
-            if (callback.action != action) {
-                if ((callback.action == KEY_EITHER) & (action != KEY_RELEASED)) {
-                    this->keyCallbacks.erase(this->keyCallbacks.begin() + j);
-                    return; // callback found, return
-                } else {
-                    j++; continue;
-                    /* I know this is a mess and would be cleaner if the for loop incremented j for me,
-                     * but it works and does not affect performance at all. and it's late.
-                     */
-                }
-            }
-            this->keyCallbacks.erase(this->keyCallbacks.begin() + j);
-            return; // callback found, return
-        }
-        return;
+    std::vector<KeyCallback> &callbacks = this->keyCallbacks[this->findKeyID(key, "remove_accept")];
+    for (size_t i = 0; i < callbacks.size(); i++) {
+        if (callbacks[i].action != action) continue;
+        callbacks.erase(callbacks.begin() + (long) i);
+        return; // callback found, return
     }
-    spdlog::error("remove_accept(): Received an invalid key string!");
-    throw std::runtime_error("An invalid key was received by the input module.");
 }
 
+// Removes the key's first callback, whatever its action
 void InputManager::remove_accept_key(const char *key) {
-    size_t keyMapLength = sizeof(this->keyAliases) / sizeof(GLFWKeyAlias);
-
-    for (size_t i = 0; i < keyMapLength; i++) {
-        GLFWKeyAlias alias = this->keyAliases[i];
-        if (alias.keyAlias != key) continue;
-
-        int j = 0; // search through callbacks vector and find index of matching callback to delete
-        for (KeyCallback callback : this->keyCallbacks) {
-            if (callback.key.compare(alias.keyAlias) != 0) {
-                j++; continue;
-            }
-            this->keyCallbacks.erase(this->keyCallbacks.begin() + j);
-            return; // callback found, return
-        }
-        return;
-    }
-    spdlog::error("remove_accept(): Received an invalid key string!");
-    throw std::runtime_error("An invalid key was received by the input module.");
+    std::vector<KeyCallback> &callbacks = this->keyCallbacks[this->findKeyID(key, "remove_accept")];
+    if (!callbacks.empty()) callbacks.erase(callbacks.begin());
 }
 
 void InputManager::new_accept_cursor(void *caller, const char* id,
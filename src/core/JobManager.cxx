@@ -11,38 +11,559 @@
  */
 
 #include "../../include/Vulkray/JobManager.h"
+#include "../../include/Vulkray/Logging.h"
 #include <spdlog/spdlog.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
 
-JobManager::JobManager() {
-    // placeholder
+// index of the calling thread's own task queue (-1 = not a worker thread)
+static thread_local int workerQueueIndex = -1;
+
+JobManager::JobManager(unsigned int workerCount) {
+    // 0 = one worker per hardware thread, leaving one for the render thread
+    if (workerCount == 0) workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    // one queue per worker + one shared by the non-worker threads (render thread)
+    for (unsigned int i = 0; i < workerCount + 1; i++) {
+        this->taskQueues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (unsigned int i = 0; i < workerCount; i++) {
+        this->workers.emplace_back(&JobManager::workerLoop, this, i);
+    }
+    VULKRAY_LOG_DEBUG("Initialized the job manager with {0} worker threads.", workerCount);
 }
 
 JobManager::~JobManager() {
-    // placeholder
+    try {
+        this->_wait_for_frame_jobs(); // don't pull the queues out from under a running frame
+    } catch (const std::exception &exception) {
+        spdlog::error("A job callback failed during shutdown: {0}", exception.what());
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->stopping = true;
+    }
+    this->wakeSignal.notify_all();
+    for (std::thread &worker : this->workers) worker.join();
 }
 
-std::vector<JobCallback> JobManager::_get_job_callbacks_vector() {
-    // note: this function was made to be used by the vulkan renderer module
-    return this->jobCallbacks;
+// FNV-1a, so removing a job by name only compares the names of the jobs with a matching hash
+static uint64_t hash_job_name(const char *jobName) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *c = jobName; *c != '\0'; c++) {
+        hash ^= static_cast<unsigned char>(*c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
 }
 
-void JobManager::new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base)) {
-    JobCallback jobCallback;
-    jobCallback.name.assign(jobName);
-    jobCallback.caller = caller;
-    jobCallback.pFunction = pFunction;
-    this->jobCallbacks.push_back(jobCallback); // push function pointer to jobs vector
+JobHandle JobManager::new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base)) {
+    JobOptions options;
+    options.beforeUniformUpdate = true;
+    options.mainThread = true; // they used to run on the main thread, and may touch GLFW or the camera
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return this->addJob(jobName, caller, pFunction, options, true);
+}
+
+JobHandle JobManager::new_job(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base),
+                              const JobOptions &options) {
+    if (options.priority < JOB_PRIORITY_LOW || options.priority > JOB_PRIORITY_HIGH) {
+        spdlog::error("new_job(): Job priorities can only be between {0}-{1}!", JOB_PRIORITY_LOW, JOB_PRIORITY_HIGH);
+        throw std::runtime_error("An invalid priority was given to the job manager.");
+    }
+    if (options.dependencyCount > JOB_MAX_DEPENDENCIES) {
+        spdlog::error("new_job(): Jobs can only have up to {0} dependencies!", JOB_MAX_DEPENDENCIES);
+        throw std::runtime_error("Too many dependencies were given to the job manager.");
+    }
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    // only registered jobs can be depended on (a handle of a job that doesn't exist yet could form a cycle)
+    for (uint32_t i = 0; i < options.dependencyCount; i++) {
+        if (!this->isAlive(options.dependencies[i])) {
+            spdlog::error("new_job(): Job dependencies have to be registered jobs!");
+            throw std::runtime_error("A stale or invalid dependency was given to the job manager.");
+        }
+    }
+    return this->addJob(jobName, caller, pFunction, options, false);
+}
+
+void JobManager::remove_job(JobHandle handle) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(handle)) {
+        spdlog::error("Could not remove job callback! Job handle is stale or invalid.");
+        throw std::runtime_error("Failed to remove job callback! Invalid handle.\n");
+    }
+    this->removeSlot(handle.index);
 }
 
 void JobManager::remove_job(const char *jobName) {
-    int index = 0;
-    for (JobCallback jobCallback : this->jobCallbacks) {
-        if (jobCallback.name.compare(jobName)) { // find job with matching name ID
-            this->jobCallbacks.erase(this->jobCallbacks.begin() + index);
+    uint64_t nameHash = hash_job_name(jobName);
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    for (const JobCallback &jobCallback : this->jobCallbacks) {
+        if (jobCallback.nameHash == nameHash && jobCallback.name == jobName) { // find job with matching name
+            this->removeSlot(jobCallback.slot);
             return;
         }
-        index++;
     }
     spdlog::error("Could not remove job callback! Job name/identifier didn't match any jobs.");
     throw std::runtime_error("Failed to remove job callback! Identifier not found.\n");
-}
\ No newline at end of file
+}
+
+bool JobManager::is_job_valid(JobHandle handle) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return this->isAlive(handle);
+}
+
+unsigned int JobManager::get_worker_count() {
+    return static_cast<unsigned int>(this->workers.size());
+}
+
+bool JobManager::isAlive(JobHandle handle) {
+    if (handle.index >= this->jobSlots.size()) return false;
+    const JobSlot &slot = this->jobSlots[handle.index];
+    return slot.alive && slot.generation == handle.generation;
+}
+
+// Takes a slot off the free list (or appends one) and pushes the callback onto the dense array
+JobHandle JobManager::addJob(const char *jobName, void *caller, void (*pFunction)(void *caller, ShowBase *base),
+                             const JobOptions &options, bool serial) {
+    uint32_t slotIndex = this->freeSlot;
+    if (slotIndex != JOB_SLOT_NONE) {
+        this->freeSlot = this->jobSlots[slotIndex].denseIndex;
+    } else {
+        slotIndex = static_cast<uint32_t>(this->jobSlots.size());
+        this->jobSlots.emplace_back();
+    }
+    JobSlot &slot = this->jobSlots[slotIndex];
+    slot.alive = true;
+    slot.denseIndex = static_cast<uint32_t>(this->jobCallbacks.size());
+    slot.previousSerial = JOB_SLOT_NONE;
+    slot.nextSerial = JOB_SLOT_NONE;
+
+    JobCallback jobCallback;
+    jobCallback.nameHash = hash_job_name(jobName);
+    jobCallback.name = jobName;
+    jobCallback.caller = caller;
+    jobCallback.pFunction = pFunction;
+    jobCallback.options = options;
+    jobCallback.serial = serial;
+    jobCallback.slot = slotIndex;
+    this->jobCallbacks.push_back(std::move(jobCallback)); // push function pointer to jobs vector
+
+    // serial jobs are kept in a linked list over the slots, the dense array doesn't keep any order
+    if (serial) {
+        slot.previousSerial = this->lastSerialSlot;
+        if (this->lastSerialSlot != JOB_SLOT_NONE) this->jobSlots[this->lastSerialSlot].nextSerial = slotIndex;
+        else this->firstSerialSlot = slotIndex;
+        this->lastSerialSlot = slotIndex;
+    }
+    this->graphDirty = true;
+    return {slotIndex, slot.generation};
+}
+
+void JobManager::removeSlot(uint32_t slotIndex) {
+    JobSlot &slot = this->jobSlots[slotIndex];
+    uint32_t denseIndex = slot.denseIndex;
+
+    if (this->jobCallbacks[denseIndex].serial) {
+        if (slot.previousSerial != JOB_SLOT_NONE) this->jobSlots[slot.previousSerial].nextSerial = slot.nextSerial;
+        else this->firstSerialSlot = slot.nextSerial;
+        if (slot.nextSerial != JOB_SLOT_NONE) this->jobSlots[slot.nextSerial].previousSerial = slot.previousSerial;
+        else this->lastSerialSlot = slot.previousSerial;
+    }
+    // swap the last callback into the hole, so the dense array stays contiguous
+    if (denseIndex != this->jobCallbacks.size() - 1) {
+        this->jobCallbacks[denseIndex] = std::move(this->jobCallbacks.back());
+        this->jobSlots[this->jobCallbacks[denseIndex].slot].denseIndex = denseIndex;
+    }
+    this->jobCallbacks.pop_back();
+
+    slot.alive = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+    slot.denseIndex = this->freeSlot;
+    this->freeSlot = slotIndex;
+    this->graphDirty = true;
+}
+
+// Rebuilds the per-frame job graph from the registered callbacks (only when they changed)
+void JobManager::compileFrameGraph() {
+    auto jobCount = static_cast<uint32_t>(this->jobCallbacks.size());
+    this->frameJobs.resize(jobCount);
+    if (this->pendingCapacity < jobCount) {
+        this->pendingCapacity = std::max<size_t>(jobCount, this->pendingCapacity * 2);
+        this->pendingDependencies = std::make_unique<std::atomic<uint32_t>[]>(this->pendingCapacity);
+    }
+    // collect every (dependency, dependent) pair: the serial chain plus the explicit dependencies
+    this->graphEdges.clear();
+    uint32_t previousSerial = JOB_SLOT_NONE;
+    for (uint32_t slot = this->firstSerialSlot; slot != JOB_SLOT_NONE; slot = this->jobSlots[slot].nextSerial) {
+        uint32_t denseIndex = this->jobSlots[slot].denseIndex;
+        if (previousSerial != JOB_SLOT_NONE) this->graphEdges.emplace_back(previousSerial, denseIndex);
+        previousSerial = denseIndex;
+    }
+    for (uint32_t i = 0; i < jobCount; i++) {
+        const JobOptions &options = this->jobCallbacks[i].options;
+        for (uint32_t j = 0; j < options.dependencyCount; j++) {
+            // a removed dependency simply doesn't hold the job back anymore
+            if (!this->isAlive(options.dependencies[j])) continue;
+            this->graphEdges.emplace_back(this->jobSlots[options.dependencies[j].index].denseIndex, i);
+        }
+    }
+    // lay the dependents out contiguously per job (counting sort over the edges)
+    for (uint32_t i = 0; i < jobCount; i++) {
+        const JobCallback &jobCallback = this->jobCallbacks[i];
+        FrameJob &frameJob = this->frameJobs[i];
+        frameJob.caller = jobCallback.caller;
+        frameJob.pFunction = jobCallback.pFunction;
+        frameJob.priority = jobCallback.options.priority;
+        frameJob.beforeUniformUpdate = jobCallback.options.beforeUniformUpdate;
+        frameJob.mainThread = jobCallback.options.mainThread;
+        frameJob.dependencyCount = 0;
+        frameJob.dependentCount = 0;
+    }
+    for (const auto &[dependency, dependent] : this->graphEdges) {
+        this->frameJobs[dependency].dependentCount++;
+        this->frameJobs[dependent].dependencyCount++;
+    }
+    uint32_t offset = 0;
+    for (FrameJob &frameJob : this->frameJobs) {
+        frameJob.firstDependent = offset;
+        offset += frameJob.dependentCount;
+        frameJob.dependentCount = 0;
+    }
+    this->frameDependents.resize(this->graphEdges.size());
+    for (const auto &[dependency, dependent] : this->graphEdges) {
+        FrameJob &frameJob = this->frameJobs[dependency];
+        this->frameDependents[frameJob.firstDependent + frameJob.dependentCount++] = dependent;
+    }
+    // a dependency cycle would never finish, so reject it here rather than hang the render loop (new_job()
+    // already rejects dependencies on jobs that don't exist, so this is only a safety net)
+    this->sortCounts.resize(jobCount);
+    this->sortStack.clear();
+    for (uint32_t i = 0; i < jobCount; i++) {
+        this->sortCounts[i] = this->frameJobs[i].dependencyCount;
+        if (this->sortCounts[i] == 0) this->sortStack.push_back(i);
+    }
+    uint32_t sortedJobs = 0;
+    while (!this->sortStack.empty()) {
+        const FrameJob &frameJob = this->frameJobs[this->sortStack.back()];
+        this->sortStack.pop_back();
+        sortedJobs++;
+        for (uint32_t i = 0; i < frameJob.dependentCount; i++) {
+            uint32_t dependent = this->frameDependents[frameJob.firstDependent + i];
+            if (--this->sortCounts[dependent] == 0) this->sortStack.push_back(dependent);
+        }
+    }
+    if (sortedJobs != jobCount) {
+        spdlog::error("The registered job callbacks contain a dependency cycle!");
+        throw std::runtime_error("Failed to build the frame job graph! Dependency cycle found.");
+    }
+    this->graphDirty = false;
+}
+
+/* Queues every registered job for this frame (jobs without pending dependencies start right away).
+ * The calling thread runs the frame's main thread jobs, so it has to wait on the frame's jobs before dispatching
+ * from another thread.
+ */
+void JobManager::_dispatch_frame_jobs(ShowBase *base) {
+    this->_wait_for_frame_jobs(); // previous frame's jobs (including async ones) have to be done first
+
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (this->graphDirty) this->compileFrameGraph();
+    this->frameBase = base;
+    this->dispatchThread = std::this_thread::get_id();
+
+    auto jobCount = static_cast<uint32_t>(this->frameJobs.size());
+    uint32_t uniformJobCount = 0;
+    for (uint32_t i = 0; i < jobCount; i++) {
+        this->pendingDependencies[i].store(this->frameJobs[i].dependencyCount, std::memory_order_relaxed);
+        if (this->frameJobs[i].beforeUniformUpdate) uniformJobCount++;
+    }
+    this->remainingUniformJobs.store(uniformJobCount);
+    this->remainingJobs.store(jobCount);
+
+    size_t nextQueue = 0;
+    for (uint32_t i = 0; i < jobCount; i++) {
+        if (this->frameJobs[i].dependencyCount != 0) continue;
+        // spread the root jobs over the worker queues, the rest get queued by whoever finishes their dependency
+        this->queueFrameJob(i, nextQueue++ % std::max<size_t>(1, this->workers.size()));
+    }
+}
+
+void JobManager::_wait_for_uniform_jobs() {
+    this->helpUntilZero(this->remainingUniformJobs, JOB_PRIORITY_LOW);
+    this->rethrowJobError();
+}
+
+void JobManager::_wait_for_frame_jobs() {
+    this->helpUntilZero(this->remainingJobs, JOB_PRIORITY_LOW);
+    this->rethrowJobError();
+}
+
+// Runs pFunction(caller, 0..count-1) across the workers, the calling thread helps until all are done
+void JobManager::_run_parallel(uint32_t count, void *caller, void (*pFunction)(void *caller, uint32_t index)) {
+    if (count == 0) return;
+    ParallelBatch batch{};
+    batch.caller = caller;
+    batch.pFunction = pFunction;
+    batch.remaining.store(count);
+
+    size_t queueCount = std::max<size_t>(1, this->workers.size());
+    for (uint32_t i = 1; i < count; i++) {
+        this->pushTask({&JobManager::runParallelTask, &batch, i}, JOB_PRIORITY_HIGH, (i - 1) % queueCount);
+    }
+    /* the other tasks point at this stack frame, so even if a task fails we have to wait for all of them. Only
+     * the batch's own tasks are helped with, other queued work could be a long user job (or fail on its own) */
+    runParallelTask(this, &batch, 0);
+    while (this->tryRunBatchTask(batch)) {}
+    {
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeSignal.wait(lock, [&batch] { return batch.remaining.load() == 0; });
+    }
+    if (batch.error) std::rethrow_exception(batch.error);
+}
+
+/* Queues pFunction(caller, index) to run on a worker whenever it has no frame work left, it's never picked up
+ * by a thread waiting on frame work (so long tasks like pipeline compiles can't stall the render thread).
+ * Nothing waits on background tasks except _wait_for_background_tasks(), queued ones are dropped at shutdown.
+ */
+void JobManager::_run_background(void *caller, void (*pFunction)(void *caller, uint32_t index), uint32_t index) {
+    if (this->workers.empty()) { // no worker would ever pick it up
+        pFunction(caller, index);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->backgroundTasks.push_back({caller, pFunction, index});
+    }
+    this->wakeSignal.notify_all();
+}
+
+// Helps out with the queued background tasks, then waits for the ones still running on the workers
+void JobManager::_wait_for_background_tasks() {
+    while (this->tryRunBackgroundTask()) {}
+    {
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeSignal.wait(lock, [this] {
+            return this->runningBackgroundTasks == 0 && (this->backgroundTasks.empty() || this->stopping);
+        });
+    }
+    this->rethrowJobError();
+}
+
+void JobManager::pushTask(Task task, int priority, size_t queueIndex) {
+    {
+        std::lock_guard<std::mutex> lock(this->taskQueues[queueIndex]->mutex);
+        this->taskQueues[queueIndex]->tasks[priority].push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->queuedTasks++;
+    }
+    this->wakeSignal.notify_all(); // waiters might be sleeping threads or a thread waiting on a frame counter
+}
+
+// Main thread jobs go to the dispatching thread's own queue (workers never look at it)
+void JobManager::queueFrameJob(uint32_t index, size_t queueIndex) {
+    Task task{&JobManager::runFrameJob, nullptr, index};
+    int priority = this->frameJobs[index].priority;
+    if (!this->frameJobs[index].mainThread) {
+        this->pushTask(task, priority, queueIndex);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mainThreadQueue.mutex);
+        this->mainThreadQueue.tasks[priority].push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->queuedMainThreadTasks++;
+    }
+    this->wakeSignal.notify_all();
+}
+
+size_t JobManager::localQueueIndex() {
+    if (workerQueueIndex < 0) return this->workers.size(); // shared non-worker queue
+    return static_cast<size_t>(workerQueueIndex);
+}
+
+// Pops a task from the local queue, otherwise steals one from another queue. Returns false if none were found.
+bool JobManager::tryRunTask(int minPriority) {
+    size_t queueCount = this->taskQueues.size();
+    size_t localQueue = this->localQueueIndex();
+    Task task{};
+    bool found = false;
+
+    for (int priority = JOB_PRIORITY_HIGH; priority >= minPriority && !found; priority--) {
+        for (size_t offset = 0; offset < queueCount && !found; offset++) {
+            TaskQueue &queue = *this->taskQueues[(localQueue + offset) % queueCount];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            std::deque<Task> &tasks = queue.tasks[priority];
+            if (tasks.empty()) continue;
+            // the owner takes the newest task (still warm in cache), thieves take the oldest
+            if (offset == 0) {
+                task = tasks.back();
+                tasks.pop_back();
+            } else {
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            found = true;
+        }
+    }
+    if (!found) return false;
+    this->queuedTasks--;
+
+    try {
+        task.pFunction(this, task.context, task.index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(this->errorMutex);
+        if (!this->jobError) this->jobError = std::current_exception(); // rethrown on the waiting thread
+    }
+    return true;
+}
+
+// Only called by the dispatching thread, in registration order within a priority (serial jobs rely on it)
+bool JobManager::tryRunMainThreadTask() {
+    Task task{};
+    {
+        std::lock_guard<std::mutex> lock(this->mainThreadQueue.mutex);
+        int priority = JOB_PRIORITY_HIGH;
+        while (priority >= JOB_PRIORITY_LOW && this->mainThreadQueue.tasks[priority].empty()) priority--;
+        if (priority < JOB_PRIORITY_LOW) return false;
+        task = this->mainThreadQueue.tasks[priority].front();
+        this->mainThreadQueue.tasks[priority].pop_front();
+    }
+    this->queuedMainThreadTasks--;
+
+    try {
+        task.pFunction(this, task.context, task.index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(this->errorMutex);
+        if (!this->jobError) this->jobError = std::current_exception(); // rethrown at the end of the wait
+    }
+    return true;
+}
+
+// Takes one of the batch's queued tasks out of any queue (they're all high priority), false once none are left
+bool JobManager::tryRunBatchTask(ParallelBatch &batch) {
+    Task task{};
+    bool found = false;
+    for (size_t queueIndex = 0; queueIndex < this->taskQueues.size() && !found; queueIndex++) {
+        TaskQueue &queue = *this->taskQueues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        std::deque<Task> &tasks = queue.tasks[JOB_PRIORITY_HIGH];
+        auto it = std::find_if(tasks.begin(), tasks.end(), [&batch](const Task &queued) {
+            return queued.context == &batch;
+        });
+        if (it == tasks.end()) continue;
+        task = *it;
+        tasks.erase(it);
+        found = true;
+    }
+    if (!found) return false;
+    this->queuedTasks--;
+    runParallelTask(this, &batch, task.index); // (keeps its own errors)
+    return true;
+}
+
+bool JobManager::tryRunBackgroundTask() {
+    BackgroundTask task{};
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        if (this->stopping || this->backgroundTasks.empty()) return false;
+        task = this->backgroundTasks.front();
+        this->backgroundTasks.pop_front();
+        this->runningBackgroundTasks++;
+    }
+    try {
+        task.pFunction(task.caller, task.index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(this->errorMutex);
+        if (!this->jobError) this->jobError = std::current_exception(); // rethrown by the next wait
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->runningBackgroundTasks--;
+    }
+    this->wakeSignal.notify_all();
+    return true;
+}
+
+/* Executes queued tasks on the calling thread until the counter drops to zero.
+ * Only tasks of at least minPriority are picked up, so the render thread doesn't get stuck in a long user job.
+ */
+void JobManager::helpUntilZero(std::atomic<uint32_t> &counter, int minPriority) {
+    // frame waits (low priority) on the dispatching thread run its main thread jobs
+    bool mainThread = minPriority == JOB_PRIORITY_LOW && std::this_thread::get_id() == this->dispatchThread.load();
+    while (counter.load() != 0) {
+        if (mainThread && this->tryRunMainThreadTask()) continue;
+        if (this->tryRunTask(minPriority)) continue;
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeSignal.wait(lock, [this, &counter, minPriority, mainThread] {
+            return counter.load() == 0 || (minPriority == JOB_PRIORITY_LOW && this->queuedTasks.load() != 0) ||
+                   (mainThread && this->queuedMainThreadTasks.load() != 0);
+        });
+    }
+}
+
+void JobManager::notifyWaiters() {
+    // take the lock so a waiter can't miss the wake up between its check and its wait
+    { std::lock_guard<std::mutex> lock(this->sleepMutex); }
+    this->wakeSignal.notify_all();
+}
+
+void JobManager::rethrowJobError() {
+    std::lock_guard<std::mutex> lock(this->errorMutex);
+    if (!this->jobError) return;
+    std::exception_ptr error = this->jobError;
+    this->jobError = nullptr;
+    std::rethrow_exception(error);
+}
+
+void JobManager::workerLoop(size_t workerIndex) {
+    workerQueueIndex = static_cast<int>(workerIndex);
+
+    while (true) {
+        if (this->tryRunTask(JOB_PRIORITY_LOW)) continue;
+        if (this->tryRunBackgroundTask()) continue; // only once no frame work is queued
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeSignal.wait(lock, [this] {
+            return this->stopping || this->queuedTasks.load() != 0 || !this->backgroundTasks.empty();
+        });
+        if (this->stopping) return;
+    }
+}
+
+void JobManager::runFrameJob(JobManager *self, void *context, uint32_t index) {
+    FrameJob &frameJob = self->frameJobs[index];
+    /* a failed job still counts as finished, otherwise its waiters would hang. Its error is kept before the
+     * counters drop, so the wait they release always rethrows it. */
+    try {
+        frameJob.pFunction(frameJob.caller, self->frameBase);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(self->errorMutex);
+        if (!self->jobError) self->jobError = std::current_exception();
+    }
+    // queue up the dependents that were only waiting on this job (on this thread's queue, they're likely related)
+    for (uint32_t i = 0; i < frameJob.dependentCount; i++) {
+        uint32_t dependent = self->frameDependents[frameJob.firstDependent + i];
+        if (--self->pendingDependencies[dependent] == 0) self->queueFrameJob(dependent, self->localQueueIndex());
+    }
+    bool finished = false;
+    if (frameJob.beforeUniformUpdate && --self->remainingUniformJobs == 0) finished = true;
+    if (--self->remainingJobs == 0) finished = true;
+    if (finished) self->notifyWaiters();
+}
+
+void JobManager::runParallelTask(JobManager *self, void *context, uint32_t index) {
+    auto batch = static_cast<ParallelBatch*>(context);
+    try {
+        batch->pFunction(batch->caller, index);
+    } catch (...) {
+        // kept by the batch, not the frame's job error (the batch's caller rethrows it)
+        std::lock_guard<std::mutex> lock(batch->errorMutex);
+        if (!batch->error) batch->error = std::current_exception();
+    }
+    if (--batch->remaining == 0) self->notifyWaiters();
+}
@@ -0,0 +1,92 @@
+/*
+ * MappedFile.cxx
+ * Read only memory mappings of asset files (mmap, file mappings on Windows).
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/MappedFile.h"
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#ifdef _WIN32 // Windows platform-specific (file mappings instead of mmap)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+    this->path = path;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(this->path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize{};
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        spdlog::error("Failed to open the file '{0}'.", this->path);
+        throw std::runtime_error("Could not open a file to map!");
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) CloseHandle(mapping);
+        CloseHandle(file);
+        spdlog::error("Failed to map the file '{0}' into memory.", this->path);
+        throw std::runtime_error("Could not map a file into memory!");
+    }
+    this->fileHandle = file;
+    this->mappingHandle = mapping;
+    this->size = (size_t) fileSize.QuadPart;
+    this->data = static_cast<const uint8_t*>(view);
+#else
+    int file = open(this->path.c_str(), O_RDONLY);
+    struct stat fileStat{};
+    if (file < 0 || fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        if (file >= 0) close(file);
+        spdlog::error("Failed to open the file '{0}'.", this->path);
+        throw std::runtime_error("Could not open a file to map!");
+    }
+    this->size = (size_t) fileStat.st_size;
+    void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        spdlog::error("Failed to map the file '{0}' into memory.", this->path);
+        throw std::runtime_error("Could not map a file into memory!");
+    }
+    // assets are read front to back once (by the uploads), so the kernel can read ahead of them
+    madvise(mapping, this->size, MADV_SEQUENTIAL);
+    madvise(mapping, this->size, MADV_WILLNEED);
+    this->data = static_cast<const uint8_t*>(mapping);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+    CloseHandle(this->mappingHandle);
+    CloseHandle(this->fileHandle);
+#else
+    munmap(const_cast<uint8_t*>(this->data), this->size);
+#endif
+}
+
+const std::string &MappedFile::get_path() const {
+    return this->path;
+}
+
+const uint8_t *MappedFile::get_data() const {
+    return this->data;
+}
+
+size_t MappedFile::get_size() const {
+    return this->size;
+}
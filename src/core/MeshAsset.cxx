@@ -0,0 +1,198 @@
+/*
+ * MeshAsset.cxx
+ * Maps .vkrmesh asset files into memory & writes them out for converter tools.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/MeshAsset.h"
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char MESH_ASSET_MAGIC[4] = {'V', 'K', 'R', 'M'};
+
+// the layout is part of the file format, it must not depend on the compiler
+static_assert(sizeof(MeshAssetHeader) == 16, "MeshAssetHeader has to be 16 bytes.");
+static_assert(sizeof(MeshAssetEntry) == 80, "MeshAssetEntry has to be 80 bytes.");
+static_assert(sizeof(MeshAssetInstance) == 80, "MeshAssetInstance has to be 80 bytes.");
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + MESH_ASSET_ALIGNMENT - 1) / MESH_ASSET_ALIGNMENT * MESH_ASSET_ALIGNMENT;
+}
+
+MeshAsset::MeshAsset(const std::string &path): file(path) {
+    this->data = this->file.get_data();
+    this->size = this->file.get_size();
+    this->readEntries();
+}
+
+void MeshAsset::readEntries() {
+    MeshAssetHeader header{};
+    if (this->size < sizeof(header)) {
+        spdlog::error("The mesh asset file '{0}' is too small to be a mesh asset.", this->file.get_path());
+        throw std::runtime_error("An invalid mesh asset file was loaded!");
+    }
+    memcpy(&header, this->data, sizeof(header));
+    if (memcmp(header.magic, MESH_ASSET_MAGIC, sizeof(MESH_ASSET_MAGIC)) != 0 ||
+        header.version != MESH_ASSET_VERSION) {
+        spdlog::error("The file '{0}' isn't a version {1} mesh asset.", this->file.get_path(), MESH_ASSET_VERSION);
+        throw std::runtime_error("An invalid mesh asset file was loaded!");
+    }
+    if ((uint64_t) header.meshCount * sizeof(MeshAssetEntry) > this->size - sizeof(header)) {
+        spdlog::error("The mesh asset file '{0}' is truncated.", this->file.get_path());
+        throw std::runtime_error("An invalid mesh asset file was loaded!");
+    }
+    // true if the block is aligned & within the file
+    auto validBlock = [this](uint64_t offset, uint64_t size) {
+        return offset % MESH_ASSET_ALIGNMENT == 0 && offset <= this->size && size <= this->size - offset;
+    };
+
+    this->meshes.reserve(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        MeshAssetEntry entry{};
+        memcpy(&entry, this->data + sizeof(header) + i * sizeof(MeshAssetEntry), sizeof(entry));
+        bool validEntry = vertexformat::is_valid(entry.vertexFormat) && entry.vertexCount > 0 &&
+                          entry.indexCount > 0 && (entry.indexSize == 4 || (entry.indexSize == 2 &&
+                          entry.vertexCount <= VERTEX_MAX_NARROW_INDEX_VERTICES)) &&
+                          ((entry.vertexFormat & VERTEX_FORMAT_QUANTIZED) == 0 || entry.quantization[3] > 0.0f);
+        uint64_t vertexSize = (uint64_t) entry.vertexCount * vertexformat::get_stride(entry.vertexFormat);
+        uint64_t indexSize = (uint64_t) entry.indexCount * entry.indexSize;
+        uint64_t instanceSize = (uint64_t) entry.instanceCount * sizeof(MeshAssetInstance);
+        if (!validEntry || !validBlock(entry.vertexDataOffset, vertexSize) ||
+            !validBlock(entry.indexDataOffset, indexSize) ||
+            (entry.instanceCount > 0 && !validBlock(entry.instanceDataOffset, instanceSize))) {
+            spdlog::error("Mesh {0} of the mesh asset file '{1}' is invalid or out of the file's bounds.",
+                          i, this->file.get_path());
+            throw std::runtime_error("An invalid mesh asset file was loaded!");
+        }
+        MeshAssetView view{};
+        view.vertexFormat = entry.vertexFormat;
+        view.vertexCount = entry.vertexCount;
+        view.indexCount = entry.indexCount;
+        view.indexSize = entry.indexSize;
+        view.quantization.offset = glm::vec3(entry.quantization[0], entry.quantization[1], entry.quantization[2]);
+        view.quantization.scale = entry.quantization[3];
+        view.boundingSphere = glm::vec4(entry.boundingSphere[0], entry.boundingSphere[1], entry.boundingSphere[2],
+                                        entry.boundingSphere[3]);
+        view.vertexData = this->data + entry.vertexDataOffset;
+        view.indexData = this->data + entry.indexDataOffset;
+        view.instanceCount = entry.instanceCount;
+        view.instances = entry.instanceCount > 0 ? reinterpret_cast<const MeshAssetInstance*>(
+                this->data + entry.instanceDataOffset) : nullptr;
+        this->meshes.push_back(view);
+    }
+}
+
+const std::string &MeshAsset::get_path() const {
+    return this->file.get_path();
+}
+
+size_t MeshAsset::get_file_size() const {
+    return this->size;
+}
+
+uint32_t MeshAsset::get_mesh_count() const {
+    return static_cast<uint32_t>(this->meshes.size());
+}
+
+const MeshAssetView &MeshAsset::get_mesh(uint32_t index) const {
+    if (index >= this->meshes.size()) {
+        spdlog::error("get_mesh(): The mesh asset '{0}' has no mesh {1}.", this->file.get_path(), index);
+        throw std::runtime_error("An invalid mesh index was given to a mesh asset.");
+    }
+    return this->meshes[index];
+}
+
+/* Packs every mesh in its vertex format (quantized ones are fit to their own bounds) & narrows the indices of
+ * small meshes to 16 bits, the same way the mesh registry & geometry arena do for meshes added at runtime.
+ */
+void MeshAsset::write(const std::string &path, const std::vector<MeshAssetSource> &meshes) {
+    std::vector<MeshAssetEntry> entries(meshes.size());
+    std::vector<std::vector<uint8_t>> blocks; // vertex, index & instance data of every mesh
+    blocks.reserve(meshes.size() * 3); // the loop below keeps references to the blocks it adds
+    uint64_t offset = alignOffset(sizeof(MeshAssetHeader) + meshes.size() * sizeof(MeshAssetEntry));
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const MeshAssetSource &mesh = meshes[i];
+        if (mesh.vertices.empty() || mesh.indices.empty() || !vertexformat::is_valid(mesh.vertexFormat)) {
+            spdlog::error("write(): Mesh {0} is empty or has an invalid vertex format.", i);
+            throw std::runtime_error("An invalid mesh was given to the mesh asset writer.");
+        }
+        for (uint32_t index : mesh.indices) {
+            if (index < mesh.vertices.size()) continue;
+            spdlog::error("write(): Index {0} of mesh {1} is out of its vertices' bounds!", index, i);
+            throw std::runtime_error("An invalid mesh was given to the mesh asset writer.");
+        }
+        MeshAssetEntry &entry = entries[i];
+        entry.vertexFormat = mesh.vertexFormat;
+        entry.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        entry.indexSize = entry.vertexCount <= VERTEX_MAX_NARROW_INDEX_VERTICES ? 2 : 4;
+        entry.instanceCount = static_cast<uint32_t>(mesh.instances.size());
+        VertexQuantization quantization;
+        if ((mesh.vertexFormat & VERTEX_FORMAT_QUANTIZED) != 0) {
+            quantization = VertexQuantization::fit(mesh.vertices);
+        }
+        glm::vec4 boundingSphere = vertexformat::compute_bounding_sphere(mesh.vertices);
+        for (int axis = 0; axis < 3; axis++) entry.quantization[axis] = quantization.offset[axis];
+        entry.quantization[3] = quantization.scale;
+        for (int component = 0; component < 4; component++) {
+            entry.boundingSphere[component] = boundingSphere[component];
+        }
+
+        std::vector<uint8_t> &vertexBlock = blocks.emplace_back();
+        vertexformat::pack_vertices(mesh.vertexFormat, quantization, mesh.vertices.data(), mesh.vertices.size(),
+                                    vertexBlock);
+        std::vector<uint8_t> &indexBlock = blocks.emplace_back(mesh.indices.size() * entry.indexSize);
+        for (size_t index = 0; index < mesh.indices.size(); index++) {
+            if (entry.indexSize == 2) {
+                auto narrowed = static_cast<uint16_t>(mesh.indices[index]);
+                memcpy(indexBlock.data() + index * 2, &narrowed, sizeof(narrowed));
+            } else {
+                memcpy(indexBlock.data() + index * 4, &mesh.indices[index], sizeof(uint32_t));
+            }
+        }
+        std::vector<uint8_t> &instanceBlock = blocks.emplace_back(mesh.instances.size() *
+                                                                  sizeof(MeshAssetInstance));
+        if (!mesh.instances.empty()) memcpy(instanceBlock.data(), mesh.instances.data(), instanceBlock.size());
+
+        entry.vertexDataOffset = offset;
+        offset = alignOffset(offset + vertexBlock.size());
+        entry.indexDataOffset = offset;
+        offset = alignOffset(offset + indexBlock.size());
+        entry.instanceDataOffset = mesh.instances.empty() ? 0 : offset;
+        offset = alignOffset(offset + instanceBlock.size());
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        spdlog::error("write(): Failed to open '{0}' for writing.", path);
+        throw std::runtime_error("Could not write a mesh asset file!");
+    }
+    MeshAssetHeader header{};
+    memcpy(header.magic, MESH_ASSET_MAGIC, sizeof(MESH_ASSET_MAGIC));
+    header.version = MESH_ASSET_VERSION;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               (std::streamsize) (entries.size() * sizeof(MeshAssetEntry)));
+    const char padding[MESH_ASSET_ALIGNMENT] = {};
+    for (const std::vector<uint8_t> &block : blocks) {
+        if (block.empty()) continue; // meshes without instances
+        // every block starts aligned, pad up to it from wherever the previous one ended
+        auto position = (uint64_t) file.tellp();
+        file.write(padding, (std::streamsize) (alignOffset(position) - position));
+        file.write(reinterpret_cast<const char*>(block.data()), (std::streamsize) block.size());
+    }
+    if (!file.good()) {
+        spdlog::error("write(): Failed to write the mesh asset file '{0}'.", path);
+        throw std::runtime_error("Could not write a mesh asset file!");
+    }
+}
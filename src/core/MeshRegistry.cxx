@@ -0,0 +1,293 @@
+/*
+ * MeshRegistry.cxx
+ * Defines the MeshRegistry class to add, update and remove geometry at runtime.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/MeshRegistry.h"
+#include "../../include/Vulkray/ObjectNode.h"
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+MeshRegistry::MeshRegistry() {
+    // placeholder
+}
+
+MeshRegistry::~MeshRegistry() {
+    // placeholder
+}
+
+MeshHandle MeshRegistry::add_mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices,
+                                  VertexFormat format) {
+    if (vertices.empty() || indices.empty()) {
+        spdlog::error("add_mesh(): Meshes need at least one vertex and one index!");
+        throw std::runtime_error("An empty mesh was given to the mesh registry.");
+    }
+    if (!vertexformat::is_valid(format)) {
+        spdlog::error("add_mesh(): Unknown vertex format flags. (format: {0})", format);
+        throw std::runtime_error("An invalid vertex format was given to the mesh registry.");
+    }
+    // packed before taking the lock, so adds from several threads don't wait on each other
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_ADD;
+    operation.vertexFormat = format;
+    if ((format & VERTEX_FORMAT_QUANTIZED) != 0) operation.quantization = VertexQuantization::fit(vertices);
+    operation.boundingSphere = vertexformat::compute_bounding_sphere(vertices);
+    vertexformat::pack_vertices(format, operation.quantization, vertices.data(), vertices.size(),
+                                operation.vertexData);
+    operation.indices = std::move(indices);
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return this->queueAdd(std::move(operation), static_cast<uint32_t>(vertices.size()));
+}
+
+/* Nothing is copied out of the asset, the geometry arena uploads the mesh's blocks straight from the mapped
+ * file (the operation keeps the asset alive until then). Instances stored with the mesh are set right away.
+ */
+MeshHandle MeshRegistry::add_mesh(std::shared_ptr<const MeshAsset> asset, uint32_t assetMesh) {
+    if (asset == nullptr) {
+        spdlog::error("add_mesh(): No mesh asset was given!");
+        throw std::runtime_error("A null mesh asset was given to the mesh registry.");
+    }
+    const MeshAssetView &view = asset->get_mesh(assetMesh);
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_ADD;
+    operation.vertexFormat = view.vertexFormat;
+    operation.quantization = view.quantization;
+    operation.boundingSphere = view.boundingSphere;
+    operation.asset = asset;
+    operation.assetMesh = assetMesh;
+    MeshOperation instances;
+    instances.type = MESH_OPERATION_SET_INSTANCES;
+    instances.instances.resize(view.instanceCount);
+    for (uint32_t i = 0; i < view.instanceCount; i++) {
+        memcpy(static_cast<void*>(&instances.instances[i].model), view.instances[i].model, sizeof(glm::mat4));
+        instances.instances[i].materialIndex = view.instances[i].materialIndex;
+    }
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    MeshHandle mesh = this->queueAdd(std::move(operation), view.vertexCount);
+    if (view.instanceCount > 0) {
+        instances.mesh = mesh;
+        this->pendingOperations.push_back(std::move(instances));
+    }
+    return mesh;
+}
+
+std::vector<MeshHandle> MeshRegistry::add_meshes(const std::shared_ptr<const MeshAsset> &asset) {
+    if (asset == nullptr) {
+        spdlog::error("add_meshes(): No mesh asset was given!");
+        throw std::runtime_error("A null mesh asset was given to the mesh registry.");
+    }
+    std::vector<MeshHandle> meshes;
+    meshes.reserve(asset->get_mesh_count());
+    for (uint32_t i = 0; i < asset->get_mesh_count(); i++) meshes.push_back(this->add_mesh(asset, i));
+    return meshes;
+}
+
+// Takes a free slot for the mesh & queues its add, called with the registry's lock held
+MeshHandle MeshRegistry::queueAdd(MeshOperation operation, uint32_t vertexCount) {
+    uint32_t slotIndex = this->freeSlot;
+    if (slotIndex != UINT32_MAX) {
+        this->freeSlot = this->meshSlots[slotIndex].nextFree;
+    } else {
+        slotIndex = static_cast<uint32_t>(this->meshSlots.size());
+        this->meshSlots.emplace_back();
+    }
+    MeshSlot &slot = this->meshSlots[slotIndex];
+    slot.alive = true;
+    slot.vertexCount = vertexCount;
+    slot.vertexFormat = operation.vertexFormat;
+    slot.quantization = operation.quantization;
+    slot.boundingSphere = operation.boundingSphere;
+    MeshHandle mesh = {slotIndex, slot.generation};
+
+    operation.mesh = mesh;
+    this->pendingOperations.push_back(std::move(operation));
+    return mesh;
+}
+
+/* The vertices are checked & their format read under the lock, but packed outside of it. The handle is only
+ * valid as long as the mesh isn't removed in between, so it's checked again before the update is queued.
+ */
+void MeshRegistry::update_mesh_vertices(MeshHandle mesh, uint32_t firstVertex, const std::vector<Vertex> &vertices) {
+    VertexFormat format;
+    VertexQuantization quantization;
+    glm::vec3 center;
+    {
+        std::lock_guard<std::mutex> lock(this->registryMutex);
+        if (!this->isAlive(mesh)) {
+            spdlog::error("update_mesh_vertices(): Mesh handle is stale or invalid.");
+            throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+        }
+        const MeshSlot &slot = this->meshSlots[mesh.index];
+        if (firstVertex + vertices.size() > slot.vertexCount) {
+            spdlog::error("update_mesh_vertices(): Vertex range is out of the mesh's bounds!");
+            throw std::runtime_error("An invalid vertex range was given to the mesh registry.");
+        }
+        format = slot.vertexFormat;
+        quantization = slot.quantization;
+        center = glm::vec3(slot.boundingSphere);
+    }
+    if (vertices.empty()) return;
+
+    float radius = 0.0f;
+    for (const Vertex &vertex : vertices) {
+        if ((format & VERTEX_FORMAT_QUANTIZED) != 0 && !quantization.contains(vertex.pos)) {
+            spdlog::error("update_mesh_vertices(): Vertices of quantized meshes can't leave the bounds they "
+                          "were added with!");
+            throw std::runtime_error("An out of bounds vertex was given to the mesh registry.");
+        }
+        radius = std::max(radius, glm::distance(center, vertex.pos));
+    }
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_UPDATE;
+    operation.mesh = mesh;
+    operation.firstVertex = firstVertex;
+    vertexformat::pack_vertices(format, quantization, vertices.data(), vertices.size(), operation.vertexData);
+
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(mesh)) {
+        spdlog::error("update_mesh_vertices(): Mesh handle is stale or invalid.");
+        throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+    }
+    // the rest of the vertices isn't known here, so the bounds can only grow to fit the updated ones
+    MeshSlot &slot = this->meshSlots[mesh.index];
+    slot.boundingSphere.w = std::max(slot.boundingSphere.w, radius);
+    operation.boundingSphere = slot.boundingSphere;
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+void MeshRegistry::remove_mesh(MeshHandle mesh) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(mesh)) {
+        spdlog::error("remove_mesh(): Mesh handle is stale or invalid.");
+        throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+    }
+    MeshSlot &slot = this->meshSlots[mesh.index];
+    slot.alive = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+    slot.nextFree = this->freeSlot;
+    this->freeSlot = mesh.index;
+
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_REMOVE;
+    operation.mesh = mesh;
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+void MeshRegistry::set_mesh_instances(MeshHandle mesh, std::vector<InstanceData> instances) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(mesh)) {
+        spdlog::error("set_mesh_instances(): Mesh handle is stale or invalid.");
+        throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+    }
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_SET_INSTANCES;
+    operation.mesh = mesh;
+    operation.instances = std::move(instances);
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+/* Draws one instance of the mesh at every node's current transform (including moves made earlier in the same
+ * frame or tick, the cached world matrices are only brought up to date after the jobs ran)
+ */
+void MeshRegistry::set_mesh_instances(MeshHandle mesh, const std::vector<ObjectNode*> &nodes,
+                                      uint32_t materialIndex) {
+    std::vector<InstanceData> instances(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        instances[i].model = nodes[i]->compute_model_matrix();
+        instances[i].materialIndex = materialIndex;
+    }
+    this->set_mesh_instances(mesh, std::move(instances));
+}
+
+void MeshRegistry::set_mesh_lods(MeshHandle mesh, std::vector<MeshLod> lods) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(mesh)) {
+        spdlog::error("set_mesh_lods(): Mesh handle is stale or invalid.");
+        throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+    }
+    if (lods.size() >= MAX_MESH_LODS) {
+        spdlog::error("set_mesh_lods(): Meshes can have at most {0} lower detail levels.", MAX_MESH_LODS - 1);
+        throw std::runtime_error("Too many LODs were given to the mesh registry.");
+    }
+    float previousDistance = 0.0f;
+    for (const MeshLod &lod : lods) {
+        if (lod.indices.empty() || lod.distance <= previousDistance) {
+            spdlog::error("set_mesh_lods(): LODs need indices and have to be sorted by increasing distance!");
+            throw std::runtime_error("An invalid LOD was given to the mesh registry.");
+        }
+        for (uint32_t index : lod.indices) {
+            if (index < this->meshSlots[mesh.index].vertexCount) continue;
+            spdlog::error("set_mesh_lods(): LOD index {0} is out of the mesh's bounds!", index);
+            throw std::runtime_error("An invalid LOD was given to the mesh registry.");
+        }
+        previousDistance = lod.distance;
+    }
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_SET_LODS;
+    operation.mesh = mesh;
+    operation.lods = std::move(lods);
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+void MeshRegistry::set_mesh_pipeline(MeshHandle mesh, PipelineState pipeline) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(mesh)) {
+        spdlog::error("set_mesh_pipeline(): Mesh handle is stale or invalid.");
+        throw std::runtime_error("An invalid mesh handle was given to the mesh registry.");
+    }
+    MeshOperation operation;
+    operation.type = MESH_OPERATION_SET_PIPELINE;
+    operation.mesh = mesh;
+    operation.pipeline = std::move(pipeline);
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+bool MeshRegistry::is_mesh_valid(MeshHandle mesh) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return this->isAlive(mesh);
+}
+
+uint32_t MeshRegistry::get_mesh_slot_count() {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return static_cast<uint32_t>(this->meshSlots.size());
+}
+
+bool MeshRegistry::isAlive(MeshHandle mesh) {
+    if (mesh.index >= this->meshSlots.size()) return false;
+    const MeshSlot &slot = this->meshSlots[mesh.index];
+    return slot.alive && slot.generation == mesh.generation;
+}
+
+// Hands the queued operations (in the order they were made) over to the renderer
+void MeshRegistry::_publish_pending_operations(uint64_t tick) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    this->publishedPerTick = true;
+    for (MeshOperation &operation : this->pendingOperations) {
+        operation.tick = tick;
+        this->publishedOperations.push_back(std::move(operation));
+    }
+    this->pendingOperations.clear();
+}
+
+void MeshRegistry::_take_pending_operations(std::vector<MeshOperation> &operations, uint64_t lastTick) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    operations.clear();
+    if (!this->publishedPerTick) {
+        operations.swap(this->pendingOperations);
+        return;
+    }
+    auto end = std::find_if(this->publishedOperations.begin(), this->publishedOperations.end(),
+                            [lastTick](const MeshOperation &operation) { return operation.tick > lastTick; });
+    operations.assign(std::make_move_iterator(this->publishedOperations.begin()), std::make_move_iterator(end));
+    this->publishedOperations.erase(this->publishedOperations.begin(), end);
+}
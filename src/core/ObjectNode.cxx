@@ -11,76 +11,89 @@
  */
 
 #include "../../include/Vulkray/ObjectNode.h"
-#include <glm/gtc/matrix_transform.hpp>
 
-ObjectNode::ObjectNode() {
-    // placeholder
+ObjectNode::ObjectNode(TransformSystem *transforms, ObjectNode *parent) {
+    this->transforms = transforms;
+    this->node = transforms->create_node(parent != nullptr ? parent->node : TransformHandle{});
 }
 
 ObjectNode::~ObjectNode() {
-    // placeholder
+    if (this->transforms->is_node_valid(this->node)) this->transforms->destroy_node(this->node);
 }
 
 void ObjectNode::set_x(float x) {
-    this->x = x;
+    glm::vec3 position = this->transforms->get_position(this->node);
+    this->transforms->set_position(this->node, x, position.y, position.z);
 }
 
 void ObjectNode::set_y(float y) {
-    this->y = y;
+    glm::vec3 position = this->transforms->get_position(this->node);
+    this->transforms->set_position(this->node, position.x, y, position.z);
 }
 
 void ObjectNode::set_z(float z) {
-    this->z = z;
+    glm::vec3 position = this->transforms->get_position(this->node);
+    this->transforms->set_position(this->node, position.x, position.y, z);
 }
 
 void ObjectNode::set_xyz(float x, float y, float z) {
-    this->x = x;
-    this->y = y;
-    this->z = z;
+    this->transforms->set_position(this->node, x, y, z);
 }
 
 void ObjectNode::set_xyz(Vector3 xyz) {
-    this->x = xyz.x;
-    this->y = xyz.y;
-    this->z = xyz.z;
+    this->transforms->set_position(this->node, xyz.x, xyz.y, xyz.z);
 }
 
 Vector3 ObjectNode::get_xyz() {
-    Vector3 vec3;
-    vec3.x = this->x;
-    vec3.y = this->y;
-    vec3.z = this->z;
-    return vec3;
+    glm::vec3 position = this->transforms->get_position(this->node);
+    return {position.x, position.y, position.z};
 }
 
 void ObjectNode::set_h(float h) {
-    this->h = h;
+    glm::vec3 rotation = this->transforms->get_rotation(this->node);
+    this->transforms->set_rotation(this->node, h, rotation.y, rotation.z);
 }
 
 void ObjectNode::set_p(float p) {
-    this->p = p;
+    glm::vec3 rotation = this->transforms->get_rotation(this->node);
+    this->transforms->set_rotation(this->node, rotation.x, p, rotation.z);
 }
 
 void ObjectNode::set_r(float r) {
-    this->r = r;
+    glm::vec3 rotation = this->transforms->get_rotation(this->node);
+    this->transforms->set_rotation(this->node, rotation.x, rotation.y, r);
 }
 
 void ObjectNode::set_hpr(float h, float p, float r) {
-    this->h = h;
-    this->p = p;
-    this->r = r;
+    this->transforms->set_rotation(this->node, h, p, r);
 }
 
 void ObjectNode::set_hpr(Vector3 hpr) {
-    this->h = hpr.x;
-    this->p = hpr.y;
-    this->r = hpr.z;
+    this->transforms->set_rotation(this->node, hpr.x, hpr.y, hpr.z);
 }
 
 Vector3 ObjectNode::get_hpr() {
-    Vector3 vec3;
-    vec3.x = this->h;
-    vec3.y = this->p;
-    vec3.z = this->r;
-    return vec3;
-}
\ No newline at end of file
+    glm::vec3 rotation = this->transforms->get_rotation(this->node);
+    return {rotation.x, rotation.y, rotation.z};
+}
+
+void ObjectNode::set_scale(float x, float y, float z) {
+    this->transforms->set_scale(this->node, x, y, z);
+}
+
+Vector3 ObjectNode::get_scale() {
+    glm::vec3 scale = this->transforms->get_scale(this->node);
+    return {scale.x, scale.y, scale.z};
+}
+
+void ObjectNode::set_parent(ObjectNode *parent) {
+    this->transforms->set_parent(this->node, parent != nullptr ? parent->node : TransformHandle{});
+}
+
+glm::mat4 ObjectNode::get_model_matrix() {
+    return this->transforms->get_world_matrix(this->node);
+}
+
+glm::mat4 ObjectNode::compute_model_matrix() {
+    return this->transforms->compute_world_matrix(this->node);
+}
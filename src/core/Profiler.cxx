@@ -0,0 +1,250 @@
+/*
+ * Profiler.cxx
+ * Rolling frame & stage timings, and Chrome trace captures of the renderer's frames.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Profiler.h"
+#include "../../include/Vulkray/Logging.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+void Profiler::RollingHistory::push(double sample) {
+    if (this->samples.size() < PROFILER_HISTORY_FRAMES) {
+        this->samples.push_back(sample);
+        return;
+    }
+    this->samples[this->next] = sample;
+    this->next = (this->next + 1) % PROFILER_HISTORY_FRAMES;
+}
+
+Profiler::Profiler(bool enabled) {
+    this->enabled = enabled;
+    this->epoch = std::chrono::steady_clock::now();
+}
+
+bool Profiler::is_enabled() {
+    return this->enabled;
+}
+
+uint64_t Profiler::_now() {
+    auto elapsed = std::chrono::steady_clock::now() - this->epoch;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+// Stage names are string literals, so most lookups match on the pointer alone (strcmp covers copies of a name)
+Profiler::StageTimings &Profiler::findStage(const char *name, uint32_t track) {
+    for (StageTimings &stage : this->stages) {
+        if (stage.name == name || strcmp(stage.name, name) == 0) return stage;
+    }
+    StageTimings &stage = this->stages.emplace_back();
+    stage.name = name;
+    stage.track = track;
+    return stage;
+}
+
+void Profiler::captureEvent(const char *name, uint64_t start, uint64_t duration, uint32_t track) {
+    if (!this->capturing) return;
+    if (this->captureEvents.size() >= PROFILER_MAX_CAPTURE_EVENTS) {
+        this->captureTruncated = true;
+        return;
+    }
+    this->captureEvents.push_back({name, start, duration, track});
+}
+
+// Nearest-rank percentile of the history's samples
+double Profiler::percentileOf(const RollingHistory &history, double percentile) {
+    if (history.samples.empty()) return 0.0;
+    this->sortScratch.assign(history.samples.begin(), history.samples.end());
+    double rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * (double) this->sortScratch.size());
+    size_t index = std::min((size_t) std::max(rank, 1.0) - 1, this->sortScratch.size() - 1);
+    std::nth_element(this->sortScratch.begin(), this->sortScratch.begin() + (long) index, this->sortScratch.end());
+    return this->sortScratch[index];
+}
+
+// The time between two frame starts is the frame time, the stages timed in between become one sample each
+void Profiler::_begin_frame() {
+    if (!this->enabled) return;
+    uint64_t now = this->_now();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->frameStarted) {
+        this->frameTimes.push((double) (now - this->frameStart) / 1e6);
+        this->captureEvent("frame", this->frameStart, now - this->frameStart, PROFILER_TRACK_CPU);
+    }
+    for (StageTimings &stage : this->stages) {
+        if (stage.frameTotal == 0) continue; // not part of that frame (e.g. a skipped present)
+        stage.history.push((double) stage.frameTotal / 1e6);
+        stage.frameTotal = 0;
+    }
+    this->frameStart = now;
+    this->frameStarted = true;
+}
+
+void Profiler::_record_stage(const char *name, uint64_t start, uint64_t end) {
+    if (!this->enabled) return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->findStage(name, PROFILER_TRACK_CPU).frameTotal += std::max<uint64_t>(end - start, 1);
+    this->captureEvent(name, start, end - start, PROFILER_TRACK_CPU);
+}
+
+/* GPU regions arrive a few frames after they ran (once their timestamps are read back), already converted
+ * to the profiler's clock by the renderer.
+ */
+void Profiler::_record_gpu_region(const char *name, uint64_t start, uint64_t end) {
+    if (!this->enabled) return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->findStage(name, PROFILER_TRACK_GPU).frameTotal += std::max<uint64_t>(end - start, 1);
+    this->captureEvent(name, start, end - start, PROFILER_TRACK_GPU);
+}
+
+void Profiler::_record_gpu_frame(uint64_t duration) {
+    if (!this->enabled) return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->gpuFrameTimes.push((double) duration / 1e6);
+}
+
+void Profiler::_record_startup_phase(const char *name, uint64_t start, uint64_t end) {
+    if (!this->enabled) return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->startupPhases.push_back({name, start, std::max<uint64_t>(end - start, 1), PROFILER_TRACK_STARTUP});
+}
+
+// Called once the first frame was submitted, background phases still running are recorded when they finish
+void Profiler::_startup_finished(uint64_t start) {
+    if (!this->enabled) return;
+    uint64_t now = this->_now();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->startupTime = std::max<uint64_t>(now - start, 1);
+    this->startupPhases.push_back({"startup", start, this->startupTime, PROFILER_TRACK_STARTUP});
+    spdlog::info("Started up in {0:.2f} ms.", (double) this->startupTime / 1e6);
+    for (const ProfileEvent &phase : this->startupPhases) {
+        VULKRAY_LOG_DEBUG("Startup phase '{0}': {1:.2f} ms", phase.name, (double) phase.duration / 1e6);
+    }
+}
+
+double Profiler::get_frame_time(double percentile) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->percentileOf(this->frameTimes, percentile);
+}
+
+double Profiler::get_gpu_frame_time(double percentile) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->percentileOf(this->gpuFrameTimes, percentile);
+}
+
+double Profiler::get_stage_time(const char *stage, double percentile) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (StageTimings &timings : this->stages) {
+        if (strcmp(timings.name, stage) == 0) return this->percentileOf(timings.history, percentile);
+    }
+    return 0.0;
+}
+
+std::vector<const char*> Profiler::get_stage_names() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<const char*> names;
+    for (StageTimings &timings : this->stages) names.push_back(timings.name);
+    return names;
+}
+
+double Profiler::get_startup_phase_time(const char *phase) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (const ProfileEvent &event : this->startupPhases) {
+        if (strcmp(event.name, phase) == 0) return (double) event.duration / 1e6;
+    }
+    return 0.0;
+}
+
+std::vector<ProfileEvent> Profiler::get_startup_phases() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->startupPhases;
+}
+
+double Profiler::get_startup_time() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return (double) this->startupTime / 1e6;
+}
+
+void Profiler::start_capture() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->captureEvents.clear();
+    this->captureTruncated = false;
+    this->capturing = true;
+}
+
+bool Profiler::is_capturing() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->capturing;
+}
+
+// Writes the trace event format's complete ("X") events, timestamps are in microseconds
+bool Profiler::stop_capture(const char *path) {
+    std::vector<ProfileEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->capturing) return false;
+        this->capturing = false;
+        if (this->captureTruncated) {
+            spdlog::warn("The profiler capture was cut short after {0} events.", PROFILER_MAX_CAPTURE_EVENTS);
+        }
+        events.swap(this->captureEvents);
+        events.insert(events.begin(), this->startupPhases.begin(), this->startupPhases.end());
+    }
+    std::ofstream file(path, std::ios::trunc);
+    file << std::fixed << std::setprecision(3); // nanosecond precision, never in scientific notation
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILER_TRACK_CPU
+         << ",\"args\":{\"name\":\"Render thread\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILER_TRACK_GPU
+         << ",\"args\":{\"name\":\"GPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILER_TRACK_STARTUP
+         << ",\"args\":{\"name\":\"Startup\"}}";
+    for (const ProfileEvent &event : events) {
+        file << ",\n{\"name\":\"";
+        for (const char *c = event.name; *c != '\0'; c++) { // engine stage names, but escape them anyway
+            if (*c == '"' || *c == '\\') file << '\\';
+            file << *c;
+        }
+        file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+             << ",\"ts\":" << (double) event.start / 1e3 << ",\"dur\":" << (double) event.duration / 1e3 << "}";
+    }
+    file << "\n]}\n";
+    if (!file) {
+        spdlog::warn("Could not write the profiler capture to '{0}'.", path);
+        return false;
+    }
+    spdlog::info("Saved a profiler capture of {0} events to '{1}'.", events.size(), path);
+    return true;
+}
+
+ProfileScope::ProfileScope(Profiler *profiler, const char *name) {
+    this->profiler = profiler;
+    this->name = name;
+    this->start = profiler->is_enabled() ? profiler->_now() : 0;
+}
+
+ProfileScope::~ProfileScope() {
+    if (this->profiler->is_enabled()) this->profiler->_record_stage(this->name, this->start, this->profiler->_now());
+}
+
+ProfilePhase::ProfilePhase(Profiler *profiler, const char *name) {
+    this->profiler = profiler;
+    this->name = name;
+    this->start = profiler->is_enabled() ? profiler->_now() : 0;
+}
+
+ProfilePhase::~ProfilePhase() {
+    if (this->profiler->is_enabled()) {
+        this->profiler->_record_startup_phase(this->name, this->start, this->profiler->_now());
+    }
+}
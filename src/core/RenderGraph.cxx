@@ -0,0 +1,369 @@
+/*
+ * RenderGraph.cxx
+ * Defines the RenderGraph class, compiles the frame's passes into render passes, barriers & aliased images.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/RenderGraph.h"
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+static bool isAttachmentUsage(uint32_t usage) {
+    return usage == RENDER_USAGE_COLOR_ATTACHMENT || usage == RENDER_USAGE_DEPTH_ATTACHMENT ||
+           usage == RENDER_USAGE_RESOLVE_ATTACHMENT || usage == RENDER_USAGE_INPUT_ATTACHMENT;
+}
+
+// Uses that replace every pixel of the image, what was in it before doesn't matter to them
+static bool overwritesImage(const RenderGraphUse &use) {
+    return use.usage == RENDER_USAGE_RESOLVE_ATTACHMENT || (use.clear && isAttachmentUsage(use.usage));
+}
+
+RenderImage RenderGraph::add_image(const std::string &name, uint32_t format, uint32_t samples) {
+    RenderGraphImage image;
+    image.name = name;
+    image.format = format;
+    image.samples = samples;
+    image.imported = false;
+    image.finalUsage = RENDER_USAGE_UNDEFINED;
+    this->images.push_back(image);
+    return static_cast<RenderImage>(this->images.size() - 1);
+}
+
+RenderImage RenderGraph::import_image(const std::string &name, uint32_t format, uint32_t finalUsage,
+                                      uint32_t samples) {
+    RenderImage image = this->add_image(name, format, samples);
+    this->images[image].imported = true;
+    this->images[image].finalUsage = finalUsage;
+    return image;
+}
+
+uint32_t RenderGraph::add_pass(const std::string &name, uint32_t type, bool sideEffects) {
+    RenderGraphPass pass;
+    pass.name = name;
+    pass.type = type;
+    pass.sideEffects = sideEffects;
+    this->passes.push_back(pass);
+    return static_cast<uint32_t>(this->passes.size() - 1);
+}
+
+void RenderGraph::write_color(uint32_t pass, RenderImage image, bool clear) {
+    this->addUse(pass, image, RENDER_USAGE_COLOR_ATTACHMENT, true, clear);
+}
+
+void RenderGraph::write_depth(uint32_t pass, RenderImage image, bool clear) {
+    this->addUse(pass, image, RENDER_USAGE_DEPTH_ATTACHMENT, true, clear);
+}
+
+void RenderGraph::write_resolve(uint32_t pass, RenderImage image) {
+    bool hasColor = false;
+    if (pass < this->passes.size()) {
+        for (const RenderGraphUse &use : this->passes[pass].uses) {
+            hasColor |= use.usage == RENDER_USAGE_COLOR_ATTACHMENT;
+        }
+    }
+    if (!hasColor) {
+        spdlog::error("write_resolve(): The render graph pass has no color attachment to resolve.");
+        throw std::runtime_error("A resolve attachment was given to a pass without color attachments.");
+    }
+    this->addUse(pass, image, RENDER_USAGE_RESOLVE_ATTACHMENT, true, false);
+}
+
+void RenderGraph::read(uint32_t pass, RenderImage image, uint32_t usage) {
+    if (usage != RENDER_USAGE_INPUT_ATTACHMENT && usage != RENDER_USAGE_SAMPLED && usage != RENDER_USAGE_STORAGE &&
+        usage != RENDER_USAGE_TRANSFER_SRC) {
+        spdlog::error("read(): Render graph images can't be read with usage {0}.", usage);
+        throw std::runtime_error("An invalid read usage was given to the render graph.");
+    }
+    this->addUse(pass, image, usage, false, false);
+}
+
+void RenderGraph::write(uint32_t pass, RenderImage image, uint32_t usage) {
+    if (usage != RENDER_USAGE_STORAGE && usage != RENDER_USAGE_TRANSFER_DST) {
+        spdlog::error("write(): Render graph images can't be written with usage {0}.", usage);
+        throw std::runtime_error("An invalid write usage was given to the render graph.");
+    }
+    this->addUse(pass, image, usage, true, false);
+}
+
+void RenderGraph::addUse(uint32_t pass, RenderImage image, uint32_t usage, bool write, bool clear) {
+    if (pass >= this->passes.size() || image >= this->images.size()) {
+        spdlog::error("The render graph pass or image index is out of range.");
+        throw std::runtime_error("An invalid pass or image was given to the render graph.");
+    }
+    RenderGraphPass &graphPass = this->passes[pass];
+    bool allowed;
+    switch (graphPass.type) {
+        case RENDER_PASS_RASTER:
+            allowed = isAttachmentUsage(usage) || usage == RENDER_USAGE_SAMPLED;
+            break;
+        case RENDER_PASS_COMPUTE:
+            allowed = usage == RENDER_USAGE_STORAGE || usage == RENDER_USAGE_SAMPLED;
+            break;
+        default:
+            allowed = usage == RENDER_USAGE_TRANSFER_SRC || usage == RENDER_USAGE_TRANSFER_DST;
+            break;
+    }
+    if (!allowed) {
+        spdlog::error("The render graph pass '{0}' can't use an image with usage {1}.", graphPass.name, usage);
+        throw std::runtime_error("An image usage the pass type doesn't allow was given to the render graph.");
+    }
+    for (const RenderGraphUse &use : graphPass.uses) {
+        if (use.image == image) {
+            spdlog::error("The render graph pass '{0}' uses the image '{1}' twice.", graphPass.name,
+                          this->images[image].name);
+            throw std::runtime_error("An image was used twice by the same render graph pass.");
+        }
+    }
+    graphPass.uses.push_back({image, usage, write, clear});
+}
+
+/* Walks the passes backwards from the graph's outputs (imported images & side effects), a pass is live if a
+ * later live pass (or the frame's end) needs what it writes. Uses overwriting an image end the need for it.
+ */
+std::vector<bool> RenderGraph::findLivePasses() const {
+    std::vector<bool> live(this->passes.size(), false);
+    std::vector<bool> needed(this->images.size(), false);
+    for (size_t image = 0; image < this->images.size(); image++) needed[image] = this->images[image].imported;
+    for (size_t pass = this->passes.size(); pass-- > 0;) {
+        const RenderGraphPass &graphPass = this->passes[pass];
+        bool contributes = graphPass.sideEffects;
+        for (const RenderGraphUse &use : graphPass.uses) contributes |= use.write && needed[use.image];
+        if (!contributes) continue;
+        live[pass] = true;
+        for (const RenderGraphUse &use : graphPass.uses) needed[use.image] = !overwritesImage(use);
+    }
+    return live;
+}
+
+RenderGraphPlan RenderGraph::compile() const {
+    RenderGraphPlan plan;
+    plan.images = this->images;
+    plan.passGroups.assign(this->passes.size(), RENDER_GRAPH_NONE);
+    plan.passSubpasses.assign(this->passes.size(), RENDER_GRAPH_NONE);
+    std::vector<bool> live = this->findLivePasses();
+
+    // Group the live passes, a raster pass joins the previous raster pass' render pass if it only uses the
+    // images the render pass touched as attachments
+    std::vector<uint32_t> touchingGroup(this->images.size(), RENDER_GRAPH_NONE); // last group using the image
+    for (uint32_t pass = 0; pass < this->passes.size(); pass++) {
+        if (!live[pass]) continue;
+        const RenderGraphPass &graphPass = this->passes[pass];
+        bool merge = !plan.groups.empty() && graphPass.type == RENDER_PASS_RASTER &&
+                     plan.groups.back().type == RENDER_PASS_RASTER;
+        uint32_t currentGroup = static_cast<uint32_t>(plan.groups.size()) - 1;
+        for (const RenderGraphUse &use : graphPass.uses) {
+            if (merge && touchingGroup[use.image] == currentGroup) merge = isAttachmentUsage(use.usage);
+        }
+        if (!merge) {
+            RenderGroupPlan group;
+            group.type = graphPass.type;
+            plan.groups.push_back(group);
+        }
+        uint32_t groupIndex = static_cast<uint32_t>(plan.groups.size()) - 1;
+        plan.passSubpasses[pass] = static_cast<uint32_t>(plan.groups[groupIndex].passes.size());
+        plan.groups[groupIndex].passes.push_back(pass);
+        plan.passGroups[pass] = groupIndex;
+        for (const RenderGraphUse &use : graphPass.uses) touchingGroup[use.image] = groupIndex;
+    }
+
+    // every image's uses in the order the groups run in, to look up what comes after a render pass
+    struct GroupUse {
+        uint32_t group;
+        uint32_t usage;
+    };
+    std::vector<std::vector<GroupUse>> imageUses(this->images.size());
+    std::vector<uint32_t> firstGroups(this->images.size(), RENDER_GRAPH_NONE);
+    std::vector<uint32_t> lastGroups(this->images.size(), RENDER_GRAPH_NONE);
+    for (uint32_t group = 0; group < plan.groups.size(); group++) {
+        for (uint32_t pass : plan.groups[group].passes) {
+            for (const RenderGraphUse &use : this->passes[pass].uses) {
+                imageUses[use.image].push_back({group, use.usage});
+                if (firstGroups[use.image] == RENDER_GRAPH_NONE) firstGroups[use.image] = group;
+                lastGroups[use.image] = group;
+                plan.images[use.image].usages |= 1u << use.usage;
+                plan.images[use.image].depth |= use.usage == RENDER_USAGE_DEPTH_ATTACHMENT;
+            }
+        }
+    }
+    auto nextUsage = [&imageUses](RenderImage image, uint32_t group) {
+        for (const GroupUse &use : imageUses[image]) {
+            if (use.group > group) return use.usage;
+        }
+        return static_cast<uint32_t>(RENDER_USAGE_UNDEFINED);
+    };
+
+    // lazily allocated images never leave their render pass, neither do their contents
+    uint32_t attachmentUsages = 1u << RENDER_USAGE_COLOR_ATTACHMENT | 1u << RENDER_USAGE_DEPTH_ATTACHMENT |
+                                1u << RENDER_USAGE_RESOLVE_ATTACHMENT | 1u << RENDER_USAGE_INPUT_ATTACHMENT;
+    for (RenderImage image = 0; image < this->images.size(); image++) {
+        RenderGraphImage &graphImage = plan.images[image];
+        graphImage.lazy = !graphImage.imported && firstGroups[image] != RENDER_GRAPH_NONE &&
+                          firstGroups[image] == lastGroups[image] && (graphImage.usages & ~attachmentUsages) == 0;
+    }
+
+    /* graph owned images share the slot of a compatible image whose last group ran before their first one. The
+     * first use of an image in a reused slot waits on the last use of the image aliased before it (its previous
+     * alias), the memory is still being read or written by it otherwise */
+    std::vector<uint32_t> slotLastGroups;
+    std::vector<RenderImage> slotLastImages;
+    std::vector<RenderImage> previousAliases(this->images.size(), RENDER_GRAPH_NONE);
+    for (uint32_t group = 0; group < plan.groups.size(); group++) {
+        for (RenderImage image = 0; image < this->images.size(); image++) {
+            RenderGraphImage &graphImage = plan.images[image];
+            if (graphImage.imported || firstGroups[image] != group) continue;
+            for (uint32_t slot = 0; slot < plan.slots.size() && graphImage.slot == RENDER_GRAPH_NONE; slot++) {
+                const RenderSlotPlan &slotPlan = plan.slots[slot];
+                if (slotLastGroups[slot] < group && slotPlan.format == graphImage.format &&
+                    slotPlan.samples == graphImage.samples && slotPlan.depth == graphImage.depth &&
+                    slotPlan.lazy == graphImage.lazy) {
+                    graphImage.slot = slot;
+                }
+            }
+            if (graphImage.slot == RENDER_GRAPH_NONE) {
+                graphImage.slot = static_cast<uint32_t>(plan.slots.size());
+                plan.slots.push_back({graphImage.format, graphImage.samples, graphImage.depth, 0, graphImage.lazy});
+                slotLastGroups.push_back(0);
+                slotLastImages.push_back(RENDER_GRAPH_NONE);
+            }
+            previousAliases[image] = slotLastImages[graphImage.slot];
+            plan.slots[graphImage.slot].usages |= graphImage.usages;
+            slotLastGroups[graphImage.slot] = lastGroups[image];
+            slotLastImages[graphImage.slot] = image;
+        }
+    }
+
+    struct ImageState {
+        uint32_t usage = RENDER_USAGE_UNDEFINED;
+        bool written = false; // by the last use, the next use has to wait on it
+    };
+    std::vector<ImageState> states(this->images.size());
+    auto addDependency = [](RenderGroupPlan &group, uint32_t src, uint32_t dst, uint32_t srcUsage,
+                            uint32_t dstUsage) {
+        bool byRegion = src != RENDER_GRAPH_EXTERNAL && dst != RENDER_GRAPH_EXTERNAL;
+        for (RenderDependencyPlan &dependency : group.dependencies) {
+            if (dependency.srcSubpass != src || dependency.dstSubpass != dst) continue;
+            dependency.srcUsages |= 1u << srcUsage;
+            dependency.dstUsages |= 1u << dstUsage;
+            return;
+        }
+        group.dependencies.push_back({src, dst, 1u << srcUsage, 1u << dstUsage, byRegion});
+    };
+
+    for (uint32_t groupIndex = 0; groupIndex < plan.groups.size(); groupIndex++) {
+        RenderGroupPlan &group = plan.groups[groupIndex];
+        std::vector<uint32_t> attachmentIndices(this->images.size(), RENDER_GRAPH_NONE);
+        std::vector<uint32_t> lastSubpasses(this->images.size(), RENDER_GRAPH_NONE); // within this group
+        std::vector<uint32_t> lastUsages(this->images.size(), RENDER_USAGE_UNDEFINED);
+        for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++) {
+            const RenderGraphPass &graphPass = this->passes[group.passes[subpass]];
+            RenderSubpassPlan subpassPlan;
+            subpassPlan.pass = group.passes[subpass];
+            for (const RenderGraphUse &use : graphPass.uses) {
+                ImageState &state = states[use.image];
+                bool written = state.usage != RENDER_USAGE_UNDEFINED || lastSubpasses[use.image] != RENDER_GRAPH_NONE;
+                // what the use waits on: the image's previous use, or for its first one the previous alias' last
+                uint32_t sourceUsage = state.usage;
+                if (!written && previousAliases[use.image] != RENDER_GRAPH_NONE) {
+                    sourceUsage = states[previousAliases[use.image]].usage;
+                }
+                if (!use.write && !written) {
+                    spdlog::error("The render graph pass '{0}' reads the image '{1}' before anything wrote it.",
+                                  graphPass.name, this->images[use.image].name);
+                    throw std::runtime_error("A render graph image was read before it was written.");
+                }
+                if (!isAttachmentUsage(use.usage)) {
+                    // a barrier ahead of the group, unless it's another read in the same layout
+                    if (state.usage != use.usage || use.write || state.written) {
+                        group.barriers.push_back({use.image, sourceUsage, use.usage});
+                    }
+                    state.usage = use.usage;
+                    state.written = use.write;
+                    continue;
+                }
+
+                uint32_t attachment = attachmentIndices[use.image];
+                if (attachment == RENDER_GRAPH_NONE) {
+                    RenderAttachmentPlan attachmentPlan{};
+                    attachmentPlan.image = use.image;
+                    // contents that are overwritten anyway are discarded by starting out undefined
+                    attachmentPlan.initialUsage = overwritesImage(use) ? RENDER_USAGE_UNDEFINED : state.usage;
+                    if (use.clear) {
+                        attachmentPlan.loadOp = RENDER_LOAD_CLEAR;
+                    } else if (use.usage == RENDER_USAGE_RESOLVE_ATTACHMENT || state.usage == RENDER_USAGE_UNDEFINED) {
+                        attachmentPlan.loadOp = RENDER_LOAD_DONT_CARE;
+                    } else {
+                        attachmentPlan.loadOp = RENDER_LOAD_LOAD;
+                    }
+                    attachment = static_cast<uint32_t>(group.attachments.size());
+                    attachmentIndices[use.image] = attachment;
+                    group.attachments.push_back(attachmentPlan);
+                }
+                switch (use.usage) {
+                    case RENDER_USAGE_COLOR_ATTACHMENT:
+                        subpassPlan.colorAttachments.push_back(attachment);
+                        break;
+                    case RENDER_USAGE_DEPTH_ATTACHMENT:
+                        subpassPlan.depthAttachment = attachment;
+                        break;
+                    case RENDER_USAGE_RESOLVE_ATTACHMENT:
+                        subpassPlan.resolveAttachments.resize(subpassPlan.colorAttachments.size(),
+                                                              RENDER_GRAPH_NONE);
+                        subpassPlan.resolveAttachments.back() = attachment;
+                        break;
+                    default:
+                        subpassPlan.inputAttachments.push_back(attachment);
+                        break;
+                }
+                // earlier subpasses of this render pass, or (also for images without contents) what came before
+                if (lastSubpasses[use.image] != RENDER_GRAPH_NONE) {
+                    addDependency(group, lastSubpasses[use.image], subpass, lastUsages[use.image], use.usage);
+                } else {
+                    addDependency(group, RENDER_GRAPH_EXTERNAL, subpass, sourceUsage, use.usage);
+                }
+                lastSubpasses[use.image] = subpass;
+                lastUsages[use.image] = use.usage;
+            }
+            if (!subpassPlan.resolveAttachments.empty()) {
+                subpassPlan.resolveAttachments.resize(subpassPlan.colorAttachments.size(), RENDER_GRAPH_NONE);
+            }
+            group.subpasses.push_back(subpassPlan);
+        }
+
+        // the render pass leaves every attachment in the layout of its next use (stored only if there is one)
+        for (RenderAttachmentPlan &attachment : group.attachments) {
+            const RenderGraphImage &image = this->images[attachment.image];
+            uint32_t next = nextUsage(attachment.image, groupIndex);
+            attachment.store = next != RENDER_USAGE_UNDEFINED || image.imported;
+            if (next != RENDER_USAGE_UNDEFINED) {
+                attachment.finalUsage = next;
+            } else {
+                attachment.finalUsage = image.imported ? image.finalUsage : lastUsages[attachment.image];
+            }
+            if (attachment.store) {
+                addDependency(group, lastSubpasses[attachment.image], RENDER_GRAPH_EXTERNAL,
+                              lastUsages[attachment.image], attachment.finalUsage);
+            }
+            // the external dependency already made the writes visible to the next use
+            states[attachment.image] = {attachment.finalUsage, false};
+        }
+    }
+    // imported images whose last use wasn't an attachment are moved to their final usage by a barrier only group
+    RenderGroupPlan finalGroup;
+    finalGroup.type = RENDER_PASS_TRANSFER;
+    for (RenderImage image = 0; image < this->images.size(); image++) {
+        const RenderGraphImage &graphImage = this->images[image];
+        if (!graphImage.imported || lastGroups[image] == RENDER_GRAPH_NONE) continue;
+        if (states[image].usage != graphImage.finalUsage) {
+            finalGroup.barriers.push_back({image, states[image].usage, graphImage.finalUsage});
+        }
+    }
+    if (!finalGroup.barriers.empty()) plan.groups.push_back(finalGroup);
+
+    return plan;
+}
@@ -12,14 +12,61 @@
 
 #include "../global_definitions.h"
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <glm/vec3.hpp>
+#include <mutex>
+#include <algorithm>
 
 #include "../../include/Vulkray/Vulkan.h"
 #include "../../include/Vulkray/ShowBase.h"
 
+static std::once_flag loggerConfigured;
+
+/* Writes errors & critical errors right away on the calling thread (they may come right before a crash or
+ * std::terminate, and a full queue would drop them), everything else is queued to the logging thread.
+ */
+class ConsoleLogger : public spdlog::logger {
+public:
+    ConsoleLogger(spdlog::sink_ptr sink, std::shared_ptr<spdlog::async_logger> queuedLogger)
+            : spdlog::logger("vulkray", sink), queuedLogger(std::move(queuedLogger)) {}
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override {
+        if (msg.level >= spdlog::level::err) {
+            spdlog::logger::sink_it_(msg); // (the sink is thread safe, shared with the logging thread)
+            return;
+        }
+        this->queuedLogger->log(msg.time, msg.source, msg.level, msg.payload);
+    }
+    void flush_() override {
+        this->queuedLogger->flush();
+        spdlog::logger::flush_();
+    }
+private:
+    std::shared_ptr<spdlog::async_logger> queuedLogger;
+};
+
+// Replaces spdlog's default logger (same console output) with one writing from its own thread
+static void configureAsyncLogger(unsigned int queueSize) {
+    spdlog::init_thread_pool(std::max(queueSize, 1u), 1);
+    auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    auto queuedLogger = std::make_shared<spdlog::async_logger>(
+            "vulkray", sink, spdlog::thread_pool(),
+            spdlog::async_overflow_policy::overrun_oldest); // never blocks the logging thread
+    queuedLogger->set_level(spdlog::level::trace); // (the default logger's level filters)
+    // the logging thread flushes warnings as soon as it wrote them, the rest is flushed once a second
+    queuedLogger->flush_on(spdlog::level::warn);
+    spdlog::set_default_logger(std::make_shared<ConsoleLogger>(sink, queuedLogger));
+    spdlog::flush_on(spdlog::level::err);
+    spdlog::flush_every(std::chrono::seconds(1));
+}
+
 ShowBase::ShowBase(EngineConfig config) {
     this->config = config;
 
+    if (this->config.asyncLogging) {
+        std::call_once(loggerConfigured, configureAsyncLogger, this->config.logQueueSize);
+    }
     // spdlog debug/release output configuration
 #ifndef NDEBUG
     spdlog::set_level(spdlog::level::debug); // enable debug logging for debug builds
@@ -29,22 +76,44 @@ ShowBase::ShowBase(EngineConfig config) {
     spdlog::set_pattern("[%H:%M:%S] [%n] [%^%l%$] %v");
 
     // Initialize top level show base instances
-    this->input = std::make_unique<InputManager>();
-    this->jobManager = std::make_unique<JobManager>();
+    this->profiler = std::make_unique<Profiler>(this->config.profiling);
+    this->memory = std::make_unique<GpuMemory>(this->config.memoryPressureThreshold);
+    // the simulation thread drains the input queue, input is always queued with one
+    bool queuedInput = this->config.queuedInput || this->config.simulationRate > 0;
+    this->input = std::make_unique<InputManager>(this, queuedInput);
+    this->jobManager = std::make_unique<JobManager>(this->config.jobWorkerThreads);
+    this->transforms = std::make_unique<TransformSystem>(); // before the camera, it's a node too
+    this->simulation = std::make_unique<Simulation>(this, this->config.simulationRate);
     this->camera = std::make_unique<Camera>(this);
+    this->meshes = std::make_unique<MeshRegistry>();
+    this->textures = std::make_unique<TextureRegistry>();
 }
 
 ShowBase::~ShowBase() {
     // not actually required, just a placeholder for now
+    this->simulation.reset(); // (its thread is stopped with the render loop)
     this->input.reset();
     this->jobManager.reset();
     this->camera.reset();
     this->vulkanRenderer.reset();
+    this->transforms.reset();
+    this->meshes.reset();
+    this->textures.reset();
+    this->memory.reset();
+    this->profiler.reset();
 }
 
 void ShowBase::launch() {
     // Enable built-in default camera controls
     this->enable_cam_controls();
+    // The configured input geometry is just the first mesh (more can be added at any time via `meshes`)
+    if (!this->config.graphicsInput.vertexData.empty() || !this->config.graphicsInput.indexData.empty()) {
+        this->meshes->add_mesh(this->config.graphicsInput.vertexData, this->config.graphicsInput.indexData,
+                               this->config.graphicsInput.vertexFormat);
+    }
+    if (!this->config.graphicsInput.meshAssetPath.empty()) {
+        this->meshes->add_meshes(std::make_shared<const MeshAsset>(this->config.graphicsInput.meshAssetPath));
+    }
     // Initialize the engine vulkan renderer loop
     this->vulkanRenderer = std::make_unique<Vulkan>(this, this->config.graphicsInput,
                                                     (char*) this->config.windowTitle,
@@ -52,12 +121,36 @@ void ShowBase::launch() {
     // NOTE: Vulkan should be initialized last ALWAYS, because that's where the render loop starts.
 }
 
+void ShowBase::stop() {
+    this->stopRequested = true;
+}
+
+bool ShowBase::_is_stopping() {
+    return this->stopRequested;
+}
+
+void ShowBase::set_window_size(unsigned int width, unsigned int height) {
+    if (width == 0 || height == 0) {
+        spdlog::error("set_window_size(): The window size has to be at least 1 pixel.");
+        throw std::runtime_error("An invalid window size was given to the engine.");
+    }
+    this->pendingWindowSize = (uint64_t) width << 32 | height;
+}
+
+bool ShowBase::_take_window_size(unsigned int *width, unsigned int *height) {
+    uint64_t size = this->pendingWindowSize.exchange(0);
+    if (size == 0) return false;
+    *width = (unsigned int) (size >> 32);
+    *height = (unsigned int) (size & UINT32_MAX);
+    return true;
+}
+
 // ----- Default Camera Controls ----- //
 
 void ShowBase::enable_cam_controls() {
     if (this->defaultCamEnabled) return; // can't enable if already enabled!
     this->defaultCamEnabled = true;
-    this->jobManager->new_job("_builtin_camera", this, &this->camera_task);
+    this->cameraJob = this->jobManager->new_job("_builtin_camera", this, &this->camera_task);
     this->input->new_accept_cursor(this, "_builtin_cam_look", this->cam_mouse_look);
     this->input->new_accept_key("w", this, this->cam_control_forward);
     this->input->new_accept_key("s", this, this->cam_control_backward);
@@ -70,7 +163,7 @@ void ShowBase::enable_cam_controls() {
 void ShowBase::disable_cam_controls() {
     if (!this->defaultCamEnabled) return; // can't disable if already disabled!
     this->defaultCamEnabled = false;
-    this->jobManager->remove_job("_builtin_camera");
+    this->jobManager->remove_job(this->cameraJob);
     this->input->remove_accept_cursor("_builtin_cam_look");
     this->input->remove_accept_key("w");
     this->input->remove_accept_key("s");
@@ -87,16 +180,21 @@ void ShowBase::camera_task(void *caller, ShowBase *base) {
     if (self->_cam_controls_key_map[0]) fwd_direction = 1;
     if (self->_cam_controls_key_map[1]) fwd_direction = -1;
 
-    glm::vec3 newPos = base->camera->get_look_at_vector();
-    // moving forward along the look vector
-    newPos.x = base->camera->x + (newPos.x * (0.06 * fwd_direction));
-    newPos.y = base->camera->y + (newPos.y * (0.06 * fwd_direction));
-    newPos.z = base->camera->z + (newPos.z * (0.06 * fwd_direction));
-    base->camera->set_xyz(newPos.x, newPos.y, newPos.z);
+    if (fwd_direction != 0) { // (setting the position marks the camera dirty, even if it didn't move)
+        glm::vec3 newPos = base->camera->get_look_at_vector();
+        Vector3 camPos = base->camera->get_xyz();
+        float distance = CAM_MOVE_SPEED * base->simulation->get_delta_time() * (float) fwd_direction;
+        // moving forward along the look vector
+        newPos.x = camPos.x + (newPos.x * distance);
+        newPos.y = camPos.y + (newPos.y * distance);
+        newPos.z = camPos.z + (newPos.z * distance);
+        base->camera->set_xyz(newPos.x, newPos.y, newPos.z);
+    }
 
     // field of view controls (will change controls to mouse scroll wheel)
-    base->camera->fov += (0.1 * self->_cam_controls_key_map[4]);
-    base->camera->fov += (-0.1 * self->_cam_controls_key_map[5]);
+    float fovChange = CAM_FOV_SPEED * base->simulation->get_delta_time();
+    base->camera->fov += (fovChange * (float) self->_cam_controls_key_map[4]);
+    base->camera->fov += (-fovChange * (float) self->_cam_controls_key_map[5]);
     // fov limiter
     if (base->camera->fov > 120) base->camera->set_fov(120);
     if (base->camera->fov < 30) base->camera->set_fov(30);
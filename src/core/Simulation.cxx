@@ -0,0 +1,141 @@
+/*
+ * Simulation.cxx
+ * Steps the user's jobs & camera, at a fixed rate on the simulation thread if configured.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Simulation.h"
+#include "../../include/Vulkray/ShowBase.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+
+Simulation::Simulation(ShowBase *base, double rate) {
+    this->base = base;
+    if (rate < 0) {
+        spdlog::error("Simulation(): The simulation rate can't be negative!");
+        throw std::runtime_error("An invalid simulation rate was given to the engine.");
+    }
+    this->rate = rate;
+    if (rate > 0) this->tickDuration = (uint64_t) (1e9 / rate);
+    this->deltaTime = rate > 0 ? (float) (1.0 / rate) : 1.0f / 60.0f; // until the second frame is measured
+}
+
+Simulation::~Simulation() {
+    this->running = false; // the renderer stops the thread, unless it failed to start up
+    if (this->thread.joinable()) this->thread.join();
+}
+
+bool Simulation::is_threaded() {
+    return this->rate > 0;
+}
+
+float Simulation::get_delta_time() {
+    return this->deltaTime;
+}
+
+uint64_t Simulation::get_tick() {
+    return this->tick.load(std::memory_order_relaxed);
+}
+
+uint64_t Simulation::now() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// ran from the calling thread, so the first frame already has a snapshot to render
+void Simulation::_start() {
+    if (!this->is_threaded()) return;
+    this->publishSnapshot();
+    this->running = true;
+    this->thread = std::thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::_stop() {
+    if (!this->thread.joinable()) return;
+    this->running = false;
+    this->thread.join();
+    if (this->threadError != nullptr) std::rethrow_exception(this->threadError);
+}
+
+void Simulation::_begin_frame_step() {
+    uint64_t now = Simulation::now();
+    if (this->lastStepTime != 0) {
+        this->deltaTime = std::min((float) ((double) (now - this->lastStepTime) / 1e9), SIMULATION_MAX_DELTA_TIME);
+    }
+    this->lastStepTime = now;
+    this->tick.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Ticks are scheduled at fixed points in time. One that ran late is followed by the next right away, but after
+ * SIMULATION_MAX_CATCHUP_TICKS late ticks the schedule skips ahead (the simulation slows down instead of
+ * trying to catch up forever).
+ */
+void Simulation::threadLoop() {
+    uint64_t nextTick = Simulation::now() + this->tickDuration;
+    try {
+        while (this->running) {
+            uint64_t now = Simulation::now();
+            if (now < nextTick) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(nextTick - now));
+                continue;
+            }
+            if (now - nextTick > this->tickDuration * SIMULATION_MAX_CATCHUP_TICKS) nextTick = now;
+            this->runTick();
+            this->publishSnapshot();
+            nextTick += this->tickDuration;
+        }
+    } catch (...) {
+        spdlog::error("The simulation thread stopped on an error, stopping the engine.");
+        this->threadError = std::current_exception();
+        this->base->stop();
+    }
+    // async jobs of the last tick, waited on here since only this thread runs the main thread jobs
+    try {
+        this->base->jobManager->_wait_for_frame_jobs();
+    } catch (...) {
+        if (this->threadError == nullptr) this->threadError = std::current_exception();
+    }
+}
+
+void Simulation::runTick() {
+    // the input callbacks move the camera, so they run on this thread too
+    uint64_t inputLatency = this->base->input->_dispatch_events();
+    if (inputLatency != 0) {
+        Profiler *profiler = this->base->profiler.get();
+        uint64_t now = profiler->_now();
+        profiler->_record_stage("input latency", now - std::min(inputLatency, now), now);
+    }
+    JobManager *jobManager = this->base->jobManager.get();
+    jobManager->_dispatch_frame_jobs(this->base);
+    jobManager->_wait_for_uniform_jobs(); // the rest may keep running into the next tick
+    this->base->transforms->_update_world_matrices(jobManager);
+    this->tick.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the tick's mesh operations go out first, so they're all there once a frame picks up its snapshot
+void Simulation::publishSnapshot() {
+    uint64_t tick = this->tick.load(std::memory_order_relaxed);
+    this->base->meshes->_publish_pending_operations(tick);
+    SimulationSnapshot &snapshot = this->snapshots.get_write_buffer();
+    snapshot.camera = this->base->camera->get_state();
+    snapshot.tick = tick;
+    this->snapshots.publish();
+}
+
+uint64_t Simulation::_begin_render_frame() {
+    if (!this->is_threaded()) return this->get_tick();
+    this->snapshots.update();
+    return this->snapshots.get_read_buffer().tick;
+}
+
+CameraState Simulation::_get_render_camera() {
+    if (!this->is_threaded()) return this->base->camera->get_state();
+    return this->snapshots.get_read_buffer().camera;
+}
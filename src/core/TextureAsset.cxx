@@ -0,0 +1,204 @@
+/*
+ * TextureAsset.cxx
+ * Reads the header & mip level index of memory mapped KTX2 texture files.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/TextureAsset.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header { // follows the identifier (little endian, as every KTX2 field)
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth; // 0 for 2D textures
+    uint32_t layerCount; // 0 for non-array textures
+    uint32_t faceCount; // 6 for cube maps
+    uint32_t levelCount; // 0 = the loader generates the mips
+    uint32_t supercompressionScheme;
+};
+// the level index follows the identifier, the header & the 32 byte index of the other (unused) file sections
+const uint64_t KTX2_LEVEL_INDEX_OFFSET = 80;
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 36, "Ktx2Header has to match the KTX2 header layout.");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "Ktx2LevelIndex has to match the KTX2 level index layout.");
+
+bool textureformat::get_format_info(uint32_t format, TextureFormatInfo *info) {
+    switch (format) {
+        case 9: case 15: // VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB
+            *info = {1, 1, 1, false};
+            return true;
+        case 16: case 22: // VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB
+            *info = {1, 1, 2, false};
+            return true;
+        case 37: case 43: case 44: case 50: // VK_FORMAT_R8G8B8A8_UNORM/SRGB, VK_FORMAT_B8G8R8A8_UNORM/SRGB
+            *info = {1, 1, 4, false};
+            return true;
+        case 97: // VK_FORMAT_R16G16B16A16_SFLOAT
+            *info = {1, 1, 8, false};
+            return true;
+        // VK_FORMAT_BC1_RGB_UNORM_BLOCK ... VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC4_UNORM/SNORM_BLOCK
+        case 131: case 132: case 133: case 134: case 139: case 140:
+            *info = {4, 4, 8, true};
+            return true;
+        default:
+            break;
+    }
+    if (format >= 135 && format <= 146) { // BC2, BC3, BC5, BC6H & BC7 (UNORM/SRGB or UFLOAT/SFLOAT pairs)
+        *info = {4, 4, 16, true};
+        return true;
+    }
+    if (format >= 157 && format <= 184) { // VK_FORMAT_ASTC_4x4_UNORM_BLOCK ... VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+        static const uint32_t astcBlocks[14][2] = {{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+                                                   {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+        const uint32_t *block = astcBlocks[(format - 157) / 2]; // every block size has an UNORM & a SRGB format
+        *info = {block[0], block[1], 16, true};
+        return true;
+    }
+    return false;
+}
+
+uint32_t textureformat::get_mip_count(uint32_t width, uint32_t height) {
+    uint32_t extent = std::max(width, height);
+    uint32_t count = 1;
+    while (extent > 1) {
+        extent >>= 1;
+        count++;
+    }
+    return count;
+}
+
+uint32_t textureformat::get_level_extent(uint32_t extent, uint32_t level) {
+    return std::max(extent >> level, 1u);
+}
+
+uint64_t textureformat::get_level_size(const TextureFormatInfo &info, uint32_t width, uint32_t height) {
+    uint64_t blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+    uint64_t blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+    return blocksWide * blocksHigh * info.blockSize;
+}
+
+TextureAsset::TextureAsset(const std::string &path): file(path) {
+    this->readHeader();
+}
+
+void TextureAsset::readHeader() {
+    const uint8_t *data = this->file.get_data();
+    size_t size = this->file.get_size();
+    Ktx2Header header{};
+    if (size < KTX2_LEVEL_INDEX_OFFSET || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        spdlog::error("The file '{0}' isn't a KTX2 texture.", this->get_path());
+        throw std::runtime_error("An invalid texture file was loaded!");
+    }
+    memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+    if (!textureformat::get_format_info(header.vkFormat, &this->formatInfo)) {
+        spdlog::error("The texture '{0}' has an unsupported format. (VkFormat: {1})", this->get_path(),
+                      header.vkFormat);
+        throw std::runtime_error("A texture file with an unsupported format was loaded!");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 ||
+        header.faceCount != 1 || header.supercompressionScheme != 0) {
+        spdlog::error("The texture '{0}' isn't a plain 2D texture (no arrays, cube maps or supercompression).",
+                      this->get_path());
+        throw std::runtime_error("An unsupported texture file was loaded!");
+    }
+    this->format = header.vkFormat;
+    this->width = header.pixelWidth;
+    this->height = header.pixelHeight;
+    uint32_t fullMipCount = textureformat::get_mip_count(this->width, this->height);
+    this->generateMips = header.levelCount == 0 && fullMipCount > 1;
+    uint32_t storedLevels = std::max(header.levelCount, 1u);
+    if (storedLevels > fullMipCount || fullMipCount > TEXTURE_MAX_LEVELS) {
+        spdlog::error("The texture '{0}' has more mip levels than its size allows.", this->get_path());
+        throw std::runtime_error("An invalid texture file was loaded!");
+    }
+    if (this->generateMips && this->formatInfo.compressed) {
+        spdlog::error("The texture '{0}' is block compressed, but has no mip levels (they can't be generated).",
+                      this->get_path());
+        throw std::runtime_error("A texture file without mip levels was loaded!");
+    }
+    this->mipCount = this->generateMips ? fullMipCount : storedLevels;
+
+    // every level has to be exactly as big as its extent needs
+    uint64_t indexOffset = KTX2_LEVEL_INDEX_OFFSET;
+    if (indexOffset + storedLevels * sizeof(Ktx2LevelIndex) > size) {
+        spdlog::error("The texture '{0}' is truncated.", this->get_path());
+        throw std::runtime_error("An invalid texture file was loaded!");
+    }
+    this->levels.resize(storedLevels);
+    for (uint32_t level = 0; level < storedLevels; level++) {
+        Ktx2LevelIndex index{};
+        memcpy(&index, data + indexOffset + level * sizeof(index), sizeof(index));
+        TextureLevel &textureLevel = this->levels[level];
+        textureLevel.width = textureformat::get_level_extent(this->width, level);
+        textureLevel.height = textureformat::get_level_extent(this->height, level);
+        textureLevel.size = textureformat::get_level_size(this->formatInfo, textureLevel.width, textureLevel.height);
+        textureLevel.rowPitch = (textureLevel.width + this->formatInfo.blockWidth - 1) /
+                                this->formatInfo.blockWidth * this->formatInfo.blockSize;
+        if (index.byteLength != textureLevel.size || index.byteOffset > size ||
+            index.byteLength > size - index.byteOffset) {
+            spdlog::error("Mip level {0} of the texture '{1}' is invalid or out of the file's bounds.",
+                          level, this->get_path());
+            throw std::runtime_error("An invalid texture file was loaded!");
+        }
+        textureLevel.data = data + index.byteOffset;
+    }
+}
+
+const std::string &TextureAsset::get_path() const {
+    return this->file.get_path();
+}
+
+uint32_t TextureAsset::get_format() const {
+    return this->format;
+}
+
+const TextureFormatInfo &TextureAsset::get_format_info() const {
+    return this->formatInfo;
+}
+
+uint32_t TextureAsset::get_width() const {
+    return this->width;
+}
+
+uint32_t TextureAsset::get_height() const {
+    return this->height;
+}
+
+uint32_t TextureAsset::get_mip_count() const {
+    return this->mipCount;
+}
+
+bool TextureAsset::needs_mip_generation() const {
+    return this->generateMips;
+}
+
+uint32_t TextureAsset::get_stored_level_count() const {
+    return static_cast<uint32_t>(this->levels.size());
+}
+
+const TextureLevel &TextureAsset::get_level(uint32_t level) const {
+    if (level >= this->levels.size()) {
+        spdlog::error("get_level(): The texture '{0}' doesn't store mip level {1}.", this->get_path(), level);
+        throw std::runtime_error("An invalid mip level was requested from a texture.");
+    }
+    return this->levels[level];
+}
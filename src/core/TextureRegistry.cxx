@@ -0,0 +1,196 @@
+/*
+ * TextureRegistry.cxx
+ * Defines the TextureRegistry class & the texture streaming residency planning.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/TextureRegistry.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+
+uint32_t texturestreaming::get_tail_level(uint32_t width, uint32_t height, uint32_t mipCount) {
+    uint32_t level = 0;
+    while (level + 1 < mipCount && std::max(width >> level, height >> level) > TEXTURE_STREAMING_TAIL_SIZE) {
+        level++;
+    }
+    return level;
+}
+
+uint32_t texturestreaming::get_wanted_level(uint32_t width, uint32_t height, uint32_t mipCount,
+                                            float coveragePixels) {
+    float texels = (float) std::max(width, height);
+    float ratio = texels / std::max(coveragePixels, 1.0f);
+    if (ratio <= 1.0f) return 0;
+    return std::min(static_cast<uint32_t>(std::floor(std::log2(ratio))), mipCount - 1);
+}
+
+uint64_t texturestreaming::get_resident_size(const TextureResidencyRequest &request, uint32_t level) {
+    uint64_t size = 0;
+    for (uint32_t i = level; i < request.mipCount; i++) size += request.levelSizes[i];
+    return size;
+}
+
+void texturestreaming::plan_residency(std::vector<TextureResidencyRequest> &requests, uint64_t budget) {
+    uint64_t used = 0;
+    for (TextureResidencyRequest &request : requests) {
+        request.plannedLevel = std::min(request.tailLevel, request.mipCount - 1);
+        used += get_resident_size(request, request.plannedLevel);
+    }
+    // refines the texture missing the most (priority weighted) levels first, ties go to the earlier texture
+    typedef std::pair<float, uint32_t> Refinement; // key, request index
+    auto lowerKey = [](const Refinement &a, const Refinement &b) {
+        return a.first != b.first ? a.first < b.first : a.second > b.second;
+    };
+    std::priority_queue<Refinement, std::vector<Refinement>, decltype(lowerKey)> refinements(lowerKey);
+    auto pushRefinement = [&refinements, &requests](uint32_t index) {
+        const TextureResidencyRequest &request = requests[index];
+        if (request.plannedLevel <= request.wantedLevel) return;
+        refinements.emplace(request.priority * (float) (request.plannedLevel - request.wantedLevel), index);
+    };
+    for (uint32_t i = 0; i < requests.size(); i++) pushRefinement(i);
+    while (!refinements.empty()) {
+        uint32_t index = refinements.top().second;
+        refinements.pop();
+        TextureResidencyRequest &request = requests[index];
+        uint64_t cost = request.levelSizes[request.plannedLevel - 1];
+        if (used + cost > budget) continue; // this texture's next levels only get bigger, others may still fit
+        used += cost;
+        request.plannedLevel--;
+        pushRefinement(index);
+    }
+
+    // keep the levels of textures that are just a bit sharper than needed (highest priority first)
+    std::vector<uint32_t> order(requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&requests](uint32_t a, uint32_t b) {
+        return requests[a].priority > requests[b].priority;
+    });
+    for (uint32_t index : order) {
+        TextureResidencyRequest &request = requests[index];
+        if (request.residentLevel >= request.plannedLevel || request.residentLevel + 1 < request.wantedLevel) {
+            continue;
+        }
+        uint64_t extra = get_resident_size(request, request.residentLevel) -
+                         get_resident_size(request, request.plannedLevel);
+        if (used + extra > budget) continue;
+        used += extra;
+        request.plannedLevel = request.residentLevel;
+    }
+}
+
+TextureRegistry::TextureRegistry() {
+    // placeholder
+}
+
+TextureRegistry::~TextureRegistry() {
+    // placeholder
+}
+
+TextureHandle TextureRegistry::add_texture(std::shared_ptr<const TextureAsset> asset, float priority) {
+    if (asset == nullptr) {
+        spdlog::error("add_texture(): No texture asset was given!");
+        throw std::runtime_error("A null texture asset was given to the texture registry.");
+    }
+    if (!(priority > 0.0f)) {
+        spdlog::error("add_texture(): Texture priorities have to be above 0.");
+        throw std::runtime_error("An invalid texture priority was given to the texture registry.");
+    }
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    uint32_t slotIndex = this->freeSlot;
+    if (slotIndex != UINT32_MAX) {
+        this->freeSlot = this->textureSlots[slotIndex].nextFree;
+    } else {
+        slotIndex = static_cast<uint32_t>(this->textureSlots.size());
+        this->textureSlots.emplace_back();
+    }
+    TextureSlot &slot = this->textureSlots[slotIndex];
+    slot.alive = true;
+    TextureHandle texture = {slotIndex, slot.generation};
+
+    TextureOperation operation;
+    operation.type = TEXTURE_OPERATION_ADD;
+    operation.texture = texture;
+    operation.asset = std::move(asset);
+    operation.priority = priority;
+    this->pendingOperations.push_back(std::move(operation));
+    return texture;
+}
+
+TextureHandle TextureRegistry::add_texture(const std::string &path, float priority) {
+    return this->add_texture(std::make_shared<const TextureAsset>(path), priority);
+}
+
+void TextureRegistry::remove_texture(TextureHandle texture) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(texture)) {
+        spdlog::error("remove_texture(): Texture handle is stale or invalid.");
+        throw std::runtime_error("An invalid texture handle was given to the texture registry.");
+    }
+    TextureSlot &slot = this->textureSlots[texture.index];
+    slot.alive = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+    slot.nextFree = this->freeSlot;
+    this->freeSlot = texture.index;
+
+    TextureOperation operation;
+    operation.type = TEXTURE_OPERATION_REMOVE;
+    operation.texture = texture;
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+void TextureRegistry::set_texture_priority(TextureHandle texture, float priority) {
+    if (!(priority > 0.0f)) {
+        spdlog::error("set_texture_priority(): Texture priorities have to be above 0.");
+        throw std::runtime_error("An invalid texture priority was given to the texture registry.");
+    }
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (!this->isAlive(texture)) {
+        spdlog::error("set_texture_priority(): Texture handle is stale or invalid.");
+        throw std::runtime_error("An invalid texture handle was given to the texture registry.");
+    }
+    TextureOperation operation;
+    operation.type = TEXTURE_OPERATION_SET_PRIORITY;
+    operation.texture = texture;
+    operation.priority = priority;
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+void TextureRegistry::set_material_texture(uint32_t materialIndex, TextureHandle texture) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    if (texture.generation != 0 && !this->isAlive(texture)) {
+        spdlog::error("set_material_texture(): Texture handle is stale or invalid.");
+        throw std::runtime_error("An invalid texture handle was given to the texture registry.");
+    }
+    TextureOperation operation;
+    operation.type = TEXTURE_OPERATION_SET_MATERIAL;
+    operation.texture = texture;
+    operation.materialIndex = materialIndex;
+    this->pendingOperations.push_back(std::move(operation));
+}
+
+bool TextureRegistry::is_texture_valid(TextureHandle texture) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    return this->isAlive(texture);
+}
+
+bool TextureRegistry::isAlive(TextureHandle texture) {
+    if (texture.index >= this->textureSlots.size()) return false;
+    const TextureSlot &slot = this->textureSlots[texture.index];
+    return slot.alive && slot.generation == texture.generation;
+}
+
+// Hands the queued operations (in the order they were made) over to the renderer
+void TextureRegistry::_take_pending_operations(std::vector<TextureOperation> &operations) {
+    std::lock_guard<std::mutex> lock(this->registryMutex);
+    operations.swap(this->pendingOperations);
+    this->pendingOperations.clear();
+}
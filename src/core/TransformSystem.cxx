@@ -0,0 +1,382 @@
+/*
+ * TransformSystem.cxx
+ * Defines the TransformSystem class storing every node's transform as structure-of-arrays.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/TransformSystem.h"
+#include "../../include/Vulkray/JobManager.h"
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+TransformSystem::TransformSystem() {
+    // placeholder
+}
+
+TransformSystem::~TransformSystem() {
+    // placeholder
+}
+
+TransformHandle TransformSystem::create_node(TransformHandle parent) {
+    uint32_t parentIndex = TRANSFORM_NONE;
+    if (parent.generation != 0) {
+        parentIndex = this->denseIndex(parent);
+        if (parentIndex == TRANSFORM_NONE) {
+            spdlog::error("create_node(): Parent node handle is stale or invalid.");
+            throw std::runtime_error("An invalid parent node handle was given to the transform system.");
+        }
+    }
+    uint32_t slotIndex = this->freeSlot;
+    if (slotIndex != TRANSFORM_NONE) {
+        this->freeSlot = this->slots[slotIndex].denseIndex;
+    } else {
+        slotIndex = static_cast<uint32_t>(this->slots.size());
+        this->slots.emplace_back();
+    }
+    auto index = static_cast<uint32_t>(this->parents.size());
+    TransformSlot &slot = this->slots[slotIndex];
+    slot.alive = true;
+    slot.denseIndex = index;
+
+    // new nodes are appended, which keeps the hierarchy order unless they land on a shallower level
+    uint32_t depth = parentIndex == TRANSFORM_NONE ? 0 : this->depths[parentIndex] + 1;
+    this->positionX.push_back(0.0f);
+    this->positionY.push_back(0.0f);
+    this->positionZ.push_back(0.0f);
+    this->heading.push_back(0.0f);
+    this->pitch.push_back(0.0f);
+    this->roll.push_back(0.0f);
+    this->scaleX.push_back(1.0f);
+    this->scaleY.push_back(1.0f);
+    this->scaleZ.push_back(1.0f);
+    this->parents.push_back(parentIndex);
+    this->versions.push_back(0);
+    this->localDirty.push_back(1);
+    this->worldChanged.push_back(0);
+    this->worldMatrices.push_back(Matrix4::identity());
+    this->depths.push_back(depth);
+    this->denseSlots.push_back(slotIndex);
+
+    if (!this->orderDirty) {
+        auto levelCount = static_cast<uint32_t>(this->levelStarts.size()) - 1;
+        if (depth == levelCount) {
+            this->levelStarts.push_back(index + 1); // starts a new (deeper) level
+        } else if (depth + 1 == levelCount) {
+            this->levelStarts.back() = index + 1; // extends the deepest level
+        } else {
+            this->orderDirty = true;
+        }
+    }
+    return {slotIndex, slot.generation};
+}
+
+void TransformSystem::destroy_node(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) {
+        spdlog::error("destroy_node(): Node handle is stale or invalid.");
+        throw std::runtime_error("An invalid node handle was given to the transform system.");
+    }
+    TransformSlot &slot = this->slots[node.index];
+    slot.alive = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+    slot.denseIndex = this->freeSlot;
+    this->freeSlot = node.index;
+    // the dense entry is compacted away (and its children detached) by the next reorder
+    this->denseSlots[index] = TRANSFORM_NONE;
+    this->orderDirty = true;
+}
+
+void TransformSystem::set_parent(TransformHandle node, TransformHandle parent) {
+    uint32_t index = this->denseIndex(node);
+    uint32_t parentIndex = parent.generation == 0 ? TRANSFORM_NONE : this->denseIndex(parent);
+    if (index == TRANSFORM_NONE || (parent.generation != 0 && parentIndex == TRANSFORM_NONE)) {
+        spdlog::error("set_parent(): Node handle is stale or invalid.");
+        throw std::runtime_error("An invalid node handle was given to the transform system.");
+    }
+    // a node can't become its own ancestor
+    for (uint32_t ancestor = parentIndex; ancestor != TRANSFORM_NONE; ancestor = this->parents[ancestor]) {
+        if (ancestor == index) {
+            spdlog::error("set_parent(): Parenting the node would create a cycle in the hierarchy.");
+            throw std::runtime_error("A transform node can't be parented to one of its descendants.");
+        }
+    }
+    if (this->parents[index] == parentIndex) return;
+    this->parents[index] = parentIndex;
+    this->markDirty(index);
+    this->orderDirty = true; // depths of the node's whole subtree changed
+}
+
+bool TransformSystem::is_node_valid(TransformHandle node) {
+    return this->isAlive(node);
+}
+
+uint32_t TransformSystem::get_node_count() {
+    uint32_t count = 0;
+    for (const TransformSlot &slot : this->slots) count += slot.alive ? 1 : 0;
+    return count;
+}
+
+void TransformSystem::set_position(TransformHandle node, float x, float y, float z) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return;
+    this->positionX[index] = x;
+    this->positionY[index] = y;
+    this->positionZ[index] = z;
+    this->markDirty(index);
+}
+
+void TransformSystem::set_rotation(TransformHandle node, float h, float p, float r) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return;
+    this->heading[index] = h;
+    this->pitch[index] = p;
+    this->roll[index] = r;
+    this->markDirty(index);
+}
+
+void TransformSystem::set_scale(TransformHandle node, float x, float y, float z) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return;
+    this->scaleX[index] = x;
+    this->scaleY[index] = y;
+    this->scaleZ[index] = z;
+    this->markDirty(index);
+}
+
+glm::vec3 TransformSystem::get_position(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return glm::vec3(0.0f);
+    return {this->positionX[index], this->positionY[index], this->positionZ[index]};
+}
+
+glm::vec3 TransformSystem::get_rotation(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return glm::vec3(0.0f);
+    return {this->heading[index], this->pitch[index], this->roll[index]};
+}
+
+glm::vec3 TransformSystem::get_scale(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return glm::vec3(1.0f);
+    return {this->scaleX[index], this->scaleY[index], this->scaleZ[index]};
+}
+
+uint32_t TransformSystem::get_version(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    return index == TRANSFORM_NONE ? 0 : this->versions[index];
+}
+
+glm::mat4 TransformSystem::get_world_matrix(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return glm::mat4(1.0f);
+    return this->worldMatrices[index];
+}
+
+// Parents that were destroyed since the last update count as gone already (their children become root nodes)
+glm::mat4 TransformSystem::compute_world_matrix(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    if (index == TRANSFORM_NONE) return glm::mat4(1.0f);
+    glm::mat4 matrix = this->localMatrix(index);
+    for (uint32_t parent = this->parents[index];
+         parent != TRANSFORM_NONE && this->denseSlots[parent] != TRANSFORM_NONE; parent = this->parents[parent]) {
+        matrix = this->localMatrix(parent) * matrix;
+    }
+    return matrix;
+}
+
+bool TransformSystem::world_matrix_changed(TransformHandle node) {
+    uint32_t index = this->denseIndex(node);
+    return index != TRANSFORM_NONE && this->worldChanged[index];
+}
+
+/* translation * heading * pitch * roll * scale (Z axis is up, same rotation directions as the camera:
+ * positive heading turns clockwise, positive pitch looks up). The world matrix updates compose whole batches
+ * of nodes at once with the same kernel.
+ */
+glm::mat4 TransformSystem::compose_matrix(glm::vec3 position, glm::vec3 hpr, glm::vec3 scale) {
+    Matrix4 matrix;
+    linmath::compose_transforms(1, &position.x, &position.y, &position.z, &hpr.x, &hpr.y, &hpr.z,
+                                &scale.x, &scale.y, &scale.z, &matrix);
+    return matrix;
+}
+
+glm::mat4 TransformSystem::localMatrix(uint32_t index) {
+    return TransformSystem::compose_matrix({this->positionX[index], this->positionY[index], this->positionZ[index]},
+                                           {this->heading[index], this->pitch[index], this->roll[index]},
+                                           {this->scaleX[index], this->scaleY[index], this->scaleZ[index]});
+}
+
+/* Recomputes the world matrices of every node whose local transform (or any ancestor's) changed since the
+ * last update. Levels are computed in order, so parents are always done before their children.
+ */
+void TransformSystem::_update_world_matrices(JobManager *jobManager) {
+    if (this->orderDirty) this->rebuildOrder();
+
+    for (size_t level = 0; level + 1 < this->levelStarts.size(); level++) {
+        uint32_t first = this->levelStarts[level];
+        uint32_t last = this->levelStarts[level + 1];
+        uint32_t batchCount = (last - first + TRANSFORM_BATCH_SIZE - 1) / TRANSFORM_BATCH_SIZE;
+        if (jobManager == nullptr || batchCount <= 1) {
+            this->computeRange(first, last);
+            continue;
+        }
+        this->batchStart = first;
+        this->batchEnd = last;
+        jobManager->_run_parallel(batchCount, this, &TransformSystem::computeBatchTask);
+    }
+}
+
+/* The changed nodes of every LINMATH_KERNEL_BATCH long stretch are gathered & composed in one kernel call,
+ * then multiplied by their parent's world matrix.
+ */
+void TransformSystem::computeRange(uint32_t first, uint32_t last) {
+    uint32_t changedNodes[LINMATH_KERNEL_BATCH];
+    float positions[3][LINMATH_KERNEL_BATCH], rotations[3][LINMATH_KERNEL_BATCH], scales[3][LINMATH_KERNEL_BATCH];
+    Matrix4 locals[LINMATH_KERNEL_BATCH];
+    for (uint32_t chunkStart = first; chunkStart < last; chunkStart += LINMATH_KERNEL_BATCH) {
+        uint32_t chunkEnd = std::min<uint32_t>(last, chunkStart + LINMATH_KERNEL_BATCH);
+        uint32_t changedCount = 0;
+        for (uint32_t i = chunkStart; i < chunkEnd; i++) {
+            uint32_t parent = this->parents[i];
+            bool changed = this->localDirty[i] || (parent != TRANSFORM_NONE && this->worldChanged[parent]);
+            this->worldChanged[i] = changed;
+            if (!changed) continue;
+            this->localDirty[i] = 0;
+
+            uint32_t n = changedCount++;
+            changedNodes[n] = i;
+            positions[0][n] = this->positionX[i];
+            positions[1][n] = this->positionY[i];
+            positions[2][n] = this->positionZ[i];
+            rotations[0][n] = this->heading[i];
+            rotations[1][n] = this->pitch[i];
+            rotations[2][n] = this->roll[i];
+            scales[0][n] = this->scaleX[i];
+            scales[1][n] = this->scaleY[i];
+            scales[2][n] = this->scaleZ[i];
+        }
+        if (changedCount == 0) continue;
+        linmath::compose_transforms(changedCount, positions[0], positions[1], positions[2],
+                                    rotations[0], rotations[1], rotations[2], scales[0], scales[1], scales[2],
+                                    locals);
+        for (uint32_t n = 0; n < changedCount; n++) {
+            uint32_t i = changedNodes[n];
+            uint32_t parent = this->parents[i];
+            this->worldMatrices[i] = parent == TRANSFORM_NONE ? locals[n] : this->worldMatrices[parent] * locals[n];
+        }
+    }
+}
+
+void TransformSystem::computeBatchTask(void *caller, uint32_t index) {
+    auto self = static_cast<TransformSystem*>(caller);
+    uint32_t first = self->batchStart + index * TRANSFORM_BATCH_SIZE;
+    uint32_t last = std::min(self->batchEnd, first + TRANSFORM_BATCH_SIZE);
+    self->computeRange(first, last);
+}
+
+/* Compacts destroyed nodes away and sorts the dense arrays by hierarchy depth (stable, so siblings keep
+ * their order). Children of destroyed nodes become root nodes. O(n), only runs after structural changes.
+ */
+void TransformSystem::rebuildOrder() {
+    auto count = static_cast<uint32_t>(this->parents.size());
+    const uint32_t unknownDepth = TRANSFORM_NONE;
+
+    // detach the children of destroyed nodes, then work out every live node's depth
+    for (uint32_t i = 0; i < count; i++) {
+        if (this->denseSlots[i] == TRANSFORM_NONE) continue;
+        uint32_t parent = this->parents[i];
+        if (parent != TRANSFORM_NONE && this->denseSlots[parent] == TRANSFORM_NONE) {
+            this->parents[i] = TRANSFORM_NONE;
+            this->markDirty(i);
+        }
+        this->depths[i] = unknownDepth;
+    }
+    uint32_t maxDepth = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (this->denseSlots[i] == TRANSFORM_NONE || this->depths[i] != unknownDepth) continue;
+        // walk up until a node with a known depth (parents can come after their children after re-parenting)
+        uint32_t node = i;
+        while (node != TRANSFORM_NONE && this->depths[node] == unknownDepth) {
+            this->depthStack.push_back(node);
+            node = this->parents[node];
+        }
+        uint32_t depth = node == TRANSFORM_NONE ? 0 : this->depths[node] + 1;
+        while (!this->depthStack.empty()) {
+            this->depths[this->depthStack.back()] = depth++;
+            this->depthStack.pop_back();
+        }
+        maxDepth = std::max(maxDepth, depth - 1);
+    }
+
+    // counting sort by depth
+    this->levelStarts.assign(maxDepth + 2, 0);
+    uint32_t liveCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (this->denseSlots[i] == TRANSFORM_NONE) continue;
+        this->levelStarts[this->depths[i] + 1]++;
+        liveCount++;
+    }
+    if (liveCount == 0) this->levelStarts.assign(1, 0);
+    for (size_t level = 1; level < this->levelStarts.size(); level++) {
+        this->levelStarts[level] += this->levelStarts[level - 1];
+    }
+    this->remap.assign(count, TRANSFORM_NONE);
+    std::vector<uint32_t> cursors(this->levelStarts.begin(), this->levelStarts.end());
+    for (uint32_t i = 0; i < count; i++) {
+        if (this->denseSlots[i] == TRANSFORM_NONE) continue;
+        this->remap[i] = cursors[this->depths[i]]++;
+    }
+
+    for (uint32_t i = 0; i < count; i++) { // parents point at dense indices, move them over first
+        if (this->parents[i] != TRANSFORM_NONE) this->parents[i] = this->remap[this->parents[i]];
+    }
+    this->permute(this->positionX, liveCount);
+    this->permute(this->positionY, liveCount);
+    this->permute(this->positionZ, liveCount);
+    this->permute(this->heading, liveCount);
+    this->permute(this->pitch, liveCount);
+    this->permute(this->roll, liveCount);
+    this->permute(this->scaleX, liveCount);
+    this->permute(this->scaleY, liveCount);
+    this->permute(this->scaleZ, liveCount);
+    this->permute(this->parents, liveCount);
+    this->permute(this->versions, liveCount);
+    this->permute(this->localDirty, liveCount);
+    this->permute(this->worldChanged, liveCount);
+    this->permute(this->worldMatrices, liveCount);
+    this->permute(this->depths, liveCount);
+    this->permute(this->denseSlots, liveCount); // last, the permutation skips entries by their slot
+    for (uint32_t i = 0; i < liveCount; i++) this->slots[this->denseSlots[i]].denseIndex = i;
+    this->orderDirty = false;
+}
+
+template<typename T> void TransformSystem::permute(std::vector<T> &values, uint32_t newCount) {
+    std::vector<T> sorted(newCount);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (this->remap[i] != TRANSFORM_NONE) sorted[this->remap[i]] = values[i];
+    }
+    values.swap(sorted);
+}
+
+uint32_t TransformSystem::denseIndex(TransformHandle node) {
+    return this->isAlive(node) ? this->slots[node.index].denseIndex : TRANSFORM_NONE;
+}
+
+bool TransformSystem::isAlive(TransformHandle node) {
+    if (node.index >= this->slots.size()) return false;
+    const TransformSlot &slot = this->slots[node.index];
+    return slot.alive && slot.generation == node.generation;
+}
+
+void TransformSystem::markDirty(uint32_t index) {
+    this->localDirty[index] = 1;
+    this->versions[index]++;
+}
@@ -0,0 +1,269 @@
+/*
+ * VertexFormat.cxx
+ * Packs vertices into the (optionally quantized) vertex formats meshes are stored in on the GPU.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const float QUANTIZATION_TOLERANCE = 1e-4f; // positions this far out of the bounds still count as inside
+
+// bytes of every attribute, unquantized & quantized
+static const uint32_t attributeSizes[VERTEX_ATTRIBUTE_COUNT][2] = {
+        {12, 8}, // position: R32G32B32_SFLOAT, R16G16B16A16_SNORM (w unused)
+        {12, 4}, // color: R32G32B32_SFLOAT, R8G8B8A8_UNORM (alpha is always 1)
+        {12, 4}, // normal: R32G32B32_SFLOAT, R16G16_SNORM (octahedral)
+        {8, 4} // uv: R32G32_SFLOAT, R16G16_SFLOAT
+};
+
+VertexQuantization VertexQuantization::fit(const std::vector<Vertex> &vertices) {
+    VertexQuantization quantization;
+    if (vertices.empty()) return quantization;
+    glm::vec3 minimum = vertices[0].pos;
+    glm::vec3 maximum = vertices[0].pos;
+    for (const Vertex &vertex : vertices) {
+        for (int axis = 0; axis < 3; axis++) {
+            minimum[axis] = std::min(minimum[axis], vertex.pos[axis]);
+            maximum[axis] = std::max(maximum[axis], vertex.pos[axis]);
+        }
+    }
+    float halfExtent = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        quantization.offset[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        halfExtent = std::max(halfExtent, (maximum[axis] - minimum[axis]) * 0.5f);
+    }
+    if (halfExtent > 0.0f) quantization.scale = halfExtent; // a single point keeps the unit scale
+    return quantization;
+}
+
+bool VertexQuantization::contains(const glm::vec3 &position) const {
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::abs(position[axis] - this->offset[axis]) > this->scale * (1.0f + QUANTIZATION_TOLERANCE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+glm::mat4 VertexQuantization::get_dequantization_matrix() const {
+    glm::mat4 matrix(this->scale);
+    matrix[3] = glm::vec4(this->offset, 1.0f);
+    return matrix;
+}
+
+bool vertexformat::is_valid(VertexFormat format) {
+    return (format & ~(VertexFormat) VERTEX_FORMAT_FLAG_MASK) == 0;
+}
+
+bool vertexformat::has_attribute(VertexFormat format, int attribute) {
+    switch (attribute) {
+        case VERTEX_ATTRIBUTE_POSITION:
+        case VERTEX_ATTRIBUTE_COLOR:
+            return true;
+        case VERTEX_ATTRIBUTE_NORMAL:
+            return (format & VERTEX_FORMAT_NORMALS) != 0;
+        case VERTEX_ATTRIBUTE_UV:
+            return (format & VERTEX_FORMAT_UVS) != 0;
+        default:
+            return false;
+    }
+}
+
+uint32_t vertexformat::get_attribute_size(VertexFormat format, int attribute) {
+    if (!vertexformat::has_attribute(format, attribute)) return 0;
+    return attributeSizes[attribute][(format & VERTEX_FORMAT_QUANTIZED) != 0 ? 1 : 0];
+}
+
+uint32_t vertexformat::get_attribute_offset(VertexFormat format, int attribute) {
+    uint32_t offset = 0;
+    for (int previous = 0; previous < attribute; previous++) {
+        offset += vertexformat::get_attribute_size(format, previous);
+    }
+    return offset;
+}
+
+uint32_t vertexformat::get_stride(VertexFormat format) {
+    return vertexformat::get_attribute_offset(format, VERTEX_ATTRIBUTE_COUNT);
+}
+
+void vertexformat::pack_vertices(VertexFormat format, const VertexQuantization &quantization,
+                                 const Vertex *vertices, size_t count, std::vector<uint8_t> &packed) {
+    uint32_t stride = vertexformat::get_stride(format);
+    uint32_t offsets[VERTEX_ATTRIBUTE_COUNT];
+    for (int attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+        offsets[attribute] = vertexformat::get_attribute_offset(format, attribute);
+    }
+    bool normals = vertexformat::has_attribute(format, VERTEX_ATTRIBUTE_NORMAL);
+    bool uvs = vertexformat::has_attribute(format, VERTEX_ATTRIBUTE_UV);
+    size_t start = packed.size();
+    packed.resize(start + count * stride);
+
+    for (size_t i = 0; i < count; i++) {
+        const Vertex &vertex = vertices[i];
+        uint8_t *destination = packed.data() + start + i * stride;
+        if ((format & VERTEX_FORMAT_QUANTIZED) == 0) {
+            memcpy(destination + offsets[VERTEX_ATTRIBUTE_POSITION], &vertex.pos, sizeof(float) * 3);
+            memcpy(destination + offsets[VERTEX_ATTRIBUTE_COLOR], &vertex.color, sizeof(float) * 3);
+            if (normals) memcpy(destination + offsets[VERTEX_ATTRIBUTE_NORMAL], &vertex.normal, sizeof(float) * 3);
+            if (uvs) memcpy(destination + offsets[VERTEX_ATTRIBUTE_UV], &vertex.uv, sizeof(float) * 2);
+            continue;
+        }
+        int16_t position[4] = {};
+        uint8_t color[4] = {0, 0, 0, 255};
+        for (int axis = 0; axis < 3; axis++) {
+            position[axis] = vertexformat::pack_snorm16((vertex.pos[axis] - quantization.offset[axis]) /
+                                                        quantization.scale);
+            color[axis] = (uint8_t) std::lround(std::clamp(vertex.color[axis], 0.0f, 1.0f) * 255.0f);
+        }
+        memcpy(destination + offsets[VERTEX_ATTRIBUTE_POSITION], position, sizeof(position));
+        memcpy(destination + offsets[VERTEX_ATTRIBUTE_COLOR], color, sizeof(color));
+        if (normals) {
+            glm::vec2 encoded = vertexformat::encode_octahedral(vertex.normal);
+            int16_t normal[2] = {vertexformat::pack_snorm16(encoded.x), vertexformat::pack_snorm16(encoded.y)};
+            memcpy(destination + offsets[VERTEX_ATTRIBUTE_NORMAL], normal, sizeof(normal));
+        }
+        if (uvs) {
+            uint16_t uv[2] = {vertexformat::pack_half(vertex.uv.x), vertexformat::pack_half(vertex.uv.y)};
+            memcpy(destination + offsets[VERTEX_ATTRIBUTE_UV], uv, sizeof(uv));
+        }
+    }
+}
+
+Vertex vertexformat::unpack_vertex(VertexFormat format, const VertexQuantization &quantization,
+                                   const uint8_t *packed) {
+    Vertex vertex{};
+    const uint8_t *position = packed + vertexformat::get_attribute_offset(format, VERTEX_ATTRIBUTE_POSITION);
+    const uint8_t *color = packed + vertexformat::get_attribute_offset(format, VERTEX_ATTRIBUTE_COLOR);
+    const uint8_t *normal = packed + vertexformat::get_attribute_offset(format, VERTEX_ATTRIBUTE_NORMAL);
+    const uint8_t *uv = packed + vertexformat::get_attribute_offset(format, VERTEX_ATTRIBUTE_UV);
+    bool normals = vertexformat::has_attribute(format, VERTEX_ATTRIBUTE_NORMAL);
+    bool uvs = vertexformat::has_attribute(format, VERTEX_ATTRIBUTE_UV);
+    if ((format & VERTEX_FORMAT_QUANTIZED) == 0) {
+        memcpy(&vertex.pos, position, sizeof(float) * 3);
+        memcpy(&vertex.color, color, sizeof(float) * 3);
+        if (normals) memcpy(&vertex.normal, normal, sizeof(float) * 3);
+        if (uvs) memcpy(&vertex.uv, uv, sizeof(float) * 2);
+        return vertex;
+    }
+    int16_t quantized[4];
+    memcpy(quantized, position, sizeof(quantized));
+    for (int axis = 0; axis < 3; axis++) {
+        vertex.pos[axis] = vertexformat::unpack_snorm16(quantized[axis]) * quantization.scale +
+                           quantization.offset[axis];
+        vertex.color[axis] = (float) color[axis] / 255.0f;
+    }
+    if (normals) {
+        int16_t encoded[2];
+        memcpy(encoded, normal, sizeof(encoded));
+        vertex.normal = vertexformat::decode_octahedral(glm::vec2(vertexformat::unpack_snorm16(encoded[0]),
+                                                                  vertexformat::unpack_snorm16(encoded[1])));
+    }
+    if (uvs) {
+        uint16_t halves[2];
+        memcpy(halves, uv, sizeof(halves));
+        vertex.uv = glm::vec2(vertexformat::unpack_half(halves[0]), vertexformat::unpack_half(halves[1]));
+    }
+    return vertex;
+}
+
+glm::vec4 vertexformat::compute_bounding_sphere(const std::vector<Vertex> &vertices) {
+    if (vertices.empty()) return glm::vec4(0.0f);
+    VertexQuantization bounds = VertexQuantization::fit(vertices); // its offset is the bounding box center
+    float radiusSquared = 0.0f;
+    for (const Vertex &vertex : vertices) {
+        float distanceSquared = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            float delta = vertex.pos[axis] - bounds.offset[axis];
+            distanceSquared += delta * delta;
+        }
+        radiusSquared = std::max(radiusSquared, distanceSquared);
+    }
+    return glm::vec4(bounds.offset, std::sqrt(radiusSquared));
+}
+
+int16_t vertexformat::pack_snorm16(float value) {
+    return (int16_t) std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+float vertexformat::unpack_snorm16(int16_t value) {
+    return std::max((float) value / 32767.0f, -1.0f); // -32768 is -1 as well (like the GPU reads it)
+}
+
+// Round to nearest even, out of range values become infinity & NaNs stay NaNs
+uint16_t vertexformat::pack_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    auto sign = (uint16_t) ((bits >> 16) & 0x8000);
+    auto exponent = (int32_t) ((bits >> 23) & 0xFF);
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF) return (uint16_t) (sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+
+    int32_t halfExponent = exponent - 127 + 15;
+    if (halfExponent >= 31) return (uint16_t) (sign | 0x7C00);
+    if (halfExponent <= 0) { // subnormal half floats (or zero)
+        if (halfExponent < -10) return sign;
+        mantissa |= 0x800000; // the implicit leading bit
+        auto shift = (uint32_t) (14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) half++;
+        return (uint16_t) (sign | half);
+    }
+    uint32_t half = (uint32_t) halfExponent << 10 | mantissa >> 13;
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) half++; // may carry into infinity
+    return (uint16_t) (sign | half);
+}
+
+float vertexformat::unpack_half(uint16_t value) {
+    uint32_t sign = (uint32_t) (value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    if (exponent == 0) {
+        float magnitude = std::ldexp((float) mantissa, -24);
+        return sign != 0 ? -magnitude : magnitude;
+    }
+    uint32_t bits = sign | mantissa << 13;
+    bits |= exponent == 31 ? 0x7F800000 : (exponent + 112) << 23; // infinity & NaN or rebiased
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/* Projects the normal onto the octahedron |x| + |y| + |z| = 1 and unfolds its lower half over the upper one,
+ * so every direction maps to a point of the square with an even spread of precision.
+ */
+glm::vec2 vertexformat::encode_octahedral(const glm::vec3 &normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) return {0.0f, 0.0f}; // decodes to +z
+    float x = normal.x / length;
+    float y = normal.y / length;
+    if (normal.z < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return {x, y};
+}
+
+glm::vec3 vertexformat::decode_octahedral(const glm::vec2 &encoded) {
+    float x = encoded.x;
+    float y = encoded.y;
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    float fold = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    float length = std::sqrt(x * x + y * y + z * z);
+    return {x / length, y / length, z / length};
+}
@@ -0,0 +1,184 @@
+/*
+ * LinearMath.cxx
+ * Defines the quaternion helpers & the SIMD batch kernels of the linear math module.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/LinearMath.h"
+#include <algorithm>
+
+// Cody-Waite split of pi / 2 (the first parts have few enough bits to be multiplied exactly)
+static const float HALF_PI_1 = 1.5703125f;
+static const float HALF_PI_2 = 4.837512969970703125e-4f;
+static const float HALF_PI_3 = 7.54978995489188216e-8f;
+static const float TWO_OVER_PI = 0.636619772367581343f;
+static const float DEGREES_TO_RADIANS = 0.0174532925199432958f;
+
+/* Minimax polynomials over [-pi / 4, pi / 4] (the same ones as the Cephes library's sinf & cosf). The angle is
+ * reduced to that range by the nearest multiple of pi / 2, whose quadrant then swaps & negates the results.
+ */
+#if defined(LINMATH_SSE2)
+static void sin_cos4(const float *radians, float *sines, float *cosines) {
+    __m128 angle = _mm_loadu_ps(radians);
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(TWO_OVER_PI))); // rounds to nearest
+    __m128 multiple = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(angle, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_3)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r2), _mm_set1_ps(8.3321608736e-3f));
+    s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(-1.6666654611e-1f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r2), _mm_set1_ps(-1.388731625493765e-3f));
+    c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(4.166664568298827e-2f));
+    c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, r2), r2), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))));
+
+    // odd quadrants swap sine & cosine, quadrants 2 & 3 negate the sine, quadrants 1 & 2 the cosine
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    __m128i sineSign = _mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30);
+    __m128i cosineSign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)),
+                                                      _mm_set1_epi32(2)), 30);
+    _mm_storeu_ps(sines, _mm_xor_ps(sine, _mm_castsi128_ps(sineSign)));
+    _mm_storeu_ps(cosines, _mm_xor_ps(cosine, _mm_castsi128_ps(cosineSign)));
+}
+#elif defined(LINMATH_NEON)
+static void sin_cos4(const float *radians, float *sines, float *cosines) {
+    float32x4_t angle = vld1q_f32(radians);
+    int32x4_t quadrant = vcvtnq_s32_f32(vmulq_f32(angle, vdupq_n_f32(TWO_OVER_PI))); // rounds to nearest
+    float32x4_t multiple = vcvtq_f32_s32(quadrant);
+    float32x4_t r = vsubq_f32(angle, vmulq_f32(multiple, vdupq_n_f32(HALF_PI_1)));
+    r = vsubq_f32(r, vmulq_f32(multiple, vdupq_n_f32(HALF_PI_2)));
+    r = vsubq_f32(r, vmulq_f32(multiple, vdupq_n_f32(HALF_PI_3)));
+    float32x4_t r2 = vmulq_f32(r, r);
+
+    float32x4_t s = vaddq_f32(vmulq_f32(vdupq_n_f32(-1.9515295891e-4f), r2), vdupq_n_f32(8.3321608736e-3f));
+    s = vaddq_f32(vmulq_f32(s, r2), vdupq_n_f32(-1.6666654611e-1f));
+    s = vaddq_f32(vmulq_f32(vmulq_f32(s, r2), r), r);
+    float32x4_t c = vaddq_f32(vmulq_f32(vdupq_n_f32(2.443315711809948e-5f), r2),
+                              vdupq_n_f32(-1.388731625493765e-3f));
+    c = vaddq_f32(vmulq_f32(c, r2), vdupq_n_f32(4.166664568298827e-2f));
+    c = vaddq_f32(vmulq_f32(vmulq_f32(c, r2), r2), vsubq_f32(vdupq_n_f32(1.0f), vmulq_f32(r2, vdupq_n_f32(0.5f))));
+
+    // odd quadrants swap sine & cosine, quadrants 2 & 3 negate the sine, quadrants 1 & 2 the cosine
+    uint32x4_t swap = vceqq_s32(vandq_s32(quadrant, vdupq_n_s32(1)), vdupq_n_s32(1));
+    float32x4_t sine = vbslq_f32(swap, c, s);
+    float32x4_t cosine = vbslq_f32(swap, s, c);
+    uint32x4_t sineSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(quadrant, vdupq_n_s32(2))), 30);
+    uint32x4_t cosineSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(vaddq_s32(quadrant, vdupq_n_s32(1)),
+                                                                        vdupq_n_s32(2))), 30);
+    vst1q_f32(sines, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(sine), sineSign)));
+    vst1q_f32(cosines, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(cosine), cosineSign)));
+}
+#else
+static void sin_cos4(const float *radians, float *sines, float *cosines) {
+    for (int i = 0; i < 4; i++) {
+        float quadrantValue = std::nearbyint(radians[i] * TWO_OVER_PI);
+        int quadrant = (int) quadrantValue;
+        float r = radians[i] - quadrantValue * HALF_PI_1;
+        r = r - quadrantValue * HALF_PI_2;
+        r = r - quadrantValue * HALF_PI_3;
+        float r2 = r * r;
+        float s = ((-1.9515295891e-4f * r2 + 8.3321608736e-3f) * r2 - 1.6666654611e-1f) * r2 * r + r;
+        float c = ((2.443315711809948e-5f * r2 - 1.388731625493765e-3f) * r2 + 4.166664568298827e-2f) * r2 * r2 +
+                  (1.0f - r2 * 0.5f);
+        float sine = (quadrant & 1) ? c : s;
+        float cosine = (quadrant & 1) ? s : c;
+        sines[i] = (quadrant & 2) ? -sine : sine;
+        cosines[i] = ((quadrant + 1) & 2) ? -cosine : cosine;
+    }
+}
+#endif
+
+void linmath::sin_cos(const float *radians, float *sines, float *cosines, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) sin_cos4(radians + i, sines + i, cosines + i);
+    if (i == count) return;
+    // the tail goes through the same code, padded to a full vector
+    float paddedRadians[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float paddedSines[4], paddedCosines[4];
+    std::copy(radians + i, radians + count, paddedRadians);
+    sin_cos4(paddedRadians, paddedSines, paddedCosines);
+    std::copy(paddedSines, paddedSines + (count - i), sines + i);
+    std::copy(paddedCosines, paddedCosines + (count - i), cosines + i);
+}
+
+void linmath::compose_transforms(size_t count, const float *positionX, const float *positionY,
+                                 const float *positionZ, const float *heading, const float *pitch,
+                                 const float *roll, const float *scaleX, const float *scaleY, const float *scaleZ,
+                                 Matrix4 *matrices) {
+    // one sin_cos call for the three angles of the whole chunk: heading & pitch turn clockwise, so they're negated
+    alignas(16) float angles[3 * LINMATH_KERNEL_BATCH];
+    alignas(16) float sines[3 * LINMATH_KERNEL_BATCH];
+    alignas(16) float cosines[3 * LINMATH_KERNEL_BATCH];
+    for (size_t chunkStart = 0; chunkStart < count; chunkStart += LINMATH_KERNEL_BATCH) {
+        size_t chunkSize = std::min<size_t>(LINMATH_KERNEL_BATCH, count - chunkStart);
+        for (size_t i = 0; i < chunkSize; i++) {
+            angles[i] = -heading[chunkStart + i] * DEGREES_TO_RADIANS;
+            angles[chunkSize + i] = -pitch[chunkStart + i] * DEGREES_TO_RADIANS;
+            angles[2 * chunkSize + i] = roll[chunkStart + i] * DEGREES_TO_RADIANS;
+        }
+        linmath::sin_cos(angles, sines, cosines, 3 * chunkSize);
+
+        for (size_t i = 0; i < chunkSize; i++) {
+            size_t node = chunkStart + i;
+            float sinH = sines[i], cosH = cosines[i];
+            float sinP = sines[chunkSize + i], cosP = cosines[chunkSize + i];
+            float sinR = sines[2 * chunkSize + i], cosR = cosines[2 * chunkSize + i];
+            // rotation about Z (heading), then Y (pitch), then X (roll), each column scaled by its axis' scale
+            Vector4 xAxis(cosH * cosP, sinH * cosP, -sinP, 0.0f);
+            Vector4 yAxis(cosH * sinP * sinR - sinH * cosR, sinH * sinP * sinR + cosH * cosR, cosP * sinR, 0.0f);
+            Vector4 zAxis(cosH * sinP * cosR + sinH * sinR, sinH * sinP * cosR - cosH * sinR, cosP * cosR, 0.0f);
+            matrices[node] = {xAxis * scaleX[node], yAxis * scaleY[node], zAxis * scaleZ[node],
+                              {positionX[node], positionY[node], positionZ[node], 1.0f}};
+        }
+    }
+}
+
+void linmath::multiply_matrices(size_t count, const Matrix4 *left, const Matrix4 *right, Matrix4 *results) {
+    for (size_t i = 0; i < count; i++) results[i] = left[i] * right[i];
+}
+
+void linmath::transform_points(const Matrix4 &matrix, size_t count, const Vector3 *points, Vector3 *results) {
+    for (size_t i = 0; i < count; i++) results[i] = matrix.transform_point(points[i]);
+}
+
+Quaternion Quaternion::from_hpr(const Vector3 &hpr) {
+    // half angles, with heading & pitch negated like the node transforms
+    alignas(16) float angles[4] = {-hpr.x * DEGREES_TO_RADIANS * 0.5f, -hpr.y * DEGREES_TO_RADIANS * 0.5f,
+                                   hpr.z * DEGREES_TO_RADIANS * 0.5f, 0.0f};
+    alignas(16) float sines[4], cosines[4];
+    linmath::sin_cos(angles, sines, cosines, 4);
+    float sinH = sines[0], cosH = cosines[0];
+    float sinP = sines[1], cosP = cosines[1];
+    float sinR = sines[2], cosR = cosines[2];
+    // heading about Z * pitch about Y * roll about X
+    return {cosH * cosP * sinR - sinH * sinP * cosR,
+            cosH * sinP * cosR + sinH * cosP * sinR,
+            sinH * cosP * cosR - cosH * sinP * sinR,
+            cosH * cosP * cosR + sinH * sinP * sinR};
+}
+
+Quaternion Quaternion::normalized() const {
+    float length = std::sqrt(this->x * this->x + this->y * this->y + this->z * this->z + this->w * this->w);
+    if (length == 0.0f) return {};
+    float inverse = 1.0f / length;
+    return {this->x * inverse, this->y * inverse, this->z * inverse, this->w * inverse};
+}
+
+Quaternion Quaternion::nlerp(const Quaternion &from, const Quaternion &to, float alpha) {
+    // q & -q are the same rotation, blending towards the closer one takes the shortest path
+    float dot = from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    Quaternion blended(from.x + (to.x * sign - from.x) * alpha, from.y + (to.y * sign - from.y) * alpha,
+                       from.z + (to.z * sign - from.z) * alpha, from.w + (to.w * sign - from.w) * alpha);
+    return blended.normalized();
+}
@@ -1,21 +0,0 @@
-/*
- * Vector3.cxx
- * Defines the Vector3 object essential to 3D linear math.
- *
- * VULKRAY ENGINE SOFTWARE
- * Copyright (c) 2023, Max Rodriguez. All rights reserved.
- *
- * All use of this software is subject to the terms of the revised BSD
- * license. You should have received a copy of this license along
- * with this source code in a file named "COPYING."
- */
-
-#include "../../include/Vulkray/Vector3.h"
-
-Vector3::Vector3() {
-    // placeholder
-}
-
-Vector3::~Vector3() {
-    // placeholder
-}
\ No newline at end of file
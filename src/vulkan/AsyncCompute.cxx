@@ -0,0 +1,122 @@
+/*
+ * AsyncCompute.cxx
+ * Submits the frame's compute work to the compute queue, the frame's graphics work waits on its results.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+
+AsyncCompute::AsyncCompute(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    QueueFamilyIndices queueFamilies = this->m_vulkan->m_physicalDevice->queueFamilies;
+    this->dedicatedQueue = queueFamilies.computeFamily.value() != queueFamilies.graphicsFamily.value();
+    this->frameValues.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT, 0);
+
+    // Compute submits complete in submission order, so a single timeline semaphore tracks all of them
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+    VkResult result = vkCreateSemaphore(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                        &semaphoreInfo, nullptr, &this->timelineSemaphore);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the async compute timeline semaphore.");
+        throw std::runtime_error("Failed to create the async compute timeline semaphore!");
+    }
+    VULKRAY_LOG_DEBUG("Initialized async compute. (dedicated compute queue: {0})", this->dedicatedQueue);
+}
+
+AsyncCompute::~AsyncCompute() {
+    this->waitFor(this->nextValue); // the compute command buffers may still be in use
+    vkDestroySemaphore(this->m_vulkan->m_logicalDevice->logicalDevice, this->timelineSemaphore, nullptr);
+}
+
+/* The job records its dispatches (and the barriers between them) into the frame's compute command buffer.
+ * graphicsWaitStages are the first stages of the frame's graphics work using the results, e.g.
+ * VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT for draws written by a compute shader.
+ * Jobs are scheduled for a single frame, systems running every frame schedule their work every frame.
+ */
+void AsyncCompute::schedule(std::function<void(VkCommandBuffer)> record, VkPipelineStageFlags graphicsWaitStages) {
+    this->scheduledJobs.push_back({std::move(record), graphicsWaitStages});
+}
+
+/* Right before the frame's graphics submit (after the UBO update, so jobs can read the frame's camera).
+ * Queued, it goes out with the graphics submit.
+ */
+void AsyncCompute::submit() {
+    this->graphicsWaitValue = 0;
+    this->graphicsWaitStages = 0;
+    if (this->scheduledJobs.empty()) return;
+
+    /* The frame's compute command buffer was last submitted MAX_FRAMES_IN_FLIGHT frames ago. That frame's graphics
+     * work waited on it, so this is free unless its graphics submit was skipped (out of date swap chain).
+     */
+    uint32_t frameIndex = this->m_vulkan->frameIndex;
+    this->waitFor(this->frameValues[frameIndex]);
+    VkCommandBuffer commandBuffer = this->m_vulkan->m_computeCommandPool->commandBuffers[frameIndex];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to start recording to a compute command buffer.");
+        throw std::runtime_error("Failed to begin recording the compute command buffer!");
+    }
+    VkPipelineStageFlags waitStages = 0;
+    for (ComputeJob &job : this->scheduledJobs) {
+        job.record(commandBuffer);
+        waitStages |= job.graphicsWaitStages;
+    }
+    this->scheduledJobs.clear();
+    result = vkEndCommandBuffer(commandBuffer);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to stop recording to a compute command buffer.");
+        throw std::runtime_error("Failed to stop recording the compute command buffer!");
+    }
+
+    // the jobs may read buffers uploaded for this frame, same as the graphics work
+    UploadQueue *m_uploadQueue = this->m_vulkan->m_uploadQueue.get();
+    uint64_t waitValue = m_uploadQueue->getGraphicsWaitValue();
+    uint64_t signalValue = ++this->nextValue;
+    this->m_vulkan->m_synchronization->queueSubmit(
+            this->m_vulkan->m_logicalDevice->computeQueue, commandBuffer,
+            {{waitValue > 0 ? m_uploadQueue->timelineSemaphore : VK_NULL_HANDLE, waitValue,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT}},
+            {{this->timelineSemaphore, signalValue, 0}});
+    this->frameValues[frameIndex] = signalValue;
+    this->graphicsWaitValue = signalValue;
+    this->graphicsWaitStages = waitStages != 0 ? waitStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+uint64_t AsyncCompute::getGraphicsWaitValue() {
+    return this->graphicsWaitValue;
+}
+
+VkPipelineStageFlags AsyncCompute::getGraphicsWaitStages() {
+    return this->graphicsWaitStages;
+}
+
+void AsyncCompute::waitFor(uint64_t value) {
+    uint64_t currentValue = 0;
+    vkGetSemaphoreCounterValue(this->m_vulkan->m_logicalDevice->logicalDevice, this->timelineSemaphore, &currentValue);
+    if (currentValue >= value) return; // the usual case, keeps the frame's queued submits together
+    this->m_vulkan->m_synchronization->flushSubmits(); // the submit may still be queued
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &this->timelineSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(this->m_vulkan->m_logicalDevice->logicalDevice, &waitInfo, UINT64_MAX);
+}
@@ -12,6 +12,7 @@
 
 #include "../../include/Vulkray/Vulkan.h"
 #include <spdlog/spdlog.h>
+#include <algorithm>
 
 CommandPool::CommandPool(Vulkan *m_vulkan, VkCommandPoolCreateFlags additionalFlags,
                          uint32_t queueIndex): VkModuleBase(m_vulkan) {
@@ -60,51 +61,159 @@ void CommandPool::createCommandBuffer() {
     }
 }
 
+// Only applies to the graphics command pool instance
+void CommandPool::allocateCachedCommandBuffers(uint32_t swapImageCount) {
+    if (this->cachedRecording && swapImageCount == this->cachedImageCount) {
+        // same layout after a swap chain recreation, every buffer is re-recorded once its frame was waited on
+        this->markCommandBuffersDirty();
+        return;
+    }
+    // The per-frame command buffers (or the previous cache) may still be pending, they're freed once they're not
+    this->m_vulkan->m_deletionQueue->retire([this, commandBuffers = this->commandBuffers] {
+        vkFreeCommandBuffers(this->m_vulkan->m_logicalDevice->logicalDevice, this->commandPool,
+                             (uint32_t) commandBuffers.size(), commandBuffers.data());
+    });
+
+    // One cached command buffer per (frame in flight, swap image) pair, so a cached buffer is never pending twice
+    this->cachedRecording = true;
+    this->cachedImageCount = swapImageCount;
+    this->commandBuffers.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT * swapImageCount);
+    this->dirtyCommandBuffers.assign(this->commandBuffers.size(), true); // nothing has been recorded yet
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = this->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t) this->commandBuffers.size();
+
+    VkResult result = vkAllocateCommandBuffers(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                               &allocInfo, this->commandBuffers.data());
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while allocating the cached Vulkan command buffers.");
+        throw std::runtime_error("Failed to allocate the cached command buffers!");
+    }
+}
+
+// Forces every cached command buffer to be re-recorded the next time it is used
+void CommandPool::markCommandBuffersDirty() {
+    std::fill(this->dirtyCommandBuffers.begin(), this->dirtyCommandBuffers.end(), true);
+}
+
 // Only applies to the graphics command pool instance
 void CommandPool::recordGraphicsCommands(uint32_t imageIndex) {
 
+    VkCommandBuffer commandBuffer = this->commandBuffers[this->activeBufferIndex];
+
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = 0; // optional
     beginInfo.pInheritanceInfo = nullptr; // optional
 
     // Start recording to the command buffer
-    VkResult result = vkBeginCommandBuffer(this->commandBuffers[this->m_vulkan->frameIndex], &beginInfo);
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
     if (result != VK_SUCCESS) {
         spdlog::error("An error occurred while trying to start recording to a command buffer.");
         throw std::runtime_error("Failed to begin recording the command buffer!");
     }
+    GpuProfiler *gpuProfiler = this->m_vulkan->m_gpuProfiler.get();
+    if (gpuProfiler != nullptr) gpuProfiler->recordFrameStart(commandBuffer);
+
+    // Record the render graph's groups in order, each render pass' subpasses are its merged raster passes
+    RenderPass *m_renderPass = this->m_vulkan->m_renderPass.get();
+    const RenderGraphPlan &plan = m_renderPass->plan;
+    uint32_t sceneGroup = plan.passGroups[m_renderPass->scenePass];
+    for (uint32_t group = 0; group < plan.groups.size(); group++) {
+        const RenderGroupPlan &groupPlan = plan.groups[group];
+        m_renderPass->recordBarriers(commandBuffer, group, imageIndex);
+        if (m_renderPass->renderPasses[group] == VK_NULL_HANDLE) {
+            for (uint32_t pass : groupPlan.passes) this->recordGraphPass(commandBuffer, pass, imageIndex);
+            continue;
+        }
+        if (group == sceneGroup && gpuProfiler != nullptr) {
+            gpuProfiler->recordTimestamp(commandBuffer, GPU_TIMESTAMP_CULLING_END,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_renderPass->renderPasses[group];
+        renderPassInfo.framebuffer = this->m_vulkan->m_frameBuffers->groupFrameBuffers[group][imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = this->m_vulkan->m_swapChain->swapChainExtent;
+        // Specify buffer clear values for color/depth images
+        std::vector<VkClearValue> clearValues = m_renderPass->getClearValues(group);
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, this->getSubpassContents(groupPlan.passes[0]));
+        for (size_t subpass = 0; subpass < groupPlan.passes.size(); subpass++) {
+            if (subpass > 0) vkCmdNextSubpass(commandBuffer, this->getSubpassContents(groupPlan.passes[subpass]));
+            this->recordGraphPass(commandBuffer, groupPlan.passes[subpass], imageIndex);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+        if (group == sceneGroup && gpuProfiler != nullptr) {
+            gpuProfiler->recordTimestamp(commandBuffer, GPU_TIMESTAMP_RENDER_PASS_END,
+                                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+    }
+    if (gpuProfiler != nullptr) {
+        gpuProfiler->recordTimestamp(commandBuffer, GPU_TIMESTAMP_FRAME_END, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    // Finish recording to the command buffer
+    result = vkEndCommandBuffer(commandBuffer);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to stop recording to a command buffer.");
+        throw std::runtime_error("Failed to stop recording the command buffer!");
+    }
+}
 
-    // Start configuring the render pass
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = this->m_vulkan->m_renderPass->renderPass;
-    renderPassInfo.framebuffer = this->m_vulkan->m_frameBuffers->swapChainFrameBuffers[imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = this->m_vulkan->m_swapChain->swapChainExtent;
-
-    // Specify buffer clear values for color/depth images
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = this->m_vulkan->graphicsInput.bufferClearColor.color;
-    clearValues[1].depthStencil = {1.0f, 0}; // 1.0f is the far plane Z value (maximum far)
-
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
-
-    // Submit (record) command to begin render pass
-    vkCmdBeginRenderPass(this->commandBuffers[this->m_vulkan->frameIndex],
-                         &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    // Record binding the graphics pipeline to the command buffer
-    vkCmdBindPipeline(this->commandBuffers[this->m_vulkan->frameIndex],
-                      VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_vulkan->m_graphicsPipeline->graphicsPipeline);
-
-    // Bind the geometry buffers to the command buffer
-    VkBuffer vertexBuffers[] = { this->m_vulkan->m_vertexBuffer->buffer._bufferInstance };
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(this->commandBuffers[this->m_vulkan->frameIndex],
-                           0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(this->commandBuffers[this->m_vulkan->frameIndex],
-                         this->m_vulkan->m_indexBuffer->buffer._bufferInstance, 0, VK_INDEX_TYPE_UINT32);
+// Records one pass of the render graph, inside its render pass for raster passes
+void CommandPool::recordGraphPass(VkCommandBuffer commandBuffer, uint32_t pass, uint32_t imageIndex) {
+    RenderPass *m_renderPass = this->m_vulkan->m_renderPass.get();
+    if (pass == m_renderPass->cullingPass) {
+        // Cull the instances & pick their LODs before the render pass draws them
+        this->m_vulkan->m_cullingPass->recordCulling(commandBuffer);
+    } else if (pass == m_renderPass->scenePass) {
+        if (this->getSubpassContents(pass) == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+            // draws are recorded into secondary command buffers by the recording threads
+            this->m_vulkan->m_parallelRecorder->recordDraws(commandBuffer, this->activeBufferIndex, imageIndex);
+        } else {
+            this->recordDrawState(commandBuffer);
+            this->recordDraws(commandBuffer, 0, static_cast<uint32_t>(this->m_vulkan->drawCommands.size()));
+        }
+    } else if (pass == m_renderPass->readbackPass) {
+        // headless frames are read back instead of presented
+        this->m_vulkan->m_frameReadback->recordCopy(commandBuffer, imageIndex);
+    }
+}
+
+// compacted draws are a single draw call, there's nothing to split across the recording threads
+VkSubpassContents CommandPool::getSubpassContents(uint32_t pass) {
+    CullingPass *cullingPass = this->m_vulkan->m_cullingPass.get();
+    bool compactedDraws = cullingPass != nullptr && cullingPass->compactDraws;
+    if (pass == this->m_vulkan->m_renderPass->scenePass && this->m_vulkan->m_parallelRecorder != nullptr &&
+        !compactedDraws) {
+        return VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+    }
+    return VK_SUBPASS_CONTENTS_INLINE;
+}
+
+/* Binds the geometry buffers, dynamic state & descriptor sets (shared by primary & secondary buffers),
+ * the pipeline variants & index buffer (its index type) are bound per draw batch by recordDraws().
+ */
+void CommandPool::recordDrawState(VkCommandBuffer commandBuffer) {
+
+    // Bind the geometry arena buffers (every mesh lives in them, draws select theirs by offset)
+    // and this frame's instance buffer (binding 1, per-instance transforms & materials)
+    GeometryArena *geometryArena = this->m_vulkan->m_geometryArena.get();
+    GeometryArena::FrameDrawBuffers &frameBuffers = geometryArena->frameDrawBuffers[this->m_vulkan->frameIndex];
+    Buffer *instanceBuffer = this->m_vulkan->m_cullingPass != nullptr ? frameBuffers.culledInstanceBuffer.get()
+                                                                      : frameBuffers.instanceBuffer.get();
+    VkBuffer vertexBuffers[] = {
+            geometryArena->vertexBuffer->buffer._bufferInstance, instanceBuffer->buffer._bufferInstance
+    };
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
     // Record setting the viewport
     VkViewport viewport{};
@@ -114,60 +223,121 @@ void CommandPool::recordGraphicsCommands(uint32_t imageIndex) {
     viewport.height = static_cast<float>(this->m_vulkan->m_swapChain->swapChainExtent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(this->commandBuffers[this->m_vulkan->frameIndex], 0, 1, &viewport);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     // Record scissor configuration
     VkRect2D scissor{};
     scissor.offset = {0, 0};
     scissor.extent = this->m_vulkan->m_swapChain->swapChainExtent;
-    vkCmdSetScissor(this->commandBuffers[this->m_vulkan->frameIndex], 0, 1, &scissor);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    // Bind the corresponding descriptor set to use for this frame render
-    vkCmdBindDescriptorSets(this->commandBuffers[this->m_vulkan->frameIndex],
+    // Bind the descriptor set at this frame's UBO in the uniform ring
+    uint32_t dynamicOffset = this->m_vulkan->cameraUniforms.offset;
+    vkCmdBindDescriptorSets(commandBuffer,
                             VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_vulkan->m_graphicsPipeline->pipelineLayout, 0, 1,
-                            &this->m_vulkan->m_descriptorPool->descriptorSets[this->m_vulkan->frameIndex], 0, nullptr);
+                            &this->m_vulkan->m_descriptorPool->descriptorSet, 1, &dynamicOffset);
+    // bindless mode: every material's texture is in the set, draws only need to know the frame's material table
+    DescriptorPool *m_descriptorPool = this->m_vulkan->m_descriptorPool.get();
+    if (m_descriptorPool->bindless) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                this->m_vulkan->m_graphicsPipeline->pipelineLayout, 1, 1,
+                                &m_descriptorPool->bindlessSet, 0, nullptr);
+        BindlessConstants constants{};
+        constants.materialTable = this->m_vulkan->frameIndex;
+        vkCmdPushConstants(commandBuffer, this->m_vulkan->m_graphicsPipeline->pipelineLayout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(BindlessConstants), &constants);
+    }
+}
 
-    // Submit (record) the draw command and end the render pass
-    vkCmdDrawIndexed(this->commandBuffers[this->m_vulkan->frameIndex],
-                     static_cast<uint32_t>(this->m_vulkan->graphicsInput.indexData.size()), 1, 0, 0, 0);
-    vkCmdEndRenderPass(this->commandBuffers[this->m_vulkan->frameIndex]);
+/* Records a range of the renderer's draw list from this frame's indirect buffer, binding the pipeline of
+ * every draw batch it overlaps (does not modify the pool, safe to call from recording threads). Batches without
+ * a pipeline for their vertex format yet are skipped, they're recorded again once it finished compiling.
+ */
+void CommandPool::recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount) {
+    if (drawCount == 0) return;
+    GeometryArena::FrameDrawBuffers &frameBuffers =
+            this->m_vulkan->m_geometryArena->frameDrawBuffers[this->m_vulkan->frameIndex];
+    CullingPass *cullingPass = this->m_vulkan->m_cullingPass.get();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    // culled draw slots without compaction (empty slots are skipped by the GPU, but still cost a draw)
+    VkBuffer indirectBuffer = cullingPass != nullptr ? frameBuffers.drawSlotBuffer->buffer._bufferInstance
+                                                     : frameBuffers.indirectBuffer->buffer._bufferInstance;
+    const std::vector<DrawBatch> &drawBatches = this->m_vulkan->drawBatches;
+    VkBuffer indexBuffer = this->m_vulkan->m_geometryArena->indexBuffer->buffer._bufferInstance;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
-    // Finish recording to the command buffer
-    result = vkEndCommandBuffer(this->commandBuffers[this->m_vulkan->frameIndex]);
-    if (result != VK_SUCCESS) {
-        spdlog::error("An error occurred while trying to stop recording to a command buffer.");
-        throw std::runtime_error("Failed to stop recording the command buffer!");
+    for (uint32_t batch = 0; batch < drawBatches.size(); batch++) {
+        uint32_t first = std::max(firstDraw, drawBatches[batch].firstDraw);
+        uint32_t last = std::min(firstDraw + drawCount, drawBatches[batch].firstDraw + drawBatches[batch].drawCount);
+        if (first >= last) continue;
+        VkPipeline pipeline = this->m_vulkan->m_pipelineLibrary->getPipeline(drawBatches[batch].pipelineKey);
+        if (pipeline == VK_NULL_HANDLE) continue;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (drawBatches[batch].indexType != boundIndexType) {
+            // the draws' first index is counted in indices of the batch's type, so the buffer is bound at 0
+            boundIndexType = drawBatches[batch].indexType;
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, boundIndexType);
+        }
+
+        if (cullingPass != nullptr && cullingPass->compactDraws) {
+            // only the batch's draws that survived culling, their count is written by the culling pass
+            vkCmdDrawIndexedIndirectCount(commandBuffer, frameBuffers.compactedDrawBuffer->buffer._bufferInstance,
+                                          (VkDeviceSize) drawBatches[batch].firstDraw * stride,
+                                          frameBuffers.drawCountBuffer->buffer._bufferInstance,
+                                          (VkDeviceSize) batch * sizeof(uint32_t), drawBatches[batch].drawCount,
+                                          stride);
+        } else if (this->m_vulkan->m_physicalDevice->multiDrawIndirect) {
+            // the whole range is a single call, no matter how many meshes & instances it covers
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, (VkDeviceSize) first * stride,
+                                     last - first, stride);
+        } else {
+            for (uint32_t draw = first; draw < last; draw++) {
+                vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, (VkDeviceSize) draw * stride, 1, stride);
+            }
+        }
     }
 }
 
 void CommandPool::submitNextCommandBuffer() {
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
     // Synchronization module pointer reference to shorten code
     Synchronization *m_synchronization = this->m_vulkan->m_synchronization.get();
 
-    m_synchronization->waitSemaphores[0] = m_synchronization->imageAvailableSemaphores[this->m_vulkan->frameIndex];
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = m_synchronization->waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &this->commandBuffers[this->m_vulkan->frameIndex];
-    m_synchronization->signalSemaphores[0] = m_synchronization->renderFinishedSemaphores[this->m_vulkan->frameIndex];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = m_synchronization->signalSemaphores;
-
-    VkResult result = vkQueueSubmit(this->m_vulkan->m_logicalDevice->graphicsQueue, 1, &submitInfo,
-                                    m_synchronization->inFlightFences[this->m_vulkan->frameIndex]);
-    if (result != VK_SUCCESS) {
-        spdlog::error("An error occurred while submitting a command buffer to the graphics queue.");
-        throw std::runtime_error("Failed to submit the draw command buffer!");
-    }
+    /* Besides the swap image, also wait for the uploads submitted so far (timeline semaphore).
+     * Waiting on an already signalled value is free, so the wait is always part of the submit.
+     * Headless frames neither acquire nor present, so they only use the timeline semaphores.
+     * The frame's async compute work (if any was scheduled) is waited on at the stages using its results.
+     * The frame timeline is signalled with the frame's value, the CPU waits on it before reusing the frame index.
+     */
+    bool headless = this->m_vulkan->base->config.headless;
+    uint32_t frameIndex = this->m_vulkan->frameIndex;
+    AsyncCompute *m_asyncCompute = this->m_vulkan->m_asyncCompute.get();
+    uint64_t computeWaitValue = m_asyncCompute->getGraphicsWaitValue();
+    m_synchronization->signalSemaphores[0] = m_synchronization->renderFinishedSemaphores[frameIndex];
+    uint64_t frameValue = m_synchronization->frameSubmitted(frameIndex);
+
+    m_synchronization->queueSubmit(
+            this->m_vulkan->m_logicalDevice->graphicsQueue, this->commandBuffers[this->activeBufferIndex],
+            {{headless ? VK_NULL_HANDLE : m_synchronization->imageAvailableSemaphores[frameIndex], 0,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
+             {this->m_vulkan->m_uploadQueue->timelineSemaphore, this->m_vulkan->m_uploadQueue->getGraphicsWaitValue(),
+              VK_PIPELINE_STAGE_VERTEX_INPUT_BIT},
+             {computeWaitValue > 0 ? m_asyncCompute->timelineSemaphore : VK_NULL_HANDLE, computeWaitValue,
+              m_asyncCompute->getGraphicsWaitStages()}},
+            // nothing waits for a headless frame's binary semaphore
+            {{headless ? VK_NULL_HANDLE : m_synchronization->signalSemaphores[0], 0, 0},
+             {m_synchronization->frameTimeline, frameValue, 0}});
 }
 
 void CommandPool::resetGraphicsCmdBuffer(uint32_t imageIndex) {
-    vkResetCommandBuffer(this->commandBuffers[this->m_vulkan->frameIndex], 0);
+    if (this->cachedRecording) {
+        this->activeBufferIndex = this->m_vulkan->frameIndex * this->cachedImageCount + imageIndex;
+        // the cached buffer is still valid; only the UBO changes, so skip re-recording this frame
+        if (!this->dirtyCommandBuffers[this->activeBufferIndex]) return;
+        this->dirtyCommandBuffers[this->activeBufferIndex] = false;
+    } else {
+        this->activeBufferIndex = this->m_vulkan->frameIndex;
+    }
+    vkResetCommandBuffer(this->commandBuffers[this->activeBufferIndex], 0);
     this->recordGraphicsCommands(imageIndex);
 }
\ No newline at end of file
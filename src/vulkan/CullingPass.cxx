@@ -0,0 +1,229 @@
+/*
+ * CullingPass.cxx
+ * Culls the frame's instances on the GPU and compacts the surviving draws in a compute pre-pass.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include "../../include/Vulkray/JobManager.h"
+#include <spdlog/spdlog.h>
+
+const uint32_t CULLING_BINDING_COUNT = 6; // storage buffers of the culling descriptor set (see recordCulling())
+
+CullingPass::CullingPass(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    // the compacted list is drawn with one call, so compaction needs multi draw support as well
+    this->compactDraws = this->m_vulkan->m_physicalDevice->drawIndirectCount &&
+                         this->m_vulkan->m_physicalDevice->multiDrawIndirect;
+    uint32_t frameCount = this->m_vulkan->MAX_FRAMES_IN_FLIGHT;
+
+    // Create the descriptor set layout (every binding is a storage buffer of the frame's draw buffers)
+    std::array<VkDescriptorSetLayoutBinding, CULLING_BINDING_COUNT> layoutBindings{};
+    for (uint32_t binding = 0; binding < CULLING_BINDING_COUNT; binding++) {
+        layoutBindings[binding].binding = binding;
+        layoutBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[binding].descriptorCount = 1;
+        layoutBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = CULLING_BINDING_COUNT;
+    layoutInfo.pBindings = layoutBindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                  &layoutInfo, nullptr, &this->descriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to create the culling descriptor set layout.");
+        throw std::runtime_error("Failed to create the culling descriptor set layout!");
+    }
+
+    // One descriptor set per frame in flight, pointed at the frame's buffers once they're allocated
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = CULLING_BINDING_COUNT * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = frameCount;
+
+    result = vkCreateDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                    &poolInfo, nullptr, &this->descriptorPool);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to initialize the culling descriptor pool!");
+        throw std::runtime_error("Failed to create the culling descriptor pool instance.");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount, this->descriptorSetLayout);
+    this->descriptorSets.resize(frameCount);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = this->descriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = setLayouts.data();
+
+    result = vkAllocateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                      &allocInfo, this->descriptorSets.data());
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred attempting to allocate the culling descriptor sets!");
+        throw std::runtime_error("Failed to allocate the culling descriptor sets.");
+    }
+
+    // Set 0 is the camera UBO shared with the graphics pipeline (frustum planes), set 1 the draw buffers
+    VkDescriptorSetLayout pipelineSetLayouts[] = {
+            this->m_vulkan->m_descriptorPool->descriptorSetLayout, this->descriptorSetLayout
+    };
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullingConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = pipelineSetLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                    &pipelineLayoutInfo, nullptr, &this->pipelineLayout);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred when initializing the culling pipeline layout instance.");
+        throw std::runtime_error("Failed to create the culling pipeline layout!");
+    }
+    // the two compute pipelines don't depend on each other, both compile at once
+    this->m_vulkan->base->jobManager->_run_parallel(2, this, &CullingPass::createPipelineTask);
+    VULKRAY_LOG_DEBUG("Initialized the GPU culling pass. (draw compaction: {0})", this->compactDraws);
+}
+
+CullingPass::~CullingPass() {
+    vkDestroyPipeline(this->m_vulkan->m_logicalDevice->logicalDevice, this->compactPipeline, nullptr);
+    vkDestroyPipeline(this->m_vulkan->m_logicalDevice->logicalDevice, this->cullPipeline, nullptr);
+    vkDestroyPipelineLayout(this->m_vulkan->m_logicalDevice->logicalDevice, this->pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice, this->descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(this->m_vulkan->m_logicalDevice->logicalDevice, this->descriptorSetLayout, nullptr);
+}
+
+VkPipeline CullingPass::createComputePipeline(const std::string &filename) {
+    auto shaderCode = this->m_vulkan->m_pipelineLibrary->getShaderBinary(filename);
+    VkShaderModule shaderModule = this->m_vulkan->m_graphicsPipeline->createShaderModule(*shaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = this->pipelineLayout;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                               this->m_vulkan->m_pipelineCache->pipelineCache, 1, &pipelineInfo,
+                                               nullptr, &pipeline);
+    vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred when initializing a culling compute pipeline. ({0})", filename);
+        throw std::runtime_error("Failed to create a culling compute pipeline.");
+    }
+    return pipeline;
+}
+
+void CullingPass::createPipelineTask(void *caller, uint32_t index) {
+    auto cullingPass = static_cast<CullingPass*>(caller);
+    if (index == 0) cullingPass->cullPipeline = cullingPass->createComputePipeline(CULLING_CULL_SHADER);
+    else cullingPass->compactPipeline = cullingPass->createComputePipeline(CULLING_COMPACT_SHADER);
+}
+
+/* Points the frame's descriptor set at its (reallocated) draw buffers. Only called after the frame was
+ * waited on, and the command buffers using the set are re-recorded before their next submit.
+ */
+void CullingPass::updateDescriptorSet(uint32_t frameIndex) {
+    GeometryArena::FrameDrawBuffers &frameBuffers = this->m_vulkan->m_geometryArena->frameDrawBuffers[frameIndex];
+    Buffer *buffers[CULLING_BINDING_COUNT] = {
+            frameBuffers.instanceBuffer.get(), frameBuffers.meshBuffer.get(), frameBuffers.drawSlotBuffer.get(),
+            frameBuffers.culledInstanceBuffer.get(), frameBuffers.compactedDrawBuffer.get(),
+            frameBuffers.drawCountBuffer.get()
+    };
+    std::array<VkDescriptorBufferInfo, CULLING_BINDING_COUNT> bufferInfos{};
+    std::array<VkWriteDescriptorSet, CULLING_BINDING_COUNT> descriptorWrites{};
+    for (uint32_t binding = 0; binding < CULLING_BINDING_COUNT; binding++) {
+        bufferInfos[binding].buffer = buffers[binding]->buffer._bufferInstance;
+        bufferInfos[binding].offset = 0;
+        bufferInfos[binding].range = VK_WHOLE_SIZE;
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = this->descriptorSets[frameIndex];
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice,
+                           CULLING_BINDING_COUNT, descriptorWrites.data(), 0, nullptr);
+}
+
+/* Records the culling pass into the frame's command buffer (outside of the render pass):
+ *   1. reset the draw slots (copied from the arena's draw list) & the compacted draw counts
+ *   2. engine_cull.comp: one invocation per instance, appends the visible ones to their LOD's draw slot
+ *   3. engine_compact.comp: one invocation per mesh, packs its non-empty slots to the front of its draw batch
+ * The render pass then draws every batch's compacted draws with a single vkCmdDrawIndexedIndirectCount().
+ */
+void CullingPass::recordCulling(VkCommandBuffer commandBuffer) {
+    GeometryArena::FrameDrawBuffers &frameBuffers =
+            this->m_vulkan->m_geometryArena->frameDrawBuffers[this->m_vulkan->frameIndex];
+    CullingConstants constants{frameBuffers.instanceCount, frameBuffers.drawCount, frameBuffers.meshCount};
+    if (constants.drawCount == 0) return;
+    auto batchCount = static_cast<uint32_t>(this->m_vulkan->drawBatches.size());
+
+    VkBufferCopy region{};
+    region.size = (VkDeviceSize) constants.drawCount * sizeof(VkDrawIndexedIndirectCommand);
+    vkCmdCopyBuffer(commandBuffer, frameBuffers.indirectBuffer->buffer._bufferInstance,
+                    frameBuffers.drawSlotBuffer->buffer._bufferInstance, 1, &region);
+    vkCmdFillBuffer(commandBuffer, frameBuffers.drawCountBuffer->buffer._bufferInstance, 0,
+                    (VkDeviceSize) batchCount * sizeof(uint32_t), 0);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // the camera UBO is bound at this frame's dynamic offset, same as for the graphics pipeline
+    VkDescriptorSet descriptorSets[] = {
+            this->m_vulkan->m_descriptorPool->descriptorSet, this->descriptorSets[this->m_vulkan->frameIndex]
+    };
+    uint32_t dynamicOffset = this->m_vulkan->cameraUniforms.offset;
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 2,
+                            descriptorSets, 1, &dynamicOffset);
+    vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(CullingConstants), &constants);
+
+    if (constants.instanceCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+        vkCmdDispatch(commandBuffer, (constants.instanceCount + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE,
+                      1, 1);
+    }
+    if (this->compactDraws) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->compactPipeline);
+        vkCmdDispatch(commandBuffer, (constants.meshCount + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE,
+                      1, 1);
+    }
+
+    // the draws & surviving instances are read by the render pass
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
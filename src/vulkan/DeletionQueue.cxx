@@ -0,0 +1,40 @@
+/*
+ * DeletionQueue.cxx
+ * Destroys retired Vulkan resources once no frame in flight can still be using them.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+
+DeletionQueue::DeletionQueue(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {}
+
+DeletionQueue::~DeletionQueue() {
+    // the renderer waits for the device to be idle before its modules are destroyed
+    while (!this->retiredResources.empty()) {
+        this->retiredResources.front().destroy();
+        this->retiredResources.pop_front();
+    }
+}
+
+/* Queues up the destruction of a resource the frames recorded so far (including the current one) may be using.
+ * The next graphics submit signals the frame timeline once those are all done (frames complete in order).
+ */
+void DeletionQueue::retire(std::function<void()> destroy) {
+    this->retiredResources.push_back({this->m_vulkan->m_synchronization->getPendingValue(), std::move(destroy)});
+}
+
+/* Destroys everything the frame timeline has passed the value of. Called right after the frame was waited on,
+ * with the timeline's value at that point (frames that finished early free their resources early too).
+ */
+void DeletionQueue::release(uint64_t completedValue) {
+    while (!this->retiredResources.empty() && this->retiredResources.front().timelineValue <= completedValue) {
+        this->retiredResources.front().destroy();
+        this->retiredResources.pop_front();
+    }
+}
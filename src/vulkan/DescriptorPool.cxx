@@ -1,6 +1,6 @@
 /*
  * DescriptorPool.cxx
- * Sets up the descriptor pool for passing UBO data to the graphics pipeline.
+ * Sets up the descriptor pool for passing UBO data to the graphics pipeline & the bindless texture set.
  *
  * VULKRAY ENGINE SOFTWARE
  * Copyright (c) 2023, Max Rodriguez. All rights reserved.
@@ -12,18 +12,19 @@
 
 #include "../../include/Vulkray/Vulkan.h"
 #include <spdlog/spdlog.h>
+#include <array>
 
 DescriptorPool::DescriptorPool(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
     VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 1;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = 1;
     poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+    poolInfo.maxSets = 1;
 
     VkResult result = vkCreateDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice,
                                              &poolInfo, nullptr, &this->descriptorPool);
@@ -35,9 +36,10 @@ DescriptorPool::DescriptorPool(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     // Create the descriptor set layout to use for the pool
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // offset given at bind time
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // Use descriptor only at the vertex stage
+    // Use descriptor at the vertex stage & in the culling pass (frustum planes)
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr; // optional
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
@@ -52,45 +54,186 @@ DescriptorPool::DescriptorPool(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
         throw std::runtime_error("Failed to create descriptor set layout!");
     }
 
-    this->descriptorSets.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
-    std::vector<VkDescriptorSetLayout> layouts(this->m_vulkan->MAX_FRAMES_IN_FLIGHT, this->descriptorSetLayout);
-
-    // Allocate descriptor sets to the descriptor pool
+    /* Allocate a single descriptor set to the descriptor pool. All frames in flight share it,
+     * the UBO of the current frame in the uniform ring is selected by the dynamic offset at bind time.
+     */
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = this->descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &this->descriptorSetLayout;
 
     result = vkAllocateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice,
-                                      &allocInfo, this->descriptorSets.data());
+                                      &allocInfo, &this->descriptorSet);
     if (result != VK_SUCCESS) {
         spdlog::error("An error occurred attempting to allocate descriptor sets to the descriptor pool!");
         throw std::runtime_error("Failed to allocate descriptor sets.");
     }
 
-    // Configure all descriptor buffers in the pool
-    for (size_t i = 0; i < this->m_vulkan->MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = this->m_vulkan->m_uniformBuffers.at(i)->buffer._bufferInstance;
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-        // Update the descriptor set
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = this->descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-        descriptorWrite.pImageInfo = nullptr; // optional
-        descriptorWrite.pTexelBufferView = nullptr; // optional
-        vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+    // Point the descriptor at the uniform ring buffer
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = this->m_vulkan->m_uniformRing->buffer._bufferInstance;
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
+    // Update the descriptor set
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = this->descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    descriptorWrite.pImageInfo = nullptr; // optional
+    descriptorWrite.pTexelBufferView = nullptr; // optional
+    vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+    this->bindless = this->m_vulkan->m_physicalDevice->descriptorIndexing;
+    if (this->bindless) {
+        this->createBindlessSet();
+    } else {
+        spdlog::info("The GPU doesn't support descriptor indexing, meshes are drawn without their textures.");
     }
 }
 
 DescriptorPool::~DescriptorPool() {
     vkDestroyDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice, this->descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(this->m_vulkan->m_logicalDevice->logicalDevice, this->descriptorSetLayout, nullptr);
+    if (this->bindless) {
+        vkDestroyDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice, this->bindlessPool, nullptr);
+        vkDestroyDescriptorSetLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                     this->bindlessSetLayout, nullptr);
+    }
+}
+
+/* The bindless set is allocated once and never rebound, its array elements are written while frames using
+ * other elements are in flight (update after bind, unused while pending). Elements nothing was written to
+ * are never read by the shaders (partially bound).
+ */
+void DescriptorPool::createBindlessSet() {
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_SAMPLER, 1};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, BINDLESS_MAX_TEXTURES};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, BINDLESS_MAX_STORAGE_BUFFERS};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    VkResult result = vkCreateDescriptorPool(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                             &poolInfo, nullptr, &this->bindlessPool);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to initialize the bindless descriptor pool!");
+        throw std::runtime_error("Failed to create the bindless descriptor pool instance.");
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER; // written once, before anything is drawn
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[1].descriptorCount = BINDLESS_MAX_TEXTURES;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = BINDLESS_MAX_STORAGE_BUFFERS;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorBindingFlags arrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    std::array<VkDescriptorBindingFlags, 3> bindingFlags = {0, arrayFlags, arrayFlags};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    result = vkCreateDescriptorSetLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                         &layoutInfo, nullptr, &this->bindlessSetLayout);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to create the bindless descriptor set layout.");
+        throw std::runtime_error("Failed to create the bindless descriptor set layout!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = this->bindlessPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &this->bindlessSetLayout;
+
+    result = vkAllocateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                      &allocInfo, &this->bindlessSet);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred attempting to allocate the bindless descriptor set!");
+        throw std::runtime_error("Failed to allocate the bindless descriptor set.");
+    }
+}
+
+uint32_t DescriptorPool::allocateTextureIndex() {
+    if (!this->freeTextureIndices.empty()) {
+        uint32_t index = this->freeTextureIndices.back();
+        this->freeTextureIndices.pop_back();
+        return index;
+    }
+    if (this->textureIndexCount == BINDLESS_MAX_TEXTURES) return BINDLESS_NO_TEXTURE;
+    return this->textureIndexCount++;
+}
+
+void DescriptorPool::freeTextureIndex(uint32_t index) {
+    if (index != BINDLESS_NO_TEXTURE) this->freeTextureIndices.push_back(index);
+}
+
+void DescriptorPool::writeSampler(VkSampler sampler) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = this->bindlessSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void DescriptorPool::writeTexture(uint32_t index, VkImageView imageView) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = this->bindlessSet;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void DescriptorPool::writeStorageBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = range;
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = this->bindlessSet;
+    descriptorWrite.dstBinding = 2;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(this->m_vulkan->m_logicalDevice->logicalDevice, 1, &descriptorWrite, 0, nullptr);
 }
\ No newline at end of file
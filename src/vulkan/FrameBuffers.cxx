@@ -16,39 +16,48 @@
 
 FrameBuffers::FrameBuffers(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
-    // resize frame buffer vector to image views count
-    this->swapChainFrameBuffers.resize(this->m_vulkan->m_imageViews->swapChainImageViews.size());
-
-    for (size_t i = 0; i < this->m_vulkan->m_imageViews->swapChainImageViews.size(); i++) {
-
-        std::array<VkImageView, 3> attachments = {
-                this->m_vulkan->m_MSAA->msaaImageView, // color attachment resolve (multi-sampling/MSAA)
-                this->m_vulkan->m_depthTesting->depthImageView, // depth attachment (depth testing)
-                this->m_vulkan->m_imageViews->swapChainImageViews[i] // color attachment (fragment render)
-        };
-        VkFramebufferCreateInfo framebufferInfo{};
-
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = this->m_vulkan->m_renderPass->renderPass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = this->m_vulkan->m_swapChain->swapChainExtent.width;
-        framebufferInfo.height = this->m_vulkan->m_swapChain->swapChainExtent.height;
-        framebufferInfo.layers = 1;
-
-        VkResult result = vkCreateFramebuffer(this->m_vulkan->m_logicalDevice->logicalDevice,
-                                              &framebufferInfo, nullptr, &this->swapChainFrameBuffers.at(i));
-        if (result != VK_SUCCESS) {
-            spdlog::error("Failed to create the Vulkan framebuffer instances; Exiting.");
-            throw std::runtime_error("Failed to create the framebuffer instances!");
+    // one frame buffer per swap image for every render pass of the render graph
+    const RenderGraphPlan &plan = this->m_vulkan->m_renderPass->plan;
+    size_t swapImageCount = this->m_vulkan->m_imageViews->swapChainImageViews.size();
+    this->groupFrameBuffers.resize(plan.groups.size());
+    for (size_t group = 0; group < plan.groups.size(); group++) {
+        VkRenderPass groupRenderPass = this->m_vulkan->m_renderPass->renderPasses[group];
+        if (groupRenderPass == VK_NULL_HANDLE) continue; // compute & transfer groups don't draw
+        this->groupFrameBuffers[group].resize(swapImageCount, VK_NULL_HANDLE);
+
+        for (size_t i = 0; i < swapImageCount; i++) {
+            // the plan's attachments, the swap image's view for the imported frame image
+            std::vector<VkImageView> attachments;
+            for (const RenderAttachmentPlan &attachment : plan.groups[group].attachments) {
+                attachments.push_back(attachment.image == this->m_vulkan->m_renderPass->frameImage
+                                      ? this->m_vulkan->m_imageViews->swapChainImageViews[i]
+                                      : this->m_vulkan->m_renderTargets->getImageView(attachment.image));
+            }
+            VkFramebufferCreateInfo framebufferInfo{};
+
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = groupRenderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = this->m_vulkan->m_swapChain->swapChainExtent.width;
+            framebufferInfo.height = this->m_vulkan->m_swapChain->swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            VkResult result = vkCreateFramebuffer(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                  &framebufferInfo, nullptr, &this->groupFrameBuffers[group].at(i));
+            if (result != VK_SUCCESS) {
+                spdlog::error("Failed to create the Vulkan framebuffer instances; Exiting.");
+                throw std::runtime_error("Failed to create the framebuffer instances!");
+            }
         }
     }
 }
 
 FrameBuffers::~FrameBuffers() {
-    for (size_t i = 0; i < this->swapChainFrameBuffers.size(); i++) {
-        vkDestroyFramebuffer(this->m_vulkan->m_logicalDevice->logicalDevice,
-                             this->swapChainFrameBuffers[i], nullptr);
-        this->swapChainFrameBuffers[i] = VK_NULL_HANDLE; // less validation layer errors on clean up
+    for (std::vector<VkFramebuffer> &frameBuffers : this->groupFrameBuffers) {
+        for (size_t i = 0; i < frameBuffers.size(); i++) {
+            vkDestroyFramebuffer(this->m_vulkan->m_logicalDevice->logicalDevice, frameBuffers[i], nullptr);
+            frameBuffers[i] = VK_NULL_HANDLE; // less validation layer errors on clean up
+        }
     }
-}
\ No newline at end of file
+}
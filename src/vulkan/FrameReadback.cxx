@@ -0,0 +1,103 @@
+/*
+ * FrameReadback.cxx
+ * Reads headless frames back from the GPU through a ring of host visible buffers.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <vk_mem_alloc.h>
+
+FrameReadback::FrameReadback(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    this->readbackSlots.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT); // buffers are allocated by recordCopy()
+}
+
+FrameReadback::~FrameReadback() = default; // pending frames are collected by the render loop on exit
+
+VkDeviceSize FrameReadback::frameSize(VkExtent2D extent) {
+    return (VkDeviceSize) extent.width * extent.height * 4; // HEADLESS_COLOR_FORMAT is 4 bytes a pixel
+}
+
+/* Copies the frame's offscreen image into its frame in flight's readback buffer. The slot was collected
+ * right after the frame was waited on, so a buffer too small for resized images can be swapped out here.
+ */
+void FrameReadback::recordCopy(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    ReadbackSlot &slot = this->readbackSlots[this->m_vulkan->frameIndex];
+    VkDeviceSize size = FrameReadback::frameSize(this->m_vulkan->m_swapChain->swapChainExtent);
+    if (slot.buffer == nullptr || slot.buffer->size < size) {
+        // other cached command buffers of the frame may still reference the old one (they're re-recorded first)
+        if (slot.buffer != nullptr) this->m_vulkan->m_deletionQueue->retire(std::move(slot.buffer));
+        // random access, so the driver picks cached host memory (the CPU reads every byte of the buffers)
+        slot.buffer = std::make_unique<Buffer>(this->m_vulkan, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size,
+                                               VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                                               VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    }
+
+    // the render graph left the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL (the scene pass' final layout)
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {this->m_vulkan->m_swapChain->swapChainExtent.width,
+                          this->m_vulkan->m_swapChain->swapChainExtent.height, 1};
+    Buffer *readbackBuffer = slot.buffer.get();
+    vkCmdCopyImageToBuffer(commandBuffer, this->m_vulkan->m_swapChain->swapChainImages[imageIndex],
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer->buffer._bufferInstance, 1, &region);
+
+    // make the copy visible to the host reads done after the frame was waited on
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = readbackBuffer->buffer._bufferInstance;
+    hostBarrier.offset = 0;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &hostBarrier, 0, nullptr);
+}
+
+void FrameReadback::frameSubmitted(uint32_t frameIndex, uint64_t frameNumber) {
+    this->readbackSlots[frameIndex].frameNumber = frameNumber;
+    this->readbackSlots[frameIndex].extent = this->m_vulkan->m_swapChain->swapChainExtent;
+    this->readbackSlots[frameIndex].pending = true;
+}
+
+// Hands the frame last submitted with this frame index to the frame callback
+void FrameReadback::collectFrame(uint32_t frameIndex) {
+    ReadbackSlot &slot = this->readbackSlots[frameIndex];
+    if (!slot.pending) return;
+    slot.pending = false;
+    EngineConfig &config = this->m_vulkan->base->config;
+    if (config.headlessFrameCallback == nullptr) return;
+
+    // only does anything on non-coherent memory
+    vmaInvalidateAllocation(this->m_vulkan->m_VMA->memoryAllocator, slot.buffer->buffer._bufferMemory,
+                            0, VK_WHOLE_SIZE);
+    HeadlessFrame frame{};
+    frame.frameNumber = slot.frameNumber;
+    frame.width = slot.extent.width;
+    frame.height = slot.extent.height;
+    frame.format = this->m_vulkan->m_swapChain->swapChainImageFormat;
+    frame.pixels = static_cast<const uint8_t*>(slot.buffer->mappedData);
+    config.headlessFrameCallback(config.headlessFrameCaller, this->m_vulkan->base, frame);
+}
+
+// The last frames in flight, handed out oldest first
+void FrameReadback::collectAll() {
+    for (uint32_t i = 0; i < this->readbackSlots.size(); i++) {
+        this->collectFrame((this->m_vulkan->frameIndex + i) % this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+    }
+}
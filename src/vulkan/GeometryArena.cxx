@@ -0,0 +1,537 @@
+/*
+ * GeometryArena.cxx
+ * Suballocates the registered meshes from shared vertex & index buffers and builds their indirect draws.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include "../../include/Vulkray/MeshRegistry.h"
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+
+const uint32_t MIN_FRAME_DRAW_CAPACITY = 64; // smallest instance/draw count the per-frame buffers are sized for
+
+const uint32_t VERTEX_ARENA_UNIT = 4; // bytes per vertex allocator unit (every vertex stride is a multiple of it)
+const uint32_t INDEX_ARENA_UNIT = 2; // bytes per index allocator unit (a 16 bit index)
+
+static uint32_t indexUnits(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? 1 : 2;
+}
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    this->capacity = capacity;
+    if (capacity > 0) this->freeRanges[0] = capacity;
+}
+
+// The space a range skips to get aligned stays free (it's in front of the allocation)
+bool RangeAllocator::allocate(uint32_t count, uint32_t *offset, uint32_t alignment) {
+    for (auto range = this->freeRanges.begin(); range != this->freeRanges.end(); range++) {
+        uint32_t rangeStart = range->first;
+        uint32_t rangeEnd = range->first + range->second;
+        uint32_t start = (rangeStart + alignment - 1) / alignment * alignment;
+        if (start > rangeEnd || rangeEnd - start < count) continue;
+        this->freeRanges.erase(range);
+        if (start > rangeStart) this->freeRanges[rangeStart] = start - rangeStart;
+        if (rangeEnd > start + count) this->freeRanges[start + count] = rangeEnd - start - count;
+        *offset = start;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+    if (count == 0) return;
+    auto next = this->freeRanges.lower_bound(offset);
+    // merge with the following free range
+    if (next != this->freeRanges.end() && offset + count == next->first) {
+        count += next->second;
+        next = this->freeRanges.erase(next);
+    }
+    // merge with the preceding free range
+    if (next != this->freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += count;
+            return;
+        }
+    }
+    this->freeRanges[offset] = count;
+}
+
+// The capacities are in default format vertices & 32 bit indices, compact meshes fit more of theirs
+GeometryArena::GeometryArena(Vulkan *m_vulkan, uint32_t vertexCapacity, uint32_t indexCapacity):
+        VkModuleBase(m_vulkan),
+        vertexRanges(vertexCapacity * (vertexformat::get_stride(VERTEX_FORMAT_DEFAULT) / VERTEX_ARENA_UNIT)),
+        indexRanges(indexCapacity * indexUnits(VK_INDEX_TYPE_UINT32)) {
+    // allocated once for the renderer's whole lifetime, they get memory of their own (meshes are ranges of them)
+    const VmaAllocationCreateFlags dedicated = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    this->vertexBuffer = std::make_unique<Buffer>(this->m_vulkan, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                  (VkDeviceSize) this->vertexRanges.capacity * VERTEX_ARENA_UNIT,
+                                                  dedicated, MEMORY_POOL_DEFAULT, true);
+    this->indexBuffer = std::make_unique<Buffer>(this->m_vulkan, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                 (VkDeviceSize) this->indexRanges.capacity * INDEX_ARENA_UNIT,
+                                                 dedicated, MEMORY_POOL_DEFAULT, true);
+    this->frameDrawBuffers.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT); // buffers allocated when first written
+}
+
+GeometryArena::~GeometryArena() {
+    // placeholder (the renderer waits for the device to be idle before the arena buffers are destroyed)
+}
+
+/* Applies the mesh registry's queued operations in the order they were made, then sends the uploads out
+ * in one batch. Called by the render thread right after the frame was waited on.
+ */
+bool GeometryArena::applyPendingOperations(uint64_t completedValue, uint64_t lastTick) {
+    this->releaseDeferredFrees(completedValue);
+    this->m_vulkan->base->meshes->_take_pending_operations(this->operations, lastTick);
+    if (this->operations.empty()) return false;
+
+    // ranges replaced now may still be drawn from by the frames submitted so far
+    uint64_t timelineValue = this->m_vulkan->m_synchronization->getPendingValue();
+
+    for (MeshOperation &operation : this->operations) {
+        switch (operation.type) {
+            case MESH_OPERATION_ADD:
+                this->addMesh(operation);
+                break;
+            case MESH_OPERATION_UPDATE:
+                this->updateMesh(operation, timelineValue);
+                break;
+            case MESH_OPERATION_REMOVE:
+                this->removeMesh(operation, timelineValue);
+                break;
+            case MESH_OPERATION_SET_INSTANCES:
+                this->setMeshInstances(operation);
+                break;
+            case MESH_OPERATION_SET_LODS:
+                this->setMeshLods(operation, timelineValue);
+                break;
+            case MESH_OPERATION_SET_PIPELINE:
+                this->setMeshPipeline(operation);
+                break;
+        }
+    }
+    this->operations.clear();
+    this->flushUploads(); // the frame's submit waits on the upload queue's timeline before reading vertices
+    return this->rebuildDrawCommands();
+}
+
+/* Copies the draw list & instances into this frame's host visible buffers (if they changed since the frame
+ * in flight last used them). Called after the frame was waited on, so the GPU is done reading them.
+ */
+bool GeometryArena::writeFrameDraws(uint32_t frameIndex) {
+    FrameDrawBuffers &frameBuffers = this->frameDrawBuffers[frameIndex];
+    if (frameBuffers.drawVersion == this->drawVersion) return false;
+
+    const VmaAllocationCreateFlags hostWrites = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    const VkDeviceSize minimumInstances = MIN_FRAME_DRAW_CAPACITY * sizeof(InstanceData);
+    const VkDeviceSize minimumDraws = MIN_FRAME_DRAW_CAPACITY * sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize instanceSize = this->instances.size() * sizeof(InstanceData);
+    VkDeviceSize indirectSize = this->m_vulkan->drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+    bool reallocated = false;
+    reallocated |= this->reserveBuffer(frameBuffers.instanceBuffer,
+                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       instanceSize, minimumInstances, hostWrites);
+    reallocated |= this->reserveBuffer(frameBuffers.indirectBuffer, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                       indirectSize, minimumDraws, hostWrites);
+    memcpy(frameBuffers.instanceBuffer->mappedData, this->instances.data(), (size_t) instanceSize);
+    memcpy(frameBuffers.indirectBuffer->mappedData, this->m_vulkan->drawCommands.data(), (size_t) indirectSize);
+    // no-ops on host coherent memory
+    vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator,
+                       frameBuffers.instanceBuffer->buffer._bufferMemory, 0, instanceSize);
+    vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator,
+                       frameBuffers.indirectBuffer->buffer._bufferMemory, 0, indirectSize);
+
+    if (this->m_vulkan->m_cullingPass != nullptr) {
+        // the culling pass' outputs stay on the GPU, only the mesh data is written from here
+        VkDeviceSize meshSize = this->cullMeshes.size() * sizeof(MeshCullData);
+        VkDeviceSize culledSize = (VkDeviceSize) this->culledInstanceCapacity * sizeof(InstanceData);
+        reallocated |= this->reserveBuffer(frameBuffers.meshBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshSize,
+                                           MIN_FRAME_DRAW_CAPACITY * sizeof(MeshCullData), hostWrites);
+        reallocated |= this->reserveBuffer(frameBuffers.drawSlotBuffer,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                           indirectSize, minimumDraws, 0);
+        reallocated |= this->reserveBuffer(frameBuffers.culledInstanceBuffer,
+                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                           culledSize, minimumInstances, 0);
+        reallocated |= this->reserveBuffer(frameBuffers.compactedDrawBuffer,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                           indirectSize, minimumDraws, 0);
+        reallocated |= this->reserveBuffer(frameBuffers.drawCountBuffer,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                           this->m_vulkan->drawBatches.size() * sizeof(uint32_t),
+                                           MIN_FRAME_DRAW_CAPACITY * sizeof(uint32_t), 0);
+        memcpy(frameBuffers.meshBuffer->mappedData, this->cullMeshes.data(), (size_t) meshSize);
+        vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator,
+                           frameBuffers.meshBuffer->buffer._bufferMemory, 0, meshSize);
+    }
+    frameBuffers.instanceCount = static_cast<uint32_t>(this->instances.size());
+    frameBuffers.drawCount = static_cast<uint32_t>(this->m_vulkan->drawCommands.size());
+    frameBuffers.meshCount = static_cast<uint32_t>(this->cullMeshes.size());
+    frameBuffers.drawVersion = this->drawVersion;
+    return reallocated;
+}
+
+// Grows the buffer to the next power of two above the size, so a slowly growing scene doesn't reallocate every frame
+bool GeometryArena::reserveBuffer(std::unique_ptr<Buffer> &buffer, VkBufferUsageFlags usage, VkDeviceSize size,
+                                  VkDeviceSize minimumSize, VmaAllocationCreateFlags allocationFlags) {
+    if (buffer != nullptr && buffer->size >= size) return false;
+    VkDeviceSize capacity = minimumSize;
+    while (capacity < size) capacity *= 2;
+    buffer = std::make_unique<Buffer>(this->m_vulkan, usage, capacity, allocationFlags, MEMORY_POOL_FRAME);
+    return true;
+}
+
+// Meshes from assets are already packed the way the arena stores them, their blocks are uploaded as they are
+void GeometryArena::addMesh(MeshOperation &operation) {
+    const MeshAssetView *assetMesh = nullptr;
+    if (operation.asset != nullptr) assetMesh = &operation.asset->get_mesh(operation.assetMesh);
+    MeshAllocation allocation{};
+    allocation.generation = operation.mesh.generation;
+    allocation.vertexFormat = operation.vertexFormat;
+    allocation.vertexStride = vertexformat::get_stride(operation.vertexFormat);
+    if (assetMesh != nullptr) {
+        allocation.vertexCount = assetMesh->vertexCount;
+        allocation.indexCount = assetMesh->indexCount;
+        allocation.indexType = assetMesh->indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    } else {
+        allocation.vertexCount = static_cast<uint32_t>(operation.vertexData.size() / allocation.vertexStride);
+        allocation.indexCount = static_cast<uint32_t>(operation.indices.size());
+        allocation.indexType = allocation.vertexCount <= VERTEX_MAX_NARROW_INDEX_VERTICES ? VK_INDEX_TYPE_UINT16
+                                                                                          : VK_INDEX_TYPE_UINT32;
+    }
+    allocation.quantization = operation.quantization;
+    allocation.boundingSphere = operation.boundingSphere;
+    PipelineState pipeline; // the default pipeline (of the mesh's vertex format)
+    pipeline.vertexFormat = allocation.vertexFormat;
+    if (this->m_vulkan->m_descriptorPool->bindless &&
+        vertexformat::has_attribute(allocation.vertexFormat, VERTEX_ATTRIBUTE_UV)) {
+        // meshes with texture coordinates sample their material's texture from the bindless set
+        pipeline.vertexShader = "shaders/engine_textured.vert.spv";
+        pipeline.fragmentShader = "shaders/engine_textured.frag.spv";
+    }
+    allocation.pipelineKey = this->m_vulkan->m_pipelineLibrary->requestPipeline(pipeline);
+
+    uint32_t vertexUnits = allocation.vertexStride / VERTEX_ARENA_UNIT;
+    uint32_t vertexUnit;
+    if (!this->vertexRanges.allocate(allocation.vertexCount * vertexUnits, &vertexUnit, vertexUnits)) {
+        spdlog::error("Out of vertex arena space for a mesh of {0} vertices. (capacity: {1} bytes)",
+                      allocation.vertexCount, (uint64_t) this->vertexRanges.capacity * VERTEX_ARENA_UNIT);
+        throw std::runtime_error("Failed to allocate the mesh's vertices from the geometry arena!");
+    }
+    allocation.vertexOffset = vertexUnit / vertexUnits;
+    if (!this->allocateIndices(allocation, allocation.indexCount, &allocation.firstIndex)) {
+        this->vertexRanges.free(vertexUnit, allocation.vertexCount * vertexUnits);
+        spdlog::error("Out of index arena space for a mesh of {0} indices. (capacity: {1} bytes)",
+                      allocation.indexCount, (uint64_t) this->indexRanges.capacity * INDEX_ARENA_UNIT);
+        throw std::runtime_error("Failed to allocate the mesh's indices from the geometry arena!");
+    }
+    if (operation.mesh.index >= this->meshAllocations.size()) this->meshAllocations.resize(operation.mesh.index + 1);
+    this->meshAllocations[operation.mesh.index] = allocation;
+
+    // fresh ranges aren't drawn from by any frame in flight, so they can be written right away
+    UploadQueue *uploadQueue = this->m_vulkan->m_uploadQueue.get();
+    VkDeviceSize vertexStart = (VkDeviceSize) allocation.vertexOffset * allocation.vertexStride;
+    VkDeviceSize vertexSize = (VkDeviceSize) allocation.vertexCount * allocation.vertexStride;
+    if (assetMesh == nullptr) {
+        uploadQueue->enqueueBufferUpload(this->vertexBuffer->buffer._bufferInstance, vertexStart,
+                                         operation.vertexData.data(), vertexSize, false);
+        this->uploadIndices(allocation, allocation.firstIndex, operation.indices);
+        return;
+    }
+    VkDeviceSize indexSize = assetMesh->indexSize;
+    uploadQueue->enqueueBufferUpload(this->vertexBuffer->buffer._bufferInstance, vertexStart,
+                                     assetMesh->vertexData, vertexSize, false);
+    uploadQueue->enqueueBufferUpload(this->indexBuffer->buffer._bufferInstance, allocation.firstIndex * indexSize,
+                                     assetMesh->indexData, allocation.indexCount * indexSize, false);
+}
+
+// Index ranges start on a whole index of the mesh's index type, firstIndex is counted in those
+bool GeometryArena::allocateIndices(const MeshAllocation &allocation, uint32_t indexCount, uint32_t *firstIndex) {
+    uint32_t units = indexUnits(allocation.indexType);
+    uint32_t offset;
+    if (!this->indexRanges.allocate(indexCount * units, &offset, units)) return false;
+    *firstIndex = offset / units;
+    return true;
+}
+
+void GeometryArena::uploadIndices(const MeshAllocation &allocation, uint32_t firstIndex,
+                                  const std::vector<uint32_t> &indices) {
+    VkBuffer indexBuffer = this->indexBuffer->buffer._bufferInstance;
+    if (allocation.indexType == VK_INDEX_TYPE_UINT32) {
+        this->m_vulkan->m_uploadQueue->enqueueBufferUpload(indexBuffer, (VkDeviceSize) firstIndex * sizeof(uint32_t),
+                                                           indices.data(),
+                                                           (VkDeviceSize) indices.size() * sizeof(uint32_t), false);
+        return;
+    }
+    // the upload queue copies the data into its staging ring, so the scratch buffer is free again right after
+    this->narrowedIndices.assign(indices.begin(), indices.end());
+    this->m_vulkan->m_uploadQueue->enqueueBufferUpload(indexBuffer, (VkDeviceSize) firstIndex * sizeof(uint16_t),
+                                                       this->narrowedIndices.data(),
+                                                       (VkDeviceSize) indices.size() * sizeof(uint16_t), false);
+}
+
+/* Frames in flight may still be drawing the mesh's current vertices, so updates are copy-on-write:
+ * the mesh moves to a new vertex range, the untouched vertices are copied over on the GPU and only the
+ * updated ones are uploaded. The old range is freed once no frame in flight can use it anymore.
+ */
+void GeometryArena::updateMesh(MeshOperation &operation, uint64_t timelineValue) {
+    MeshAllocation &allocation = this->meshAllocations[operation.mesh.index];
+    if (allocation.generation != operation.mesh.generation) return; // removed again in the same batch
+    // the mesh's current range is still being filled by this batch's copies, send those out first
+    if (allocation.copyBatch == this->uploadBatch) this->flushUploads();
+
+    uint32_t vertexUnits = allocation.vertexStride / VERTEX_ARENA_UNIT;
+    uint32_t vertexUnit;
+    if (!this->vertexRanges.allocate(allocation.vertexCount * vertexUnits, &vertexUnit, vertexUnits)) {
+        spdlog::error("Out of vertex arena space while updating a mesh of {0} vertices. (capacity: {1} bytes)",
+                      allocation.vertexCount, (uint64_t) this->vertexRanges.capacity * VERTEX_ARENA_UNIT);
+        throw std::runtime_error("Failed to allocate the updated mesh's vertices from the geometry arena!");
+    }
+    uint32_t vertexOffset = vertexUnit / vertexUnits;
+    VkBuffer vertexBuffer = this->vertexBuffer->buffer._bufferInstance;
+    VkDeviceSize stride = allocation.vertexStride;
+    auto updatedCount = static_cast<uint32_t>(operation.vertexData.size() / stride);
+    uint32_t suffixStart = operation.firstVertex + updatedCount;
+
+    if (operation.firstVertex > 0) { // vertices before the updated range
+        VkBufferCopy region{};
+        region.srcOffset = (VkDeviceSize) allocation.vertexOffset * stride;
+        region.dstOffset = (VkDeviceSize) vertexOffset * stride;
+        region.size = (VkDeviceSize) operation.firstVertex * stride;
+        this->m_vulkan->m_uploadQueue->enqueueBufferCopy(vertexBuffer, vertexBuffer, region);
+    }
+    if (suffixStart < allocation.vertexCount) { // vertices after the updated range
+        VkBufferCopy region{};
+        region.srcOffset = (VkDeviceSize) (allocation.vertexOffset + suffixStart) * stride;
+        region.dstOffset = (VkDeviceSize) (vertexOffset + suffixStart) * stride;
+        region.size = (VkDeviceSize) (allocation.vertexCount - suffixStart) * stride;
+        this->m_vulkan->m_uploadQueue->enqueueBufferCopy(vertexBuffer, vertexBuffer, region);
+    }
+    this->m_vulkan->m_uploadQueue->enqueueBufferUpload(
+            vertexBuffer, (VkDeviceSize) (vertexOffset + operation.firstVertex) * stride,
+            operation.vertexData.data(), (VkDeviceSize) operation.vertexData.size(), false);
+    allocation.boundingSphere = operation.boundingSphere; // grown by the registry
+
+    this->deferredFrees.push_back({timelineValue, allocation.vertexOffset * vertexUnits,
+                                   allocation.vertexCount * vertexUnits, 0, 0});
+    allocation.vertexOffset = vertexOffset;
+    allocation.copyBatch = this->uploadBatch;
+}
+
+void GeometryArena::removeMesh(MeshOperation &operation, uint64_t timelineValue) {
+    MeshAllocation &allocation = this->meshAllocations[operation.mesh.index];
+    if (allocation.generation != operation.mesh.generation) return;
+    uint32_t vertexUnits = allocation.vertexStride / VERTEX_ARENA_UNIT;
+    uint32_t units = indexUnits(allocation.indexType);
+    this->deferredFrees.push_back({timelineValue, allocation.vertexOffset * vertexUnits,
+                                   allocation.vertexCount * vertexUnits,
+                                   allocation.firstIndex * units, allocation.indexCount * units});
+    for (const LodRange &lod : allocation.lods) {
+        this->deferredFrees.push_back({timelineValue, 0, 0, lod.firstIndex * units, lod.indexCount * units});
+    }
+    allocation.lods.clear();
+    allocation.generation = 0;
+    allocation.customInstances = false;
+    allocation.instances.clear();
+}
+
+void GeometryArena::setMeshInstances(MeshOperation &operation) {
+    MeshAllocation &allocation = this->meshAllocations[operation.mesh.index];
+    if (allocation.generation != operation.mesh.generation) return;
+    allocation.customInstances = true;
+    allocation.instances.swap(operation.instances);
+}
+
+// LODs index into the mesh's vertex range, so they're unaffected by (copy-on-write) vertex updates
+void GeometryArena::setMeshLods(MeshOperation &operation, uint64_t timelineValue) {
+    MeshAllocation &allocation = this->meshAllocations[operation.mesh.index];
+    if (allocation.generation != operation.mesh.generation) return;
+    // frames in flight may still be drawing the current LODs
+    uint32_t units = indexUnits(allocation.indexType);
+    for (const LodRange &lod : allocation.lods) {
+        this->deferredFrees.push_back({timelineValue, 0, 0, lod.firstIndex * units, lod.indexCount * units});
+    }
+    allocation.lods.clear();
+
+    for (const MeshLod &lod : operation.lods) {
+        LodRange range{};
+        range.indexCount = static_cast<uint32_t>(lod.indices.size());
+        range.distance = lod.distance;
+        if (!this->allocateIndices(allocation, range.indexCount, &range.firstIndex)) {
+            spdlog::error("Out of index arena space for a mesh LOD of {0} indices. (capacity: {1} bytes)",
+                          range.indexCount, (uint64_t) this->indexRanges.capacity * INDEX_ARENA_UNIT);
+            throw std::runtime_error("Failed to allocate the mesh LOD's indices from the geometry arena!");
+        }
+        this->uploadIndices(allocation, range.firstIndex, lod.indices);
+        allocation.lods.push_back(range);
+    }
+}
+
+/* Only the key is kept, draws use the default pipeline (of the mesh's vertex format) until the library
+ * finished compiling the variant
+ */
+void GeometryArena::setMeshPipeline(MeshOperation &operation) {
+    MeshAllocation &allocation = this->meshAllocations[operation.mesh.index];
+    if (allocation.generation != operation.mesh.generation) return;
+    PipelineState pipeline = operation.pipeline.value();
+    pipeline.vertexFormat = allocation.vertexFormat;
+    allocation.pipelineKey = this->m_vulkan->m_pipelineLibrary->requestPipeline(pipeline);
+}
+
+// Returns the ranges no frame in flight can still draw from (the frame timeline passed their value) to the allocators
+void GeometryArena::releaseDeferredFrees(uint64_t completedValue) {
+    while (!this->deferredFrees.empty() && this->deferredFrees.front().timelineValue <= completedValue) {
+        const DeferredFree &range = this->deferredFrees.front();
+        this->vertexRanges.free(range.vertexOffset, range.vertexSize);
+        this->indexRanges.free(range.indexOffset, range.indexSize);
+        this->deferredFrees.pop_front();
+    }
+}
+
+void GeometryArena::flushUploads() {
+    this->m_vulkan->m_uploadQueue->flush();
+    this->uploadBatch++;
+}
+
+/* One indirect draw per live mesh covering all of its instances, so thousands of objects sharing a mesh
+ * cost a single draw. With GPU culling every LOD of the mesh gets an empty draw slot instead, the culling pass
+ * fills in the instances that survived. Draws are sorted by pipeline variant & index type, each run of them is
+ * a draw batch recorded with one pipeline (& index buffer) bind. Quantized meshes get their dequantization
+ * folded into their instance transforms, so their bounding spheres are tested in the quantized space.
+ * Returns true when the draw count (or with GPU culling, the instance count the culling dispatch is sized by)
+ * or the batches changed, those are recorded into the command buffers.
+ */
+bool GeometryArena::rebuildDrawCommands() {
+    static const InstanceData defaultInstance = {glm::mat4(1.0f), 0};
+    std::vector<VkDrawIndexedIndirectCommand> &drawCommands = this->m_vulkan->drawCommands;
+    std::vector<DrawBatch> &drawBatches = this->m_vulkan->drawBatches;
+    bool gpuCulling = this->m_vulkan->m_cullingPass != nullptr;
+    size_t previousDrawCount = drawCommands.size();
+    size_t previousInstanceCount = this->instances.size();
+    std::vector<DrawBatch> previousBatches = drawBatches;
+    drawCommands.clear();
+    drawBatches.clear();
+    this->instances.clear();
+    this->cullMeshes.clear();
+    this->culledInstanceCapacity = 0;
+
+    this->drawOrder.clear();
+    for (uint32_t slot = 0; slot < this->meshAllocations.size(); slot++) {
+        const MeshAllocation &allocation = this->meshAllocations[slot];
+        if (allocation.generation == 0) continue;
+        if (allocation.customInstances && allocation.instances.empty()) continue; // hidden
+        this->drawOrder.push_back(slot);
+    }
+    std::stable_sort(this->drawOrder.begin(), this->drawOrder.end(), [this](uint32_t first, uint32_t second) {
+        const MeshAllocation &firstMesh = this->meshAllocations[first];
+        const MeshAllocation &secondMesh = this->meshAllocations[second];
+        if (firstMesh.pipelineKey != secondMesh.pipelineKey) return firstMesh.pipelineKey < secondMesh.pipelineKey;
+        return firstMesh.indexType < secondMesh.indexType;
+    });
+
+    for (uint32_t slot : this->drawOrder) {
+        const MeshAllocation &allocation = this->meshAllocations[slot];
+        if (drawBatches.empty() || drawBatches.back().pipelineKey != allocation.pipelineKey ||
+            drawBatches.back().indexType != allocation.indexType) {
+            drawBatches.push_back({allocation.pipelineKey, allocation.indexType,
+                                   static_cast<uint32_t>(drawCommands.size()), 0});
+        }
+
+        auto firstInstance = static_cast<uint32_t>(this->instances.size());
+        if (allocation.customInstances) {
+            this->instances.insert(this->instances.end(), allocation.instances.begin(), allocation.instances.end());
+        } else {
+            this->instances.push_back(defaultInstance);
+        }
+        auto instanceCount = static_cast<uint32_t>(this->instances.size()) - firstInstance;
+        bool quantized = (allocation.vertexFormat & VERTEX_FORMAT_QUANTIZED) != 0;
+        if (quantized) {
+            glm::mat4 dequantization = allocation.quantization.get_dequantization_matrix();
+            for (uint32_t instance = firstInstance; instance < this->instances.size(); instance++) {
+                this->instances[instance].model = this->instances[instance].model * dequantization;
+            }
+        }
+
+        if (!gpuCulling) {
+            VkDrawIndexedIndirectCommand command{};
+            command.indexCount = allocation.indexCount;
+            command.instanceCount = instanceCount;
+            command.firstIndex = allocation.firstIndex;
+            command.vertexOffset = static_cast<int32_t>(allocation.vertexOffset);
+            command.firstInstance = firstInstance;
+            drawCommands.push_back(command);
+            drawBatches.back().drawCount++;
+            continue;
+        }
+        MeshCullData cullData{};
+        cullData.boundingSphere = allocation.boundingSphere;
+        if (quantized) {
+            const VertexQuantization &quantization = allocation.quantization;
+            cullData.boundingSphere = glm::vec4((glm::vec3(allocation.boundingSphere) - quantization.offset) /
+                                                quantization.scale, allocation.boundingSphere.w / quantization.scale);
+        }
+        cullData.firstDraw = static_cast<uint32_t>(drawCommands.size());
+        cullData.lodCount = 1 + static_cast<uint32_t>(allocation.lods.size());
+        cullData.drawBatch = static_cast<uint32_t>(drawBatches.size()) - 1;
+        cullData.batchFirstDraw = drawBatches.back().firstDraw;
+        drawBatches.back().drawCount += cullData.lodCount;
+        for (uint32_t lod = 0; lod < cullData.lodCount; lod++) {
+            // any instance can end up in any LOD, so every slot has room for all of them
+            VkDrawIndexedIndirectCommand command{};
+            command.indexCount = lod == 0 ? allocation.indexCount : allocation.lods[lod - 1].indexCount;
+            command.instanceCount = 0;
+            command.firstIndex = lod == 0 ? allocation.firstIndex : allocation.lods[lod - 1].firstIndex;
+            command.vertexOffset = static_cast<int32_t>(allocation.vertexOffset);
+            command.firstInstance = this->culledInstanceCapacity;
+            cullData.lodDistances[static_cast<int>(lod)] = lod == 0 ? 0.0f : allocation.lods[lod - 1].distance;
+            this->culledInstanceCapacity += instanceCount;
+            drawCommands.push_back(command);
+        }
+        for (uint32_t instance = firstInstance; instance < this->instances.size(); instance++) {
+            this->instances[instance].meshIndex = static_cast<uint32_t>(this->cullMeshes.size());
+        }
+        this->cullMeshes.push_back(cullData);
+    }
+    this->drawVersion++;
+    bool countsChanged = drawCommands.size() != previousDrawCount || drawBatches != previousBatches;
+    if (gpuCulling) countsChanged |= this->instances.size() != previousInstanceCount;
+    return countsChanged;
+}
+
+/* Estimates the screen coverage (in pixels across) of every material: the projected diameter of the largest
+ * looking instance drawn with it. Only the bounding spheres' distance to the camera is used (no frustum test),
+ * textures just about to come into view are streamed in as well. Instances of meshes without instances set
+ * use material 0. The coverage vector is indexed by material index.
+ */
+void GeometryArena::estimateMaterialCoverage(const glm::vec3 &cameraPosition, float pixelsPerUnit,
+                                             std::vector<float> &coverage) {
+    static const InstanceData defaultInstance = {glm::mat4(1.0f), 0};
+    coverage.clear();
+    for (const MeshAllocation &allocation : this->meshAllocations) {
+        if (allocation.generation == 0) continue;
+        const InstanceData *instances = allocation.customInstances ? allocation.instances.data() : &defaultInstance;
+        size_t instanceCount = allocation.customInstances ? allocation.instances.size() : 1;
+        for (size_t i = 0; i < instanceCount; i++) {
+            const glm::mat4 &model = instances[i].model;
+            glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(allocation.boundingSphere), 1.0f));
+            float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+                                    glm::length(glm::vec3(model[2]))});
+            float radius = allocation.boundingSphere.w * scale;
+            float distance = std::max(glm::length(center - cameraPosition), radius); // inside the sphere = its radius
+            float pixels = distance > 0.0f ? 2.0f * radius * pixelsPerUnit / distance : 0.0f;
+            uint32_t material = instances[i].materialIndex;
+            if (material >= coverage.size()) coverage.resize(material + 1, 0.0f);
+            coverage[material] = std::max(coverage[material], pixels);
+        }
+    }
+}
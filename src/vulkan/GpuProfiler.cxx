@@ -0,0 +1,87 @@
+/*
+ * GpuProfiler.cxx
+ * Times the GPU work of every frame with timestamp queries, read back without stalling.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+
+GpuProfiler::GpuProfiler(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    uint32_t validBits = this->m_vulkan->m_physicalDevice->timestampValidBits;
+    this->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    this->frameQueries.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = GPU_TIMESTAMP_COUNT * this->m_vulkan->MAX_FRAMES_IN_FLIGHT;
+
+    VkResult result = vkCreateQueryPool(this->m_vulkan->m_logicalDevice->logicalDevice, &poolInfo,
+                                        nullptr, &this->queryPool);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the GPU profiler's timestamp query pool.");
+        throw std::runtime_error("Failed to create the timestamp query pool!");
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    vkDestroyQueryPool(this->m_vulkan->m_logicalDevice->logicalDevice, this->queryPool, nullptr);
+}
+
+// Every frame in flight has its own range of queries (cached command buffers are only replayed by their frame)
+void GpuProfiler::recordFrameStart(VkCommandBuffer commandBuffer) {
+    uint32_t firstQuery = this->m_vulkan->frameIndex * GPU_TIMESTAMP_COUNT;
+    vkCmdResetQueryPool(commandBuffer, this->queryPool, firstQuery, GPU_TIMESTAMP_COUNT);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->queryPool,
+                        firstQuery + GPU_TIMESTAMP_FRAME_START);
+}
+
+void GpuProfiler::recordTimestamp(VkCommandBuffer commandBuffer, uint32_t timestamp, VkPipelineStageFlagBits stage) {
+    vkCmdWriteTimestamp(commandBuffer, stage, this->queryPool,
+                        this->m_vulkan->frameIndex * GPU_TIMESTAMP_COUNT + timestamp);
+}
+
+void GpuProfiler::frameSubmitted(uint32_t frameIndex, uint64_t submitTime) {
+    this->frameQueries[frameIndex].submitTime = submitTime;
+    this->frameQueries[frameIndex].pending = true;
+}
+
+// The frame was waited on, so its timestamps are available (a not ready result is just skipped)
+void GpuProfiler::collectFrame(uint32_t frameIndex) {
+    FrameQueries &queries = this->frameQueries[frameIndex];
+    if (!queries.pending) return;
+    queries.pending = false;
+
+    uint64_t timestamps[GPU_TIMESTAMP_COUNT];
+    VkResult result = vkGetQueryPoolResults(this->m_vulkan->m_logicalDevice->logicalDevice, this->queryPool,
+                                            frameIndex * GPU_TIMESTAMP_COUNT, GPU_TIMESTAMP_COUNT,
+                                            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return;
+
+    // ticks relative to the frame's first timestamp, converted to nanoseconds
+    double timestampPeriod = this->m_vulkan->m_physicalDevice->properties.limits.timestampPeriod;
+    uint64_t offsets[GPU_TIMESTAMP_COUNT];
+    for (uint32_t i = 0; i < GPU_TIMESTAMP_COUNT; i++) {
+        uint64_t ticks = (timestamps[i] - timestamps[GPU_TIMESTAMP_FRAME_START]) & this->timestampMask;
+        offsets[i] = queries.submitTime + (uint64_t) ((double) ticks * timestampPeriod);
+    }
+    Profiler *profiler = this->m_vulkan->base->profiler.get();
+    if (this->m_vulkan->m_cullingPass != nullptr) {
+        profiler->_record_gpu_region("GPU culling", offsets[GPU_TIMESTAMP_FRAME_START],
+                                     offsets[GPU_TIMESTAMP_CULLING_END]);
+    }
+    profiler->_record_gpu_region("GPU render pass", offsets[GPU_TIMESTAMP_CULLING_END],
+                                 offsets[GPU_TIMESTAMP_RENDER_PASS_END]);
+    if (this->m_vulkan->m_frameReadback != nullptr) {
+        profiler->_record_gpu_region("GPU readback", offsets[GPU_TIMESTAMP_RENDER_PASS_END],
+                                     offsets[GPU_TIMESTAMP_FRAME_END]);
+    }
+    profiler->_record_gpu_frame(offsets[GPU_TIMESTAMP_FRAME_END] - offsets[GPU_TIMESTAMP_FRAME_START]);
+}
@@ -11,19 +11,76 @@
  */
 
 #include "../../include/Vulkray/Vulkan.h"
+#include "../../include/Vulkray/JobManager.h"
+#include "../../include/Vulkray/Profiler.h"
 
 #include <spdlog/spdlog.h>
 #include <fstream>
 
 GraphicsPipeline::GraphicsPipeline(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
-    // read spir-v shader binary files
-    // TODO: Get shader code path from engine's input, instead of hardcoded shader file names.
-    auto vertShaderCode = GraphicsPipeline::readSpirVShaderBinary("shaders/engine_basic.vert.spv");
-    auto fragShaderCode = GraphicsPipeline::readSpirVShaderBinary("shaders/engine_basic.frag.spv");
+    // Create the Pipeline Layout vulkan instance (set 1 & the push constants only exist in bindless mode)
+    DescriptorPool *m_descriptorPool = this->m_vulkan->m_descriptorPool.get();
+    VkDescriptorSetLayout setLayouts[] = {m_descriptorPool->descriptorSetLayout, m_descriptorPool->bindlessSetLayout};
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(BindlessConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = m_descriptorPool->bindless ? 2 : 1;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    /* per-object data comes in as instance attributes (push constants can't change between the draws of one
+     * indirect call), the push constants only select the frame's material table */
+    pipelineLayoutInfo.pushConstantRangeCount = m_descriptorPool->bindless ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkResult result = vkCreatePipelineLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                             &pipelineLayoutInfo, nullptr, &this->pipelineLayout);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred when initializing the graphics pipeline layout instance.");
+        throw std::runtime_error("Failed to create the graphics pipeline layout!");
+    }
+
+    /* every variant shares the layout, the default one is compiled on a worker while the rest of the renderer
+     * starts up. It's the fallback of every variant, so failing to build it is fatal (the next frame rethrows
+     * it, see checkDefaultPipeline()). */
+    this->m_vulkan->base->jobManager->_run_background(this, &GraphicsPipeline::compileDefaultTask, 0);
+}
+
+void GraphicsPipeline::compileDefaultTask(void *caller, uint32_t index) {
+    auto graphicsPipeline = static_cast<GraphicsPipeline*>(caller);
+    ProfilePhase phase(graphicsPipeline->m_vulkan->base->profiler.get(), "default pipeline");
+    try {
+        graphicsPipeline->graphicsPipeline = graphicsPipeline->createPipeline(PipelineState{});
+    } catch (...) {
+        graphicsPipeline->defaultError = std::current_exception();
+        graphicsPipeline->defaultFailed.store(true, std::memory_order_release);
+    }
+}
+
+// Frames only clear while the default pipeline compiles, without this they'd never draw anything if it failed
+void GraphicsPipeline::checkDefaultPipeline() {
+    if (this->defaultFailed.load(std::memory_order_acquire)) std::rethrow_exception(this->defaultError);
+}
+
+/* Builds the graphics pipeline for the given state. Only uses the (immutable) layout, render pass & cache,
+ * so variants can be compiled from any thread.
+ */
+VkPipeline GraphicsPipeline::createPipeline(const PipelineState &state) {
+
+    // spir-v shader binaries are read once by the pipeline library
+    auto vertShaderCode = this->m_vulkan->m_pipelineLibrary->getShaderBinary(state.vertexShader);
+    auto fragShaderCode = this->m_vulkan->m_pipelineLibrary->getShaderBinary(state.fragmentShader);
     // create shader module instances
-    VkShaderModule vertShaderModule = GraphicsPipeline::createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = GraphicsPipeline::createShaderModule(fragShaderCode);
+    VkShaderModule vertShaderModule = this->createShaderModule(*vertShaderCode);
+    VkShaderModule fragShaderModule;
+    try {
+        fragShaderModule = this->createShaderModule(*fragShaderCode);
+    } catch (const std::runtime_error &) {
+        vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, vertShaderModule, nullptr);
+        throw;
+    }
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
@@ -57,45 +114,37 @@ GraphicsPipeline::GraphicsPipeline(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    // Get vertex shader binding descriptions from Vertex struct
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    // Vertex shader bindings: the state's vertex format (per-vertex) & the InstanceData struct (per-instance)
+    VkVertexInputBindingDescription bindingDescriptions[] = {
+            GraphicsPipeline::getVertexBindingDescription(state.vertexFormat), InstanceData::getBindingDescription()
+    };
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions =
+            GraphicsPipeline::getVertexAttributeDescriptions(state.vertexFormat);
+    for (auto &attribute : InstanceData::getAttributeDescriptions()) attributeDescriptions.push_back(attribute);
 
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = state.topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    // viewport region should cover the entire framebuffer
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) this->m_vulkan->m_swapChain->swapChainExtent.width;
-    viewport.height = (float) this->m_vulkan->m_swapChain->swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    // scissor should cover the entire buffer
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = this->m_vulkan->m_swapChain->swapChainExtent;
-
+    // viewport & scissor are dynamic state (set while recording), so variants don't depend on the swap chain
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
 
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // other modes will require more GPU features
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = state.cullMode;
     rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // counterclockwise to fix GLM y-coords flip
     // other optional rasterizer configuration
     rasterizer.depthBiasEnable = VK_FALSE;
@@ -117,7 +166,7 @@ GraphicsPipeline::GraphicsPipeline(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
             VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
-    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.blendEnable = state.alphaBlending ? VK_TRUE : VK_FALSE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
     colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -146,22 +195,6 @@ GraphicsPipeline::GraphicsPipeline(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     depthStencil.minDepthBounds = 0.0f; // Optional
     depthStencil.maxDepthBounds = 1.0f; // Optional
 
-
-    // Create the Pipeline Layout vulkan instance
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &this->m_vulkan->m_descriptorPool->descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-    VkResult result = vkCreatePipelineLayout(this->m_vulkan->m_logicalDevice->logicalDevice,
-                                             &pipelineLayoutInfo, nullptr, &this->pipelineLayout);
-    if (result != VK_SUCCESS) {
-        spdlog::error("An error occurred when initializing the graphics pipeline layout instance.");
-        throw std::runtime_error("Failed to create the graphics pipeline layout!");
-    }
-
     // Create the Vulkan graphics pipeline instance
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -177,20 +210,57 @@ GraphicsPipeline::GraphicsPipeline(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = this->pipelineLayout;
     pipelineInfo.renderPass = this->m_vulkan->m_renderPass->renderPass;
-    pipelineInfo.subpass = 0;
+    pipelineInfo.subpass = this->m_vulkan->m_renderPass->sceneSubpass;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional
     pipelineInfo.basePipelineIndex = -1; // optional
 
-    result = vkCreateGraphicsPipelines(this->m_vulkan->m_logicalDevice->logicalDevice,
-                                       VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->graphicsPipeline);
+    // the pipeline cache is internally synchronized, so workers can compile into it at the same time
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                this->m_vulkan->m_pipelineCache->pipelineCache, 1, &pipelineInfo,
+                                                nullptr, &pipeline);
+    // modules compiled after pipeline creation, so they can be destroyed
+    vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, fragShaderModule, nullptr);
+    vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, vertShaderModule, nullptr);
     if (result != VK_SUCCESS) {
-        spdlog::error("An error occurred when initializing the Vulkan graphics pipeline instance.");
+        spdlog::error("An error occurred when initializing a Vulkan graphics pipeline instance. ({0}, {1})",
+                      state.vertexShader, state.fragmentShader);
         throw std::runtime_error("Failed to create the Vulkan graphics pipeline.");
     }
+    return pipeline;
+}
 
-    // modules compiled after pipeline creation, so they can be destroyed
-    vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, fragShaderModule, nullptr);
-    vkDestroyShaderModule(this->m_vulkan->m_logicalDevice->logicalDevice, vertShaderModule, nullptr);
+VkVertexInputBindingDescription GraphicsPipeline::getVertexBindingDescription(VertexFormat format) {
+    VkVertexInputBindingDescription bindingDescription{};
+    // vertex binding data (the geometry arena's shared vertex buffer)
+    bindingDescription.binding = 0;
+    bindingDescription.stride = vertexformat::get_stride(format);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+// One attribute per one the format stores, at the shader locations listed in VertexFormat.h
+std::vector<VkVertexInputAttributeDescription> GraphicsPipeline::getVertexAttributeDescriptions(VertexFormat format) {
+    static const uint32_t locations[VERTEX_ATTRIBUTE_COUNT] = {0, 1, 7, 8};
+    static const VkFormat formats[VERTEX_ATTRIBUTE_COUNT][2] = { // unquantized, quantized
+            {VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R16G16B16A16_SNORM}, // position
+            {VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM}, // color
+            {VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R16G16_SNORM}, // normal (octahedral when quantized)
+            {VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R16G16_SFLOAT} // uv
+    };
+    int quantized = (format & VERTEX_FORMAT_QUANTIZED) != 0 ? 1 : 0;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    for (int attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+        if (!vertexformat::has_attribute(format, attribute)) continue;
+        VkVertexInputAttributeDescription description{};
+        description.binding = 0;
+        description.location = locations[attribute];
+        description.format = formats[attribute][quantized];
+        description.offset = vertexformat::get_attribute_offset(format, attribute);
+        attributeDescriptions.push_back(description);
+    }
+    return attributeDescriptions;
 }
 
 VkShaderModule GraphicsPipeline::createShaderModule(const std::vector<char> &shaderBinary) {
@@ -231,6 +301,13 @@ std::vector<char> GraphicsPipeline::readSpirVShaderBinary(const std::string &fil
 }
 
 GraphicsPipeline::~GraphicsPipeline() {
-    vkDestroyPipeline(this->m_vulkan->m_logicalDevice->logicalDevice, this->graphicsPipeline, nullptr);
+    // the default pipeline may still be compiling (a failed compile was logged already, destructors can't throw)
+    try {
+        if (this->m_vulkan->base->jobManager != nullptr) this->m_vulkan->base->jobManager->_wait_for_background_tasks();
+    } catch (const std::exception &) {}
+    VkPipeline pipeline = this->graphicsPipeline.load();
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(this->m_vulkan->m_logicalDevice->logicalDevice, pipeline, nullptr);
+    }
     vkDestroyPipelineLayout(this->m_vulkan->m_logicalDevice->logicalDevice, this->pipelineLayout, nullptr);
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 /*
  * ImageViews.cxx
- * Allocates image view instances for swap chain images & 3D depth images.
+ * Allocates image view instances for swap chain images & 3D depth images, records image layout transitions.
  *
  * VULKRAY ENGINE SOFTWARE
  * Copyright (c) 2023, Max Rodriguez. All rights reserved.
@@ -63,7 +63,8 @@ SwapImageViews::~SwapImageViews() {
 
 void ImageViews::allocateVMAImage(VmaAllocator allocator, AllocatedImage *allocatedImage, uint32_t width,
                                   uint32_t height, VkImageTiling tiling, VkSampleCountFlagBits msaaSamples,
-                                  VkImageUsageFlags usageFlags, VkFormat imageFormat) {
+                                  VkImageUsageFlags usageFlags, VkFormat imageFormat, uint32_t mipLevels,
+                                  VmaAllocationCreateFlags allocationFlags, VmaMemoryUsage memoryUsage) {
     VkExtent3D imageExtent = {
         .width = width,
         .height = height,
@@ -74,7 +75,7 @@ void ImageViews::allocateVMAImage(VmaAllocator allocator, AllocatedImage *alloca
         .imageType = VK_IMAGE_TYPE_2D,
         .format = imageFormat,
         .extent = imageExtent,
-        .mipLevels = 1,
+        .mipLevels = mipLevels,
         .arrayLayers = 1,
         .samples = msaaSamples,
         .tiling = tiling,
@@ -83,7 +84,8 @@ void ImageViews::allocateVMAImage(VmaAllocator allocator, AllocatedImage *alloca
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
     const VmaAllocationCreateInfo allocCreateInfo = {
-        .usage = VMA_MEMORY_USAGE_AUTO
+        .flags = allocationFlags,
+        .usage = memoryUsage
     };
 
     VkResult result = vmaCreateImage(allocator, &imageCreateInfo, &allocCreateInfo,
@@ -94,8 +96,8 @@ void ImageViews::allocateVMAImage(VmaAllocator allocator, AllocatedImage *alloca
     }
 }
 
-VkImageView ImageViews::createImageView(VkDevice logicalDevice, VkImage image,
-                                        VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView ImageViews::createImageView(VkDevice logicalDevice, VkImage image, VkFormat format,
+                                        VkImageAspectFlags aspectFlags, uint32_t levelCount) {
 
     VkImageViewCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -110,7 +112,7 @@ VkImageView ImageViews::createImageView(VkDevice logicalDevice, VkImage image,
 
     createInfo.subresourceRange.aspectMask = aspectFlags;
     createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.levelCount = levelCount;
     createInfo.subresourceRange.baseArrayLayer = 0;
     createInfo.subresourceRange.layerCount = 1;
 
@@ -125,40 +127,70 @@ VkImageView ImageViews::createImageView(VkDevice logicalDevice, VkImage image,
     return imageView;
 }
 
-void ImageViews::transitionImageLayout(AllocatedImage allocatedImage, VkFormat format,
-                                       VkImageLayout oldLayout, VkImageLayout newLayout) {
-    return;
-    // TODO: Will work on this once textures are implemented :) (not required for depth image buffer)
-    /*
-     * if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-            if (hasStencilComponent(format)) {
-                barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-            }
-        } else {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        }
-         if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+/* Records a barrier moving the mip levels from one layout to the other. The stages & accesses waited on (and
+ * blocked) are derived from the layouts, covering every way the engine uses images in them.
+ */
+void ImageViews::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask,
+                                       VkImageLayout oldLayout, VkImageLayout newLayout,
+                                       uint32_t baseMipLevel, uint32_t levelCount) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspectMask;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags sourceStage;
+    VkPipelineStageFlags destinationStage;
+    // the old layout's writes (or reads) have to be done before the layout changes
+    switch (oldLayout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED: // contents are discarded, nothing to wait on
             barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
             sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
             barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
             sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
+        default:
+            spdlog::error("transitionImageLayout(): Unsupported old image layout. (layout: {0})", (int) oldLayout);
+            throw std::invalid_argument("Unsupported image layout transition!");
+    }
+    switch (newLayout) {
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
             destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
             destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        } else {
-            throw std::invalid_argument("unsupported layout transition!");
-        }
-     */
-}
\ No newline at end of file
+            break;
+        default:
+            spdlog::error("transitionImageLayout(): Unsupported new image layout. (layout: {0})", (int) newLayout);
+            throw std::invalid_argument("Unsupported image layout transition!");
+    }
+    vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -23,13 +23,59 @@ LogicalDevice::LogicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     std::set<uint32_t> uniqueQueueFamilies = {
             queueFamilies.graphicsFamily.value(),
             queueFamilies.presentFamily.value(),
-            queueFamilies.transferFamily.value()
+            queueFamilies.transferFamily.value(),
+            queueFamilies.computeFamily.value()
     };
     VkDeviceCreateInfo createInfo{};
 
-    // GPU device features configuration
-    VkPhysicalDeviceFeatures deviceFeatures{};
-    deviceFeatures.sampleRateShading = VK_TRUE; // TODO: Add engine API to enable/disable texture MSAA.
+    // GPU device features configuration (Vulkan 1.2 features are chained onto the core features)
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE; // upload queue completion tracking
+    // culled draws compacted on the GPU (optional, every draw slot is drawn without it)
+    bool drawIndirectCount = this->m_vulkan->m_physicalDevice->drawIndirectCount;
+    vulkan12Features.drawIndirectCount = drawIndirectCount ? VK_TRUE : VK_FALSE;
+    // non-uniformly indexed, update after bind descriptor arrays (optional, textures aren't drawn without them)
+    VkBool32 descriptorIndexing = this->m_vulkan->m_physicalDevice->descriptorIndexing ? VK_TRUE : VK_FALSE;
+    vulkan12Features.runtimeDescriptorArray = descriptorIndexing;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = descriptorIndexing;
+    vulkan12Features.descriptorBindingPartiallyBound = descriptorIndexing;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = descriptorIndexing;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = descriptorIndexing;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = descriptorIndexing;
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.features.shaderStorageBufferArrayDynamicIndexing = descriptorIndexing;
+    deviceFeatures.pNext = &vulkan12Features;
+    deviceFeatures.features.sampleRateShading = VK_TRUE; // TODO: Add engine API to enable/disable texture MSAA.
+    // batched indirect draws (optional, one call per draw without it)
+    bool multiDrawIndirect = this->m_vulkan->m_physicalDevice->multiDrawIndirect;
+    deviceFeatures.features.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    // texture filtering & compressed texture formats (optional, textures in unsupported formats aren't loaded)
+    PhysicalDevice *m_physicalDevice = this->m_vulkan->m_physicalDevice.get();
+    deviceFeatures.features.samplerAnisotropy = m_physicalDevice->samplerAnisotropy ? VK_TRUE : VK_FALSE;
+    deviceFeatures.features.textureCompressionBC = m_physicalDevice->textureCompressionBC ? VK_TRUE : VK_FALSE;
+    deviceFeatures.features.textureCompressionASTC_LDR = m_physicalDevice->textureCompressionASTC ? VK_TRUE : VK_FALSE;
+    // present wait (optional, low latency mode falls back to pacing on the frame timeline without it)
+    std::vector<const char*> extensions;
+    if (!this->m_vulkan->base->config.headless) extensions = this->m_vulkan->requiredExtensions;
+    // driver reported heap budgets (optional, VMA estimates them without it)
+    if (this->m_vulkan->m_physicalDevice->memoryBudget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    bool presentWait = this->m_vulkan->base->config.lowLatency && this->m_vulkan->m_physicalDevice->presentWait;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.pNext = &presentIdFeatures;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    if (presentWait) {
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        vulkan12Features.pNext = &presentWaitFeatures;
+    } else if (this->m_vulkan->base->config.lowLatency && !this->m_vulkan->base->config.headless) {
+        spdlog::info("VK_KHR_present_wait is unsupported, low latency mode only limits the frames in flight.");
+    }
 
     // Create logical device queue create info struct for each queue
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -49,9 +95,10 @@ LogicalDevice::LogicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-    createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(this->m_vulkan->requiredExtensions.size());
-    createInfo.ppEnabledExtensionNames = this->m_vulkan->requiredExtensions.data();
+    createInfo.pNext = &deviceFeatures;
+    createInfo.pEnabledFeatures = nullptr; // given through VkPhysicalDeviceFeatures2 instead
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     // Validation layer fields are ignored by newer Vk implementations; set for compatibility
     if (this->m_vulkan->enableValidationLayers) {
@@ -68,10 +115,18 @@ LogicalDevice::LogicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
         throw std::runtime_error("Failed to create the logical device!");
     }
 
-    // Create handles for Graphics, Present, and Transfer queues using given handle pointers
+    /* Create handles for Graphics, Present, Transfer and Compute queues using given handle pointers
+     * (families are shared by their queues, e.g. transfer & compute without a transfer only family, which is fine
+     * as long as every queue is submitted to from the render thread only)
+     */
     vkGetDeviceQueue(this->logicalDevice, queueFamilies.graphicsFamily.value(), 0, &this->graphicsQueue);
     vkGetDeviceQueue(this->logicalDevice, queueFamilies.presentFamily.value(), 0, &this->presentQueue);
     vkGetDeviceQueue(this->logicalDevice, queueFamilies.transferFamily.value(), 0, &this->transferQueue);
+    vkGetDeviceQueue(this->logicalDevice, queueFamilies.computeFamily.value(), 0, &this->computeQueue);
+    if (presentWait) {
+        this->pWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                vkGetDeviceProcAddr(this->logicalDevice, "vkWaitForPresentKHR"));
+    }
 }
 
 LogicalDevice::~LogicalDevice() {
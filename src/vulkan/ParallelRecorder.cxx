@@ -0,0 +1,146 @@
+/*
+ * ParallelRecorder.cxx
+ * Records the draw list into secondary command buffers across multiple threads.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+ParallelRecorder::ParallelRecorder(Vulkan *m_vulkan, uint32_t slotCount): VkModuleBase(m_vulkan) {
+
+    // 0 = one recording slot per job worker, plus one for the render thread
+    if (slotCount == 0) slotCount = this->m_vulkan->base->jobManager->get_worker_count() + 1;
+    this->recordingSlots.resize(slotCount);
+
+    /* Vulkan command pools are externally synchronized, so every recording slot owns its own pool.
+     * The slots are recorded on the job manager's workers, with the render thread helping out.
+     */
+    for (uint32_t slot = 0; slot < slotCount; slot++) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = this->m_vulkan->m_physicalDevice->queueFamilies.graphicsFamily.value();
+
+        VkResult result = vkCreateCommandPool(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                              &poolInfo, nullptr, &this->recordingSlots[slot].commandPool);
+        if (result != VK_SUCCESS) {
+            spdlog::error("An error occurred while initializing a recording slot command pool.");
+            throw std::runtime_error("Failed to create a recording slot command pool!");
+        }
+    }
+    VULKRAY_LOG_DEBUG("Initialized {0} command recording slots.", slotCount);
+}
+
+ParallelRecorder::~ParallelRecorder() {
+    for (RecordingSlot &slot : this->recordingSlots) {
+        vkDestroyCommandPool(this->m_vulkan->m_logicalDevice->logicalDevice, slot.commandPool, nullptr);
+    }
+}
+
+// Allocates one secondary command buffer per slot for every primary command buffer of the graphics pool
+void ParallelRecorder::allocateSecondaryBuffers(uint32_t primaryBufferCount) {
+
+    for (RecordingSlot &slot : this->recordingSlots) {
+        if (slot.commandBuffers.size() == primaryBufferCount) continue; // re-recorded along with their primary
+        if (!slot.commandBuffers.empty()) { // may still be pending, freed once their frames were waited on
+            this->m_vulkan->m_deletionQueue->retire(
+                    [this, commandPool = slot.commandPool, commandBuffers = slot.commandBuffers] {
+                vkFreeCommandBuffers(this->m_vulkan->m_logicalDevice->logicalDevice, commandPool,
+                                     (uint32_t) commandBuffers.size(), commandBuffers.data());
+            });
+        }
+        slot.commandBuffers.resize(primaryBufferCount);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = slot.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY; // executed by the primary buffer
+        allocInfo.commandBufferCount = primaryBufferCount;
+
+        VkResult result = vkAllocateCommandBuffers(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                   &allocInfo, slot.commandBuffers.data());
+        if (result != VK_SUCCESS) {
+            spdlog::error("An error occurred while allocating the secondary command buffers.");
+            throw std::runtime_error("Failed to allocate the secondary command buffers!");
+        }
+    }
+}
+
+// Splits the draw list across the recording slots and executes the results in the given primary buffer
+void ParallelRecorder::recordDraws(VkCommandBuffer primaryBuffer, uint32_t primaryIndex, uint32_t imageIndex) {
+
+    auto drawCount = static_cast<uint32_t>(this->m_vulkan->drawCommands.size());
+    auto slotCount = static_cast<uint32_t>(this->recordingSlots.size());
+    // don't wake up threads for a handful of draws, the hand-off costs more than recording them
+    uint32_t usedSlots = std::min(slotCount, (drawCount + MIN_DRAWS_PER_SLOT - 1) / MIN_DRAWS_PER_SLOT);
+    if (usedSlots == 0) return;
+
+    uint32_t drawsPerSlot = (drawCount + usedSlots - 1) / usedSlots;
+    uint32_t workerSlots = 0; // slots (other than slot 0) that received draws
+    for (uint32_t slot = 0; slot < slotCount; slot++) {
+        RecordingSlot &recordingSlot = this->recordingSlots[slot];
+        recordingSlot.firstDraw = std::min(drawCount, slot * drawsPerSlot);
+        recordingSlot.drawCount = std::min(drawsPerSlot, drawCount - recordingSlot.firstDraw);
+        if (slot > 0 && recordingSlot.drawCount > 0) workerSlots++;
+    }
+    usedSlots = workerSlots + 1;
+    this->primaryIndex = primaryIndex;
+    this->imageIndex = imageIndex;
+
+    // task index == slot index, so every slot is only ever recorded by one thread at a time
+    this->m_vulkan->base->jobManager->_run_parallel(usedSlots, this, &ParallelRecorder::recordSlotTask);
+
+    // merge the secondary buffers into the primary buffer (in slot order to keep the draw order)
+    std::vector<VkCommandBuffer> secondaryBuffers(usedSlots);
+    for (uint32_t slot = 0; slot < usedSlots; slot++) {
+        secondaryBuffers[slot] = this->recordingSlots[slot].commandBuffers[primaryIndex];
+    }
+    vkCmdExecuteCommands(primaryBuffer, usedSlots, secondaryBuffers.data());
+}
+
+void ParallelRecorder::recordSlot(uint32_t slot) {
+    RecordingSlot &recordingSlot = this->recordingSlots[slot];
+    VkCommandBuffer commandBuffer = recordingSlot.commandBuffers[this->primaryIndex];
+
+    // secondary buffers continue the primary buffer's render pass
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = this->m_vulkan->m_renderPass->renderPass;
+    inheritanceInfo.subpass = this->m_vulkan->m_renderPass->sceneSubpass;
+    uint32_t sceneGroup = this->m_vulkan->m_renderPass->plan.passGroups[this->m_vulkan->m_renderPass->scenePass];
+    inheritanceInfo.framebuffer = this->m_vulkan->m_frameBuffers->groupFrameBuffers[sceneGroup][this->imageIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to start recording to a secondary command buffer.");
+        throw std::runtime_error("Failed to begin recording the secondary command buffer!");
+    }
+    // bound state is not inherited from the primary buffer, so every secondary binds its own
+    this->m_vulkan->m_graphicsCommandPool->recordDrawState(commandBuffer);
+    this->m_vulkan->m_graphicsCommandPool->recordDraws(commandBuffer,
+                                                       recordingSlot.firstDraw, recordingSlot.drawCount);
+
+    result = vkEndCommandBuffer(commandBuffer);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while trying to stop recording to a secondary command buffer.");
+        throw std::runtime_error("Failed to stop recording the secondary command buffer!");
+    }
+}
+
+void ParallelRecorder::recordSlotTask(void *caller, uint32_t slot) {
+    auto self = static_cast<ParallelRecorder*>(caller);
+    self->recordSlot(slot);
+}
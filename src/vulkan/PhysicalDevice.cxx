@@ -11,9 +11,11 @@
  */
 
 #include "../../include/Vulkray/Vulkan.h"
+#include "../../include/Vulkray/JobManager.h"
 #include <spdlog/spdlog.h>
 #include <map>
 #include <set>
+#include <cstring>
 
 PhysicalDevice::PhysicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
@@ -25,20 +27,22 @@ PhysicalDevice::PhysicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
         throw std::runtime_error("No Vulkan-compatible GPU device found.");
     }
     // Get all available GPU devices
-    std::vector<VkPhysicalDevice> devices(deviceCount);
-    vkEnumeratePhysicalDevices(this->m_vulkan->m_vulkanInstance->vulkanInstance, &deviceCount, devices.data());
+    this->probedDevices.resize(deviceCount);
+    vkEnumeratePhysicalDevices(this->m_vulkan->m_vulkanInstance->vulkanInstance, &deviceCount,
+                               this->probedDevices.data());
 
     // ---------- Scan GPU devices features & score suitability --------- //
 
+    /* Every GPU is probed on its own worker (the queries are independent, and the first ones to a GPU can be
+     * slow while its driver wakes it up).
+     */
+    this->probedScores.assign(deviceCount, 0);
+    this->m_vulkan->base->jobManager->_run_parallel(deviceCount, this, &PhysicalDevice::rateDeviceTask);
+
     // Use an ordered map to automatically sort candidates by increasing score
     std::multimap<int, VkPhysicalDevice> candidates;
-
-    for (auto& device : devices) {
-        // Initialize `queueFamilies` struct with GPU device queue family indices
-        this->physicalDevice = device;
-        this->queueFamilies = this->findDeviceQueueFamilies();
-        int score = this->rateGPUSuitability();
-        candidates.insert(std::make_pair(score, device));
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        candidates.insert(std::make_pair(this->probedScores[i], this->probedDevices[i]));
     }
 
     // Check if the best candidate is suitable at all
@@ -49,39 +53,99 @@ PhysicalDevice::PhysicalDevice(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
         throw std::runtime_error("No system GPU device met the minimal device requirements.");
     }
 
-    // Get selected GPU properties
-    VkPhysicalDeviceProperties gpuProperties;
-    vkGetPhysicalDeviceProperties(this->physicalDevice, &gpuProperties);
+    // Get selected GPU properties (the driver UUID identifies the driver build, e.g. for the pipeline cache)
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 gpuProperties{};
+    gpuProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    gpuProperties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(this->physicalDevice, &gpuProperties);
+    this->properties = gpuProperties.properties;
+    memcpy(this->driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
 
-    spdlog::info("Vulkan GPU Selected: {0}", gpuProperties.deviceName);
+    spdlog::info("Vulkan GPU Selected: {0}", this->properties.deviceName);
 
     // Store final selected GPU device information
-    this->queueFamilies = this->findDeviceQueueFamilies();
-    this->msaaSamples = this->getMaxUsableSampleCount();
+    this->queueFamilies = this->findDeviceQueueFamilies(this->physicalDevice);
+    this->msaaSamples = this->getMaxUsableSampleCount(this->physicalDevice);
+
+    // GPU frame profiling needs timestamps on the graphics queue
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    this->timestampValidBits = queueFamilyProperties[this->queueFamilies.graphicsFamily.value()].timestampValidBits;
+
+    // Optional features the renderer makes use of when available
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 gpuFeatures{};
+    gpuFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    gpuFeatures.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(this->physicalDevice, &gpuFeatures);
+    this->multiDrawIndirect = gpuFeatures.features.multiDrawIndirect == VK_TRUE;
+    this->drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+    this->samplerAnisotropy = gpuFeatures.features.samplerAnisotropy == VK_TRUE;
+    this->textureCompressionBC = gpuFeatures.features.textureCompressionBC == VK_TRUE;
+    this->textureCompressionASTC = gpuFeatures.features.textureCompressionASTC_LDR == VK_TRUE;
+    // everything the bindless set needs (VK_EXT_descriptor_indexing, core in Vulkan 1.2)
+    this->descriptorIndexing = gpuFeatures.features.shaderStorageBufferArrayDynamicIndexing == VK_TRUE &&
+                               vulkan12Features.runtimeDescriptorArray == VK_TRUE &&
+                               vulkan12Features.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+                               vulkan12Features.descriptorBindingPartiallyBound == VK_TRUE &&
+                               vulkan12Features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                               vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+                               vulkan12Features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE;
+    this->memoryBudget = this->checkGPUExtensionSupport(this->physicalDevice,
+                                                        {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+
+    // Present pacing features are extension defined, so they're only queried when the extensions are there
+    if (!this->m_vulkan->base->config.headless &&
+        this->checkGPUExtensionSupport(this->physicalDevice,
+                                       {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME})) {
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        VkPhysicalDeviceFeatures2 presentFeatures{};
+        presentFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        presentFeatures.pNext = &presentWaitFeatures;
+        vkGetPhysicalDeviceFeatures2(this->physicalDevice, &presentFeatures);
+        this->presentWait = presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+    }
 }
 
-int PhysicalDevice::rateGPUSuitability() {
+void PhysicalDevice::rateDeviceTask(void *caller, uint32_t index) {
+    auto physicalDevice = static_cast<PhysicalDevice*>(caller);
+    physicalDevice->probedScores[index] = physicalDevice->rateGPUSuitability(physicalDevice->probedDevices[index]);
+}
+
+// Only queries the given device (thread safe, GPUs are rated concurrently)
+int PhysicalDevice::rateGPUSuitability(VkPhysicalDevice device) {
     int deviceScore = 0;
 
     // Get GPU device information
     VkPhysicalDeviceProperties gpuProperties;
     VkPhysicalDeviceFeatures gpuFeatures;
-    bool hasRequiredExtensions = this->checkGPUExtensionSupport();
-    VkSampleCountFlagBits msaaSupported = this->getMaxUsableSampleCount();
+    bool headless = this->m_vulkan->base->config.headless; // renders offscreen, doesn't need to present
+    bool hasRequiredExtensions = headless || this->checkGPUExtensionSupport(device,
+                                                                            this->m_vulkan->requiredExtensions);
+    VkSampleCountFlagBits msaaSupported = this->getMaxUsableSampleCount(device);
 
-    vkGetPhysicalDeviceProperties(this->physicalDevice, &gpuProperties);
-    vkGetPhysicalDeviceFeatures(this->physicalDevice, &gpuFeatures);
+    vkGetPhysicalDeviceProperties(device, &gpuProperties);
+    vkGetPhysicalDeviceFeatures(device, &gpuFeatures);
 
     // Check minimal GPU device requirements
     if (!hasRequiredExtensions) return 0; // required GPU extensions
-    else {
+    else if (!headless) {
         // Check GPU swap chain support
         SwapChainSupportDetails swapChainSupport = SwapChain::querySwapChainSupport(
-                this->physicalDevice, this->m_vulkan->m_window->surface);
+                device, this->m_vulkan->m_window->surface);
 
         if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) return 0;
     }
-    if (!this->queueFamilies.isComplete()) return 0; // required GPU queues
+    if (!this->findDeviceQueueFamilies(device).isComplete()) return 0; // required GPU queues
     if (!gpuFeatures.geometryShader) return 0; // required geometry shader
 
     // Rate GPU physical device with score
@@ -93,41 +157,57 @@ int PhysicalDevice::rateGPUSuitability() {
     return deviceScore;
 }
 
-QueueFamilyIndices PhysicalDevice::findDeviceQueueFamilies() {
+QueueFamilyIndices PhysicalDevice::findDeviceQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices queueIndices; // values initialized with std::optional, so no init required
 
     // Get device queue family information
     uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, nullptr);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &queueFamilyCount, queueFamilies.data());
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    // For each queue family in GPU, find the index of each queue type we need.
+    /* For each queue family in GPU, find the index of each queue type we need.
+     * Every family is looked at (there's only a handful), the graphics family pre-fills the transfer & compute
+     * family indices, & dedicated families found later replace them.
+     */
     int index = 0;
     for (const auto &queueFamily : queueFamilies) {
-        /* break the loop if the queue indices struct is complete (WITH a dedicated transfer family,
-         * or else it will exit early as the graphics family will also pre-fill the transfer family index
-         * before a dedicated one is possibly found. this check prevents that bug.
-         */
-        if (queueIndices.isComplete() && queueIndices.dedicatedTransferFamily) break;
-
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(this->physicalDevice, index,
-                                             this->m_vulkan->m_window->surface, &presentSupport);
 
         VkQueueFlags queueFlags = queueFamily.queueFlags;
 
+        // nothing is presented in headless mode, the "present" family is just the graphics family then
+        VkBool32 presentSupport = false;
+        if (this->m_vulkan->base->config.headless) {
+            presentSupport = (queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        } else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, index,
+                                                 this->m_vulkan->m_window->surface, &presentSupport);
+        }
+
         if (presentSupport) {
-            queueIndices.presentFamily = index; // found present queue index
+            // presenting from the graphics family is preferred (swap images aren't shared between families then)
+            bool graphicsPresent = queueIndices.presentFamily.has_value() &&
+                                   queueIndices.presentFamily == queueIndices.graphicsFamily;
+            if (!graphicsPresent) queueIndices.presentFamily = index; // found present queue index
         } else {
-            // most likely a dedicated VK_QUEUE_TRANSFER_BIT capable queue family, check!
-            if ((queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            /* most likely a dedicated VK_QUEUE_TRANSFER_BIT capable queue family, check! A transfer only family
+             * (the GPU's copy engines) is preferred over an async compute family, which is kept for compute work.
+             */
+            bool transferOnly = !(queueFlags & VK_QUEUE_COMPUTE_BIT);
+            if ((queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                (!queueIndices.dedicatedTransferFamily || transferOnly)) {
                 queueIndices.transferFamily = index;
                 queueIndices.dedicatedTransferFamily = true;
             }
         }
-        if (queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        // compute without graphics: an async compute family, its queues run next to the graphics queue
+        if ((queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+            !queueIndices.dedicatedComputeFamily) {
+            queueIndices.computeFamily = index;
+            queueIndices.dedicatedComputeFamily = true;
+        }
+        if ((queueFlags & VK_QUEUE_GRAPHICS_BIT) && !queueIndices.graphicsFamily.has_value()) {
             queueIndices.graphicsFamily = index; // found graphics queue index
 
             /* If a dedicated `VK_QUEUE_TRANSFER_BIT` capable queue family is not found on the GPU,
@@ -141,22 +221,25 @@ QueueFamilyIndices PhysicalDevice::findDeviceQueueFamilies() {
             if (!queueIndices.dedicatedTransferFamily) {
                 queueIndices.transferFamily = index;
             }
+            // same for compute (every GPU has a family supporting both graphics & compute)
+            if (!queueIndices.dedicatedComputeFamily && (queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                queueIndices.computeFamily = index;
+            }
         }
         index++;
     }
     return queueIndices;
 }
 
-bool PhysicalDevice::checkGPUExtensionSupport() {
+bool PhysicalDevice::checkGPUExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> &extensions) {
     // Get GPU extensions information
     uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, nullptr);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(this->m_vulkan->requiredExtensions.begin(),
-                                             this->m_vulkan->requiredExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -195,10 +278,10 @@ bool PhysicalDevice::depthFormatHasStencilComponent(VkFormat format) {
 }
 
 // Gets best compatible MSAA configuration for GPU device
-VkSampleCountFlagBits PhysicalDevice::getMaxUsableSampleCount() {
+VkSampleCountFlagBits PhysicalDevice::getMaxUsableSampleCount(VkPhysicalDevice device) {
 
     VkPhysicalDeviceProperties physicalDeviceProperties;
-    vkGetPhysicalDeviceProperties(this->physicalDevice, &physicalDeviceProperties);
+    vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
 
     VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts &
                                 physicalDeviceProperties.limits.framebufferDepthSampleCounts;
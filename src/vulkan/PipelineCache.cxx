@@ -0,0 +1,131 @@
+/*
+ * PipelineCache.cxx
+ * Keeps the Vulkan pipeline cache on disk between engine runs.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t PIPELINE_CACHE_MAGIC = 0x43524B56; // "VKRC"
+const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+/* Written in front of the driver's cache data. Drivers validate their own data as well, but a cache saved
+ * by another GPU or driver build would just be thrown away by them, so those are never handed over at all.
+ */
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint8_t driverUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+
+static bool sameDevice(const PipelineCacheFileHeader &header, const PipelineCacheFileHeader &other) {
+    return header.magic == other.magic && header.version == other.version &&
+           header.vendorID == other.vendorID && header.deviceID == other.deviceID &&
+           header.driverVersion == other.driverVersion &&
+           memcmp(header.pipelineCacheUUID, other.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+           memcmp(header.driverUUID, other.driverUUID, VK_UUID_SIZE) == 0;
+}
+
+static PipelineCacheFileHeader currentDeviceHeader(PhysicalDevice *physicalDevice, uint64_t dataSize) {
+    PipelineCacheFileHeader header{};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_FILE_VERSION;
+    header.vendorID = physicalDevice->properties.vendorID;
+    header.deviceID = physicalDevice->properties.deviceID;
+    header.driverVersion = physicalDevice->properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, physicalDevice->properties.pipelineCacheUUID, VK_UUID_SIZE);
+    memcpy(header.driverUUID, physicalDevice->driverUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+    return header;
+}
+
+PipelineCache::PipelineCache(Vulkan *m_vulkan, const char* cachePath): VkModuleBase(m_vulkan) {
+    if (cachePath != nullptr) this->cachePath = cachePath;
+    std::vector<char> cacheData = this->readCacheFile(); // empty on a cold start
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    VkResult result = vkCreatePipelineCache(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                            &cacheInfo, nullptr, &this->pipelineCache);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the Vulkan pipeline cache.");
+        throw std::runtime_error("Failed to create the pipeline cache!");
+    }
+    VULKRAY_LOG_DEBUG("Initialized the pipeline cache. ({0} bytes loaded)", cacheData.size());
+}
+
+PipelineCache::~PipelineCache() {
+    this->writeCacheFile(); // every pipeline is built by now (destroyed after the modules using it)
+    vkDestroyPipelineCache(this->m_vulkan->m_logicalDevice->logicalDevice, this->pipelineCache, nullptr);
+}
+
+// Returns the driver's cache data saved by the last run (if it's compatible with the current GPU & driver)
+std::vector<char> PipelineCache::readCacheFile() {
+    if (this->cachePath.empty()) return {};
+    std::ifstream file(this->cachePath, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) return {}; // first run
+    auto fileSize = (uint64_t) file.tellg();
+    file.seekg(0);
+
+    PipelineCacheFileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.dataSize != fileSize - sizeof(header)) {
+        spdlog::warn("The saved pipeline cache file is damaged, rebuilding it.");
+        return {};
+    }
+    if (!sameDevice(header, currentDeviceHeader(this->m_vulkan->m_physicalDevice.get(), 0))) {
+        spdlog::info("The saved pipeline cache is from another GPU or driver version, rebuilding it.");
+        return {};
+    }
+    std::vector<char> cacheData(header.dataSize);
+    file.read(cacheData.data(), (std::streamsize) cacheData.size());
+    if (!file) return {};
+    return cacheData;
+}
+
+// Written to a temporary file first, so a crash while saving never leaves a half written cache behind
+void PipelineCache::writeCacheFile() {
+    if (this->cachePath.empty()) return;
+    size_t dataSize = 0;
+    vkGetPipelineCacheData(this->m_vulkan->m_logicalDevice->logicalDevice, this->pipelineCache, &dataSize, nullptr);
+    std::vector<char> cacheData(dataSize);
+    VkResult result = vkGetPipelineCacheData(this->m_vulkan->m_logicalDevice->logicalDevice, this->pipelineCache,
+                                             &dataSize, cacheData.data());
+    if (result != VK_SUCCESS || dataSize == 0) return;
+
+    PipelineCacheFileHeader header = currentDeviceHeader(this->m_vulkan->m_physicalDevice.get(), dataSize);
+    std::string temporaryPath = this->cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(cacheData.data(), (std::streamsize) dataSize);
+        if (!file) {
+            spdlog::warn("Could not write the pipeline cache to '{0}'.", temporaryPath);
+            return;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), this->cachePath.c_str()) != 0) {
+        spdlog::warn("Could not replace the saved pipeline cache at '{0}'.", this->cachePath);
+        std::remove(temporaryPath.c_str());
+        return;
+    }
+    VULKRAY_LOG_DEBUG("Saved the pipeline cache. ({0} bytes)", dataSize);
+}
@@ -0,0 +1,170 @@
+/*
+ * PipelineLibrary.cxx
+ * Compiles graphics pipeline variants in the background and caches the shader binaries they use.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include "../../include/Vulkray/JobManager.h"
+#include "../../include/Vulkray/Profiler.h"
+#include <spdlog/spdlog.h>
+
+const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325;
+const uint64_t FNV_PRIME = 0x100000001B3;
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * FNV_PRIME;
+    return hash;
+}
+
+PipelineLibrary::PipelineLibrary(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    this->defaultKey = this->hashState(PipelineState{});
+}
+
+PipelineLibrary::~PipelineLibrary() {
+    // compiles already running have to finish before their pipelines can be destroyed
+    this->shuttingDown = true;
+    try {
+        if (this->m_vulkan->base->jobManager != nullptr) this->m_vulkan->base->jobManager->_wait_for_background_tasks();
+    } catch (const std::exception &) {} // a failed compile was logged already, it left no pipeline to destroy
+    for (auto &[key, variant] : this->variants) {
+        VkPipeline pipeline = variant->pipeline.load();
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(this->m_vulkan->m_logicalDevice->logicalDevice, pipeline, nullptr);
+        }
+    }
+}
+
+/* FNV-1a over the shader paths and the packed fixed function state. The render pass' sample count is part
+ * of the key as well, every pipeline is built against it.
+ */
+PipelineKey PipelineLibrary::hashState(const PipelineState &state) {
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, state.vertexShader.data(), state.vertexShader.size());
+    hash = hashBytes(hash, "\0", 1); // keeps "ab" + "c" apart from "a" + "bc"
+    hash = hashBytes(hash, state.fragmentShader.data(), state.fragmentShader.size());
+    uint64_t packedState = (uint64_t) state.cullMode | (uint64_t) state.topology << 8 |
+                           (uint64_t) state.alphaBlending << 16 |
+                           (uint64_t) this->m_vulkan->m_physicalDevice->msaaSamples << 24 |
+                           (uint64_t) state.vertexFormat << 32;
+    return hashBytes(hash, &packedState, sizeof(packedState));
+}
+
+/* Returns the variant's key right away, its pipeline is compiled by the next idle worker. Variants of other
+ * vertex formats than the default one also request the default state in their format, it's drawn with until
+ * the variant is ready (the default pipeline can't read their vertices).
+ */
+PipelineKey PipelineLibrary::requestPipeline(const PipelineState &state) {
+    PipelineKey key = this->hashState(state);
+    if (key == this->defaultKey || this->variants.count(key) > 0) return key;
+    PipelineKey fallbackKey = this->defaultKey;
+    if (state.vertexFormat != VERTEX_FORMAT_DEFAULT) {
+        PipelineState fallback;
+        fallback.vertexFormat = state.vertexFormat;
+        fallbackKey = this->hashState(fallback);
+        if (fallbackKey != key) this->requestPipeline(fallback);
+    }
+
+    auto variant = std::make_unique<PipelineVariant>();
+    variant->library = this;
+    variant->state = state;
+    variant->fallbackKey = fallbackKey;
+    PipelineVariant *pVariant = variant.get(); // stable, the map only holds pointers to variants
+    this->variants[key] = std::move(variant);
+    VULKRAY_LOG_DEBUG("Compiling a new pipeline variant. ({0}, {1})", state.vertexShader, state.fragmentShader);
+    this->m_vulkan->base->jobManager->_run_background(pVariant, &PipelineLibrary::compileVariantTask, 0);
+    return key;
+}
+
+// Called while recording draws (possibly from the parallel recorder's workers, the map isn't modified then)
+VkPipeline PipelineLibrary::getPipeline(PipelineKey key) {
+    auto variant = this->variants.find(key);
+    if (variant == this->variants.end()) return this->m_vulkan->m_graphicsPipeline->graphicsPipeline.load();
+    VkPipeline pipeline = variant->second->pipeline.load();
+    if (pipeline != VK_NULL_HANDLE) return pipeline;
+    PipelineKey fallbackKey = variant->second->fallbackKey;
+    if (fallbackKey == this->defaultKey) return this->m_vulkan->m_graphicsPipeline->graphicsPipeline.load();
+    if (fallbackKey == key) return VK_NULL_HANDLE; // the vertex format's default pipeline itself isn't ready
+    return this->variants.at(fallbackKey)->pipeline.load();
+}
+
+// The default pipeline finishing its (startup) compile counts as a ready variant too
+bool PipelineLibrary::takeReadyVariants() {
+    bool ready = this->variantsReady.exchange(false);
+    if (this->defaultPipelinePending && this->m_vulkan->m_graphicsPipeline->graphicsPipeline.load() != VK_NULL_HANDLE) {
+        this->defaultPipelinePending = false;
+        ready = true;
+    }
+    return ready;
+}
+
+std::shared_ptr<const std::vector<char>> PipelineLibrary::getShaderBinary(const std::string &filename) {
+    std::unique_lock<std::mutex> lock(this->shaderMutex);
+    if (this->shaderBinaries.count(filename) > 0) {
+        // waits for the thread reading it (e.g. a preload), instead of reading the file twice
+        this->shaderLoaded.wait(lock, [this, &filename] {
+            auto binary = this->shaderBinaries.find(filename);
+            return binary == this->shaderBinaries.end() || !binary->second.loading;
+        });
+        auto binary = this->shaderBinaries.find(filename);
+        if (binary != this->shaderBinaries.end()) return binary->second.code;
+        // that read failed, so it's read again here (reporting the error on this thread)
+    }
+    this->shaderBinaries[filename] = ShaderBinary{};
+    lock.unlock();
+
+    std::shared_ptr<const std::vector<char>> shaderCode;
+    try {
+        shaderCode = std::make_shared<const std::vector<char>>(GraphicsPipeline::readSpirVShaderBinary(filename));
+    } catch (const std::runtime_error &) {
+        lock.lock();
+        this->shaderBinaries.erase(filename);
+        lock.unlock();
+        this->shaderLoaded.notify_all();
+        throw;
+    }
+    lock.lock();
+    this->shaderBinaries[filename] = ShaderBinary{shaderCode, false};
+    lock.unlock();
+    this->shaderLoaded.notify_all();
+    return shaderCode;
+}
+
+// Reads the binaries on idle workers while the renderer's other modules are still being created
+void PipelineLibrary::preloadShaders(std::vector<std::string> filenames) {
+    this->preloadFilenames = std::move(filenames); // the tasks index into it, so it's never modified again
+    for (uint32_t i = 0; i < this->preloadFilenames.size(); i++) {
+        this->m_vulkan->base->jobManager->_run_background(this, &PipelineLibrary::preloadShaderTask, i);
+    }
+}
+
+void PipelineLibrary::preloadShaderTask(void *caller, uint32_t index) {
+    auto library = static_cast<PipelineLibrary*>(caller);
+    if (library->shuttingDown) return;
+    ProfilePhase phase(library->m_vulkan->base->profiler.get(), "shader preload");
+    try {
+        library->getShaderBinary(library->preloadFilenames[index]);
+    } catch (const std::runtime_error &) {
+        // the pipeline using it reads it again, and fails with the error
+    }
+}
+
+// A variant that fails to compile is logged and keeps drawing with the default pipeline
+void PipelineLibrary::compileVariantTask(void *caller, uint32_t index) {
+    auto variant = static_cast<PipelineVariant*>(caller);
+    PipelineLibrary *library = variant->library;
+    if (library->shuttingDown) return;
+    try {
+        variant->pipeline = library->m_vulkan->m_graphicsPipeline->createPipeline(variant->state);
+        library->variantsReady = true;
+    } catch (const std::runtime_error &error) {
+        spdlog::error("A pipeline variant failed to compile, it's drawn with the default pipeline of its vertex "
+                      "format. ({0})", error.what());
+    }
+}
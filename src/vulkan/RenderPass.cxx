@@ -1,6 +1,6 @@
 /*
  * RenderPass.cxx
- * Creates the Vulkan render pass instance for the graphics pipeline.
+ * Builds the frame's render graph & creates the Vulkan render passes of its compiled plan.
  *
  * VULKRAY ENGINE SOFTWARE
  * Copyright (c) 2023, Max Rodriguez. All rights reserved.
@@ -16,89 +16,264 @@
 
 RenderPass::RenderPass(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
-    VkAttachmentDescription colorAttachment{}; // Create color image attachment
-    colorAttachment.format = this->m_vulkan->m_swapChain->swapChainImageFormat;
-    colorAttachment.samples = this->m_vulkan->m_physicalDevice->msaaSamples;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription depthAttachment{}; // Create depth image attachment
-    depthAttachment.format = this->m_vulkan->m_physicalDevice->findDepthFormat();
-    depthAttachment.samples = this->m_vulkan->m_physicalDevice->msaaSamples;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription colorAttachmentResolve{};
-    colorAttachmentResolve.format = this->m_vulkan->m_swapChain->swapChainImageFormat;
-    colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentResolveRef{};
-    colorAttachmentResolveRef.attachment = 2;
-    colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorAttachmentResolveRef;
-
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-    // Store all attachments in a single vector
-    std::array<VkAttachmentDescription, 3> attachments = {
-            colorAttachment, // color attachment (fragment render)
-            depthAttachment, // depth attachment (depth testing)
-            colorAttachmentResolve // color attachment resolve (post-MSAA)
+    this->buildFrameGraph();
+    this->renderPasses.resize(this->plan.groups.size(), VK_NULL_HANDLE);
+    for (size_t i = 0; i < this->plan.groups.size(); i++) {
+        if (this->plan.groups[i].type != RENDER_PASS_RASTER || this->plan.groups[i].passes.empty()) continue;
+        this->renderPasses[i] = this->createRenderPass(this->plan.groups[i]);
+    }
+    this->renderPass = this->renderPasses[this->plan.passGroups[this->scenePass]];
+    this->sceneSubpass = this->plan.passSubpasses[this->scenePass];
+}
+
+RenderPass::~RenderPass() {
+    for (VkRenderPass groupRenderPass : this->renderPasses) {
+        if (groupRenderPass == VK_NULL_HANDLE) continue;
+        vkDestroyRenderPass(this->m_vulkan->m_logicalDevice->logicalDevice, groupRenderPass, nullptr);
+    }
+}
+
+/* Declares the frame: the GPU culling pre-pass, the scene pass & (headless) the readback copy. The scene is
+ * drawn multisampled & resolved into the swap image, the multisampled color & the depth image never leave the
+ * render pass, so the plan marks them transient (lazily allocated, tile memory only on tiled GPUs).
+ */
+void RenderPass::buildFrameGraph() {
+    RenderGraph graph;
+    bool headless = this->m_vulkan->base->config.headless;
+    // headless frames are copied to their readback buffer instead of being presented
+    this->frameImage = graph.import_image("frame", this->m_vulkan->m_swapChain->swapChainImageFormat,
+                                          headless ? RENDER_USAGE_TRANSFER_SRC : RENDER_USAGE_PRESENT);
+    uint32_t samples = this->m_vulkan->m_physicalDevice->msaaSamples;
+    RenderImage depth = graph.add_image("depth", this->m_vulkan->m_physicalDevice->findDepthFormat(), samples);
+
+    // culling writes the draw & instance buffers (its own barriers order them), not any graph image
+    if (this->m_vulkan->base->config.gpuCulling) {
+        this->cullingPass = graph.add_pass("culling", RENDER_PASS_COMPUTE, true);
+    }
+    this->scenePass = graph.add_pass("scene", RENDER_PASS_RASTER);
+    if (samples > VK_SAMPLE_COUNT_1_BIT) {
+        RenderImage color = graph.add_image("color", this->m_vulkan->m_swapChain->swapChainImageFormat, samples);
+        graph.write_color(this->scenePass, color, true);
+        graph.write_resolve(this->scenePass, this->frameImage);
+    } else { // without MSAA there's nothing to resolve, the scene is drawn into the swap image directly
+        graph.write_color(this->scenePass, this->frameImage, true);
+    }
+    graph.write_depth(this->scenePass, depth, true);
+    if (headless) {
+        this->readbackPass = graph.add_pass("readback", RENDER_PASS_TRANSFER, true);
+        graph.read(this->readbackPass, this->frameImage, RENDER_USAGE_TRANSFER_SRC);
+    }
+    this->plan = graph.compile();
+}
+
+VkRenderPass RenderPass::createRenderPass(const RenderGroupPlan &group) {
+
+    std::vector<VkAttachmentDescription> attachments(group.attachments.size());
+    for (size_t i = 0; i < group.attachments.size(); i++) {
+        const RenderAttachmentPlan &attachmentPlan = group.attachments[i];
+        const RenderGraphImage &image = this->plan.images[attachmentPlan.image];
+        VkAttachmentDescription &attachment = attachments[i];
+        attachment.format = (VkFormat) image.format;
+        attachment.samples = (VkSampleCountFlagBits) image.samples;
+        switch (attachmentPlan.loadOp) {
+            case RENDER_LOAD_CLEAR: attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; break;
+            case RENDER_LOAD_LOAD: attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD; break;
+            default: attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; break;
+        }
+        // not stored attachments are only ever in tile memory
+        attachment.storeOp = attachmentPlan.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = getUsageLayout(attachmentPlan.initialUsage, image.depth);
+        attachment.finalLayout = getUsageLayout(attachmentPlan.finalUsage, image.depth);
+    }
+
+    // attachment references of every subpass (kept alive until the render pass is created)
+    auto makeReferences = [&group, this](const std::vector<uint32_t> &indices, uint32_t usage) {
+        std::vector<VkAttachmentReference> references;
+        for (uint32_t index : indices) {
+            if (index == RENDER_GRAPH_NONE) {
+                references.push_back({VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+                continue;
+            }
+            bool depth = this->plan.images[group.attachments[index].image].depth;
+            references.push_back({index, getUsageLayout(usage, depth)});
+        }
+        return references;
     };
+    std::vector<std::vector<VkAttachmentReference>> colorReferences, resolveReferences, inputReferences;
+    std::vector<VkAttachmentReference> depthReferences(group.subpasses.size());
+    std::vector<VkSubpassDescription> subpasses(group.subpasses.size());
+    for (size_t i = 0; i < group.subpasses.size(); i++) {
+        const RenderSubpassPlan &subpassPlan = group.subpasses[i];
+        colorReferences.push_back(makeReferences(subpassPlan.colorAttachments, RENDER_USAGE_COLOR_ATTACHMENT));
+        resolveReferences.push_back(makeReferences(subpassPlan.resolveAttachments,
+                                                   RENDER_USAGE_RESOLVE_ATTACHMENT));
+        inputReferences.push_back(makeReferences(subpassPlan.inputAttachments, RENDER_USAGE_INPUT_ATTACHMENT));
+
+        VkSubpassDescription &subpass = subpasses[i];
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences[i].size());
+        subpass.pColorAttachments = colorReferences[i].data();
+        subpass.pResolveAttachments = resolveReferences[i].empty() ? nullptr : resolveReferences[i].data();
+        subpass.inputAttachmentCount = static_cast<uint32_t>(inputReferences[i].size());
+        subpass.pInputAttachments = inputReferences[i].data();
+        if (subpassPlan.depthAttachment != RENDER_GRAPH_NONE) {
+            depthReferences[i] = {subpassPlan.depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+            subpass.pDepthStencilAttachment = &depthReferences[i];
+        }
+    }
+
+    std::vector<VkSubpassDependency> dependencies;
+    for (const RenderDependencyPlan &dependencyPlan : group.dependencies) {
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = dependencyPlan.srcSubpass == RENDER_GRAPH_EXTERNAL ? VK_SUBPASS_EXTERNAL
+                                                                                   : dependencyPlan.srcSubpass;
+        dependency.dstSubpass = dependencyPlan.dstSubpass == RENDER_GRAPH_EXTERNAL ? VK_SUBPASS_EXTERNAL
+                                                                                   : dependencyPlan.dstSubpass;
+        dependency.srcStageMask = getUsageStages(dependencyPlan.srcUsages);
+        dependency.srcAccessMask = getUsageAccess(dependencyPlan.srcUsages);
+        dependency.dstStageMask = getUsageStages(dependencyPlan.dstUsages);
+        dependency.dstAccessMask = getUsageAccess(dependencyPlan.dstUsages);
+        // images without contents still wait on the stages that last used their memory (the previous frame)
+        if (dependency.srcStageMask == 0) dependency.srcStageMask = dependency.dstStageMask;
+        if (dependency.dstStageMask == 0) dependency.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        dependency.dependencyFlags = dependencyPlan.byRegion ? VK_DEPENDENCY_BY_REGION_BIT : 0;
+        dependencies.push_back(dependency);
+    }
 
     // Configure Render Pass instance
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
     // Create the Vulkan render pass instance
+    VkRenderPass groupRenderPass = VK_NULL_HANDLE;
     VkResult result = vkCreateRenderPass(this->m_vulkan->m_logicalDevice->logicalDevice,
-                                         &renderPassInfo, nullptr, &this->renderPass);
+                                         &renderPassInfo, nullptr, &groupRenderPass);
     if (result != VK_SUCCESS) {
         spdlog::error("An error occurred while initializing the Vulkan render pass instance.");
         throw std::runtime_error("Failed to create the render pass.");
     }
+    return groupRenderPass;
 }
 
-RenderPass::~RenderPass() {
-    vkDestroyRenderPass(this->m_vulkan->m_logicalDevice->logicalDevice, this->renderPass, nullptr);
-}
\ No newline at end of file
+VkImage RenderPass::getImage(RenderImage image, uint32_t imageIndex) {
+    if (image == this->frameImage) return this->m_vulkan->m_swapChain->swapChainImages[imageIndex];
+    return this->m_vulkan->m_renderTargets->getImage(image);
+}
+
+// one per attachment of the group's render pass, only the cleared ones are read
+std::vector<VkClearValue> RenderPass::getClearValues(uint32_t group) {
+    const RenderGroupPlan &groupPlan = this->plan.groups[group];
+    std::vector<VkClearValue> clearValues(groupPlan.attachments.size());
+    for (size_t i = 0; i < groupPlan.attachments.size(); i++) {
+        if (this->plan.images[groupPlan.attachments[i].image].depth) {
+            clearValues[i].depthStencil = {1.0f, 0}; // 1.0f is the far plane Z value (maximum far)
+        } else {
+            clearValues[i].color = this->m_vulkan->graphicsInput.bufferClearColor.color;
+        }
+    }
+    return clearValues;
+}
+
+// Records the layout changes the plan puts ahead of the group (render passes change their attachments' layouts)
+void RenderPass::recordBarriers(VkCommandBuffer commandBuffer, uint32_t group, uint32_t imageIndex) {
+    const RenderGroupPlan &groupPlan = this->plan.groups[group];
+    if (groupPlan.barriers.empty()) return;
+
+    std::vector<VkImageMemoryBarrier> barriers;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    for (const RenderBarrierPlan &barrierPlan : groupPlan.barriers) {
+        bool depth = this->plan.images[barrierPlan.image].depth;
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = getUsageLayout(barrierPlan.oldUsage, depth);
+        barrier.newLayout = getUsageLayout(barrierPlan.newUsage, depth);
+        barrier.srcAccessMask = getUsageAccess(1u << barrierPlan.oldUsage);
+        barrier.dstAccessMask = getUsageAccess(1u << barrierPlan.newUsage);
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = this->getImage(barrierPlan.image, imageIndex);
+        barrier.subresourceRange.aspectMask = depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barriers.push_back(barrier);
+        srcStages |= getUsageStages(1u << barrierPlan.oldUsage);
+        dstStages |= getUsageStages(1u << barrierPlan.newUsage);
+    }
+    if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; // contents are discarded
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+// --------- Mapping of the render graph's image usages to Vulkan ---------- //
+
+VkImageLayout RenderPass::getUsageLayout(uint32_t usage, bool depth) {
+    switch (usage) {
+        case RENDER_USAGE_COLOR_ATTACHMENT:
+        case RENDER_USAGE_RESOLVE_ATTACHMENT:
+            return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case RENDER_USAGE_DEPTH_ATTACHMENT:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case RENDER_USAGE_INPUT_ATTACHMENT:
+        case RENDER_USAGE_SAMPLED:
+            return depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        case RENDER_USAGE_STORAGE:
+            return VK_IMAGE_LAYOUT_GENERAL;
+        case RENDER_USAGE_TRANSFER_SRC:
+            return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        case RENDER_USAGE_TRANSFER_DST:
+            return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        case RENDER_USAGE_PRESENT:
+            return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        default:
+            return VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+}
+
+// 0 for RENDER_USAGE_UNDEFINED (nothing to wait on), callers substitute a stage where Vulkan requires one
+VkPipelineStageFlags RenderPass::getUsageStages(uint32_t usages) {
+    VkPipelineStageFlags stages = 0;
+    if (usages & (1u << RENDER_USAGE_COLOR_ATTACHMENT | 1u << RENDER_USAGE_RESOLVE_ATTACHMENT)) {
+        stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_DEPTH_ATTACHMENT) {
+        stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_INPUT_ATTACHMENT) stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (usages & 1u << RENDER_USAGE_SAMPLED) {
+        stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_STORAGE) stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (usages & (1u << RENDER_USAGE_TRANSFER_SRC | 1u << RENDER_USAGE_TRANSFER_DST)) {
+        stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_PRESENT) stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    return stages;
+}
+
+VkAccessFlags RenderPass::getUsageAccess(uint32_t usages) {
+    VkAccessFlags access = 0;
+    if (usages & 1u << RENDER_USAGE_COLOR_ATTACHMENT) {
+        access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_RESOLVE_ATTACHMENT) access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    if (usages & 1u << RENDER_USAGE_DEPTH_ATTACHMENT) {
+        access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+    if (usages & 1u << RENDER_USAGE_INPUT_ATTACHMENT) access |= VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    if (usages & 1u << RENDER_USAGE_SAMPLED) access |= VK_ACCESS_SHADER_READ_BIT;
+    if (usages & 1u << RENDER_USAGE_STORAGE) access |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    if (usages & 1u << RENDER_USAGE_TRANSFER_SRC) access |= VK_ACCESS_TRANSFER_READ_BIT;
+    if (usages & 1u << RENDER_USAGE_TRANSFER_DST) access |= VK_ACCESS_TRANSFER_WRITE_BIT;
+    return access; // none for presenting (the present semaphore orders it)
+}
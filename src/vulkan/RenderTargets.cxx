@@ -0,0 +1,96 @@
+/*
+ * RenderTargets.cxx
+ * Allocates the images the frame's render graph owns, transient attachments use lazily allocated memory.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+RenderTargets::RenderTargets(Vulkan *m_vulkan, VkExtent2D minimumExtent): VkModuleBase(m_vulkan) {
+
+    // never shrinks below the given extent, so resizing back and forth reuses the images (high-water mark)
+    this->imageExtent.width = std::max(this->m_vulkan->m_swapChain->swapChainExtent.width, minimumExtent.width);
+    this->imageExtent.height = std::max(this->m_vulkan->m_swapChain->swapChainExtent.height, minimumExtent.height);
+
+    const std::vector<RenderSlotPlan> &slots = this->m_vulkan->m_renderPass->plan.slots;
+    this->images.resize(slots.size());
+    this->imageViews.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        const RenderSlotPlan &slot = slots[i];
+        VkImageUsageFlags usageFlags = 0;
+        if (slot.usages & (1 << RENDER_USAGE_COLOR_ATTACHMENT | 1 << RENDER_USAGE_RESOLVE_ATTACHMENT)) {
+            usageFlags |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        }
+        if (slot.usages & 1 << RENDER_USAGE_DEPTH_ATTACHMENT) {
+            usageFlags |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        }
+        if (slot.usages & 1 << RENDER_USAGE_INPUT_ATTACHMENT) usageFlags |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        if (slot.usages & 1 << RENDER_USAGE_SAMPLED) usageFlags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (slot.usages & 1 << RENDER_USAGE_STORAGE) usageFlags |= VK_IMAGE_USAGE_STORAGE_BIT;
+        if (slot.usages & 1 << RENDER_USAGE_TRANSFER_SRC) usageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if (slot.usages & 1 << RENDER_USAGE_TRANSFER_DST) usageFlags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+        VkFormat format = (VkFormat) slot.format;
+        VkSampleCountFlagBits samples = (VkSampleCountFlagBits) slot.samples;
+        VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO;
+        if (slot.lazy) { // never leaves tile memory, GPUs without lazily allocated memory fall back to device memory
+            usageFlags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = format;
+            imageInfo.extent = {this->imageExtent.width, this->imageExtent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = samples;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = usageFlags;
+            VmaAllocationCreateInfo allocationInfo{};
+            allocationInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            uint32_t memoryTypeIndex;
+            if (vmaFindMemoryTypeIndexForImageInfo(this->m_vulkan->m_VMA->memoryAllocator, &imageInfo,
+                                                   &allocationInfo, &memoryTypeIndex) == VK_SUCCESS) {
+                memoryUsage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            }
+        }
+        ImageViews::allocateVMAImage(this->m_vulkan->m_VMA->memoryAllocator, &this->images[i],
+                                     this->imageExtent.width, this->imageExtent.height, VK_IMAGE_TILING_OPTIMAL,
+                                     samples, usageFlags, format, 1,
+                                     VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, memoryUsage);
+        this->m_vulkan->m_VMA->track(this->images[i]._imageMemory, MEMORY_CATEGORY_IMAGE);
+        this->imageViews[i] = ImageViews::createImageView(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                          this->images[i]._imageInstance, format,
+                                                          slot.depth ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                                                     : VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    // no layout transitions needed, the render passes & the plan's barriers move the images out of UNDEFINED
+}
+
+RenderTargets::~RenderTargets() {
+    for (size_t i = 0; i < this->images.size(); i++) {
+        vkDestroyImageView(this->m_vulkan->m_logicalDevice->logicalDevice, this->imageViews[i], nullptr);
+        this->m_vulkan->m_VMA->untrack(this->images[i]._imageMemory);
+        vmaDestroyImage(this->m_vulkan->m_VMA->memoryAllocator,
+                        this->images[i]._imageInstance, this->images[i]._imageMemory);
+    }
+}
+// Framebuffers can use attachments larger than themselves, only the render area is drawn to
+bool RenderTargets::covers(VkExtent2D extent) {
+    return extent.width <= this->imageExtent.width && extent.height <= this->imageExtent.height;
+}
+
+VkImage RenderTargets::getImage(RenderImage image) {
+    return this->images[this->m_vulkan->m_renderPass->plan.images[image].slot]._imageInstance;
+}
+
+VkImageView RenderTargets::getImageView(RenderImage image) {
+    return this->imageViews[this->m_vulkan->m_renderPass->plan.images[image].slot];
+}
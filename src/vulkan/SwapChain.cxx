@@ -18,13 +18,18 @@
 #include <algorithm>
 
 SwapChain::SwapChain(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
+    if (this->m_vulkan->base->config.headless) {
+        this->createOffscreenImages();
+        return;
+    }
     // Get device swap chain support info
     SwapChainSupportDetails supportDetails = SwapChain::querySwapChainSupport(
             this->m_vulkan->m_physicalDevice->physicalDevice, this->m_vulkan->m_window->surface);
 
     // Choose swap chain configuration
     VkSurfaceFormatKHR surfaceFormat = SwapChain::chooseSurfaceFormat(supportDetails.formats);
-    VkPresentModeKHR presentMode = SwapChain::choosePresentMode(supportDetails.presentModes);
+    VkPresentModeKHR presentMode = SwapChain::choosePresentMode(supportDetails.presentModes,
+                                                                this->m_vulkan->base->config.presentMode);
     VkExtent2D swapExtent = SwapChain::chooseSwapExtent(supportDetails.capabilities, this->m_vulkan->m_window->window);
     uint32_t imageCount = supportDetails.capabilities.minImageCount + 1;
 
@@ -114,7 +119,38 @@ SwapChain::SwapChain(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 }
 
 SwapChain::~SwapChain() {
-    vkDestroySwapchainKHR(this->m_vulkan->m_logicalDevice->logicalDevice, this->swapChain, nullptr);
+    if (this->swapChain != VK_NULL_HANDLE) { // the swap chain extension isn't enabled in headless mode
+        vkDestroySwapchainKHR(this->m_vulkan->m_logicalDevice->logicalDevice, this->swapChain, nullptr);
+    }
+    for (AllocatedImage &image : this->offscreenImages) {
+        this->m_vulkan->m_VMA->untrack(image._imageMemory);
+        vmaDestroyImage(this->m_vulkan->m_VMA->memoryAllocator, image._imageInstance, image._imageMemory);
+    }
+}
+
+/* Headless mode: one offscreen image per frame in flight (a frame always renders into the image of its frame
+ * index, so it's free again once the frame was waited on). They're copied to the readback buffers
+ * after the render pass, which leaves them in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL instead of presenting them.
+ */
+void SwapChain::createOffscreenImages() {
+    this->swapChainImageFormat = HEADLESS_COLOR_FORMAT;
+    this->swapChainExtent = {this->m_vulkan->base->config.headlessWidth, this->m_vulkan->base->config.headlessHeight};
+    if (this->swapChainExtent.width == 0 || this->swapChainExtent.height == 0) {
+        spdlog::error("EngineConfig::headlessWidth & headlessHeight have to be at least 1 pixel.");
+        throw std::runtime_error("Invalid headless render resolution!");
+    }
+    this->offscreenImages.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+    for (AllocatedImage &image : this->offscreenImages) {
+        ImageViews::allocateVMAImage(this->m_vulkan->m_VMA->memoryAllocator, &image,
+                                     this->swapChainExtent.width, this->swapChainExtent.height,
+                                     VK_IMAGE_TILING_OPTIMAL, VK_SAMPLE_COUNT_1_BIT,
+                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                     this->swapChainImageFormat);
+        this->m_vulkan->m_VMA->track(image._imageMemory, MEMORY_CATEGORY_IMAGE);
+        this->swapChainImages.push_back(image._imageInstance);
+    }
+    VULKRAY_LOG_DEBUG("Rendering headless into {0} offscreen images. ({1}x{2})", this->swapChainImages.size(),
+                      this->swapChainExtent.width, this->swapChainExtent.height);
 }
 
 SwapChainSupportDetails SwapChain::querySwapChainSupport(VkPhysicalDevice gpuDevice, VkSurfaceKHR surface) {
@@ -155,12 +191,14 @@ VkSurfaceFormatKHR SwapChain::chooseSurfaceFormat(const std::vector <VkSurfaceFo
     return availableFormats[0];
 }
 
-VkPresentModeKHR SwapChain::choosePresentMode(const std::vector <VkPresentModeKHR> &availablePresentModes) {
+VkPresentModeKHR SwapChain::choosePresentMode(const std::vector <VkPresentModeKHR> &availablePresentModes,
+                                              VkPresentModeKHR requestedMode) {
 
-    // Look for the preferred swap presentation mode
+    // Look for the requested swap presentation mode
     for (const auto &availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == PREFERRED_PRESENTATION) return availablePresentMode;
+        if (availablePresentMode == requestedMode) return availablePresentMode;
     }
+    VULKRAY_LOG_DEBUG("Present mode {0} is not supported by the surface, falling back to FIFO.", (int) requestedMode);
     return DEFAULT_PRESENTATION;
 }
 
@@ -1,6 +1,6 @@
 /*
  * Synchronization.cxx
- * Creates the Vulkan semaphores/fences instances for GPU/CPU synchronization.
+ * Creates the Vulkan semaphores for GPU/CPU synchronization (the frame timeline) & batches the queue submits.
  *
  * VULKRAY ENGINE SOFTWARE
  * Copyright (c) 2023, Max Rodriguez. All rights reserved.
@@ -15,31 +15,36 @@
 
 Synchronization::Synchronization(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
 
-    // resize semaphore and fence vectors to max frames in flight value
+    // resize semaphore vectors to max frames in flight value
     this->imageAvailableSemaphores.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
     this->renderFinishedSemaphores.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
-    this->inFlightFences.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT);
+    this->frameValues.resize(this->m_vulkan->MAX_FRAMES_IN_FLIGHT, 0); // value 0 is signalled from the start
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // start fence signaled (to render first frame)
-
-    // create each semaphore & fence for each frame that can be drawn in flight
+    // the swap chain only works with binary semaphores, so acquire & present keep one each per frame in flight
     for (unsigned int i = 0; i < this->m_vulkan->MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(this->m_vulkan->m_logicalDevice->logicalDevice, &semaphoreInfo, nullptr,
                               &this->imageAvailableSemaphores.at(i)) != VK_SUCCESS ||
             vkCreateSemaphore(this->m_vulkan->m_logicalDevice->logicalDevice, &semaphoreInfo, nullptr,
-                              &this->renderFinishedSemaphores.at(i)) != VK_SUCCESS ||
-            vkCreateFence(this->m_vulkan->m_logicalDevice->logicalDevice, &fenceInfo, nullptr,
-                          &this->inFlightFences.at(i)) != VK_SUCCESS) {
+                              &this->renderFinishedSemaphores.at(i)) != VK_SUCCESS) {
 
-            spdlog::error("An error occurred while initializing the Vulkan semaphores and fence instances.");
+            spdlog::error("An error occurred while initializing the Vulkan semaphore instances.");
             throw std::runtime_error("Failed to create the synchronization objects!");
         }
     }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+    semaphoreInfo.pNext = &timelineInfo;
+    if (vkCreateSemaphore(this->m_vulkan->m_logicalDevice->logicalDevice, &semaphoreInfo, nullptr,
+                          &this->frameTimeline) != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the frame timeline semaphore.");
+        throw std::runtime_error("Failed to create the frame timeline semaphore!");
+    }
 }
 
 Synchronization::~Synchronization() {
@@ -48,7 +53,116 @@ Synchronization::~Synchronization() {
                            this->imageAvailableSemaphores.at(i), nullptr);
         vkDestroySemaphore(this->m_vulkan->m_logicalDevice->logicalDevice,
                            this->renderFinishedSemaphores.at(i), nullptr);
-        vkDestroyFence(this->m_vulkan->m_logicalDevice->logicalDevice,
-                       this->inFlightFences.at(i), nullptr);
     }
-}
\ No newline at end of file
+    vkDestroySemaphore(this->m_vulkan->m_logicalDevice->logicalDevice, this->frameTimeline, nullptr);
+}
+
+uint64_t Synchronization::getPendingValue() {
+    return this->submittedValue + 1;
+}
+
+// A single counter read, cheap enough to poll every frame
+uint64_t Synchronization::getCompletedValue() {
+    uint64_t currentValue = 0;
+    vkGetSemaphoreCounterValue(this->m_vulkan->m_logicalDevice->logicalDevice, this->frameTimeline, &currentValue);
+    return currentValue;
+}
+
+// Called by the frame's graphics submit (the value is only handed out to frames that do submit)
+uint64_t Synchronization::frameSubmitted(uint32_t frameIndex) {
+    this->frameValues[frameIndex] = ++this->submittedValue;
+    return this->submittedValue;
+}
+
+void Synchronization::waitForFrame(uint32_t frameIndex) {
+    this->waitFor(this->frameValues[frameIndex]);
+}
+
+void Synchronization::waitFor(uint64_t value) {
+    if (this->getCompletedValue() >= value) return;
+    this->flushSubmits(); // the value may be signalled by a queued submit
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &this->frameTimeline;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(this->m_vulkan->m_logicalDevice->logicalDevice, &waitInfo, UINT64_MAX);
+}
+
+/* Queues up a submit of a single command buffer, the semaphores are copied (the lists can be temporaries).
+ * Note: Not thread safe, every queue is submitted to from the render thread.
+ */
+void Synchronization::queueSubmit(VkQueue queue, VkCommandBuffer commandBuffer,
+                                  std::initializer_list<SubmitSemaphore> waits,
+                                  std::initializer_list<SubmitSemaphore> signals) {
+    QueuedSubmit submit{queue, commandBuffer, static_cast<uint32_t>(this->queuedSemaphores.size()), 0, 0};
+    for (const SubmitSemaphore &wait : waits) {
+        if (wait.semaphore == VK_NULL_HANDLE) continue;
+        this->queuedSemaphores.push_back(wait.semaphore);
+        this->queuedValues.push_back(wait.value);
+        this->queuedStages.push_back(wait.stages);
+        submit.waitCount++;
+    }
+    for (const SubmitSemaphore &signal : signals) {
+        if (signal.semaphore == VK_NULL_HANDLE) continue;
+        this->queuedSemaphores.push_back(signal.semaphore);
+        this->queuedValues.push_back(signal.value);
+        this->queuedStages.push_back(0);
+        submit.signalCount++;
+    }
+    this->queuedSubmits.push_back(submit);
+}
+
+/* Submits everything queued so far, a single vkQueueSubmit per queue. The queues are submitted to in the order
+ * they were first queued for, the submits of every queue stay in their queued order.
+ * Called once per frame (before the present) and before any CPU wait on work that may still be queued.
+ */
+void Synchronization::flushSubmits() {
+    if (this->queuedSubmits.empty()) return;
+    // sized up front, the submit infos point at the timeline infos
+    this->submitInfos.resize(this->queuedSubmits.size());
+    this->timelineInfos.resize(this->queuedSubmits.size());
+
+    for (size_t first = 0; first < this->queuedSubmits.size(); first++) {
+        VkQueue queue = this->queuedSubmits[first].queue;
+        if (queue == VK_NULL_HANDLE) continue; // already went out with an earlier queue's vkQueueSubmit
+
+        uint32_t submitCount = 0;
+        for (size_t i = first; i < this->queuedSubmits.size(); i++) {
+            QueuedSubmit &submit = this->queuedSubmits[i];
+            if (submit.queue != queue) continue;
+            uint32_t firstSignal = submit.firstWait + submit.waitCount;
+
+            VkTimelineSemaphoreSubmitInfo &timelineInfo = this->timelineInfos[submitCount];
+            timelineInfo = {};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = submit.waitCount;
+            timelineInfo.pWaitSemaphoreValues = this->queuedValues.data() + submit.firstWait;
+            timelineInfo.signalSemaphoreValueCount = submit.signalCount;
+            timelineInfo.pSignalSemaphoreValues = this->queuedValues.data() + firstSignal;
+
+            VkSubmitInfo &submitInfo = this->submitInfos[submitCount];
+            submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = submit.waitCount;
+            submitInfo.pWaitSemaphores = this->queuedSemaphores.data() + submit.firstWait;
+            submitInfo.pWaitDstStageMask = this->queuedStages.data() + submit.firstWait;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &submit.commandBuffer;
+            submitInfo.signalSemaphoreCount = submit.signalCount;
+            submitInfo.pSignalSemaphores = this->queuedSemaphores.data() + firstSignal;
+            submit.queue = VK_NULL_HANDLE;
+            submitCount++;
+        }
+        VkResult result = vkQueueSubmit(queue, submitCount, this->submitInfos.data(), VK_NULL_HANDLE);
+        if (result != VK_SUCCESS) {
+            spdlog::error("An error occurred while submitting the queued command buffers.");
+            throw std::runtime_error("Failed to submit the queued command buffers!");
+        }
+    }
+    this->queuedSubmits.clear();
+    this->queuedSemaphores.clear();
+    this->queuedValues.clear();
+    this->queuedStages.clear();
+}
@@ -0,0 +1,467 @@
+/*
+ * TextureStreamer.cxx
+ * Streams the texture registry's mip levels in & out by screen-space need, within the texture memory budget.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <vk_mem_alloc.h>
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer::TextureStreamer(Vulkan *m_vulkan, uint64_t memoryBudget,
+                                 uint64_t uploadBytesPerFrame): VkModuleBase(m_vulkan) {
+    this->memoryBudget = memoryBudget;
+    this->uploadBytesPerFrame = uploadBytesPerFrame;
+
+    // mip levels missing from a texture's image are clamped to by its view, so one sampler fits every texture
+    PhysicalDevice *m_physicalDevice = this->m_vulkan->m_physicalDevice.get();
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = m_physicalDevice->samplerAnisotropy ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = m_physicalDevice->samplerAnisotropy ?
+                                m_physicalDevice->properties.limits.maxSamplerAnisotropy : 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    VkResult result = vkCreateSampler(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                      &samplerInfo, nullptr, &this->sampler);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the texture sampler.");
+        throw std::runtime_error("Failed to create the texture sampler!");
+    }
+
+    // bindless mode: the sampler & every frame in flight's material table are written into the set once
+    DescriptorPool *m_descriptorPool = this->m_vulkan->m_descriptorPool.get();
+    if (!m_descriptorPool->bindless) return;
+    m_descriptorPool->writeSampler(this->sampler);
+    VkDeviceSize tableSize = BINDLESS_MAX_MATERIALS * sizeof(uint32_t);
+    for (uint32_t frame = 0; frame < this->m_vulkan->MAX_FRAMES_IN_FLIGHT; frame++) {
+        this->materialTables.push_back(std::make_unique<Buffer>(
+                this->m_vulkan, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, tableSize,
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT));
+        memset(this->materialTables[frame]->mappedData, 0xFF, (size_t) tableSize); // BINDLESS_NO_TEXTURE
+        vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator,
+                           this->materialTables[frame]->buffer._bufferMemory, 0, tableSize);
+        m_descriptorPool->writeStorageBuffer(frame, this->materialTables[frame]->buffer._bufferInstance, tableSize);
+    }
+    this->materialTableVersions.assign(this->m_vulkan->MAX_FRAMES_IN_FLIGHT, 0);
+}
+
+TextureStreamer::~TextureStreamer() {
+    // the renderer waits for the device to be idle first, so nothing is in use anymore
+    for (const StreamedTexture &texture : this->textures) {
+        if (texture.imageView != VK_NULL_HANDLE) this->destroyImage(texture.image, texture.imageView);
+        if (texture.pendingImageView != VK_NULL_HANDLE) {
+            this->destroyImage(texture.pendingImage, texture.pendingImageView);
+        }
+        if (texture.pendingSource._imageInstance != VK_NULL_HANDLE) {
+            this->destroyImage(texture.pendingSource, VK_NULL_HANDLE);
+        }
+    }
+    for (const CancelledUpload &upload : this->cancelledUploads) this->destroyImage(upload.image, upload.imageView);
+    vkDestroySampler(this->m_vulkan->m_logicalDevice->logicalDevice, this->sampler, nullptr);
+}
+
+/* Called by the render thread once per frame, after the geometry arena applied its operations.
+ * The residency is planned every TEXTURE_STREAMING_INTERVAL frames (and right after textures changed),
+ * uploads towards the plan are started every frame as the per-frame upload limit allows.
+ */
+void TextureStreamer::update(uint64_t frameNumber) {
+    this->flushUploads(); // left over from a skipped frame (nothing was submitted)
+    this->applyPendingOperations();
+    this->swapFinishedUploads();
+    if (this->planNeeded || frameNumber % TEXTURE_STREAMING_INTERVAL == 0) this->planResidency();
+    this->startUploads();
+    // the frame was waited on, so nothing reads its material table anymore
+    uint32_t frameIndex = this->m_vulkan->frameIndex;
+    if (!this->materialTables.empty() && this->materialTableVersions[frameIndex] != this->materialsVersion) {
+        this->writeMaterialTable(frameIndex);
+    }
+}
+
+// Sends the uploads queued this frame out in one batch (kept apart from the geometry uploads the frame waits on)
+void TextureStreamer::flushUploads() {
+    if (this->uploadSlots.empty()) return;
+    uint64_t value = this->m_vulkan->m_uploadQueue->flush();
+    for (uint32_t slot : this->uploadSlots) this->textures[slot].pendingValue = value;
+    this->uploadSlots.clear();
+}
+
+VkImageView TextureStreamer::getTextureView(uint32_t materialIndex) {
+    if (materialIndex >= this->materials.size()) return VK_NULL_HANDLE;
+    TextureHandle handle = this->materials[materialIndex];
+    if (handle.index >= this->textures.size() || this->textures[handle.index].generation != handle.generation ||
+        handle.generation == 0) {
+        return VK_NULL_HANDLE;
+    }
+    return this->textures[handle.index].imageView;
+}
+
+uint64_t TextureStreamer::getResidentBytes() {
+    uint64_t bytes = 0;
+    for (const StreamedTexture &texture : this->textures) {
+        if (texture.generation == 0) continue;
+        for (uint32_t level = texture.residentLevel; level < texture.mipCount; level++) {
+            bytes += texture.levelSizes[level];
+        }
+    }
+    return bytes;
+}
+
+void TextureStreamer::applyPendingOperations() {
+    this->m_vulkan->base->textures->_take_pending_operations(this->operations);
+    for (TextureOperation &operation : this->operations) {
+        uint32_t slot = operation.texture.index;
+        bool alive = slot < this->textures.size() && this->textures[slot].generation != 0 &&
+                     this->textures[slot].generation == operation.texture.generation;
+        switch (operation.type) {
+            case TEXTURE_OPERATION_ADD:
+                this->addTexture(operation);
+                break;
+            case TEXTURE_OPERATION_REMOVE:
+                if (alive) this->removeTexture(slot);
+                break;
+            case TEXTURE_OPERATION_SET_PRIORITY:
+                if (alive) this->textures[slot].priority = operation.priority;
+                this->planNeeded = true;
+                break;
+            case TEXTURE_OPERATION_SET_MATERIAL:
+                if (!this->materialTables.empty() && operation.materialIndex >= BINDLESS_MAX_MATERIALS) {
+                    VULKRAY_LOG_EVERY_MS(spdlog::level::warn, VULKRAY_LOG_REPEAT_INTERVAL_MS,
+                                         "Material index {0} is past the bindless material table, it's drawn "
+                                         "untextured.", operation.materialIndex);
+                }
+                if (operation.materialIndex >= this->materials.size()) {
+                    this->materials.resize(operation.materialIndex + 1);
+                }
+                this->materials[operation.materialIndex] = operation.texture;
+                this->materialsVersion++;
+                this->planNeeded = true;
+                break;
+            default:
+                break;
+        }
+    }
+    this->operations.clear();
+}
+
+void TextureStreamer::addTexture(TextureOperation &operation) {
+    uint32_t slot = operation.texture.index;
+    if (slot >= this->textures.size()) this->textures.resize(slot + 1);
+    StreamedTexture &texture = this->textures[slot];
+    texture = StreamedTexture{};
+    const TextureAsset &asset = *operation.asset;
+    bool blitMips = false;
+    if (!this->checkFormatSupport(asset, &blitMips)) return; // the slot stays unused, nothing is ever resident
+
+    const TextureFormatInfo &formatInfo = asset.get_format_info();
+    texture.generation = operation.texture.generation;
+    texture.format = static_cast<VkFormat>(asset.get_format());
+    texture.mipCount = asset.needs_mip_generation() && !blitMips ? 1 : asset.get_mip_count();
+    for (uint32_t level = 0; level < texture.mipCount; level++) {
+        texture.levelSizes[level] = textureformat::get_level_size(
+                formatInfo, textureformat::get_level_extent(asset.get_width(), level),
+                textureformat::get_level_extent(asset.get_height(), level));
+    }
+    // generated mips past level 0 are blitted down from it (see startUpload()), so they stream like stored ones
+    texture.tailLevel = texturestreaming::get_tail_level(asset.get_width(), asset.get_height(), texture.mipCount);
+    texture.priority = operation.priority;
+    texture.wantedLevel = 0;
+    texture.plannedLevel = texture.tailLevel;
+    texture.residentLevel = texture.mipCount;
+    texture.asset = std::move(operation.asset);
+    this->planNeeded = true;
+}
+
+void TextureStreamer::removeTexture(uint32_t slot) {
+    StreamedTexture &texture = this->textures[slot];
+    if (texture.imageView != VK_NULL_HANDLE) {
+        this->retireImage(texture.image, texture.imageView, texture.descriptorIndex);
+        this->materialsVersion++;
+    }
+    if (texture.pendingImageView != VK_NULL_HANDLE) {
+        this->cancelledUploads.push_back({texture.pendingImage, texture.pendingImageView, texture.pendingValue});
+    }
+    if (texture.pendingSource._imageInstance != VK_NULL_HANDLE) {
+        this->cancelledUploads.push_back({texture.pendingSource, VK_NULL_HANDLE, texture.pendingValue});
+    }
+    texture = StreamedTexture{};
+    this->planNeeded = true;
+}
+
+/* Textures in formats the GPU can't sample are logged & skipped, the render loop keeps going without them.
+ * Generated mips need the format to be blittable with linear filtering, otherwise only level 0 is used.
+ */
+bool TextureStreamer::checkFormatSupport(const TextureAsset &asset, bool *blitMips) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(this->m_vulkan->m_physicalDevice->physicalDevice,
+                                        static_cast<VkFormat>(asset.get_format()), &formatProperties);
+    VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+    VkFormatFeatureFlags sampledFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((features & sampledFeatures) != sampledFeatures) {
+        spdlog::error("The GPU can't sample the format of the texture '{0}', it isn't loaded. (VkFormat: {1})",
+                      asset.get_path(), asset.get_format());
+        return false;
+    }
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    *blitMips = (features & blitFeatures) == blitFeatures;
+    if (asset.needs_mip_generation() && !*blitMips) {
+        spdlog::warn("The GPU can't generate the mips of the texture '{0}', only its first level is used.",
+                     asset.get_path());
+    }
+    return true;
+}
+
+/* Swaps in the images whose uploads are done, the images they replace (& their descriptor indices) may still be
+ * sampled by frames in flight
+ */
+void TextureStreamer::swapFinishedUploads() {
+    UploadQueue *uploadQueue = this->m_vulkan->m_uploadQueue.get();
+    DescriptorPool *m_descriptorPool = this->m_vulkan->m_descriptorPool.get();
+    for (StreamedTexture &texture : this->textures) {
+        if (texture.pendingValue == 0 || !uploadQueue->isComplete(texture.pendingValue)) continue;
+        if (texture.imageView != VK_NULL_HANDLE) {
+            this->retireImage(texture.image, texture.imageView, texture.descriptorIndex);
+        }
+        texture.image = texture.pendingImage;
+        texture.imageView = texture.pendingImageView;
+        texture.residentLevel = texture.pendingLevel;
+        if (m_descriptorPool->bindless) {
+            // a fresh element, the retired one is only reused once the frames sampling it are done
+            texture.descriptorIndex = m_descriptorPool->allocateTextureIndex();
+            if (texture.descriptorIndex != BINDLESS_NO_TEXTURE) {
+                m_descriptorPool->writeTexture(texture.descriptorIndex, texture.imageView);
+            } else {
+                VULKRAY_LOG_EVERY_MS(spdlog::level::warn, VULKRAY_LOG_REPEAT_INTERVAL_MS,
+                                     "The bindless texture array is full, the texture '{0}' is drawn untextured.",
+                                     texture.asset->get_path());
+            }
+            this->materialsVersion++;
+        }
+        // frames sampling the new image wait on its (finished) upload, which makes the upload's writes visible
+        uploadQueue->addGraphicsWait(texture.pendingValue);
+        // the GPU is done blitting from the source level, nothing else uses it
+        if (texture.pendingSource._imageInstance != VK_NULL_HANDLE) {
+            this->destroyImage(texture.pendingSource, VK_NULL_HANDLE);
+        }
+        texture.pendingImage = {};
+        texture.pendingImageView = VK_NULL_HANDLE;
+        texture.pendingSource = {};
+        texture.pendingValue = 0;
+    }
+    // images of removed textures were never sampled, they're destroyed as soon as the GPU is done writing them
+    std::erase_if(this->cancelledUploads, [this, uploadQueue](const CancelledUpload &upload) {
+        if (!uploadQueue->isComplete(upload.value)) return false;
+        this->destroyImage(upload.image, upload.imageView);
+        return true;
+    });
+}
+
+/* Every texture wants the level matching the largest screen coverage among the materials using it (by the
+ * last frame's camera), textures no material uses want all of their levels. The wanted levels are then
+ * planned within the budget by texturestreaming::plan_residency().
+ */
+void TextureStreamer::planResidency() {
+    this->planNeeded = false;
+    this->m_vulkan->m_geometryArena->estimateMaterialCoverage(this->m_vulkan->cameraPosition,
+                                                              this->m_vulkan->pixelsPerUnit, this->coverage);
+    std::vector<float> textureCoverage(this->textures.size(), -1.0f); // -1 = no material uses the texture
+    for (uint32_t material = 0; material < this->materials.size(); material++) {
+        TextureHandle handle = this->materials[material];
+        if (handle.generation == 0 || handle.index >= this->textures.size() ||
+            this->textures[handle.index].generation != handle.generation) continue;
+        float pixels = material < this->coverage.size() ? this->coverage[material] : 0.0f;
+        textureCoverage[handle.index] = std::max(textureCoverage[handle.index], pixels);
+    }
+
+    this->requests.clear();
+    this->requestSlots.clear();
+    for (uint32_t slot = 0; slot < this->textures.size(); slot++) {
+        StreamedTexture &texture = this->textures[slot];
+        if (texture.generation == 0) continue;
+        const TextureAsset &asset = *texture.asset;
+        float pixels = textureCoverage[slot];
+        texture.wantedLevel = pixels < 0.0f ? 0 : texturestreaming::get_wanted_level(
+                asset.get_width(), asset.get_height(), texture.mipCount, pixels);
+
+        TextureResidencyRequest request{};
+        request.mipCount = texture.mipCount;
+        memcpy(request.levelSizes, texture.levelSizes, sizeof(request.levelSizes));
+        request.tailLevel = texture.tailLevel;
+        request.wantedLevel = texture.wantedLevel;
+        request.residentLevel = texture.residentLevel;
+        request.priority = texture.priority;
+        this->requests.push_back(request);
+        this->requestSlots.push_back(slot);
+    }
+    texturestreaming::plan_residency(this->requests, this->getBudget());
+    for (size_t i = 0; i < this->requests.size(); i++) {
+        this->textures[this->requestSlots[i]].plannedLevel = this->requests[i].plannedLevel;
+    }
+}
+
+/* Starts the uploads towards the planned residency, textures with nothing resident yet first (then by
+ * priority). Stops at the per-frame upload limit, which is at most half the staging ring (so the frame's uploads
+ * never wait on the ones of the frame before). A texture that doesn't fit gets the sharpest levels that still
+ * do, at least one level more than it has when it's the frame's first upload.
+ */
+void TextureStreamer::startUploads() {
+    std::vector<uint32_t> candidates;
+    for (uint32_t slot = 0; slot < this->textures.size(); slot++) {
+        const StreamedTexture &texture = this->textures[slot];
+        if (texture.generation == 0 || texture.pendingImageView != VK_NULL_HANDLE) continue;
+        if (texture.plannedLevel != texture.residentLevel) candidates.push_back(slot);
+    }
+    if (candidates.empty()) return;
+    std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t first, uint32_t second) {
+        const StreamedTexture &firstTexture = this->textures[first];
+        const StreamedTexture &secondTexture = this->textures[second];
+        bool firstEmpty = firstTexture.residentLevel == firstTexture.mipCount;
+        bool secondEmpty = secondTexture.residentLevel == secondTexture.mipCount;
+        if (firstEmpty != secondEmpty) return firstEmpty;
+        return firstTexture.priority > secondTexture.priority;
+    });
+
+    uint64_t uploadLimit = std::min<uint64_t>(this->uploadBytesPerFrame,
+                                              this->m_vulkan->m_uploadQueue->getStagingSize() / 2);
+    uint64_t uploadedBytes = 0;
+    for (uint32_t slot : candidates) {
+        const StreamedTexture &texture = this->textures[slot];
+        uint32_t level = texture.plannedLevel;
+        // (generated mips always upload level 0, a level at a time wouldn't upload any less)
+        if (level < texture.residentLevel && !texture.asset->needs_mip_generation()) {
+            uint32_t nextLevel = texture.residentLevel == texture.mipCount ? texture.tailLevel
+                                                                           : texture.residentLevel - 1;
+            while (level < nextLevel && uploadedBytes + this->getUploadBytes(texture, level) > uploadLimit) level++;
+        }
+        uint64_t bytes = this->getUploadBytes(texture, level);
+        if (uploadedBytes > 0 && uploadedBytes + bytes > uploadLimit) break;
+        if (this->startUpload(slot, level)) uploadedBytes += bytes;
+    }
+}
+
+// Bytes going through the staging ring for an image holding the levels from the given one on
+uint64_t TextureStreamer::getUploadBytes(const StreamedTexture &texture, uint32_t level) {
+    if (texture.asset->needs_mip_generation()) return texture.levelSizes[0]; // the only stored level
+    uint64_t bytes = 0;
+    for (; level < texture.mipCount; level++) bytes += texture.levelSizes[level];
+    return bytes;
+}
+
+// Allocates the image holding the levels from the given one on & queues their upload from the mapped file
+bool TextureStreamer::startUpload(uint32_t slot, uint32_t level) {
+    StreamedTexture &texture = this->textures[slot];
+    const TextureAsset &asset = *texture.asset;
+    uint32_t width = textureformat::get_level_extent(asset.get_width(), level);
+    uint32_t height = textureformat::get_level_extent(asset.get_height(), level);
+    uint32_t levelCount = texture.mipCount - level;
+    bool generated = asset.needs_mip_generation();
+    bool downsampled = generated && level > 0; // from the stored level 0, through a source image
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (generated && levelCount > 1) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // blitted from
+    VmaAllocator allocator = this->m_vulkan->m_VMA->memoryAllocator;
+
+    try {
+        // textures come & go all the time, so they're suballocated from VMA's blocks
+        ImageViews::allocateVMAImage(allocator, &texture.pendingImage, width, height, VK_IMAGE_TILING_OPTIMAL,
+                                     VK_SAMPLE_COUNT_1_BIT, usage, texture.format, levelCount, 0);
+        if (downsampled) { // levels 0 to the image's first one, destroyed again once the upload is done
+            ImageViews::allocateVMAImage(allocator, &texture.pendingSource, asset.get_width(), asset.get_height(),
+                                         VK_IMAGE_TILING_OPTIMAL, VK_SAMPLE_COUNT_1_BIT,
+                                         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                         texture.format, level + 1, 0);
+        }
+    } catch (const std::runtime_error &) {
+        // out of device memory, the texture keeps its levels until the next residency plan (error already logged)
+        if (texture.pendingImage._imageInstance != VK_NULL_HANDLE) {
+            vmaDestroyImage(allocator, texture.pendingImage._imageInstance, texture.pendingImage._imageMemory);
+        }
+        texture.pendingImage = {};
+        texture.pendingSource = {};
+        texture.plannedLevel = texture.residentLevel;
+        return false;
+    }
+    this->m_vulkan->m_VMA->track(texture.pendingImage._imageMemory, MEMORY_CATEGORY_TEXTURE);
+    if (downsampled) this->m_vulkan->m_VMA->track(texture.pendingSource._imageMemory, MEMORY_CATEGORY_TEXTURE);
+    texture.pendingImageView = ImageViews::createImageView(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                                           texture.pendingImage._imageInstance, texture.format,
+                                                           VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+
+    if (downsampled) {
+        const TextureLevel &source = asset.get_level(0);
+        this->m_vulkan->m_uploadQueue->enqueueDownsampledImageUpload(
+                texture.pendingImage._imageInstance, texture.pendingSource._imageInstance,
+                {asset.get_width(), asset.get_height()}, level, levelCount,
+                {source.data, source.size, source.rowPitch, asset.get_format_info().blockHeight});
+        texture.pendingLevel = level;
+        this->uploadSlots.push_back(slot);
+        return true;
+    }
+    std::vector<ImageUploadLevel> levels;
+    uint32_t storedLevels = generated ? 1 : levelCount;
+    for (uint32_t i = 0; i < storedLevels; i++) {
+        const TextureLevel &source = asset.get_level(level + i);
+        levels.push_back({source.data, source.size, source.rowPitch, asset.get_format_info().blockHeight});
+    }
+    this->m_vulkan->m_uploadQueue->enqueueImageUpload(texture.pendingImage._imageInstance, {width, height},
+                                                      levelCount, levels);
+    texture.pendingLevel = level;
+    this->uploadSlots.push_back(slot);
+    return true;
+}
+
+// The texture memory budget, shrunk to what's left of the device local heaps' budgets
+uint64_t TextureStreamer::getBudget() {
+    uint64_t headroom = 0;
+    for (const GpuHeapBudget &heap : this->m_vulkan->base->memory->get_heap_budgets()) {
+        if (heap.deviceLocal && heap.budget > heap.usage) headroom += heap.budget - heap.usage;
+    }
+    return std::min(this->memoryBudget, this->getResidentBytes() + headroom);
+}
+
+// Writes the descriptor index of every material's texture into the frame's material table
+void TextureStreamer::writeMaterialTable(uint32_t frameIndex) {
+    Buffer *materialTable = this->materialTables[frameIndex].get();
+    auto *entries = static_cast<uint32_t*>(materialTable->mappedData);
+    uint32_t materialCount = std::min(static_cast<uint32_t>(this->materials.size()), BINDLESS_MAX_MATERIALS);
+    for (uint32_t material = 0; material < materialCount; material++) {
+        TextureHandle handle = this->materials[material];
+        bool valid = handle.generation != 0 && handle.index < this->textures.size() &&
+                        this->textures[handle.index].generation == handle.generation;
+        entries[material] = valid ? this->textures[handle.index].descriptorIndex : BINDLESS_NO_TEXTURE;
+    }
+    // the material list never shrinks, so entries past it were never written (still BINDLESS_NO_TEXTURE)
+    vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator, materialTable->buffer._bufferMemory,
+                       0, materialCount * sizeof(uint32_t));
+    this->materialTableVersions[frameIndex] = this->materialsVersion;
+}
+
+void TextureStreamer::retireImage(AllocatedImage image, VkImageView imageView, uint32_t descriptorIndex) {
+    this->m_vulkan->m_deletionQueue->retire([this, image, imageView, descriptorIndex] {
+        this->destroyImage(image, imageView);
+        this->m_vulkan->m_descriptorPool->freeTextureIndex(descriptorIndex);
+    });
+}
+
+void TextureStreamer::destroyImage(AllocatedImage image, VkImageView imageView) {
+    vkDestroyImageView(this->m_vulkan->m_logicalDevice->logicalDevice, imageView, nullptr);
+    this->m_vulkan->m_VMA->untrack(image._imageMemory);
+    vmaDestroyImage(this->m_vulkan->m_VMA->memoryAllocator, image._imageInstance, image._imageMemory);
+}
@@ -0,0 +1,87 @@
+/*
+ * UniformRing.cxx
+ * Suballocates the per-frame uniform data from one persistently mapped buffer.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <vk_mem_alloc.h>
+#include <algorithm>
+
+UniformRing::UniformRing(Vulkan *m_vulkan, VkDeviceSize frameSize): VkModuleBase(m_vulkan) {
+
+    // dynamic offsets have to be a multiple of the device's uniform offset alignment
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(this->m_vulkan->m_physicalDevice->physicalDevice, &properties);
+    this->alignment = std::max<VkDeviceSize>(1, properties.limits.minUniformBufferOffsetAlignment);
+    this->frameSize = this->alignUp(frameSize);
+
+    // one region per frame in flight, a region is only reused after its frame was waited on
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = this->frameSize * this->m_vulkan->MAX_FRAMES_IN_FLIGHT;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // only ever read by the graphics queue
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+    VmaAllocationInfo allocationInfo{};
+    VkResult result = vmaCreateBuffer(this->m_vulkan->m_VMA->memoryAllocator, &bufferInfo, &allocInfo,
+                                      &this->buffer._bufferInstance, &this->buffer._bufferMemory, &allocationInfo);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while allocating the uniform ring buffer.");
+        throw std::runtime_error("Failed to allocate the uniform ring buffer!\n");
+    }
+    this->m_vulkan->m_VMA->track(this->buffer._bufferMemory, MEMORY_CATEGORY_UNIFORM);
+    // stays mapped for the lifetime of the buffer (VMA unmaps it on destruction)
+    this->mappedData = static_cast<uint8_t*>(allocationInfo.pMappedData);
+
+    VkMemoryPropertyFlags memoryFlags;
+    vmaGetAllocationMemoryProperties(this->m_vulkan->m_VMA->memoryAllocator, this->buffer._bufferMemory, &memoryFlags);
+    this->hostCoherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+UniformRing::~UniformRing() {
+    this->m_vulkan->m_VMA->untrack(this->buffer._bufferMemory);
+    vmaDestroyBuffer(this->m_vulkan->m_VMA->memoryAllocator,
+                     this->buffer._bufferInstance, this->buffer._bufferMemory);
+}
+
+// Starts writing into the given frame's region (everything allocated from it last time is overwritten)
+void UniformRing::beginFrame(uint32_t frameIndex) {
+    this->frameOffset = this->frameSize * frameIndex;
+    this->head = 0;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+    VkDeviceSize alignedSize = this->alignUp(size);
+    if (this->head + alignedSize > this->frameSize) {
+        spdlog::error("The uniform ring ran out of space for this frame! ({0} bytes per frame)", this->frameSize);
+        throw std::runtime_error("Failed to allocate uniform data! Uniform ring is full.");
+    }
+    UniformAllocation allocation{};
+    allocation.data = this->mappedData + this->frameOffset + this->head;
+    allocation.offset = static_cast<uint32_t>(this->frameOffset + this->head);
+    this->head += alignedSize;
+    return allocation;
+}
+
+// Makes this frame's writes visible to the GPU (only does anything on non-coherent memory)
+void UniformRing::flush() {
+    if (this->hostCoherent || this->head == 0) return;
+    vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator, this->buffer._bufferMemory,
+                       this->frameOffset, this->head);
+}
+
+VkDeviceSize UniformRing::alignUp(VkDeviceSize size) {
+    return (size + this->alignment - 1) & ~(this->alignment - 1); // alignment is always a power of two
+}
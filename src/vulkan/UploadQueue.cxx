@@ -0,0 +1,585 @@
+/*
+ * UploadQueue.cxx
+ * Streams buffer & image uploads through a staging ring, batched into one submit on the transfer queue.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../../include/Vulkray/Vulkan.h"
+#include <spdlog/spdlog.h>
+#include <vk_mem_alloc.h>
+#include <algorithm>
+
+const VkDeviceSize STAGING_ALIGNMENT = 16; // keeps every copy's source offset nicely aligned
+
+UploadQueue::UploadQueue(Vulkan *m_vulkan, VkDeviceSize stagingSize): VkModuleBase(m_vulkan) {
+    QueueFamilyIndices queueFamilies = this->m_vulkan->m_physicalDevice->queueFamilies;
+    this->ownershipTransfer = queueFamilies.transferFamily.value() != queueFamilies.graphicsFamily.value();
+    this->stagingSize = std::max(STAGING_ALIGNMENT, stagingSize & ~(STAGING_ALIGNMENT - 1));
+
+    // One pool per queue family, the graphics one is only used to acquire ownership of the uploaded buffers
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilies.transferFamily.value();
+    VkResult result = vkCreateCommandPool(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                          &poolInfo, nullptr, &this->transferPool);
+    if (result == VK_SUCCESS && this->ownershipTransfer) {
+        poolInfo.queueFamilyIndex = queueFamilies.graphicsFamily.value();
+        result = vkCreateCommandPool(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                     &poolInfo, nullptr, &this->graphicsPool);
+    }
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while initializing the upload queue command pools.");
+        throw std::runtime_error("Failed to create the upload queue command pools!");
+    }
+
+    // Uploads complete in submission order, so a single timeline semaphore tracks all of them
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+    result = vkCreateSemaphore(this->m_vulkan->m_logicalDevice->logicalDevice,
+                               &semaphoreInfo, nullptr, &this->timelineSemaphore);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating the upload queue timeline semaphore.");
+        throw std::runtime_error("Failed to create the upload timeline semaphore!");
+    }
+
+    // Persistently mapped staging ring, only ever read by the transfer queue
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = this->stagingSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+    VmaAllocationInfo allocationInfo{};
+    result = vmaCreateBuffer(this->m_vulkan->m_VMA->memoryAllocator, &bufferInfo, &allocInfo,
+                             &this->stagingBuffer._bufferInstance, &this->stagingBuffer._bufferMemory,
+                             &allocationInfo);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while allocating the upload staging ring.");
+        throw std::runtime_error("Failed to allocate the upload staging buffer!\n");
+    }
+    this->stagingData = static_cast<uint8_t*>(allocationInfo.pMappedData);
+    this->m_vulkan->m_VMA->track(this->stagingBuffer._bufferMemory, MEMORY_CATEGORY_STAGING);
+
+    VkMemoryPropertyFlags memoryFlags;
+    vmaGetAllocationMemoryProperties(this->m_vulkan->m_VMA->memoryAllocator,
+                                     this->stagingBuffer._bufferMemory, &memoryFlags);
+    this->stagingCoherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+UploadQueue::~UploadQueue() {
+    this->waitFor(this->lastSubmittedValue); // the staging ring and command buffers may still be in use
+
+    VkDevice logicalDevice = this->m_vulkan->m_logicalDevice->logicalDevice;
+    this->m_vulkan->m_VMA->untrack(this->stagingBuffer._bufferMemory);
+    vmaDestroyBuffer(this->m_vulkan->m_VMA->memoryAllocator,
+                     this->stagingBuffer._bufferInstance, this->stagingBuffer._bufferMemory);
+    vkDestroySemaphore(logicalDevice, this->timelineSemaphore, nullptr);
+    vkDestroyCommandPool(logicalDevice, this->transferPool, nullptr); // frees the pool's command buffers too
+    if (this->graphicsPool != VK_NULL_HANDLE) vkDestroyCommandPool(logicalDevice, this->graphicsPool, nullptr);
+}
+
+/* Copies the data into the staging ring right away (the caller's memory can be freed after this returns).
+ * The GPU copy itself happens with the next flush().
+ * Note: Not thread safe, uploads are queued & flushed from the render thread.
+ */
+void UploadQueue::enqueueBufferUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset,
+                                      const void *data, VkDeviceSize size, bool exclusiveBuffer) {
+    auto source = static_cast<const uint8_t*>(data);
+
+    // uploads bigger than the ring are split into chunks (the ring gets flushed in between)
+    while (size > 0) {
+        VkDeviceSize chunkSize = std::min(size, this->stagingSize);
+        VkDeviceSize stagingOffset = this->allocateStaging(chunkSize);
+        memcpy(this->stagingData + stagingOffset, source, (size_t) chunkSize);
+        if (!this->stagingCoherent) {
+            vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator, this->stagingBuffer._bufferMemory,
+                               stagingOffset, chunkSize);
+        }
+        PendingCopy copy{};
+        copy.srcBuffer = this->stagingBuffer._bufferInstance;
+        copy.dstBuffer = dstBuffer;
+        copy.region.srcOffset = stagingOffset;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = chunkSize;
+        copy.exclusiveBuffer = exclusiveBuffer;
+        this->pendingCopies.push_back(copy);
+
+        source += chunkSize;
+        dstOffset += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+/* Queues a GPU side copy between two (concurrently shared) buffers, e.g. to move geometry around.
+ * It runs after all the uploads of the same batch, so it can read data uploaded in that batch.
+ */
+void UploadQueue::enqueueBufferCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, VkBufferCopy region) {
+    PendingCopy copy{};
+    copy.srcBuffer = srcBuffer;
+    copy.dstBuffer = dstBuffer;
+    copy.region = region;
+    copy.exclusiveBuffer = false;
+    this->pendingBufferCopies.push_back(copy);
+}
+
+/* Uploads the first levels of an image (levels[0] = mip level 0), the image's remaining levels get generated
+ * from the last uploaded one with blits. The image has to be in the UNDEFINED layout (its contents are
+ * replaced), queued images are in the SHADER_READ_ONLY_OPTIMAL layout once the batch finishing them is done.
+ * Levels are split along rows of texel blocks if they don't fit in the ring. Like buffer uploads, the level
+ * data is copied into the staging ring right away.
+ */
+void UploadQueue::enqueueImageUpload(VkImage image, VkExtent2D extent, uint32_t levelCount,
+                                     const std::vector<ImageUploadLevel> &levels) {
+    if (levels.empty() || levels.size() > levelCount) {
+        spdlog::error("enqueueImageUpload(): An image upload needs between 1 and {0} levels.", levelCount);
+        throw std::runtime_error("An invalid image upload was queued!");
+    }
+    PendingImage pendingImage{};
+    pendingImage.image = image;
+    pendingImage.extent = extent;
+    pendingImage.levelCount = levelCount;
+    pendingImage.uploadedLevels = static_cast<uint32_t>(levels.size());
+    this->pendingImages.push_back(pendingImage);
+
+    for (uint32_t level = 0; level < levels.size(); level++) {
+        VkExtent2D levelExtent = {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)};
+        this->stageImageLevel(image, level, levelExtent, levels[level]);
+    }
+    // batches flushed in between (ring full) only remove finished images, so this one is still the last
+    this->pendingImages.back().finished = true;
+}
+
+/* Uploads an image starting at a smaller level than the one stored (e.g. generated mips, where only level 0
+ * exists): the level goes into sourceImage (UNDEFINED, at least skippedLevels + 1 levels), is blitted down its
+ * levels & into the image's level 0, the image's remaining levels are generated from there. The source image
+ * can be destroyed once the batch is done.
+ */
+void UploadQueue::enqueueDownsampledImageUpload(VkImage image, VkImage sourceImage, VkExtent2D sourceExtent,
+                                                uint32_t skippedLevels, uint32_t levelCount,
+                                                const ImageUploadLevel &level) {
+    if (skippedLevels == 0 || levelCount == 0) {
+        spdlog::error("enqueueDownsampledImageUpload(): The image has to start at a smaller level than the source.");
+        throw std::runtime_error("An invalid image upload was queued!");
+    }
+    PendingImage pendingImage{};
+    pendingImage.image = image;
+    pendingImage.extent = {std::max(sourceExtent.width >> skippedLevels, 1u),
+                           std::max(sourceExtent.height >> skippedLevels, 1u)};
+    pendingImage.levelCount = levelCount;
+    pendingImage.uploadedLevels = 0;
+    pendingImage.sourceImage = sourceImage;
+    pendingImage.sourceExtent = sourceExtent;
+    pendingImage.skippedLevels = skippedLevels;
+    this->pendingImages.push_back(pendingImage);
+
+    this->stageImageLevel(sourceImage, 0, sourceExtent, level);
+    this->pendingImages.back().finished = true;
+}
+
+VkDeviceSize UploadQueue::getStagingSize() {
+    return this->stagingSize;
+}
+
+// Copies a level into the staging ring (split along rows of texel blocks if it doesn't fit) & queues its copy
+void UploadQueue::stageImageLevel(VkImage image, uint32_t mipLevel, VkExtent2D extent,
+                                  const ImageUploadLevel &upload) {
+    if (upload.rowPitch == 0 || upload.rowPitch > this->stagingSize) {
+        spdlog::error("enqueueImageUpload(): A row of the image is bigger than the staging ring.");
+        throw std::runtime_error("An invalid image upload was queued!");
+    }
+    auto source = static_cast<const uint8_t*>(upload.data);
+    VkDeviceSize rowsLeft = upload.size / upload.rowPitch;
+    uint32_t y = 0;
+    while (rowsLeft > 0) {
+        VkDeviceSize rows = std::min(rowsLeft, this->stagingSize / upload.rowPitch);
+        VkDeviceSize chunkSize = rows * upload.rowPitch;
+        VkDeviceSize stagingOffset = this->allocateStaging(chunkSize);
+        memcpy(this->stagingData + stagingOffset, source, (size_t) chunkSize);
+        if (!this->stagingCoherent) {
+            vmaFlushAllocation(this->m_vulkan->m_VMA->memoryAllocator, this->stagingBuffer._bufferMemory,
+                               stagingOffset, chunkSize);
+        }
+        PendingImageCopy copy{};
+        copy.image = image;
+        copy.region.bufferOffset = stagingOffset;
+        copy.region.bufferRowLength = 0; // tightly packed
+        copy.region.bufferImageHeight = 0;
+        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.region.imageSubresource.mipLevel = mipLevel;
+        copy.region.imageSubresource.baseArrayLayer = 0;
+        copy.region.imageSubresource.layerCount = 1;
+        copy.region.imageOffset = {0, static_cast<int32_t>(y), 0};
+        copy.region.imageExtent = {extent.width,
+                                   std::min(static_cast<uint32_t>(rows) * upload.rowHeight, extent.height - y), 1};
+        this->pendingImageCopies.push_back(copy);
+
+        source += chunkSize;
+        y += static_cast<uint32_t>(rows) * upload.rowHeight;
+        rowsLeft -= rows;
+    }
+}
+
+/* Submits every queued copy as one batch and returns the timeline value signalled once it's done. The batch's
+ * submits are queued along with the frame's other submits (they go out with the frame's graphics submit).
+ * With a dedicated transfer family, exclusive destination buffers are released to the graphics family by the
+ * transfer queue and acquired by a small submit on the graphics queue (which then signals the value).
+ */
+uint64_t UploadQueue::flush() {
+    this->reclaimBatches();
+    if (!this->hasPendingWork()) return this->lastSubmittedValue;
+    bool writesBuffers = !this->pendingCopies.empty() || !this->pendingBufferCopies.empty();
+
+    std::vector<VkBufferMemoryBarrier> releaseBarriers;
+    UploadBatch batch{};
+    batch.transferCommands = this->getCommandBuffer(this->transferPool, this->freeTransferCommands);
+    batch.graphicsCommands = VK_NULL_HANDLE;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.transferCommands, &beginInfo);
+
+    /* Batches on the queue aren't ordered by themselves, so wait for the previous batches' copies first
+     * (a copy may read or overwrite a range a previous batch wrote). The second barrier does the same
+     * for the buffer to buffer copies reading data uploaded in this batch.
+     */
+    VkMemoryBarrier copyBarrier{};
+    copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+    this->recordCopies(batch.transferCommands, this->pendingCopies, releaseBarriers);
+    if (!this->pendingBufferCopies.empty()) {
+        vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+        this->recordCopies(batch.transferCommands, this->pendingBufferCopies, releaseBarriers);
+    }
+    this->recordImageCopies(batch.transferCommands);
+
+    /* Finished images are handed over to be sampled by whichever queue can blit their remaining mips: the
+     * transfer queue itself when it's part of the graphics family, the acquiring graphics submit otherwise.
+     */
+    std::vector<PendingImage> finishedImages;
+    std::vector<VkImageMemoryBarrier> imageReleaseBarriers;
+    for (const PendingImage &pendingImage : this->pendingImages) {
+        if (!pendingImage.finished) continue;
+        finishedImages.push_back(pendingImage);
+        if (!this->ownershipTransfer) {
+            this->recordImageFinalize(batch.transferCommands, pendingImage);
+            continue;
+        }
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0; // ignored for the release
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = this->m_vulkan->m_physicalDevice->queueFamilies.transferFamily.value();
+        barrier.dstQueueFamilyIndex = this->m_vulkan->m_physicalDevice->queueFamilies.graphicsFamily.value();
+        barrier.image = pendingImage.image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pendingImage.levelCount, 0, 1};
+        imageReleaseBarriers.push_back(barrier);
+        if (pendingImage.sourceImage == VK_NULL_HANDLE) continue;
+        barrier.image = pendingImage.sourceImage; // blitted from by the acquiring queue too
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pendingImage.skippedLevels + 1, 0, 1};
+        imageReleaseBarriers.push_back(barrier);
+    }
+    std::erase_if(this->pendingImages, [](const PendingImage &pendingImage) { return pendingImage.finished; });
+
+    bool releasing = this->ownershipTransfer && (!releaseBarriers.empty() || !imageReleaseBarriers.empty());
+    if (releasing) {
+        vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(),
+                             static_cast<uint32_t>(imageReleaseBarriers.size()), imageReleaseBarriers.data());
+    }
+    vkEndCommandBuffer(batch.transferCommands);
+
+    /* The timeline is signalled by both queues, so every value has to be signalled after the ones before it:
+     * the transfer submit waits on the previous batch's acquire (if it had one) finishing first.
+     */
+    uint64_t transferValue = ++this->nextValue;
+    this->submit(this->m_vulkan->m_logicalDevice->transferQueue, batch.transferCommands,
+                 this->lastAcquireValue, VK_PIPELINE_STAGE_TRANSFER_BIT, transferValue);
+    this->lastAcquireValue = 0;
+    batch.value = transferValue;
+
+    if (releasing) {
+        batch.graphicsCommands = this->getCommandBuffer(this->graphicsPool, this->freeGraphicsCommands);
+        vkBeginCommandBuffer(batch.graphicsCommands, &beginInfo);
+        for (VkBufferMemoryBarrier &barrier : releaseBarriers) {
+            barrier.srcAccessMask = 0; // ignored for the acquire
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        for (VkImageMemoryBarrier &barrier : imageReleaseBarriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        vkCmdPipelineBarrier(batch.graphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(),
+                             static_cast<uint32_t>(imageReleaseBarriers.size()), imageReleaseBarriers.data());
+        for (const PendingImage &pendingImage : finishedImages) {
+            this->recordImageFinalize(batch.graphicsCommands, pendingImage);
+        }
+        vkEndCommandBuffer(batch.graphicsCommands);
+
+        batch.value = ++this->nextValue;
+        this->submit(this->m_vulkan->m_logicalDevice->graphicsQueue, batch.graphicsCommands,
+                     transferValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, batch.value);
+        this->lastAcquireValue = batch.value;
+    }
+    batch.stagingEnd = this->writeCursor;
+    this->inFlightBatches.push_back(batch);
+    this->lastSubmittedValue = batch.value;
+    if (writesBuffers) this->graphicsWaitValue = batch.value;
+    return batch.value;
+}
+
+// Moves the images first uploaded in this batch to TRANSFER_DST_OPTIMAL & records the staging ring copies
+void UploadQueue::recordImageCopies(VkCommandBuffer commandBuffer) {
+    for (PendingImage &pendingImage : this->pendingImages) {
+        if (pendingImage.started) continue;
+        ImageViews::transitionImageLayout(commandBuffer, pendingImage.image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          0, pendingImage.levelCount);
+        if (pendingImage.sourceImage != VK_NULL_HANDLE) {
+            ImageViews::transitionImageLayout(commandBuffer, pendingImage.sourceImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                                              VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                              0, pendingImage.skippedLevels + 1);
+        }
+        pendingImage.started = true;
+    }
+    std::vector<VkBufferImageCopy> regions;
+    for (size_t i = 0; i < this->pendingImageCopies.size();) {
+        VkImage image = this->pendingImageCopies[i].image;
+        regions.clear();
+        for (; i < this->pendingImageCopies.size() && this->pendingImageCopies[i].image == image; i++) {
+            regions.push_back(this->pendingImageCopies[i].region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer, this->stagingBuffer._bufferInstance, image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+                               regions.data());
+    }
+    this->pendingImageCopies.clear();
+}
+
+/* Blits the levels after the uploaded ones (each from the one before it), then moves the whole image to
+ * SHADER_READ_ONLY_OPTIMAL. Blitted source levels end up in TRANSFER_SRC_OPTIMAL, the rest in TRANSFER_DST.
+ * Downsampled uploads first blit their way down the source image, its last level becomes the image's level 0.
+ */
+void UploadQueue::recordImageFinalize(VkCommandBuffer commandBuffer, const PendingImage &pendingImage) {
+    VkImage image = pendingImage.image;
+    uint32_t uploadedLevels = pendingImage.uploadedLevels;
+    if (pendingImage.sourceImage != VK_NULL_HANDLE) {
+        VkImage sourceImage = pendingImage.sourceImage;
+        for (uint32_t level = 1; level <= pendingImage.skippedLevels; level++) {
+            this->recordLevelBlit(commandBuffer, sourceImage, pendingImage.sourceExtent, level - 1,
+                                  sourceImage, pendingImage.sourceExtent, level);
+        }
+        this->recordLevelBlit(commandBuffer, sourceImage, pendingImage.sourceExtent, pendingImage.skippedLevels,
+                              image, pendingImage.extent, 0);
+        uploadedLevels = 1;
+    }
+    for (uint32_t level = uploadedLevels; level < pendingImage.levelCount; level++) {
+        this->recordLevelBlit(commandBuffer, image, pendingImage.extent, level - 1, image, pendingImage.extent, level);
+    }
+    if (uploadedLevels == pendingImage.levelCount) {
+        ImageViews::transitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, pendingImage.levelCount);
+        return;
+    }
+    uint32_t firstSource = uploadedLevels - 1;
+    if (firstSource > 0) {
+        ImageViews::transitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, firstSource);
+    }
+    ImageViews::transitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      firstSource, pendingImage.levelCount - 1 - firstSource);
+    ImageViews::transitionImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      pendingImage.levelCount - 1, 1);
+}
+
+// Moves the source level (written in TRANSFER_DST_OPTIMAL) to TRANSFER_SRC_OPTIMAL, then blits it into dstLevel
+void UploadQueue::recordLevelBlit(VkCommandBuffer commandBuffer, VkImage srcImage, VkExtent2D srcExtent,
+                                  uint32_t srcLevel, VkImage dstImage, VkExtent2D dstExtent, uint32_t dstLevel) {
+    ImageViews::transitionImageLayout(commandBuffer, srcImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                      srcLevel, 1);
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, srcLevel, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(std::max(srcExtent.width >> srcLevel, 1u)),
+                          static_cast<int32_t>(std::max(srcExtent.height >> srcLevel, 1u)), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, dstLevel, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(std::max(dstExtent.width >> dstLevel, 1u)),
+                          static_cast<int32_t>(std::max(dstExtent.height >> dstLevel, 1u)), 1};
+    vkCmdBlitImage(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+}
+
+bool UploadQueue::hasPendingWork() {
+    return !this->pendingCopies.empty() || !this->pendingBufferCopies.empty() ||
+           !this->pendingImageCopies.empty() || !this->pendingImages.empty();
+}
+
+// Records the copies (merged per source/destination pair) and collects the exclusive buffers to release
+void UploadQueue::recordCopies(VkCommandBuffer commandBuffer, std::vector<PendingCopy> &copies,
+                               std::vector<VkBufferMemoryBarrier> &releaseBarriers) {
+    // the queue keeps copies in order, but merged copies must not overlap (callers never overlap in a batch)
+    std::stable_sort(copies.begin(), copies.end(), [](const PendingCopy &a, const PendingCopy &b) {
+        return a.dstBuffer != b.dstBuffer ? a.dstBuffer < b.dstBuffer : a.srcBuffer < b.srcBuffer;
+    });
+    std::vector<VkBufferCopy> regions;
+
+    for (size_t i = 0; i < copies.size();) {
+        VkBuffer srcBuffer = copies[i].srcBuffer;
+        VkBuffer dstBuffer = copies[i].dstBuffer;
+        bool exclusiveBuffer = copies[i].exclusiveBuffer;
+        regions.clear();
+        for (; i < copies.size() && copies[i].dstBuffer == dstBuffer && copies[i].srcBuffer == srcBuffer; i++) {
+            regions.push_back(copies[i].region);
+        }
+        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+        if (!exclusiveBuffer) continue; // concurrent buffers don't have an owner
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0; // ignored for the release, the acquire side sets the real access mask
+        barrier.srcQueueFamilyIndex = this->m_vulkan->m_physicalDevice->queueFamilies.transferFamily.value();
+        barrier.dstQueueFamilyIndex = this->m_vulkan->m_physicalDevice->queueFamilies.graphicsFamily.value();
+        barrier.buffer = dstBuffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        releaseBarriers.push_back(barrier);
+    }
+    copies.clear();
+}
+
+/* Timeline value the next graphics submit has to wait on, so it never reads a buffer that's still uploading.
+ * Batches only uploading images don't count: their images aren't used before the batch is done anyway.
+ */
+uint64_t UploadQueue::getGraphicsWaitValue() {
+    return this->graphicsWaitValue;
+}
+
+void UploadQueue::addGraphicsWait(uint64_t value) {
+    this->graphicsWaitValue = std::max(this->graphicsWaitValue, value);
+}
+
+bool UploadQueue::isComplete(uint64_t value) {
+    uint64_t currentValue = 0;
+    vkGetSemaphoreCounterValue(this->m_vulkan->m_logicalDevice->logicalDevice, this->timelineSemaphore, &currentValue);
+    return currentValue >= value;
+}
+
+void UploadQueue::waitFor(uint64_t value) {
+    if (this->isComplete(value)) return;
+    this->m_vulkan->m_synchronization->flushSubmits(); // the batch may not have gone out yet
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &this->timelineSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(this->m_vulkan->m_logicalDevice->logicalDevice, &waitInfo, UINT64_MAX);
+    this->reclaimBatches();
+}
+
+// Returns the ring offset of a free staging range, flushing and waiting on older batches if the ring is full
+VkDeviceSize UploadQueue::allocateStaging(VkDeviceSize size) {
+    VkDeviceSize alignedSize = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    alignedSize = std::min(alignedSize, this->stagingSize);
+
+    while (true) {
+        VkDeviceSize position = this->writeCursor % this->stagingSize;
+        // ranges never wrap around the end of the ring, the leftover tail is skipped instead
+        VkDeviceSize padding = position + alignedSize > this->stagingSize ? this->stagingSize - position : 0;
+        if (this->writeCursor + padding + alignedSize - this->reclaimCursor <= this->stagingSize) {
+            this->writeCursor += padding;
+            VkDeviceSize offset = this->writeCursor % this->stagingSize;
+            this->writeCursor += alignedSize;
+            return offset;
+        }
+        // not enough space: submit what's queued (it holds ring space too), then wait on the oldest batch
+        if (this->hasPendingWork()) this->flush();
+        this->reclaimBatches();
+        if (this->inFlightBatches.empty()) {
+            // nothing left in flight, so the whole ring is free
+            this->writeCursor = this->reclaimCursor;
+            if (this->writeCursor % this->stagingSize != 0) {
+                this->writeCursor += this->stagingSize - this->writeCursor % this->stagingSize;
+                this->reclaimCursor = this->writeCursor;
+            }
+            continue;
+        }
+        this->waitFor(this->inFlightBatches.front().value);
+    }
+}
+
+// Recycles the staging space & command buffers of every batch the GPU finished
+void UploadQueue::reclaimBatches() {
+    if (this->inFlightBatches.empty()) return;
+    uint64_t currentValue = 0;
+    vkGetSemaphoreCounterValue(this->m_vulkan->m_logicalDevice->logicalDevice, this->timelineSemaphore, &currentValue);
+
+    while (!this->inFlightBatches.empty() && this->inFlightBatches.front().value <= currentValue) {
+        UploadBatch &batch = this->inFlightBatches.front();
+        this->reclaimCursor = batch.stagingEnd;
+        this->freeTransferCommands.push_back(batch.transferCommands);
+        if (batch.graphicsCommands != VK_NULL_HANDLE) this->freeGraphicsCommands.push_back(batch.graphicsCommands);
+        this->inFlightBatches.pop_front();
+    }
+}
+
+VkCommandBuffer UploadQueue::getCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer> &freeCommands) {
+    VkCommandBuffer commandBuffer;
+    if (!freeCommands.empty()) {
+        commandBuffer = freeCommands.back();
+        freeCommands.pop_back();
+        vkResetCommandBuffer(commandBuffer, 0);
+        return commandBuffer;
+    }
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkResult result = vkAllocateCommandBuffers(this->m_vulkan->m_logicalDevice->logicalDevice,
+                                               &allocInfo, &commandBuffer);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while allocating an upload command buffer.");
+        throw std::runtime_error("Failed to allocate an upload command buffer!");
+    }
+    return commandBuffer;
+}
+
+// Queued with the frame's other submits (Synchronization::flushSubmits sends them out)
+void UploadQueue::submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue,
+                         VkPipelineStageFlags waitStage, uint64_t signalValue) {
+    this->m_vulkan->m_synchronization->queueSubmit(
+            queue, commandBuffer, {{waitValue > 0 ? this->timelineSemaphore : VK_NULL_HANDLE, waitValue, waitStage}},
+            {{this->timelineSemaphore, signalValue, 0}});
+}
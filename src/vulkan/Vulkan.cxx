@@ -12,6 +12,8 @@
 
 #include "../../include/Vulkray/Vulkan.h"
 #include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -22,69 +24,291 @@ Vulkan::Vulkan(ShowBase *base, GraphicsInput graphicsInput, char* winTitle,
     // store args as class attributes for modules to access
     this->base = base;
     this->graphicsInput = graphicsInput;
+    if (this->base->config.framesInFlight < 1 || this->base->config.framesInFlight > 3) {
+        spdlog::warn("EngineConfig::framesInFlight has to be between 1 and 3, clamping it.");
+    }
+    this->MAX_FRAMES_IN_FLIGHT = std::clamp(this->base->config.framesInFlight, 1u, 3u);
 
     // initialize modules using smart pointers and store as class properties
-    spdlog::debug("Initializing Vulkan ...");
-    this->m_vulkanInstance = std::make_unique<VulkanInstance>(this);
-    this->m_window = std::make_unique<Window>(this, winTitle);
-    this->m_physicalDevice = std::make_unique<PhysicalDevice>(this);
-    this->m_logicalDevice = std::make_unique<LogicalDevice>(this);
-    this->m_VMA = std::make_unique<VulkanMemoryAllocator>(this);
-    this->m_swapChain = std::make_unique<SwapChain>(this);
-    this->m_imageViews = std::make_unique<SwapImageViews>(this);
-    this->m_MSAA = std::make_unique<MultiSampling>(this);
-    this->m_depthTesting = std::make_unique<DepthTesting>(this);
-    this->m_renderPass = std::make_unique<RenderPass>(this);
-    this->m_graphicsCommandPool = std::make_unique<CommandPool>(
-            this, (VkCommandPoolCreateFlags) 0, this->m_physicalDevice->queueFamilies.graphicsFamily.value());
-    this->m_transferCommandPool = std::make_unique<CommandPool>(
-            this, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, this->m_physicalDevice->queueFamilies.transferFamily.value());
-    this->m_vertexBuffer = std::make_unique<Buffer>(this, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                                    &this->graphicsInput.vertexData, nullptr);
-    this->m_indexBuffer = std::make_unique<Buffer>(this, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                                   nullptr, &this->graphicsInput.indexData);
-    this->m_uniformBuffers.resize(this->MAX_FRAMES_IN_FLIGHT); // have as many UBs as frames in flight
-    for (size_t i = 0; i < this->MAX_FRAMES_IN_FLIGHT; i++) {
-        this->m_uniformBuffers[i] = std::make_unique<Buffer>(this, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, nullptr, nullptr);
-    }
-    this->m_descriptorPool = std::make_unique<DescriptorPool>(this);
-    this->m_graphicsPipeline = std::make_unique<GraphicsPipeline>(this);
-    this->m_frameBuffers = std::make_unique<FrameBuffers>(this);
-    this->m_synchronization = std::make_unique<Synchronization>(this);
+    VULKRAY_LOG_DEBUG("Initializing Vulkan ...");
+    Profiler *profiler = this->base->profiler.get();
+    this->startupStart = profiler->_now();
+    bool headless = this->base->config.headless; // no window, surface or swap chain (offscreen images instead)
+    {
+        // each creation needs the one before it, only the device probing & pipeline builds run on the workers
+        ProfilePhase phase(profiler, "instance & window");
+        this->m_vulkanInstance = std::make_unique<VulkanInstance>(this);
+        if (!headless) this->m_window = std::make_unique<Window>(this, winTitle);
+    }
+    {
+        ProfilePhase phase(profiler, "device selection");
+        this->m_physicalDevice = std::make_unique<PhysicalDevice>(this);
+    }
+    /* the shader binaries of the startup pipelines are read from disk on idle workers while the device is
+     * created (their library only needs the device's sample count), variants requested by meshes compile in
+     * the background as well */
+    this->m_pipelineLibrary = std::make_unique<PipelineLibrary>(this);
+    PipelineState defaultState;
+    std::vector<std::string> startupShaders = {defaultState.vertexShader, defaultState.fragmentShader};
+    if (this->base->config.gpuCulling) {
+        startupShaders.push_back(CULLING_CULL_SHADER);
+        startupShaders.push_back(CULLING_COMPACT_SHADER);
+    }
+    this->m_pipelineLibrary->preloadShaders(std::move(startupShaders));
+    {
+        ProfilePhase phase(profiler, "logical device");
+        this->m_logicalDevice = std::make_unique<LogicalDevice>(this);
+        this->m_VMA = std::make_unique<VulkanMemoryAllocator>(this);
+        // the frame timeline & submit batching, used by every module retiring resources or submitting work
+        this->m_synchronization = std::make_unique<Synchronization>(this);
+        this->m_deletionQueue = std::make_unique<DeletionQueue>(this);
+        this->m_pipelineCache = std::make_unique<PipelineCache>(this, this->base->config.pipelineCachePath);
+    }
+    {
+        ProfilePhase phase(profiler, "swap chain & render graph");
+        this->m_swapChain = std::make_unique<SwapChain>(this);
+        this->m_imageViews = std::make_unique<SwapImageViews>(this);
+        // the frame's render graph, then the images it owns (their slots come from its compiled plan)
+        this->m_renderPass = std::make_unique<RenderPass>(this);
+        this->m_renderTargets = std::make_unique<RenderTargets>(this);
+    }
+    {
+        ProfilePhase phase(profiler, "queues & resources");
+        this->m_graphicsCommandPool = std::make_unique<CommandPool>(
+                this, (VkCommandPoolCreateFlags) 0, this->m_physicalDevice->queueFamilies.graphicsFamily.value());
+        // compute work scheduled for a frame runs on its own queue family when the GPU has one (async compute)
+        this->m_computeCommandPool = std::make_unique<CommandPool>(
+                this, (VkCommandPoolCreateFlags) 0, this->m_physicalDevice->queueFamilies.computeFamily.value());
+        this->m_asyncCompute = std::make_unique<AsyncCompute>(this);
+        this->m_uploadQueue = std::make_unique<UploadQueue>(this, this->base->config.uploadStagingSize);
+        // all meshes share the arena buffers, the registry's meshes are uploaded before every frame that needs them
+        this->m_geometryArena = std::make_unique<GeometryArena>(this, this->base->config.vertexArenaCapacity,
+                                                                this->base->config.indexArenaCapacity);
+        // one persistently mapped buffer holds the uniform data of every frame in flight
+        this->m_uniformRing = std::make_unique<UniformRing>(this, this->base->config.uniformRingFrameSize);
+        this->m_descriptorPool = std::make_unique<DescriptorPool>(this);
+        // textures are streamed in the background of frames, a mip tail first, sharper levels as they're needed
+        // (after the descriptor pool, their views are written into its bindless set)
+        this->m_textureStreamer = std::make_unique<TextureStreamer>(this, this->base->config.textureMemoryBudget,
+                                                                    this->base->config.textureUploadBytesPerFrame);
+    }
+    {
+        // the default pipeline compiles in the background, frames only clear until it's ready
+        ProfilePhase phase(profiler, "pipelines");
+        this->m_graphicsPipeline = std::make_unique<GraphicsPipeline>(this);
+        if (this->base->config.gpuCulling) this->m_cullingPass = std::make_unique<CullingPass>(this);
+    }
+    {
+        ProfilePhase phase(profiler, "framebuffers");
+        this->m_frameBuffers = std::make_unique<FrameBuffers>(this);
+        if (this->base->config.cacheCommandBuffers) {
+            this->m_graphicsCommandPool->allocateCachedCommandBuffers(
+                    static_cast<uint32_t>(this->m_swapChain->swapChainImages.size()));
+        }
+        if (this->base->config.recordingThreads != 1) {
+            this->m_parallelRecorder = std::make_unique<ParallelRecorder>(this, this->base->config.recordingThreads);
+            this->m_parallelRecorder->allocateSecondaryBuffers(
+                    static_cast<uint32_t>(this->m_graphicsCommandPool->commandBuffers.size()));
+        }
+        if (headless) this->m_frameReadback = std::make_unique<FrameReadback>(this);
+        if (this->base->config.profiling) {
+            if (this->m_physicalDevice->timestampValidBits > 0) {
+                this->m_gpuProfiler = std::make_unique<GpuProfiler>(this);
+            } else {
+                spdlog::info("The GPU doesn't support timestamp queries, only the CPU side of frames is profiled.");
+            }
+        }
+    }
+    // the meshes added before startup start uploading now, while the default pipeline may still be compiling
+    this->m_geometryArena->applyPendingOperations(this->m_synchronization->getCompletedValue(), UINT64_MAX);
+    this->m_synchronization->flushSubmits();
 
-    /* Before initializing render loop, call initGlfwInput callback,
-     * so the UserInput class (ShowBase's input module) can read keyboard input via GLFW. */
-    initGlfwInput(this);
+    this->base->simulation->_start(); // threaded mode: the simulation runs alongside the render loop from here on
+    if (headless) {
+        // runs a fixed number of frames (or until stopped), there's no window or input to wait for
+        uint64_t frameCount = this->base->config.headlessFrameCount;
+        VULKRAY_LOG_DEBUG("Running engine renderer headless ...");
+        // read back frames always show the scene, so the first one waits for the default pipeline
+        this->base->jobManager->_wait_for_background_tasks();
+        this->m_graphicsPipeline->checkDefaultPipeline();
+        while (!this->base->_is_stopping() && (frameCount == 0 || this->frameNumber < frameCount)) {
+            this->applyWindowSize();
+            renderFrame();
+        }
+    } else {
+        /* Before initializing render loop, call initGlfwInput callback,
+         * so the UserInput class (ShowBase's input module) can read keyboard input via GLFW. */
+        initGlfwInput(this);
 
-    spdlog::debug("Running engine renderer ...");
-    while(!glfwWindowShouldClose(this->m_window->window)) {
-        glfwPollEvents(); // Respond to window events (exit, resize, etc.)
-        renderFrame();
+        VULKRAY_LOG_DEBUG("Running engine renderer ...");
+        while (!glfwWindowShouldClose(this->m_window->window) && !this->base->_is_stopping()) {
+            this->waitForPresentPacing(); // low latency mode: input is polled once the display caught up
+            this->applyWindowSize();
+            glfwPollEvents(); // Respond to window events (exit, resize, etc.)
+            renderFrame();
+        }
+    }
+    this->base->simulation->_stop();
+    this->base->jobManager->_wait_for_frame_jobs(); // don't leave async jobs running past the render loop
+    if (this->m_frameReadback != nullptr) { // the last frames in flight are still being read back
+        this->m_logicalDevice->waitForDeviceIdle();
+        this->m_frameReadback->collectAll();
     }
 }
 
-void Vulkan::renderFrame() {
-    /* before rendering a new image, execute user jobs for this frame
-     * (also utilizes the CPU the most it can rather than waiting for the previous frame to finish) */
-    std::vector<JobCallback> jobCallbacks = this->base->jobManager->_get_job_callbacks_vector();
+/* Resizes requested with ShowBase::set_window_size() (from any thread). A window's resize comes back through
+ * its framebuffer size callback, headless images are simply recreated at the new resolution.
+ */
+void Vulkan::applyWindowSize() {
+    unsigned int width, height;
+    if (!this->base->_take_window_size(&width, &height)) return;
+    if (this->base->config.headless) {
+        this->base->config.headlessWidth = width;
+        this->base->config.headlessHeight = height;
+        this->framebufferResized = true;
+    } else {
+        glfwSetWindowSize(this->m_window->window, (int) width, (int) height);
+    }
+}
 
-    for (JobCallback jobStruct : jobCallbacks) {
-        jobStruct.pFunction(jobStruct.caller, this->base); // execute every job callback in vector
+void Vulkan::renderFrame() {
+    // every stage is timed on the CPU (the GPU side of the frame is timed by the GPU profiler's timestamps)
+    Profiler *profiler = this->base->profiler.get();
+    profiler->_begin_frame();
+    this->m_graphicsPipeline->checkDefaultPipeline();
+    // with a simulation thread, the input, jobs & world matrices are all stepped by its ticks instead
+    bool frameStepped = !this->base->simulation->is_threaded();
+    if (frameStepped) {
+        this->base->simulation->_begin_frame_step();
+        ProfileScope scope(profiler, "input");
+        // queued input events are handed to their callbacks here, before the frame's jobs are dispatched
+        uint64_t inputLatency = this->base->input->_dispatch_events();
+        if (inputLatency != 0) {
+            uint64_t now = profiler->_now();
+            profiler->_record_stage("input latency", now - std::min(inputLatency, now), now);
+        }
     }
+    /* before rendering a new image, hand this frame's user jobs to the job manager's workers
+     * (they run while the render thread waits on the previous frame and records commands) */
+    if (frameStepped) {
+        ProfileScope scope(profiler, "dispatch jobs");
+        this->base->jobManager->_dispatch_frame_jobs(this->base);
+    }
+
+    // threaded mode: the frame draws the latest tick (its camera & the mesh changes up to it)
+    uint64_t renderTick = this->base->simulation->_begin_render_frame();
+
     // render the next frame after the previous one is finished
     uint32_t imageIndex;
-    this->waitForPreviousFrame(); // TODO: Measure FPS at this point in the engine renderer
-    this->getNextSwapChainImage(&imageIndex); // <-- swap chain recreation called here (via Vulkan OUT_OF_DATE_KHR)
-    this->m_graphicsCommandPool->resetGraphicsCmdBuffer(imageIndex);
-    this->updateUniformBuffer(imageIndex);
-    this->m_graphicsCommandPool->submitNextCommandBuffer();
-    this->presentImageBuffer(&imageIndex); // <-- swap chain recreation called here (via GLFW framebuffer callback)
+    {
+        ProfileScope scope(profiler, "frame wait");
+        this->waitForPreviousFrame();
+    }
+    // resources retired before the frames finished so far were submitted (at least the one just waited on)
+    uint64_t completedValue = this->m_synchronization->getCompletedValue();
+    this->m_deletionQueue->release(completedValue);
+    this->base->memory->_update_budgets(this->base); // after the release, so freed memory isn't under pressure
+    // the frame's timestamps were written by then, reading them back doesn't wait on anything
+    if (this->m_gpuProfiler != nullptr) this->m_gpuProfiler->collectFrame(this->frameIndex);
+    // headless: the frame rendered MAX_FRAMES_IN_FLIGHT frames ago is in this frame index' readback buffer
+    if (this->m_frameReadback != nullptr) {
+        ProfileScope scope(profiler, "readback");
+        this->m_frameReadback->collectFrame(this->frameIndex);
+    }
+    {
+        ProfileScope scope(profiler, "draw list");
+        /* meshes added, updated or removed since the last frame change the draw list. The draws themselves are
+         * read from the frame's indirect buffer, so cached buffers only re-record when the draw (or culled
+         * instance) count changed, the frame's draw buffers had to be reallocated or a pipeline variant finished
+         * compiling. */
+        bool drawCountChanged = this->m_geometryArena->applyPendingOperations(completedValue, renderTick);
+        bool drawBuffersReallocated = this->m_geometryArena->writeFrameDraws(this->frameIndex);
+        if (drawBuffersReallocated && this->m_cullingPass != nullptr) {
+            this->m_cullingPass->updateDescriptorSet(this->frameIndex);
+        }
+        bool variantsReady = this->m_pipelineLibrary->takeReadyVariants();
+        if (drawCountChanged || drawBuffersReallocated || variantsReady) {
+            this->m_graphicsCommandPool->markCommandBuffersDirty();
+        }
+    }
+    {
+        ProfileScope scope(profiler, "textures");
+        this->m_textureStreamer->update(this->frameNumber);
+    }
+    // the frame's uniform region is free once the frame was waited on (the UBO is allocated before recording)
+    this->m_uniformRing->beginFrame(this->frameIndex);
+    this->cameraUniforms = this->m_uniformRing->allocate(sizeof(UniformBufferObject));
+    bool imageAcquired;
+    {
+        ProfileScope scope(profiler, "acquire");
+        // resize events & out of date presents only flag the swap chain, so it's recreated at most once per frame
+        if (this->framebufferResized) this->recreateSwapChain();
+        imageAcquired = this->getNextSwapChainImage(&imageIndex);
+    }
+    if (!imageAcquired) {
+        this->m_synchronization->flushSubmits(); // the frame's uploads still go out
+        return; // out of date, recreated by the next frame
+    }
+    {
+        ProfileScope scope(profiler, "record");
+        this->m_graphicsCommandPool->resetGraphicsCmdBuffer(imageIndex);
+    }
+    if (frameStepped) {
+        ProfileScope scope(profiler, "uniform jobs");
+        // jobs like the camera updates have to be done before their results are copied into the UBO
+        this->base->jobManager->_wait_for_uniform_jobs();
+    }
+    {
+        ProfileScope scope(profiler, "UBO update");
+        // those jobs are also the ones moving nodes around, so the world matrices are brought up to date here
+        if (frameStepped) this->base->transforms->_update_world_matrices(this->base->jobManager.get());
+        this->updateUniformBuffer(imageIndex);
+    }
+    {
+        ProfileScope scope(profiler, "submit");
+        // the compute work goes first, it can start while the graphics queue is still busy with the last frame
+        this->m_asyncCompute->submit();
+        this->m_graphicsCommandPool->submitNextCommandBuffer();
+        this->m_textureStreamer->flushUploads(); // the frame doesn't wait on texture uploads, they go out after it
+        // a single vkQueueSubmit per queue, for the frame's upload, compute & graphics work
+        this->m_synchronization->flushSubmits();
+    }
+    if (this->m_gpuProfiler != nullptr) this->m_gpuProfiler->frameSubmitted(this->frameIndex, profiler->_now());
+    if (this->m_frameReadback != nullptr) {
+        this->m_frameReadback->frameSubmitted(this->frameIndex, this->frameNumber);
+    } else {
+        ProfileScope scope(profiler, "present");
+        this->presentImageBuffer(&imageIndex);
+    }
+    if (this->frameNumber == 0) profiler->_startup_finished(this->startupStart);
     this->frameIndex = (this->frameIndex + 1) % this->MAX_FRAMES_IN_FLIGHT;
+    this->frameNumber++;
 }
 
+// The last frame submitted with this frame index, MAX_FRAMES_IN_FLIGHT frames ago (or earlier, if frames were skipped)
 void Vulkan::waitForPreviousFrame() {
-    vkWaitForFences(this->m_logicalDevice->logicalDevice, 1,
-                    &this->m_synchronization->inFlightFences[this->frameIndex], VK_TRUE, UINT64_MAX);
+    this->m_synchronization->waitForFrame(this->frameIndex);
+}
+
+/* Low latency pacing: waits until the present MAX_FRAMES_IN_FLIGHT - 1 frames back reached the display, so the
+ * next frame's input is sampled right before it's rendered instead of a few queued frames early.
+ * The wait is capped, a hidden or occluded window may never finish presenting.
+ */
+void Vulkan::waitForPresentPacing() {
+    if (this->m_logicalDevice->pWaitForPresent == nullptr) return;
+    if (this->presentId < this->swapChainFirstPresentId + this->MAX_FRAMES_IN_FLIGHT - 1) return;
+    uint64_t targetPresentId = this->presentId - (this->MAX_FRAMES_IN_FLIGHT - 1);
+    ProfileScope scope(this->base->profiler.get(), "present wait");
+
+    VkResult result = this->m_logicalDevice->pWaitForPresent(this->m_logicalDevice->logicalDevice,
+                                                             this->m_swapChain->swapChain, targetPresentId,
+                                                             PRESENT_WAIT_TIMEOUT);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        this->framebufferResized = true;
+    } else if (result != VK_SUCCESS && result != VK_TIMEOUT && result != VK_SUBOPTIMAL_KHR) {
+        spdlog::error("An error occurred while waiting for a swap chain image to be presented.");
+        throw std::runtime_error("Failed to wait for the swap chain present!");
+    }
 }
 
 void Vulkan::updateUniformBuffer(uint32_t imageIndex) {
@@ -92,47 +316,65 @@ void Vulkan::updateUniformBuffer(uint32_t imageIndex) {
     uint32_t swapImageHeight = this->m_swapChain->swapChainExtent.height;
 
     UniformBufferObject ubo{};
-    // TODO: Currently model transform does not change any geometry. Will edit once camera rotation is implemented.
-    ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = this->base->camera->get_view_matrix();
-    ubo.proj = glm::perspective(this->base->camera->get_fov_radians(),
-                                swapImageWidth / (float) swapImageHeight,
-                                this->base->camera->near, this->base->camera->far);
+    // the camera as it is, or as of the simulation tick the frame draws
+    CameraState camera = this->base->simulation->_get_render_camera();
+    ubo.view = Camera::compose_view_matrix(camera.position, camera.lookAt);
+    ubo.proj = glm::perspective(camera.fovRadians, swapImageWidth / (float) swapImageHeight,
+                                camera.near, camera.far);
     ubo.proj[1][1] *= -1; // GLM was designed for OpenGL, where Y coordinates are flipped. Corrected for vulkan here.
+    this->cameraPosition = camera.position;
+    this->pixelsPerUnit = std::abs(ubo.proj[1][1]) * (float) swapImageHeight * 0.5f;
+
+    /* frustum planes for the culling pass, taken from the rows of the view-projection matrix
+     * (left, right, bottom, top, near, far; clip space depth goes from 0 to 1) */
+    glm::mat4 viewProjection = ubo.proj * ubo.view;
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+                              viewProjection[2][row], viewProjection[3][row]);
+    }
+    ubo.frustumPlanes[0] = rows[3] + rows[0];
+    ubo.frustumPlanes[1] = rows[3] - rows[0];
+    ubo.frustumPlanes[2] = rows[3] + rows[1];
+    ubo.frustumPlanes[3] = rows[3] - rows[1];
+    ubo.frustumPlanes[4] = rows[2];
+    ubo.frustumPlanes[5] = rows[3] - rows[2];
+    for (glm::vec4 &plane : ubo.frustumPlanes) plane /= glm::length(glm::vec3(plane));
+    ubo.cameraPosition = glm::inverse(ubo.view)[3];
 
-    // map new UBO information to current uniform buffer memory
-    void* data;
-    vmaMapMemory(this->m_VMA->memoryAllocator, this->m_uniformBuffers.at(this->frameIndex)->buffer._bufferMemory, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vmaUnmapMemory(this->m_VMA->memoryAllocator, this->m_uniformBuffers.at(this->frameIndex)->buffer._bufferMemory);
+    // copy the new UBO information straight into the persistently mapped uniform ring
+    memcpy(this->cameraUniforms.data, &ubo, sizeof(ubo));
+    this->m_uniformRing->flush();
 }
 
-void Vulkan::getNextSwapChainImage(uint32_t *imageIndex) {
+bool Vulkan::getNextSwapChainImage(uint32_t *imageIndex) {
+    // headless frames render into the offscreen image of their frame index (free once the frame was waited on)
+    if (this->base->config.headless) {
+        *imageIndex = this->frameIndex;
+        return true;
+    }
 
     // acquire next image view, also get swap chain status
     VkResult result = vkAcquireNextImageKHR(this->m_logicalDevice->logicalDevice, this->m_swapChain->swapChain,
-                                            10, // timeout in nanoseconds (kept low for best latency)
+                                            UINT64_MAX, // frame pacing is up to the frame timeline & present mode
                                             this->m_synchronization->imageAvailableSemaphores[frameIndex],
                                             VK_NULL_HANDLE, imageIndex);
 
     /* check if vkAcquireNextImageKHR returned an out of date framebuffer flag
      * Note: this is not a feature on all Vulkan compatible drivers! also checking via GLFW resize callback!
+     * Nothing was acquired (the semaphore won't be signalled), so the frame is skipped without submitting.
+     * The frame index keeps its timeline value, the next frame reuses it and recreates the swap chain first.
      */
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || this->framebufferResized) {
-        this->framebufferResized = false; // reset GLFW triggered framebuffer resized flag
-        this->recreateSwapChain();
-        // resetting fences here fixed something. already forgot what lol
-        vkResetFences(this->m_logicalDevice->logicalDevice, 1,
-                      &this->m_synchronization->inFlightFences[this->frameIndex]);
-        return;
-
-    // TODO: Handle VK_SUBOPTIMAL_KHR status code
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        this->framebufferResized = true;
+        return false;
+
+    // suboptimal images can still be presented, the present reports it again and flags the recreation
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         spdlog::error("An error occurred when acquiring the next swap chain image view; Exiting.");
         throw std::runtime_error("Failed to acquire swap chain image!");
     }
-    // reset fence only if we know we're submitting work
-    vkResetFences(this->m_logicalDevice->logicalDevice, 1, &this->m_synchronization->inFlightFences[this->frameIndex]);
+    return true;
 }
 
 void Vulkan::presentImageBuffer(uint32_t *imageIndex) {
@@ -148,10 +390,21 @@ void Vulkan::presentImageBuffer(uint32_t *imageIndex) {
     presentInfo.pImageIndices = imageIndex;
     presentInfo.pResults = nullptr; // optional
 
+    // tag the present, so the low latency pacing can wait for it to reach the display
+    VkPresentIdKHR presentIdInfo{};
+    uint64_t presentId = this->presentId + 1;
+    if (this->m_logicalDevice->pWaitForPresent != nullptr) {
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        presentInfo.pNext = &presentIdInfo;
+    }
+
     VkResult result = vkQueuePresentKHR(this->m_logicalDevice->presentQueue, &presentInfo);
+    this->presentId = presentId;
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        this->recreateSwapChain();
+        this->framebufferResized = true; // recreated by the next frame
 
     } else if (result != VK_SUCCESS) {
         spdlog::error("An error occurred while submitting a swap chain image for presentation.");
@@ -159,29 +412,45 @@ void Vulkan::presentImageBuffer(uint32_t *imageIndex) {
     }
 }
 
-// Swap chain recreation (m_swapChain, m_imageViews, m_depthTesting, m_frameBuffers)
+/* Swap chain recreation (m_swapChain, m_imageViews, m_renderTargets, m_frameBuffers)
+ * The frames in flight keep drawing to the old swap chain, so the replaced modules are retired to the deletion
+ * queue instead of waiting for the device to be idle. The render graph's images are kept while they still cover
+ * the new extent (and otherwise grow to the largest extent seen so far), so a window drag mostly reuses them.
+ */
 void Vulkan::recreateSwapChain() {
-    this->m_window->waitForWindowFocus();
-    this->m_logicalDevice->waitForDeviceIdle();
-    // Move current swap to old swap smart pointer
+    this->framebufferResized = false;
+    if (this->m_window != nullptr) this->m_window->waitForWindowFocus();
+    // Move current swap to old swap smart pointer (handed to the new swap chain as its oldSwapchain)
     this->m_oldSwapChain = std::move(this->m_swapChain);
-    // recreate the swap chain & its dependent modules
-    this->m_imageViews.reset();
-    this->m_MSAA.reset();
-    this->m_depthTesting.reset();
-    this->m_frameBuffers.reset();
     this->m_swapChain = std::make_unique<SwapChain>(this);
+    this->m_deletionQueue->retire(std::move(this->m_oldSwapChain));
+    this->swapChainFirstPresentId = this->presentId + 1; // older present ids belong to the retired swap chain
+    // recreate the swap chain's dependent modules
+    VkExtent2D swapExtent = this->m_swapChain->swapChainExtent;
+    this->m_deletionQueue->retire(std::move(this->m_imageViews));
     this->m_imageViews = std::make_unique<SwapImageViews>(this);
-    this->m_MSAA = std::make_unique<MultiSampling>(this);
-    this->m_depthTesting = std::make_unique<DepthTesting>(this);
+    if (!this->m_renderTargets->covers(swapExtent)) {
+        VkExtent2D previousExtent = this->m_renderTargets->imageExtent;
+        this->m_deletionQueue->retire(std::move(this->m_renderTargets));
+        this->m_renderTargets = std::make_unique<RenderTargets>(this, previousExtent);
+    }
+    this->m_deletionQueue->retire(std::move(this->m_frameBuffers));
     this->m_frameBuffers = std::make_unique<FrameBuffers>(this);
-    // destroy old swap chain module after recreation
-    this->m_oldSwapChain.reset();
-    spdlog::debug("Recreated the swap chain!");
+    // cached command buffers reference the retired framebuffers, re-record them (swap image count may change)
+    if (this->base->config.cacheCommandBuffers) {
+        this->m_graphicsCommandPool->allocateCachedCommandBuffers(
+                static_cast<uint32_t>(this->m_swapChain->swapChainImages.size()));
+        if (this->m_parallelRecorder != nullptr) {
+            this->m_parallelRecorder->allocateSecondaryBuffers(
+                    static_cast<uint32_t>(this->m_graphicsCommandPool->commandBuffers.size()));
+        }
+    }
+    VULKRAY_LOG_DEBUG("Recreated the swap chain! ({0}x{1})", swapExtent.width, swapExtent.height);
 }
 
 Vulkan::~Vulkan() {
-    // Sleeps thread until GPU is idle before cleaning up engine memory
+    // Sleeps thread until GPU is idle before cleaning up engine memory (submits still queued go out first)
+    this->m_synchronization->flushSubmits();
     this->m_logicalDevice->waitForDeviceIdle();
 }
 
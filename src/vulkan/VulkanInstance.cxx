@@ -29,14 +29,18 @@ VulkanInstance::VulkanInstance(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &applicationInfo;
 
-    glfwInit(); // I know it's an odd spot to init GLFW, but it doesn't matter.
+    // headless mode never creates a surface, so it neither needs GLFW nor its surface extensions
+    bool headless = this->m_vulkan->base->config.headless;
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    if (glfwExtensions == NULL) {
-        spdlog::error("Fatal! GLFW did not find Vulkan support on this computer.");
-        throw std::runtime_error("A Vulkan-compatible GPU driver was not found on this machine.");
+    const char** glfwExtensions = nullptr;
+    if (!headless) {
+        glfwInit(); // I know it's an odd spot to init GLFW, but it doesn't matter.
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        if (glfwExtensions == NULL) {
+            spdlog::error("Fatal! GLFW did not find Vulkan support on this computer.");
+            throw std::runtime_error("A Vulkan-compatible GPU driver was not found on this machine.");
+        }
     }
 
     createInfo.enabledExtensionCount = glfwExtensionCount;
@@ -11,6 +11,7 @@
  */
 
 #include <vk_mem_alloc.h>
+#include <spdlog/spdlog.h>
 #include "../../include/Vulkray/Vulkan.h"
 
 VulkanMemoryAllocator::VulkanMemoryAllocator(Vulkan *m_vulkan): VkModuleBase(m_vulkan) {
@@ -24,9 +25,76 @@ VulkanMemoryAllocator::VulkanMemoryAllocator(Vulkan *m_vulkan): VkModuleBase(m_v
     allocatorCreateInfo.device = this->m_vulkan->m_logicalDevice->logicalDevice;
     allocatorCreateInfo.instance = this->m_vulkan->m_vulkanInstance->vulkanInstance;
     allocatorCreateInfo.pVulkanFunctions = &vulkanFunctions;
+    // budgets straight from the driver, VMA estimates them from its own allocations otherwise
+    if (this->m_vulkan->m_physicalDevice->memoryBudget) {
+        allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    } else {
+        spdlog::info("VK_EXT_memory_budget is unsupported, GPU memory budgets are estimated.");
+    }
 
     vmaCreateAllocator(&allocatorCreateInfo, &this->memoryAllocator);
+    this->m_vulkan->base->memory->_set_allocator(this->memoryAllocator);
+
+    this->hostFramePool = this->createFramePool(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                                VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    this->deviceFramePool = this->createFramePool(0);
 }
 VulkanMemoryAllocator::~VulkanMemoryAllocator() {
+    // every buffer in the pools was destroyed by now (the renderer's modules go before the allocator)
+    vmaDestroyPool(this->memoryAllocator, this->hostFramePool);
+    vmaDestroyPool(this->memoryAllocator, this->deviceFramePool);
+    this->m_vulkan->base->memory->_set_allocator(VK_NULL_HANDLE);
     vmaDestroyAllocator(this->memoryAllocator);
+}
+
+// A pool over the memory type VMA would pick for a per-frame draw buffer with those allocation flags
+VmaPool VulkanMemoryAllocator::createFramePool(VmaAllocationCreateFlags allocationFlags) {
+    VkBufferCreateInfo sampleBufferInfo{};
+    sampleBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    sampleBufferInfo.size = 0x10000; // doesn't matter, only the usage picks the memory type
+    sampleBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    sampleBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VmaAllocationCreateInfo sampleAllocInfo = {};
+    sampleAllocInfo.flags = allocationFlags;
+    sampleAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+    VmaPoolCreateInfo poolInfo = {};
+    VkResult result = vmaFindMemoryTypeIndexForBufferInfo(this->memoryAllocator, &sampleBufferInfo,
+                                                          &sampleAllocInfo, &poolInfo.memoryTypeIndex);
+    poolInfo.blockSize = FRAME_POOL_BLOCK_SIZE;
+    VmaPool pool = VK_NULL_HANDLE;
+    if (result == VK_SUCCESS) result = vmaCreatePool(this->memoryAllocator, &poolInfo, &pool);
+    if (result != VK_SUCCESS) {
+        spdlog::error("An error occurred while creating a VMA pool for the per-frame buffers.");
+        throw std::runtime_error("Failed to create a VMA memory pool!");
+    }
+    return pool;
+}
+
+/* Buffers too big for the pool's blocks fall back to the default pool (VMA gives them memory of their own).
+ * Every pool buffer has to use the allocation flags the pool was made for.
+ */
+VmaPool VulkanMemoryAllocator::getPool(int memoryPool, VmaAllocationCreateFlags allocationFlags, VkDeviceSize size) {
+    if (memoryPool != MEMORY_POOL_FRAME || size > FRAME_POOL_BLOCK_SIZE / 2) return VK_NULL_HANDLE;
+    if (allocationFlags & VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT) return VK_NULL_HANDLE;
+    if (allocationFlags & VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT) return this->hostFramePool;
+    return this->deviceFramePool;
+}
+
+// The category is kept in the allocation's user data (offset by one, nullptr = untracked)
+void VulkanMemoryAllocator::track(VmaAllocation allocation, int category) {
+    vmaSetAllocationUserData(this->memoryAllocator, allocation, reinterpret_cast<void*>((uintptr_t) category + 1));
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(this->memoryAllocator, allocation, &allocationInfo);
+    this->m_vulkan->base->memory->_track_allocation(category, allocationInfo.size);
+}
+
+void VulkanMemoryAllocator::untrack(VmaAllocation allocation) {
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(this->memoryAllocator, allocation, &allocationInfo);
+    if (allocationInfo.pUserData == nullptr) return;
+    int category = (int) (reinterpret_cast<uintptr_t>(allocationInfo.pUserData) - 1);
+    this->m_vulkan->base->memory->_untrack_allocation(category, allocationInfo.size);
 }
\ No newline at end of file
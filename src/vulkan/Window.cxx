@@ -40,7 +40,7 @@ Window::Window(Vulkan *m_vulkan, char* winTitle): VkModuleBase(m_vulkan) {
 
     glfwSetWindowUserPointer(this->window, this->m_vulkan);
     glfwSetFramebufferSizeCallback(this->window, Window::framebufferResizeCallback);
-    spdlog::debug("Initialized GLFW window.");
+    VULKRAY_LOG_DEBUG("Initialized GLFW window.");
 
     // Windows platform-specific window
     #ifdef _WIN32
@@ -0,0 +1,123 @@
+/*
+ * InputManagerTests.cxx
+ * Unit tests for the InputManager's key callback registration & dispatch.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <utility>
+#include "../include/Vulkray/InputManager.h"
+
+struct KeyLog {
+    std::vector<int> actions;
+};
+
+void log_key(void *caller, ShowBase *base, int action) {
+    ((KeyLog*) caller)->actions.push_back(action);
+}
+
+TEST(InputManagerTests, CallbacksOnlyReceiveTheirKeyAndAction) {
+    InputManager input(nullptr);
+    KeyLog anyLog, pressLog, otherKeyLog;
+    input.new_accept_key("w", &anyLog, log_key);
+    input.new_accept_key("w", KEY_PRESSED, &pressLog, log_key);
+    input.new_accept_key("np_5", &otherKeyLog, log_key);
+
+    input._non_static_key_callback(GLFW_KEY_W, 0, KEY_PRESSED, 0);
+    input._non_static_key_callback(GLFW_KEY_W, 0, KEY_HELD, 0);
+    input._non_static_key_callback(GLFW_KEY_W, 0, KEY_RELEASED, 0);
+    input._non_static_key_callback(GLFW_KEY_UNKNOWN, 0, KEY_PRESSED, 0); // ignored
+    EXPECT_EQ(anyLog.actions, (std::vector<int>{KEY_PRESSED, KEY_HELD, KEY_RELEASED}));
+    EXPECT_EQ(pressLog.actions, (std::vector<int>{KEY_PRESSED}));
+    EXPECT_TRUE(otherKeyLog.actions.empty());
+}
+
+TEST(InputManagerTests, EitherActionFiresOncePerPressOrHold) {
+    InputManager input(nullptr);
+    KeyLog log;
+    input.new_accept_key(" ", KEY_EITHER, &log, log_key);
+    input._non_static_key_callback(GLFW_KEY_SPACE, 0, KEY_PRESSED, 0);
+    input._non_static_key_callback(GLFW_KEY_SPACE, 0, KEY_HELD, 0);
+    input._non_static_key_callback(GLFW_KEY_SPACE, 0, KEY_RELEASED, 0);
+    EXPECT_EQ(log.actions, (std::vector<int>{KEY_PRESSED, KEY_HELD}));
+}
+
+TEST(InputManagerTests, InvalidKeysAndActionsThrow) {
+    InputManager input(nullptr);
+    KeyLog log;
+    EXPECT_THROW(input.new_accept_key("not_a_key", &log, log_key), std::runtime_error);
+    EXPECT_THROW(input.new_accept_key("a", 5, &log, log_key), std::runtime_error);
+    EXPECT_THROW(input.remove_accept_key("not_a_key"), std::runtime_error);
+}
+
+TEST(InputManagerTests, RemovedCallbacksStopReceivingKeys) {
+    InputManager input(nullptr);
+    KeyLog first, second;
+    input.new_accept_key("enter", KEY_PRESSED, &first, log_key);
+    input.new_accept_key("enter", KEY_RELEASED, &second, log_key);
+    input.remove_accept_key("enter", KEY_RELEASED);
+    input._non_static_key_callback(GLFW_KEY_ENTER, 0, KEY_PRESSED, 0);
+    input._non_static_key_callback(GLFW_KEY_ENTER, 0, KEY_RELEASED, 0);
+    EXPECT_EQ(first.actions.size(), 1u);
+    EXPECT_TRUE(second.actions.empty());
+
+    input.remove_accept_key("enter");
+    input._non_static_key_callback(GLFW_KEY_ENTER, 0, KEY_PRESSED, 0);
+    EXPECT_EQ(first.actions.size(), 1u);
+}
+
+struct CursorLog {
+    std::vector<std::pair<double, double>> positions;
+};
+
+void log_cursor(void *caller, ShowBase *base, double x, double y) {
+    ((CursorLog*) caller)->positions.emplace_back(x, y);
+}
+
+TEST(InputManagerTests, QueuedEventsWaitForTheFramesDispatch) {
+    InputManager input(nullptr, true);
+    KeyLog keyLog;
+    CursorLog cursorLog;
+    input.new_accept_key("a", &keyLog, log_key);
+    input.new_accept_cursor(&cursorLog, "test", log_cursor);
+
+    input._non_static_cursor_callback(10, 10);
+    input._non_static_key_callback(GLFW_KEY_A, 0, KEY_PRESSED, 0);
+    input._non_static_cursor_callback(12, 15);
+    input._non_static_key_callback(GLFW_KEY_A, 0, KEY_RELEASED, 0);
+    EXPECT_TRUE(keyLog.actions.empty());
+    EXPECT_TRUE(cursorLog.positions.empty());
+
+    EXPECT_GT(input._dispatch_events(), 0u);
+    EXPECT_EQ(keyLog.actions, (std::vector<int>{KEY_PRESSED, KEY_RELEASED}));
+    // the frame's motion is coalesced into one callback with its last position
+    ASSERT_EQ(cursorLog.positions.size(), 1u);
+    EXPECT_EQ(cursorLog.positions[0], std::make_pair(12.0, 15.0));
+    double dx, dy;
+    input.get_cursor_delta(&dx, &dy);
+    EXPECT_DOUBLE_EQ(dx, 2.0);
+    EXPECT_DOUBLE_EQ(dy, 5.0);
+
+    // nothing came in, so the next frame has no events & no motion
+    EXPECT_EQ(input._dispatch_events(), 0u);
+    input.get_cursor_delta(&dx, &dy);
+    EXPECT_DOUBLE_EQ(dx, 0.0);
+    EXPECT_EQ(cursorLog.positions.size(), 1u);
+}
+
+TEST(InputManagerTests, FullQueueDropsEvents) {
+    InputManager input(nullptr, true);
+    KeyLog log;
+    input.new_accept_key("a", &log, log_key);
+    for (int i = 0; i < INPUT_QUEUE_CAPACITY + 8; i++) input._non_static_key_callback(GLFW_KEY_A, 0, KEY_HELD, 0);
+    EXPECT_EQ(input.get_dropped_events(), 8u);
+    input._dispatch_events();
+    EXPECT_EQ(log.actions.size(), (size_t) INPUT_QUEUE_CAPACITY);
+}
@@ -0,0 +1,238 @@
+/*
+ * JobManagerTests.cxx
+ * Unit tests for the JobManager's frame job scheduling.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include "../include/Vulkray/JobManager.h"
+
+struct JobLog {
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<int> runs = 0;
+};
+
+template<int id>
+void log_job(void *caller, ShowBase *base) {
+    auto log = (JobLog*) caller;
+    std::lock_guard<std::mutex> lock(log->mutex);
+    log->order.push_back(id);
+    log->runs++;
+}
+
+void failing_job(void *caller, ShowBase *base) {
+    throw std::runtime_error("job failed");
+}
+
+TEST(JobManagerTests, SerialJobsKeepRegistrationOrder) {
+    JobManager jobManager(4);
+    JobLog log;
+    jobManager.new_job("first", &log, &log_job<1>);
+    jobManager.new_job("second", &log, &log_job<2>);
+    jobManager.new_job("third", &log, &log_job<3>);
+
+    for (int frame = 0; frame < 100; frame++) {
+        jobManager._dispatch_frame_jobs(nullptr);
+        jobManager._wait_for_uniform_jobs();
+    }
+    jobManager._wait_for_frame_jobs();
+    ASSERT_EQ(log.order.size(), 300u);
+    for (size_t i = 0; i < log.order.size(); i++) EXPECT_EQ(log.order[i], (int) (i % 3) + 1);
+}
+
+struct ThreadLog {
+    std::thread::id dispatchThread = std::this_thread::get_id();
+    std::atomic<int> runs = 0;
+    std::atomic<int> offThreadRuns = 0;
+};
+
+void thread_job(void *caller, ShowBase *base) {
+    auto log = (ThreadLog*) caller;
+    if (std::this_thread::get_id() != log->dispatchThread) log->offThreadRuns++;
+    log->runs++;
+}
+
+TEST(JobManagerTests, MainThreadJobsRunOnTheDispatchingThread) {
+    JobManager jobManager(4);
+    ThreadLog log;
+    jobManager.new_job("legacy", &log, &thread_job); // jobs without options run on the main thread
+    JobOptions options;
+    options.mainThread = true;
+    JobHandle mainThreadJob = jobManager.new_job("main", &log, &thread_job, options);
+    options.dependencies[0] = mainThreadJob;
+    options.dependencyCount = 1;
+    jobManager.new_job("dependent", &log, &thread_job, options); // queued by a job running on the main thread
+
+    for (int frame = 0; frame < 50; frame++) {
+        jobManager._dispatch_frame_jobs(nullptr);
+        jobManager._wait_for_frame_jobs();
+    }
+    EXPECT_EQ(log.runs.load(), 150);
+    EXPECT_EQ(log.offThreadRuns.load(), 0);
+}
+
+TEST(JobManagerTests, DependenciesRunFirst) {
+    JobManager jobManager(3);
+    JobLog log;
+    JobHandle a = jobManager.new_job("a", &log, &log_job<1>, JobOptions{});
+    JobHandle b = jobManager.new_job("b", &log, &log_job<2>, JobOptions{});
+    JobOptions dependentOptions;
+    dependentOptions.dependencies[0] = a;
+    dependentOptions.dependencies[1] = b;
+    dependentOptions.dependencyCount = 2;
+    jobManager.new_job("c", &log, &log_job<3>, dependentOptions);
+
+    for (int frame = 0; frame < 50; frame++) {
+        jobManager._dispatch_frame_jobs(nullptr);
+        jobManager._wait_for_frame_jobs();
+        ASSERT_EQ(log.order.size(), 3u);
+        EXPECT_EQ(log.order.back(), 3);
+        log.order.clear();
+    }
+}
+
+TEST(JobManagerTests, RemovedHandlesGoStale) {
+    JobManager jobManager(0);
+    JobLog log;
+    JobHandle first = jobManager.new_job("first", &log, &log_job<1>);
+    JobHandle second = jobManager.new_job("second", &log, &log_job<2>);
+    jobManager.new_job("third", &log, &log_job<3>);
+    jobManager.remove_job(first);
+    EXPECT_FALSE(jobManager.is_job_valid(first));
+    EXPECT_TRUE(jobManager.is_job_valid(second));
+    EXPECT_THROW(jobManager.remove_job(first), std::runtime_error);
+
+    // a job added after the removal never answers to the old handle
+    JobHandle fourth = jobManager.new_job("fourth", &log, &log_job<4>);
+    EXPECT_TRUE(jobManager.is_job_valid(fourth));
+    EXPECT_FALSE(jobManager.is_job_valid(first));
+    EXPECT_FALSE(jobManager.is_job_valid(JobHandle{}));
+    EXPECT_THROW(jobManager.remove_job(first), std::runtime_error);
+    EXPECT_TRUE(jobManager.is_job_valid(fourth));
+
+    // serial jobs still run in registration order after removals and slot reuse
+    jobManager._dispatch_frame_jobs(nullptr);
+    jobManager._wait_for_frame_jobs();
+    EXPECT_EQ(log.order, (std::vector<int>{2, 3, 4}));
+}
+
+TEST(JobManagerTests, RemoveJobMatchesName) {
+    JobManager jobManager(0);
+    JobLog log;
+    jobManager.new_job("keep", &log, &log_job<1>);
+    jobManager.new_job("remove", &log, &log_job<2>);
+    jobManager.remove_job("remove");
+    EXPECT_THROW(jobManager.remove_job("missing"), std::runtime_error);
+
+    jobManager._dispatch_frame_jobs(nullptr);
+    jobManager._wait_for_frame_jobs();
+    ASSERT_EQ(log.order.size(), 1u);
+    EXPECT_EQ(log.order[0], 1);
+}
+
+TEST(JobManagerTests, RemoveJobComparesTheWholeName) {
+    JobManager jobManager(0);
+    JobLog log;
+    jobManager.new_job("camera", &log, &log_job<1>);
+    EXPECT_THROW(jobManager.remove_job("camera2"), std::runtime_error);
+    EXPECT_THROW(jobManager.remove_job("camer"), std::runtime_error);
+    jobManager.remove_job("camera");
+    EXPECT_THROW(jobManager.remove_job("camera"), std::runtime_error);
+}
+
+TEST(JobManagerTests, DependenciesHaveToBeRegisteredJobs) {
+    JobManager jobManager(1);
+    JobLog log;
+    JobHandle removed = jobManager.new_job("removed", &log, &log_job<1>, JobOptions{});
+    jobManager.remove_job(removed);
+    JobOptions options;
+    options.dependencyCount = 1;
+    options.dependencies[0] = removed; // stale
+    EXPECT_THROW(jobManager.new_job("a", &log, &log_job<2>, options), std::runtime_error);
+    options.dependencies[0] = JobHandle{}; // null
+    EXPECT_THROW(jobManager.new_job("b", &log, &log_job<3>, options), std::runtime_error);
+
+    // removing a dependency later just stops holding its dependents back
+    JobHandle dependency = jobManager.new_job("dependency", &log, &log_job<4>, JobOptions{});
+    options.dependencies[0] = dependency;
+    jobManager.new_job("dependent", &log, &log_job<5>, options);
+    jobManager.remove_job(dependency);
+    jobManager._dispatch_frame_jobs(nullptr);
+    jobManager._wait_for_frame_jobs();
+    EXPECT_EQ(log.order, (std::vector<int>{5}));
+}
+
+TEST(JobManagerTests, JobErrorsReachTheWaitingThread) {
+    JobManager jobManager(2);
+    JobLog log;
+    jobManager.new_job("fails", nullptr, &failing_job);
+    jobManager.new_job("runs", &log, &log_job<1>);
+
+    jobManager._dispatch_frame_jobs(nullptr);
+    EXPECT_THROW(jobManager._wait_for_uniform_jobs(), std::runtime_error);
+    jobManager._wait_for_frame_jobs();
+    EXPECT_EQ(log.runs.load(), 1);
+}
+
+TEST(JobManagerTests, RunParallelCoversEveryIndex) {
+    JobManager jobManager(3);
+    std::vector<std::atomic<int>> hits(1000);
+    jobManager._run_parallel((uint32_t) hits.size(), &hits, [](void *caller, uint32_t index) {
+        (*(std::vector<std::atomic<int>>*) caller)[index]++;
+    });
+    for (std::atomic<int> &hit : hits) EXPECT_EQ(hit.load(), 1);
+}
+
+TEST(JobManagerTests, RunParallelOnlyRethrowsItsOwnErrors) {
+    JobManager jobManager(2);
+    jobManager.new_job("fails", nullptr, &failing_job, JobOptions{});
+    std::atomic<int> runs = 0;
+    // a few frames, the frame job fails on a worker while (or after) the batch runs
+    for (int frame = 0; frame < 32; frame++) {
+        runs = 0;
+        jobManager._dispatch_frame_jobs(nullptr);
+        jobManager._run_parallel(64, &runs, [](void *caller, uint32_t index) {
+            (*(std::atomic<int>*) caller)++;
+        });
+        EXPECT_EQ(runs.load(), 64);
+        EXPECT_THROW(jobManager._wait_for_frame_jobs(), std::runtime_error); // the frame job's error waits for it
+    }
+
+    EXPECT_THROW(jobManager._run_parallel(64, &runs, [](void *caller, uint32_t index) {
+        if (index == 7) throw std::runtime_error("batch task failed");
+        (*(std::atomic<int>*) caller)++;
+    }), std::runtime_error);
+    EXPECT_EQ(runs.load(), 64 + 63); // the rest of the batch still ran
+    EXPECT_NO_THROW(jobManager._wait_for_uniform_jobs());
+}
+
+TEST(JobManagerTests, BackgroundTasksRunOutsideTheFrame) {
+    JobManager jobManager(2);
+    std::atomic<int> runs = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        jobManager._run_background(&runs, [](void *caller, uint32_t index) {
+            (*(std::atomic<int>*) caller)++;
+        }, i);
+    }
+    jobManager._dispatch_frame_jobs(nullptr);
+    jobManager._wait_for_frame_jobs(); // frame waits never pick up background tasks, so no deadlock on them
+    jobManager._wait_for_background_tasks();
+    EXPECT_EQ(runs.load(), 8);
+}
+
+TEST(JobManagerTests, BackgroundErrorsReachTheWaitingThread) {
+    JobManager jobManager(2);
+    jobManager._run_background(nullptr, [](void *caller, uint32_t index) {
+        throw std::runtime_error("background task failed");
+    }, 0);
+    EXPECT_THROW(jobManager._wait_for_background_tasks(), std::runtime_error);
+    EXPECT_NO_THROW(jobManager._wait_for_background_tasks()); // the error is only rethrown once
+}
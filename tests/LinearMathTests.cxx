@@ -0,0 +1,80 @@
+/*
+ * LinearMathTests.cxx
+ * Unit tests for the linear math module's SIMD types & batch kernels.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../include/Vulkray/LinearMath.h"
+
+// the types are usable in constant expressions
+static_assert(Matrix4::translation({1.0f, 2.0f, 3.0f}).transform_point({1.0f, 1.0f, 1.0f}) ==
+              Vector3(2.0f, 3.0f, 4.0f));
+static_assert(Matrix4::identity() * Matrix4::identity() == Matrix4::identity());
+static_assert(Vector3(1.0f, 0.0f, 0.0f).cross({0.0f, 1.0f, 0.0f}) == Vector3(0.0f, 0.0f, 1.0f));
+
+TEST(LinearMathTests, SinCosMatchesTheStandardLibrary) {
+    std::vector<float> angles, sines, cosines;
+    for (int i = -2000; i <= 2000; i++) angles.push_back((float) i * 0.01f); // about -3 to 3 turns
+    angles.push_back(0.0f);
+    sines.resize(angles.size());
+    cosines.resize(angles.size());
+    linmath::sin_cos(angles.data(), sines.data(), cosines.data(), angles.size()); // odd count, has a tail
+    for (size_t i = 0; i < angles.size(); i++) {
+        ASSERT_NEAR(sines[i], std::sin(angles[i]), 1e-6f) << angles[i];
+        ASSERT_NEAR(cosines[i], std::cos(angles[i]), 1e-6f) << angles[i];
+    }
+    EXPECT_EQ(sines.back(), 0.0f); // exact at zero
+    EXPECT_EQ(cosines.back(), 1.0f);
+}
+
+TEST(LinearMathTests, ComposedTransformsMatchQuaternionRotations) {
+    const size_t count = 100; // more than a kernel batch
+    std::vector<float> px(count), py(count, -2.0f), pz(count, 0.5f);
+    std::vector<float> h(count), p(count), r(count);
+    std::vector<float> sx(count, 1.0f), sy(count, 2.0f), sz(count, 0.5f);
+    for (size_t i = 0; i < count; i++) {
+        px[i] = (float) i;
+        h[i] = (float) i * 7.0f;
+        p[i] = (float) i * -3.0f;
+        r[i] = (float) i * 11.0f;
+    }
+    std::vector<Matrix4> matrices(count);
+    linmath::compose_transforms(count, px.data(), py.data(), pz.data(), h.data(), p.data(), r.data(),
+                                sx.data(), sy.data(), sz.data(), matrices.data());
+    for (size_t i = 0; i < count; i++) {
+        Matrix4 scale(Vector4(sx[i], 0.0f, 0.0f, 0.0f), Vector4(0.0f, sy[i], 0.0f, 0.0f),
+                      Vector4(0.0f, 0.0f, sz[i], 0.0f), Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+        Matrix4 expected = Matrix4::translation({px[i], py[i], pz[i]}) *
+                           Quaternion::from_hpr({h[i], p[i], r[i]}).to_matrix() * scale;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                ASSERT_NEAR(matrices[i][column][row], expected[column][row], 1e-5f) << i;
+            }
+        }
+    }
+}
+
+TEST(LinearMathTests, HeadingTurnsClockwise) {
+    // Z axis is up, a 90 degree heading turns +X towards -Y
+    Vector3 turned = Quaternion::from_hpr({90.0f, 0.0f, 0.0f}).rotate({1.0f, 0.0f, 0.0f});
+    EXPECT_NEAR(turned.x, 0.0f, 1e-6f);
+    EXPECT_NEAR(turned.y, -1.0f, 1e-6f);
+    Quaternion halfway = Quaternion::nlerp({}, Quaternion::from_hpr({90.0f, 0.0f, 0.0f}), 0.5f);
+    EXPECT_NEAR(halfway.rotate({1.0f, 0.0f, 0.0f}).y, -std::sqrt(0.5f), 1e-6f);
+}
+
+TEST(LinearMathTests, ConvertsToGlmWithTheSameLayout) {
+    Matrix4 matrix = Matrix4::translation({1.0f, 2.0f, 3.0f});
+    glm::mat4 converted = matrix;
+    EXPECT_EQ(converted[3][1], 2.0f);
+    EXPECT_EQ(Matrix4(converted), matrix);
+}
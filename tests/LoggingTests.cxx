@@ -0,0 +1,77 @@
+/*
+ * LoggingTests.cxx
+ * Unit tests for the rate limited & sampled log macros.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "../include/Vulkray/Logging.h"
+
+// Captures the default logger's output (one message per line) while it's alive
+class CapturedLog {
+public:
+    std::ostringstream output;
+    CapturedLog() {
+        this->previousLogger = spdlog::default_logger();
+        auto logger = std::make_shared<spdlog::logger>(
+                "test", std::make_shared<spdlog::sinks::ostream_sink_st>(this->output));
+        logger->set_pattern("%v");
+        logger->set_level(spdlog::level::debug);
+        spdlog::set_default_logger(logger);
+    }
+    ~CapturedLog() {
+        spdlog::set_default_logger(this->previousLogger);
+    }
+    size_t lines() {
+        std::string text = this->output.str();
+        return std::count(text.begin(), text.end(), '\n');
+    }
+private:
+    std::shared_ptr<spdlog::logger> previousLogger;
+};
+
+TEST(LoggingTests, EveryNLogsTheFirstOfEveryNCalls) {
+    CapturedLog log;
+    for (int frame = 0; frame < 10; frame++) {
+        VULKRAY_LOG_EVERY_N(spdlog::level::info, 4, "frame {0}", frame);
+    }
+    EXPECT_EQ(log.lines(), 3u);
+    EXPECT_EQ(log.output.str(), "frame 0\nframe 4\nframe 8\n");
+}
+
+TEST(LoggingTests, EveryMsLogsOncePerInterval) {
+    CapturedLog log;
+    for (int frame = 0; frame < 100; frame++) {
+        VULKRAY_LOG_EVERY_MS(spdlog::level::warn, 60 * 60 * 1000, "frame {0}", frame);
+    }
+    EXPECT_EQ(log.output.str(), "frame 0\n");
+
+    // a new interval logs again, every log site keeps its own
+    std::atomic<int64_t> lastLogged{VULKRAY_LOG_SITE_NEVER_LOGGED};
+    EXPECT_TRUE(vulkray_log_interval_passed(lastLogged, 0));
+    EXPECT_TRUE(vulkray_log_interval_passed(lastLogged, 0));
+    EXPECT_FALSE(vulkray_log_interval_passed(lastLogged, 60 * 60 * 1000));
+}
+
+TEST(LoggingTests, DebugOutputIsCompiledOutOfReleaseBuilds) {
+    CapturedLog log;
+    int evaluations = 0;
+    VULKRAY_LOG_DEBUG("evaluated {0}", ++evaluations);
+#ifndef NDEBUG
+    EXPECT_EQ(evaluations, 1);
+    EXPECT_EQ(log.output.str(), "evaluated 1\n");
+#else
+    EXPECT_EQ(evaluations, 0);
+    EXPECT_EQ(log.lines(), 0u);
+#endif
+}
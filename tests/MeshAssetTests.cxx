@@ -0,0 +1,78 @@
+/*
+ * MeshAssetTests.cxx
+ * Unit tests for writing & loading the binary mesh asset format.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "../include/Vulkray/MeshAsset.h"
+
+static std::string getTestPath(const char *name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST(MeshAssetTests, WrittenMeshesLoadInTheirPackedFormat) {
+    std::string path = getTestPath("vulkray_test_asset.vkrmesh");
+    MeshAssetSource triangle;
+    triangle.vertices = {{{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+                         {{2.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+                         {{0.0f, 4.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}};
+    triangle.indices = {0, 1, 2};
+    MeshAssetSource compact = triangle;
+    compact.vertexFormat = VERTEX_FORMAT_COMPACT;
+    MeshAssetInstance instance{};
+    instance.model[0] = instance.model[5] = instance.model[10] = instance.model[15] = 1.0f;
+    instance.materialIndex = 3;
+    compact.instances = {instance, instance};
+    MeshAsset::write(path, {triangle, compact});
+    {
+        MeshAsset asset(path);
+        ASSERT_EQ(asset.get_mesh_count(), 2u);
+        const MeshAssetView &first = asset.get_mesh(0);
+        EXPECT_EQ(first.vertexFormat, (VertexFormat) VERTEX_FORMAT_DEFAULT);
+        EXPECT_EQ(first.indexSize, 2u);
+        EXPECT_EQ(first.instanceCount, 0u);
+        uint32_t stride = vertexformat::get_stride(VERTEX_FORMAT_DEFAULT); // float pos & color, as in Vertex
+        EXPECT_EQ(std::memcmp(first.vertexData + stride, &triangle.vertices[1], stride), 0);
+        uint16_t indices[3];
+        std::memcpy(indices, first.indexData, sizeof(indices));
+        EXPECT_EQ(indices[2], 2);
+        Vertex vertex = vertexformat::unpack_vertex(first.vertexFormat, first.quantization,
+                                                    first.vertexData + 2 * stride);
+        EXPECT_FLOAT_EQ(vertex.pos.y, 4.0f);
+        EXPECT_GE(first.boundingSphere.w, 2.0f);
+
+        const MeshAssetView &second = asset.get_mesh(1);
+        EXPECT_EQ(second.vertexFormat, (VertexFormat) VERTEX_FORMAT_COMPACT);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(second.vertexData) % MESH_ASSET_ALIGNMENT, 0u);
+        vertex = vertexformat::unpack_vertex(second.vertexFormat, second.quantization,
+                                             second.vertexData + vertexformat::get_stride(VERTEX_FORMAT_COMPACT));
+        EXPECT_NEAR(vertex.pos.x, 2.0f, 1e-3f);
+        ASSERT_EQ(second.instanceCount, 2u);
+        EXPECT_EQ(second.instances[1].materialIndex, 3u);
+        EXPECT_THROW(asset.get_mesh(2), std::runtime_error);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(MeshAssetTests, TruncatedFilesAreRejected) {
+    std::string path = getTestPath("vulkray_test_truncated.vkrmesh");
+    MeshAssetSource quad;
+    quad.vertices = {{{0, 0, 0}, {1, 1, 1}}, {{1, 0, 0}, {1, 1, 1}}, {{1, 1, 0}, {1, 1, 1}}, {{0, 1, 0}, {1, 1, 1}}};
+    quad.indices = {0, 1, 2, 2, 3, 0};
+    MeshAsset::write(path, {quad});
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+    EXPECT_THROW(MeshAsset asset(path), std::runtime_error);
+    { std::ofstream garbage(path, std::ios::binary | std::ios::trunc); garbage << "not a mesh asset file"; }
+    EXPECT_THROW(MeshAsset asset(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
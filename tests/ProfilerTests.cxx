@@ -0,0 +1,99 @@
+/*
+ * ProfilerTests.cxx
+ * Unit tests for the Profiler's rolling percentiles and trace captures.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "../include/Vulkray/Profiler.h"
+
+TEST(ProfilerTests, StagePercentilesRollOverTheHistory) {
+    Profiler profiler(true);
+    // 1 to 100 ms, then 1 ms over and over, pushing the slow frames out of the rolling window
+    for (uint64_t i = 1; i <= 100; i++) {
+        profiler._record_stage("record", 0, i * 1000000);
+        profiler._begin_frame();
+    }
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("record", 50), 50.0);
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("record", 99), 99.0);
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("record", 100), 100.0);
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("unknown", 50), 0.0);
+
+    for (int i = 0; i < PROFILER_HISTORY_FRAMES; i++) {
+        profiler._record_stage("record", 0, 1000000);
+        profiler._begin_frame();
+    }
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("record", 100), 1.0);
+}
+
+TEST(ProfilerTests, DisabledProfilerRecordsNothing) {
+    Profiler profiler(false);
+    {
+        ProfileScope scope(&profiler, "submit");
+    }
+    profiler._begin_frame();
+    profiler._begin_frame();
+    profiler._record_gpu_frame(5000000);
+    EXPECT_DOUBLE_EQ(profiler.get_frame_time(50), 0.0);
+    EXPECT_DOUBLE_EQ(profiler.get_gpu_frame_time(50), 0.0);
+    EXPECT_DOUBLE_EQ(profiler.get_stage_time("submit", 50), 0.0);
+}
+
+TEST(ProfilerTests, CapturesAreSavedAsChromeTraces) {
+    Profiler profiler(true);
+    profiler.start_capture();
+    profiler._begin_frame();
+    profiler._record_stage("fence wait", 1000, 3000);
+    profiler._record_gpu_region("GPU render pass", 2000, 9000);
+    profiler._begin_frame();
+
+    const char *path = "profiler_capture_test.json";
+    ASSERT_TRUE(profiler.stop_capture(path));
+    EXPECT_FALSE(profiler.is_capturing());
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::remove(path);
+
+    std::string trace = contents.str();
+    EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"fence wait\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1.000,\"dur\":2.000}"),
+              std::string::npos);
+    EXPECT_NE(trace.find("\"GPU render pass\",\"ph\":\"X\",\"pid\":1,\"tid\":2"), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"frame\""), std::string::npos);
+    EXPECT_FALSE(profiler.stop_capture(path)); // not capturing anymore
+}
+
+TEST(ProfilerTests, StartupPhasesAreKeptAndCaptured) {
+    Profiler profiler(true);
+    profiler._record_startup_phase("device selection", 1000, 4000);
+    profiler._record_startup_phase("shader load", 2000, 3000); // background phases overlap the others
+    EXPECT_DOUBLE_EQ(profiler.get_startup_time(), 0.0);
+    profiler._startup_finished(0);
+    EXPECT_GT(profiler.get_startup_time(), 0.0);
+    EXPECT_DOUBLE_EQ(profiler.get_startup_phase_time("device selection"), 0.003);
+    EXPECT_DOUBLE_EQ(profiler.get_startup_phase_time("pipelines"), 0.0);
+    ASSERT_EQ(profiler.get_startup_phases().size(), 3u);
+    EXPECT_STREQ(profiler.get_startup_phases().back().name, "startup");
+    EXPECT_TRUE(profiler.get_stage_names().empty()); // not frame stages
+
+    // captures started after the startup still show it
+    profiler.start_capture();
+    const char *path = "profiler_startup_test.json";
+    ASSERT_TRUE(profiler.stop_capture(path));
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::remove(path);
+    EXPECT_NE(contents.str().find("{\"name\":\"shader load\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":2.000"),
+              std::string::npos);
+}
@@ -0,0 +1,132 @@
+/*
+ * RenderGraphTests.cxx
+ * Unit tests for the render graph's pass culling, subpass merging, barriers & transient image aliasing.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include "../include/Vulkray/RenderGraph.h"
+
+const uint32_t COLOR_FORMAT = 44; // VK_FORMAT_B8G8R8A8_UNORM
+const uint32_t HDR_FORMAT = 97; // VK_FORMAT_R16G16B16A16_SFLOAT
+const uint32_t DEPTH_FORMAT = 126; // VK_FORMAT_D32_SFLOAT
+
+TEST(RenderGraphTests, MultisampledAttachmentsStayInTileMemory) {
+    // the renderer's own frame: a multisampled scene resolved into the presented swap image
+    RenderGraph graph;
+    RenderImage color = graph.add_image("scene color", COLOR_FORMAT, 4);
+    RenderImage depth = graph.add_image("scene depth", DEPTH_FORMAT, 4);
+    RenderImage frame = graph.import_image("frame", COLOR_FORMAT, RENDER_USAGE_PRESENT);
+    uint32_t scene = graph.add_pass("scene", RENDER_PASS_RASTER);
+    graph.write_color(scene, color, true);
+    graph.write_depth(scene, depth, true);
+    graph.write_resolve(scene, frame);
+    RenderGraphPlan plan = graph.compile();
+
+    ASSERT_EQ(plan.groups.size(), 1u);
+    const RenderGroupPlan &group = plan.groups[0];
+    ASSERT_EQ(group.attachments.size(), 3u);
+    EXPECT_EQ(group.attachments[0].loadOp, RENDER_LOAD_CLEAR);
+    EXPECT_FALSE(group.attachments[0].store);
+    EXPECT_FALSE(group.attachments[1].store);
+    EXPECT_TRUE(group.attachments[2].store);
+    EXPECT_EQ(group.attachments[2].loadOp, RENDER_LOAD_DONT_CARE);
+    EXPECT_EQ(group.attachments[2].finalUsage, (uint32_t) RENDER_USAGE_PRESENT);
+    ASSERT_EQ(group.subpasses.size(), 1u);
+    EXPECT_EQ(group.subpasses[0].resolveAttachments, std::vector<uint32_t>{2});
+    EXPECT_EQ(group.subpasses[0].depthAttachment, 1u);
+    EXPECT_TRUE(group.barriers.empty());
+
+    EXPECT_TRUE(plan.images[color].lazy);
+    EXPECT_TRUE(plan.images[depth].lazy);
+    EXPECT_TRUE(plan.images[depth].depth);
+    EXPECT_EQ(plan.images[frame].slot, RENDER_GRAPH_NONE); // imported images aren't allocated by the graph
+    EXPECT_EQ(plan.slots.size(), 2u);
+}
+
+TEST(RenderGraphTests, PassesMergeCullAndAlias) {
+    RenderGraph graph;
+    RenderImage albedo = graph.add_image("albedo", COLOR_FORMAT);
+    RenderImage depth = graph.add_image("depth", DEPTH_FORMAT);
+    RenderImage hdr = graph.add_image("hdr", HDR_FORMAT);
+    RenderImage debug = graph.add_image("debug", COLOR_FORMAT);
+    RenderImage bloom = graph.add_image("bloom", HDR_FORMAT);
+    RenderImage blur = graph.add_image("blur", HDR_FORMAT);
+    RenderImage frame = graph.import_image("frame", COLOR_FORMAT, RENDER_USAGE_PRESENT);
+
+    uint32_t geometry = graph.add_pass("geometry", RENDER_PASS_RASTER);
+    graph.write_color(geometry, albedo, true);
+    graph.write_depth(geometry, depth, true);
+    uint32_t lighting = graph.add_pass("lighting", RENDER_PASS_RASTER);
+    graph.read(lighting, albedo, RENDER_USAGE_INPUT_ATTACHMENT);
+    graph.write_color(lighting, hdr, true);
+    uint32_t unused = graph.add_pass("debug view", RENDER_PASS_RASTER); // nothing reads its result
+    graph.write_color(unused, debug, true);
+    uint32_t bloomPass = graph.add_pass("bloom", RENDER_PASS_COMPUTE);
+    graph.read(bloomPass, hdr, RENDER_USAGE_SAMPLED);
+    graph.write(bloomPass, bloom, RENDER_USAGE_STORAGE);
+    uint32_t blurPass = graph.add_pass("blur", RENDER_PASS_COMPUTE);
+    graph.read(blurPass, bloom, RENDER_USAGE_SAMPLED);
+    graph.write(blurPass, blur, RENDER_USAGE_STORAGE);
+    uint32_t tonemap = graph.add_pass("tonemap", RENDER_PASS_RASTER);
+    graph.read(tonemap, blur, RENDER_USAGE_SAMPLED);
+    graph.write_color(tonemap, frame, true);
+    RenderGraphPlan plan = graph.compile();
+
+    // the lighting pass only reads the geometry pass' pixels, so they're subpasses of one render pass
+    ASSERT_EQ(plan.groups.size(), 4u);
+    EXPECT_EQ(plan.passGroups[geometry], 0u);
+    EXPECT_EQ(plan.passGroups[lighting], 0u);
+    EXPECT_EQ(plan.passSubpasses[lighting], 1u);
+    EXPECT_EQ(plan.passGroups[unused], RENDER_GRAPH_NONE);
+    bool subpassDependency = false;
+    for (const RenderDependencyPlan &dependency : plan.groups[0].dependencies) {
+        if (dependency.srcSubpass == 0 && dependency.dstSubpass == 1) subpassDependency = dependency.byRegion;
+    }
+    EXPECT_TRUE(subpassDependency);
+
+    EXPECT_TRUE(plan.images[albedo].lazy);
+    EXPECT_FALSE(plan.images[hdr].lazy);
+    const RenderAttachmentPlan &hdrAttachment = plan.groups[0].attachments.back();
+    EXPECT_EQ(hdrAttachment.image, hdr);
+    EXPECT_TRUE(hdrAttachment.store);
+    EXPECT_EQ(hdrAttachment.finalUsage, (uint32_t) RENDER_USAGE_SAMPLED); // transitioned by the render pass
+
+    // the bloom pass reads hdr in the layout the render pass left it in, only its own output needs a barrier
+    ASSERT_EQ(plan.groups[1].barriers.size(), 1u);
+    EXPECT_EQ(plan.groups[1].barriers[0].image, bloom);
+    EXPECT_EQ(plan.groups[1].barriers[0].oldUsage, (uint32_t) RENDER_USAGE_UNDEFINED);
+    ASSERT_EQ(plan.groups[3].barriers.size(), 1u);
+    EXPECT_EQ(plan.groups[3].barriers[0].oldUsage, (uint32_t) RENDER_USAGE_STORAGE);
+    EXPECT_EQ(plan.groups[3].barriers[0].newUsage, (uint32_t) RENDER_USAGE_SAMPLED);
+
+    // hdr is done before blur is first written, they share an image (bloom overlaps both)
+    EXPECT_EQ(plan.images[blur].slot, plan.images[hdr].slot);
+    EXPECT_NE(plan.images[bloom].slot, plan.images[hdr].slot);
+    EXPECT_EQ(plan.images[debug].slot, RENDER_GRAPH_NONE);
+    // blur's first write waits on the bloom pass still sampling hdr in the shared memory
+    uint32_t blurOldUsage = RENDER_GRAPH_NONE;
+    for (const RenderBarrierPlan &barrier : plan.groups[2].barriers) {
+        if (barrier.image == blur) blurOldUsage = barrier.oldUsage;
+    }
+    EXPECT_EQ(blurOldUsage, RENDER_USAGE_SAMPLED);
+}
+
+TEST(RenderGraphTests, InvalidGraphsAreRejected) {
+    RenderGraph graph;
+    RenderImage color = graph.add_image("color", COLOR_FORMAT);
+    RenderImage frame = graph.import_image("frame", COLOR_FORMAT, RENDER_USAGE_PRESENT);
+    uint32_t compute = graph.add_pass("compute", RENDER_PASS_COMPUTE);
+    EXPECT_THROW(graph.write_color(compute, color, true), std::runtime_error);
+    uint32_t raster = graph.add_pass("raster", RENDER_PASS_RASTER);
+    EXPECT_THROW(graph.write_resolve(raster, frame), std::runtime_error); // nothing to resolve
+    graph.read(raster, color, RENDER_USAGE_SAMPLED); // never written
+    graph.write_color(raster, frame, true);
+    EXPECT_THROW(graph.compile(), std::runtime_error);
+}
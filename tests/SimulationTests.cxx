@@ -0,0 +1,57 @@
+/*
+ * SimulationTests.cxx
+ * Unit tests for the triple buffer handing the simulation thread's snapshots to the renderer.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "../include/Vulkray/Simulation.h"
+
+TEST(SimulationTests, ConsumerGetsTheLatestPublishedValue) {
+    TripleBuffer<int> buffer;
+    EXPECT_FALSE(buffer.update()); // nothing published yet
+
+    buffer.get_write_buffer() = 1;
+    buffer.publish();
+    buffer.get_write_buffer() = 2;
+    buffer.publish(); // overwrites 1 before the consumer got to it
+    EXPECT_TRUE(buffer.update());
+    EXPECT_EQ(buffer.get_read_buffer(), 2);
+    EXPECT_FALSE(buffer.update()); // the read value is kept until a newer one arrives
+    EXPECT_EQ(buffer.get_read_buffer(), 2);
+
+    buffer.get_write_buffer() = 3;
+    buffer.publish();
+    EXPECT_TRUE(buffer.update());
+    EXPECT_EQ(buffer.get_read_buffer(), 3);
+}
+
+TEST(SimulationTests, ValuesArriveWholeAndInOrderAcrossThreads) {
+    struct Pair {
+        uint64_t a = 0, b = 0;
+    };
+    TripleBuffer<Pair> buffer;
+    constexpr uint64_t count = 100000;
+    std::thread producer([&buffer] {
+        for (uint64_t i = 1; i <= count; i++) {
+            buffer.get_write_buffer() = {i, i * 2};
+            buffer.publish();
+        }
+    });
+    uint64_t last = 0;
+    while (last != count) {
+        if (!buffer.update()) continue;
+        const Pair &pair = buffer.get_read_buffer();
+        ASSERT_EQ(pair.b, pair.a * 2); // never half written
+        ASSERT_GT(pair.a, last); // never an older value
+        last = pair.a;
+    }
+    producer.join();
+}
@@ -0,0 +1,121 @@
+/*
+ * TextureStreamingTests.cxx
+ * Unit tests for the KTX2 texture loader & the texture streaming residency planning.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "../include/Vulkray/TextureRegistry.h"
+
+// Writes a KTX2 file with the given levels (an empty level list writes a file asking for generated mips)
+static std::string writeKtx2(const char *name, uint32_t format, uint32_t width, uint32_t height,
+                             const std::vector<std::vector<uint8_t>> &levels) {
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    uint32_t header[9] = {format, 1, width, height, 0, 0, 1, static_cast<uint32_t>(levels.size()), 0};
+    uint32_t sectionIndex[8] = {}; // data format descriptor, key/value & supercompression data (none)
+    std::vector<uint8_t> file(identifier, identifier + sizeof(identifier));
+    auto append = [&file](const void *data, size_t size) {
+        file.insert(file.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+    };
+    append(header, sizeof(header));
+    append(sectionIndex, sizeof(sectionIndex));
+    uint64_t offset = file.size() + std::max<size_t>(levels.size(), 1) * 24;
+    std::vector<uint64_t> index;
+    for (const std::vector<uint8_t> &level : levels) {
+        index.insert(index.end(), {offset, level.size(), level.size()});
+        offset += level.size();
+    }
+    if (levels.empty()) index = {offset, (uint64_t) width * height * 4, (uint64_t) width * height * 4};
+    append(index.data(), index.size() * sizeof(uint64_t));
+    for (const std::vector<uint8_t> &level : levels) append(level.data(), level.size());
+    if (levels.empty()) file.resize(file.size() + (size_t) width * height * 4);
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()),
+                                                (std::streamsize) file.size());
+    return path;
+}
+
+TEST(TextureStreamingTests, Ktx2LevelsPointIntoTheMappedFile) {
+    // BC1 (VK_FORMAT_BC1_RGB_UNORM_BLOCK) 8x4: two blocks, then one block for the 4x2 & 2x1 levels
+    std::vector<std::vector<uint8_t>> levels = {std::vector<uint8_t>(16, 1), std::vector<uint8_t>(8, 2),
+                                                std::vector<uint8_t>(8, 3), std::vector<uint8_t>(8, 4)};
+    std::string path = writeKtx2("vulkray_test_bc1.ktx2", 131, 8, 4, levels);
+    {
+        TextureAsset texture(path);
+        EXPECT_TRUE(texture.get_format_info().compressed);
+        EXPECT_EQ(texture.get_mip_count(), 4u);
+        EXPECT_FALSE(texture.needs_mip_generation());
+        const TextureLevel &level = texture.get_level(1);
+        EXPECT_EQ(level.width, 4u);
+        EXPECT_EQ(level.height, 2u);
+        EXPECT_EQ(level.size, 8u);
+        EXPECT_EQ(level.data[0], 2);
+        EXPECT_THROW(texture.get_level(4), std::runtime_error);
+    }
+    // RGBA8 without mip levels gets the full chain generated, level 0 is still read from the file
+    std::string generatedPath = writeKtx2("vulkray_test_rgba.ktx2", 37, 16, 4, {});
+    {
+        TextureAsset texture(generatedPath);
+        EXPECT_TRUE(texture.needs_mip_generation());
+        EXPECT_EQ(texture.get_mip_count(), 5u);
+        EXPECT_EQ(texture.get_stored_level_count(), 1u);
+        EXPECT_EQ(texture.get_level(0).rowPitch, 64u);
+    }
+    // levels sized for another format are rejected
+    std::string invalidPath = writeKtx2("vulkray_test_invalid.ktx2", 37, 8, 4, levels);
+    EXPECT_THROW(TextureAsset texture(invalidPath), std::runtime_error);
+    std::filesystem::remove(path);
+    std::filesystem::remove(generatedPath);
+    std::filesystem::remove(invalidPath);
+}
+
+static TextureResidencyRequest makeRequest(uint32_t size, uint32_t wantedLevel, float priority) {
+    TextureResidencyRequest request{};
+    request.mipCount = textureformat::get_mip_count(size, size);
+    for (uint32_t level = 0; level < request.mipCount; level++) {
+        uint32_t extent = textureformat::get_level_extent(size, level);
+        request.levelSizes[level] = (uint64_t) extent * extent * 4;
+    }
+    request.tailLevel = texturestreaming::get_tail_level(size, size, request.mipCount);
+    request.wantedLevel = wantedLevel;
+    request.residentLevel = request.mipCount;
+    request.priority = priority;
+    return request;
+}
+
+TEST(TextureStreamingTests, WantedLevelsFollowTheScreenCoverage) {
+    EXPECT_EQ(texturestreaming::get_tail_level(1024, 512, 11), 4u); // 64x32
+    EXPECT_EQ(texturestreaming::get_wanted_level(1024, 1024, 11, 2048.0f), 0u);
+    EXPECT_EQ(texturestreaming::get_wanted_level(1024, 1024, 11, 256.0f), 2u);
+    EXPECT_EQ(texturestreaming::get_wanted_level(1024, 1024, 11, 0.0f), 10u);
+}
+
+TEST(TextureStreamingTests, BudgetRefinesTheMostNeededTexturesFirst) {
+    // two 1024 textures, the budget fits the 128 & 256 levels of one of them on top of both mip tails
+    std::vector<TextureResidencyRequest> requests = {makeRequest(1024, 0, 1.0f), makeRequest(1024, 0, 2.0f)};
+    uint64_t tails = texturestreaming::get_resident_size(requests[0], requests[0].tailLevel) * 2;
+    texturestreaming::plan_residency(requests, tails + requests[0].levelSizes[3] + requests[0].levelSizes[2]);
+    EXPECT_EQ(requests[0].plannedLevel, requests[0].tailLevel);
+    EXPECT_EQ(requests[1].plannedLevel, 2u); // higher priority, refined first
+
+    // over budget, the tails still stay resident
+    texturestreaming::plan_residency(requests, 0);
+    EXPECT_EQ(requests[0].plannedLevel, requests[0].tailLevel);
+
+    // a texture one level sharper than it needs keeps its levels, two levels sharper drops them
+    requests = {makeRequest(1024, 3, 1.0f), makeRequest(1024, 3, 1.0f)};
+    requests[0].residentLevel = 2;
+    requests[1].residentLevel = 1;
+    texturestreaming::plan_residency(requests, UINT64_MAX);
+    EXPECT_EQ(requests[0].plannedLevel, 2u);
+    EXPECT_EQ(requests[1].plannedLevel, 3u);
+}
@@ -0,0 +1,123 @@
+/*
+ * TransformSystemTests.cxx
+ * Unit tests for the TransformSystem's hierarchy ordering and world matrix updates.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+#include "../include/Vulkray/TransformSystem.h"
+#include "../include/Vulkray/JobManager.h"
+
+static glm::vec3 world_position(TransformSystem &transforms, TransformHandle node) {
+    glm::mat4 world = transforms.get_world_matrix(node);
+    return {world[3][0], world[3][1], world[3][2]};
+}
+
+TEST(TransformSystemTests, ChildrenFollowTheirParents) {
+    TransformSystem transforms;
+    TransformHandle parent = transforms.create_node();
+    TransformHandle child = transforms.create_node(parent);
+    transforms.set_position(parent, 1.0f, 2.0f, 3.0f);
+    transforms.set_position(child, 1.0f, 0.0f, 0.0f);
+    transforms._update_world_matrices(nullptr);
+
+    glm::vec3 position = world_position(transforms, child);
+    EXPECT_FLOAT_EQ(position.x, 2.0f);
+    EXPECT_FLOAT_EQ(position.y, 2.0f);
+    EXPECT_FLOAT_EQ(position.z, 3.0f);
+
+    // heading turns clockwise (Z axis is up): +X rotates towards -Y
+    transforms.set_rotation(parent, 90.0f, 0.0f, 0.0f);
+    transforms._update_world_matrices(nullptr);
+    position = world_position(transforms, child);
+    EXPECT_NEAR(position.x, 1.0f, 1e-5f);
+    EXPECT_NEAR(position.y, 1.0f, 1e-5f);
+    EXPECT_TRUE(transforms.world_matrix_changed(child));
+}
+
+TEST(TransformSystemTests, ComputedWorldMatricesIncludePendingChanges) {
+    TransformSystem transforms;
+    TransformHandle parent = transforms.create_node();
+    TransformHandle child = transforms.create_node(parent);
+    transforms.set_position(child, 1.0f, 0.0f, 0.0f);
+    transforms._update_world_matrices(nullptr);
+    transforms.set_position(parent, 0.0f, 0.0f, 5.0f); // not updated yet
+
+    glm::mat4 computed = transforms.compute_world_matrix(child);
+    EXPECT_FLOAT_EQ(computed[3][0], 1.0f);
+    EXPECT_FLOAT_EQ(computed[3][2], 5.0f);
+    EXPECT_FLOAT_EQ(world_position(transforms, child).z, 0.0f); // the cached one is as of the last update
+    transforms._update_world_matrices(nullptr);
+    EXPECT_FLOAT_EQ(world_position(transforms, child).z, computed[3][2]);
+}
+
+TEST(TransformSystemTests, OnlyDirtyNodesAreRecomputed) {
+    TransformSystem transforms;
+    TransformHandle moving = transforms.create_node();
+    TransformHandle still = transforms.create_node();
+    transforms._update_world_matrices(nullptr);
+
+    uint32_t version = transforms.get_version(still);
+    transforms.set_position(moving, 5.0f, 0.0f, 0.0f);
+    transforms._update_world_matrices(nullptr);
+    EXPECT_TRUE(transforms.world_matrix_changed(moving));
+    EXPECT_FALSE(transforms.world_matrix_changed(still));
+    EXPECT_EQ(transforms.get_version(still), version);
+}
+
+TEST(TransformSystemTests, ReparentingReordersTheHierarchy) {
+    TransformSystem transforms;
+    TransformHandle child = transforms.create_node();
+    TransformHandle parent = transforms.create_node(); // created after its future child
+    transforms.set_position(parent, 0.0f, 0.0f, 10.0f);
+    transforms.set_position(child, 0.0f, 0.0f, 1.0f);
+    transforms.set_parent(child, parent);
+    transforms._update_world_matrices(nullptr);
+    EXPECT_FLOAT_EQ(world_position(transforms, child).z, 11.0f);
+
+    EXPECT_THROW(transforms.set_parent(parent, child), std::runtime_error); // would be a cycle
+}
+
+TEST(TransformSystemTests, DestroyedParentsDetachTheirChildren) {
+    TransformSystem transforms;
+    TransformHandle parent = transforms.create_node();
+    TransformHandle child = transforms.create_node(parent);
+    transforms.set_position(parent, 10.0f, 0.0f, 0.0f);
+    transforms.set_position(child, 1.0f, 0.0f, 0.0f);
+    transforms._update_world_matrices(nullptr);
+
+    transforms.destroy_node(parent);
+    EXPECT_FALSE(transforms.is_node_valid(parent));
+    TransformHandle other = transforms.create_node(); // reuses the destroyed node's slot
+    EXPECT_NE(other, parent);
+    transforms._update_world_matrices(nullptr);
+    EXPECT_FLOAT_EQ(world_position(transforms, child).x, 1.0f);
+    EXPECT_EQ(transforms.get_node_count(), 2u);
+}
+
+TEST(TransformSystemTests, ParallelUpdateMatchesSerialUpdate) {
+    JobManager jobManager(4);
+    TransformSystem serial, parallel;
+    std::vector<TransformHandle> serialNodes, parallelNodes;
+    // a few wide levels, so every level is split into several batches
+    for (uint32_t i = 0; i < 4 * TRANSFORM_BATCH_SIZE; i++) {
+        TransformHandle serialParent = i < TRANSFORM_BATCH_SIZE ? TransformHandle{} : serialNodes[i / 2];
+        TransformHandle parallelParent = i < TRANSFORM_BATCH_SIZE ? TransformHandle{} : parallelNodes[i / 2];
+        serialNodes.push_back(serial.create_node(serialParent));
+        parallelNodes.push_back(parallel.create_node(parallelParent));
+        serial.set_position(serialNodes[i], (float) i, 1.0f, 0.0f);
+        parallel.set_position(parallelNodes[i], (float) i, 1.0f, 0.0f);
+    }
+    serial._update_world_matrices(nullptr);
+    parallel._update_world_matrices(&jobManager);
+    for (uint32_t i = 0; i < serialNodes.size(); i++) {
+        ASSERT_EQ(serial.get_world_matrix(serialNodes[i]), parallel.get_world_matrix(parallelNodes[i]));
+    }
+}
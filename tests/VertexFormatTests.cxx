@@ -0,0 +1,85 @@
+/*
+ * VertexFormatTests.cxx
+ * Unit tests for the vertex format layouts & the quantized attribute packing.
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../include/Vulkray/VertexFormat.h"
+
+TEST(VertexFormatTests, LayoutsPackAttributesInOrder) {
+    EXPECT_EQ(vertexformat::get_stride(VERTEX_FORMAT_DEFAULT), 24u);
+    EXPECT_EQ(vertexformat::get_stride(VERTEX_FORMAT_COMPACT), 12u); // half of the default format
+    VertexFormat surface = VERTEX_FORMAT_QUANTIZED | VERTEX_FORMAT_NORMALS | VERTEX_FORMAT_UVS;
+    EXPECT_EQ(vertexformat::get_stride(surface), 20u);
+    EXPECT_EQ(vertexformat::get_attribute_offset(surface, VERTEX_ATTRIBUTE_NORMAL), 12u);
+    EXPECT_EQ(vertexformat::get_attribute_offset(surface, VERTEX_ATTRIBUTE_UV), 16u);
+    EXPECT_EQ(vertexformat::get_attribute_offset(VERTEX_FORMAT_UVS, VERTEX_ATTRIBUTE_UV), 24u); // no normals
+    EXPECT_EQ(vertexformat::get_attribute_size(VERTEX_FORMAT_DEFAULT, VERTEX_ATTRIBUTE_NORMAL), 0u);
+    EXPECT_FALSE(vertexformat::is_valid(8));
+}
+
+TEST(VertexFormatTests, HalfFloatsRoundToNearestEven) {
+    EXPECT_EQ(vertexformat::pack_half(1.0f), 0x3C00);
+    EXPECT_EQ(vertexformat::pack_half(-2.0f), 0xC000);
+    EXPECT_EQ(vertexformat::pack_half(65504.0f), 0x7BFF); // largest half float
+    EXPECT_EQ(vertexformat::pack_half(70000.0f), 0x7C00); // overflows to infinity
+    EXPECT_EQ(vertexformat::pack_half(1.0f + 1.0f / 2048.0f), 0x3C00); // halfway, rounds to the even mantissa
+    EXPECT_EQ(vertexformat::pack_half(std::ldexp(1.0f, -24)), 0x0001); // smallest subnormal
+    for (float value : {0.0f, 0.5f, -0.333f, 0.999f, 1024.25f, 0.0001f}) {
+        EXPECT_NEAR(vertexformat::unpack_half(vertexformat::pack_half(value)), value, std::abs(value) / 1024.0f);
+    }
+}
+
+TEST(VertexFormatTests, OctahedralNormalsRoundTrip) {
+    std::vector<glm::vec3> normals = {
+            {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+            {0.577350f, -0.577350f, -0.577350f}, {0.267261f, 0.534522f, -0.801784f}
+    };
+    for (const glm::vec3 &normal : normals) {
+        glm::vec2 encoded = vertexformat::encode_octahedral(normal);
+        EXPECT_LE(std::abs(encoded.x), 1.0f); // the lower half unfolds into the square's corners
+        EXPECT_LE(std::abs(encoded.y), 1.0f);
+        glm::vec3 decoded = vertexformat::decode_octahedral(
+                {vertexformat::unpack_snorm16(vertexformat::pack_snorm16(encoded.x)),
+                 vertexformat::unpack_snorm16(vertexformat::pack_snorm16(encoded.y))});
+        for (int axis = 0; axis < 3; axis++) EXPECT_NEAR(decoded[axis], normal[axis], 1e-4f);
+    }
+}
+
+TEST(VertexFormatTests, QuantizedVerticesStayWithinTheMeshBounds) {
+    std::vector<Vertex> vertices = {
+            {{-2.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.25f, 0.75f}},
+            {{6.0f, 3.0f, 1.0f}, {0.2f, 1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {1.0f, 0.0f}},
+            {{1.0f, 2.0f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.5f, 0.5f}}
+    };
+    VertexQuantization quantization = VertexQuantization::fit(vertices);
+    EXPECT_FLOAT_EQ(quantization.scale, 4.0f); // half of the longest (x) side
+    EXPECT_FLOAT_EQ(quantization.offset.x, 2.0f);
+    EXPECT_TRUE(quantization.contains({6.0f, 2.0f, 0.5f}));
+    EXPECT_FALSE(quantization.contains({6.5f, 2.0f, 0.5f}));
+
+    VertexFormat format = VERTEX_FORMAT_QUANTIZED | VERTEX_FORMAT_NORMALS | VERTEX_FORMAT_UVS;
+    std::vector<uint8_t> packed;
+    vertexformat::pack_vertices(format, quantization, vertices.data(), vertices.size(), packed);
+    ASSERT_EQ(packed.size(), vertices.size() * vertexformat::get_stride(format));
+    for (size_t i = 0; i < vertices.size(); i++) {
+        Vertex unpacked = vertexformat::unpack_vertex(format, quantization,
+                                                      packed.data() + i * vertexformat::get_stride(format));
+        for (int axis = 0; axis < 3; axis++) {
+            EXPECT_NEAR(unpacked.pos[axis], vertices[i].pos[axis], quantization.scale / 32767.0f);
+            EXPECT_NEAR(unpacked.color[axis], vertices[i].color[axis], 1.0f / 255.0f);
+            EXPECT_NEAR(unpacked.normal[axis], vertices[i].normal[axis], 1e-4f);
+        }
+        EXPECT_NEAR(unpacked.uv.x, vertices[i].uv.x, 1e-3f);
+        EXPECT_NEAR(unpacked.uv.y, vertices[i].uv.y, 1e-3f);
+    }
+}
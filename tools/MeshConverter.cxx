@@ -0,0 +1,156 @@
+/*
+ * MeshConverter.cxx
+ * Offline tool converting Wavefront OBJ files to the engine's binary mesh asset format (.vkrmesh).
+ *
+ * VULKRAY ENGINE SOFTWARE
+ * Copyright (c) 2023, Max Rodriguez. All rights reserved.
+ *
+ * All use of this software is subject to the terms of the revised BSD
+ * license. You should have received a copy of this license along
+ * with this source code in a file named "COPYING."
+ */
+
+#include "../include/Vulkray/MeshAsset.h"
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+/* Every object ('o') and group ('g') of the OBJ file becomes a mesh of its own. Polygons are triangulated as
+ * fans, vertices are deduplicated by their position, texture coordinate & normal indices. Vertex colors are
+ * read from the common "v x y z r g b" extension, vertices without them are white.
+ */
+struct ObjReader {
+    VertexFormat format;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<MeshAssetSource> meshes;
+    std::unordered_map<std::string, uint32_t> meshVertices; // "v/vt/vn" -> index of the current mesh's vertex
+
+    // OBJ indices start at 1, negative ones count back from the last element read so far
+    static int64_t resolveIndex(const std::string &token, size_t count) {
+        if (token.empty()) return -1;
+        int64_t index = std::stoll(token);
+        if (index < 0) index += (int64_t) count;
+        else index -= 1;
+        if (index < 0 || index >= (int64_t) count) throw std::runtime_error("OBJ face index out of range.");
+        return index;
+    }
+
+    void startMesh() {
+        if (!this->meshes.empty() && this->meshes.back().indices.empty()) return; // reuse the empty one
+        this->meshes.emplace_back().vertexFormat = this->format;
+        this->meshVertices.clear();
+    }
+
+    uint32_t faceVertex(const std::string &corner) {
+        auto existing = this->meshVertices.find(corner);
+        if (existing != this->meshVertices.end()) return existing->second;
+        std::string tokens[3];
+        size_t start = 0;
+        for (int i = 0; i < 3 && start <= corner.size(); i++) {
+            size_t slash = corner.find('/', start);
+            tokens[i] = corner.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+            if (slash == std::string::npos) break;
+            start = slash + 1;
+        }
+        Vertex vertex{};
+        int64_t position = resolveIndex(tokens[0], this->positions.size());
+        if (position < 0) throw std::runtime_error("OBJ face corner without a position.");
+        vertex.pos = this->positions[position];
+        vertex.color = this->colors[position];
+        int64_t uv = resolveIndex(tokens[1], this->uvs.size());
+        if (uv >= 0) vertex.uv = this->uvs[uv];
+        int64_t normal = resolveIndex(tokens[2], this->normals.size());
+        if (normal >= 0) vertex.normal = this->normals[normal];
+
+        MeshAssetSource &mesh = this->meshes.back();
+        auto index = static_cast<uint32_t>(mesh.vertices.size());
+        mesh.vertices.push_back(vertex);
+        this->meshVertices[corner] = index;
+        return index;
+    }
+
+    void read(std::istream &input) {
+        this->startMesh();
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream stream(line);
+            std::string type;
+            stream >> type;
+            if (type == "v") {
+                glm::vec3 position(0.0f), color(1.0f);
+                stream >> position.x >> position.y >> position.z;
+                if (!(stream >> color.x >> color.y >> color.z)) color = glm::vec3(1.0f);
+                this->positions.push_back(position);
+                this->colors.push_back(color);
+            } else if (type == "vt") {
+                glm::vec2 uv(0.0f, 0.0f);
+                stream >> uv.x >> uv.y;
+                this->uvs.push_back(uv);
+            } else if (type == "vn") {
+                glm::vec3 normal(0.0f);
+                stream >> normal.x >> normal.y >> normal.z;
+                this->normals.push_back(normal);
+            } else if (type == "o" || type == "g") {
+                this->startMesh();
+            } else if (type == "f") {
+                std::vector<uint32_t> polygon;
+                std::string corner;
+                while (stream >> corner) polygon.push_back(this->faceVertex(corner));
+                std::vector<uint32_t> &indices = this->meshes.back().indices;
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    indices.insert(indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+                }
+            }
+        }
+        if (this->meshes.back().indices.empty()) this->meshes.pop_back();
+    }
+};
+
+static void printUsage() {
+    spdlog::info("Usage: vulkray-mesh-converter [--compact] [--normals] [--uvs] <input.obj> <output.vkrmesh>");
+    spdlog::info("  --compact  quantized vertices (16 bit positions, 8 bit colors, octahedral normals, half uvs)");
+    spdlog::info("  --normals  store the vertex normals");
+    spdlog::info("  --uvs      store the texture coordinates");
+}
+
+int main(int argc, char **argv) {
+    VertexFormat format = VERTEX_FORMAT_DEFAULT;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compact") == 0) format |= VERTEX_FORMAT_QUANTIZED;
+        else if (strcmp(argv[i], "--normals") == 0) format |= VERTEX_FORMAT_NORMALS;
+        else if (strcmp(argv[i], "--uvs") == 0) format |= VERTEX_FORMAT_UVS;
+        else paths.emplace_back(argv[i]);
+    }
+    if (paths.size() != 2) {
+        printUsage();
+        return 1;
+    }
+    std::ifstream input(paths[0]);
+    if (!input.is_open()) {
+        spdlog::error("Failed to open the OBJ file '{0}'.", paths[0]);
+        return 1;
+    }
+    try {
+        ObjReader reader{format};
+        reader.read(input);
+        if (reader.meshes.empty()) {
+            spdlog::error("The OBJ file '{0}' has no faces to convert.", paths[0]);
+            return 1;
+        }
+        MeshAsset::write(paths[1], reader.meshes);
+        size_t vertexCount = 0;
+        for (const MeshAssetSource &mesh : reader.meshes) vertexCount += mesh.vertices.size();
+        spdlog::info("Wrote {0} meshes ({1} vertices of {2} bytes) to '{3}'.", reader.meshes.size(), vertexCount,
+                     vertexformat::get_stride(format), paths[1]);
+    } catch (const std::exception &error) {
+        spdlog::error("Failed to convert '{0}': {1}", paths[0], error.what());
+        return 1;
+    }
+    return 0;
+}